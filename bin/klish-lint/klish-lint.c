@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include <faux/faux.h>
+#include <faux/str.h>
+#include <faux/list.h>
+#include <klish/kscheme.h>
+#include <klish/kxml.h>
+
+#include "private.h"
+
+
+int main(int argc, char *argv[])
+{
+	int retval = -1;
+	struct options *opts = NULL;
+	faux_list_node_t *iter = NULL;
+	const char *file = NULL;
+	char *path = NULL;
+	kscheme_t *scheme = NULL;
+	char *error = NULL;
+	int check = 0;
+	struct timespec start = {};
+	struct timespec stop = {};
+
+	// Parse command line options
+	opts = opts_init();
+	if (opts_parse(argc, argv, opts))
+		goto err;
+
+	iter = faux_list_head(opts->files);
+	while ((file = (const char *)faux_list_each(&iter))) {
+		if (path)
+			faux_str_cat(&path, KXML_PATH_DELIM);
+		faux_str_cat(&path, file);
+	}
+
+	// Files are parsed concurrently then merged and linked
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	scheme = kxml_load(path, opts->jobs, &error);
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+	if (!scheme) {
+		fprintf(stderr, "%s", error);
+		faux_str_free(error);
+		goto err;
+	}
+
+	check = stat_check(scheme);
+
+	if (!opts->quiet) {
+		printf("Load time: %.3f ms\n",
+			(stop.tv_sec - start.tv_sec) * 1000.0 +
+			(stop.tv_nsec - start.tv_nsec) / 1000000.0);
+		if (stat_show(scheme, opts->verbose) < 0)
+			goto err;
+	}
+
+	if (check < 0)
+		goto err;
+
+	retval = 0;
+err:
+	kscheme_free(scheme);
+	faux_str_free(path);
+	opts_free(opts);
+
+	return retval;
+}
@@ -0,0 +1,141 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include <faux/faux.h>
+#include <faux/str.h>
+#include <faux/list.h>
+#include <faux/conv.h>
+#include <klish/kscheme.h>
+
+#include "private.h"
+
+
+/** @brief Initialize option structure by defaults
+ */
+struct options *opts_init(void)
+{
+	struct options *opts = NULL;
+
+	opts = faux_zmalloc(sizeof(*opts));
+	assert(opts);
+
+	// Initialize
+	opts->files = faux_list_new(FAUX_LIST_UNSORTED, FAUX_LIST_NONUNIQUE,
+		NULL, NULL, (void (*)(void *))faux_str_free);
+	assert(opts->files);
+	opts->jobs = 0; // Number of CPUs
+	opts->quiet = BOOL_FALSE;
+	opts->verbose = BOOL_FALSE;
+
+	return opts;
+}
+
+
+/** @brief Free options structure
+ */
+void opts_free(struct options *opts)
+{
+	faux_list_free(opts->files);
+	faux_free(opts);
+}
+
+
+/** @brief Parse command line options
+ */
+int opts_parse(int argc, char *argv[], struct options *opts)
+{
+	static const char *shortopts = "hj:qv";
+	static const struct option longopts[] = {
+		{"help",		0, NULL, 'h'},
+		{"jobs",		1, NULL, 'j'},
+		{"quiet",		0, NULL, 'q'},
+		{"verbose",		0, NULL, 'v'},
+		{NULL,			0, NULL, 0}
+	};
+
+	optind = 1;
+	while(1) {
+		int opt = 0;
+
+		opt = getopt_long(argc, argv, shortopts, longopts, NULL);
+		if (-1 == opt)
+			break;
+		switch (opt) {
+		case 'j':
+			if (!faux_conv_atoui(optarg, &opts->jobs, 0) ||
+				(0 == opts->jobs) || (opts->jobs > MAX_JOBS)) {
+				fprintf(stderr, "Error: Illegal number of jobs %s.\n",
+					optarg);
+				_exit(-1);
+			}
+			break;
+		case 'q':
+			opts->quiet = BOOL_TRUE;
+			break;
+		case 'v':
+			opts->verbose = BOOL_TRUE;
+			break;
+		case 'h':
+			help(0, argv[0]);
+			_exit(0);
+			break;
+		default:
+			help(-1, argv[0]);
+			_exit(-1);
+			break;
+		}
+	}
+
+	if (optind >= argc) {
+		fprintf(stderr, "Error: Scheme files are not specified.\n");
+		help(-1, argv[0]);
+		_exit(-1);
+	}
+	for (; optind < argc; optind++)
+		faux_list_add(opts->files, faux_str_dup(argv[optind]));
+
+	return 0;
+}
+
+
+/** @brief Print help message
+ */
+void help(int status, const char *argv0)
+{
+	const char *name = NULL;
+
+	if (!argv0)
+		return;
+
+	// Find the basename
+	name = strrchr(argv0, '/');
+	if (name)
+		name++;
+	else
+		name = argv0;
+
+	if (status != 0) {
+		fprintf(stderr, "Try `%s -h' for more information.\n",
+			name);
+	} else {
+		printf("Version : %s\n", VERSION);
+		printf("Usage   : %s [options] <file|dir> [<file|dir> ...]\n",
+			name);
+		printf("Klish scheme validator. Loads scheme files (all "
+			"*.xml and *.lua files for directory), resolves "
+			"references and shows scheme statistics.\n");
+		printf("Options :\n");
+		printf("\t-h, --help Print this help.\n");
+		printf("\t-j <num>, --jobs=<num> Number of files to parse "
+			"concurrently (number of CPUs).\n");
+		printf("\t-q, --quiet Validate only. Don't show statistics.\n");
+		printf("\t-v, --verbose Be verbose. Show details of "
+			"statistics.\n");
+	}
+}
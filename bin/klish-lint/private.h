@@ -0,0 +1,25 @@
+#ifndef VERSION
+#define VERSION "1.0.0"
+#endif
+
+#define MAX_JOBS 256
+
+
+/** @brief Command line options
+ */
+struct options {
+	faux_list_t *files; // Files and directories
+	unsigned int jobs; // Number of parallel workers. 0 - number of CPUs.
+	bool_t quiet; // Validate only. Don't show statistics.
+	bool_t verbose;
+};
+
+// Options
+void help(int status, const char *argv0);
+struct options *opts_init(void);
+void opts_free(struct options *opts);
+int opts_parse(int argc, char *argv[], struct options *opts);
+
+// Statistics
+int stat_check(const kscheme_t *scheme);
+int stat_show(kscheme_t *scheme, bool_t verbose);
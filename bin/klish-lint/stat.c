@@ -0,0 +1,772 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include <sys/types.h>
+#include <regex.h>
+
+#include <faux/faux.h>
+#include <faux/str.h>
+#include <faux/list.h>
+#include <klish/kscheme.h>
+#include <klish/kpath.h>
+
+#include "private.h"
+
+#define STAT_TOP 10 // Number of entries to show within top lists
+#define STAT_REGEX_NESTING 32 // Max nesting of regex groups to analyze
+#define STAT_LEVEL_OVERHEAD 64 // Estimated size of level structure
+
+
+/** @brief Counter of string occurrences
+ */
+typedef struct {
+	const char *str;
+	size_t count;
+} stat_str_t;
+
+
+/** @brief Node of the command words trie
+ */
+typedef struct {
+	char *word;
+	faux_list_t *children;
+} stat_trie_t;
+
+
+/** @brief Results of trie analysis
+ */
+typedef struct {
+	size_t nodes;
+	size_t inner_nodes; // Nodes with children
+	size_t fanout_sum; // Sum of children numbers of inner nodes
+	size_t max_depth;
+	const char *max_depth_view;
+	size_t max_fanout;
+	const char *max_fanout_view;
+} stat_trie_info_t;
+
+
+/** @brief PTYPE regular expression info
+ */
+typedef struct {
+	const kptype_t *ptype;
+	unsigned int score;
+	bool_t nested; // Quantified group contains quantifier
+} stat_regex_t;
+
+
+/** @brief Scheme statistics
+ */
+typedef struct {
+	size_t views;
+	size_t templates;
+	size_t instances; // Views based on template
+	size_t shared; // Template's commands referenced by instances
+	size_t binds;
+	size_t commands;
+	size_t params;
+	size_t max_params_depth;
+	size_t ptypes;
+	size_t vars;
+	size_t nspaces;
+	size_t actions;
+	size_t conds;
+	faux_list_t *strings;
+	faux_list_t *ptype_refs; // Referenced PTYPE names
+} stat_t;
+
+
+static int stat_str_compare(const void *first, const void *second)
+{
+	const stat_str_t *f = (const stat_str_t *)first;
+	const stat_str_t *s = (const stat_str_t *)second;
+
+	return strcmp(f->str, s->str);
+}
+
+
+static int stat_str_kcompare(const void *key, const void *list_item)
+{
+	const char *f = (const char *)key;
+	const stat_str_t *s = (const stat_str_t *)list_item;
+
+	return strcmp(f, s->str);
+}
+
+
+static void stat_str_add(faux_list_t *list, const char *str)
+{
+	stat_str_t *entry = NULL;
+
+	if (!str)
+		return;
+	entry = (stat_str_t *)faux_list_kfind(list, str);
+	if (entry) {
+		entry->count++;
+		return;
+	}
+	entry = faux_zmalloc(sizeof(*entry));
+	assert(entry);
+	entry->str = str;
+	entry->count = 1;
+	faux_list_add(list, entry);
+}
+
+
+static void stat_action(stat_t *stat, const kaction_t *action)
+{
+	if (!action)
+		return;
+
+	stat->actions++;
+	stat_str_add(stat->strings, kaction_sym(action));
+	stat_str_add(stat->strings, kaction_script(action));
+	stat_str_add(stat->strings, kaction_shebang(action));
+}
+
+
+static void stat_params(stat_t *stat, const faux_list_t *params, size_t depth)
+{
+	faux_list_node_t *iter = NULL;
+	kparam_t *param = NULL;
+
+	iter = faux_list_head(params);
+	while ((param = (kparam_t *)faux_list_each(&iter))) {
+		stat->params++;
+		if (depth > stat->max_params_depth)
+			stat->max_params_depth = depth;
+		stat_str_add(stat->strings, kparam_name(param));
+		stat_str_add(stat->strings, kparam_help(param));
+		stat_str_add(stat->strings, kparam_ptype_ref(param));
+		stat_str_add(stat->strings, kparam_defval(param));
+		stat_str_add(stat->strings, kparam_prefix(param));
+		stat_str_add(stat->strings, kparam_value(param));
+		stat_str_add(stat->ptype_refs, kparam_ptype_ref(param));
+		stat_params(stat, kparam_params(param), depth + 1);
+	}
+}
+
+
+/** @brief Counts scheme objects and collects all the strings
+ */
+static void stat_collect(stat_t *stat, const kscheme_t *scheme)
+{
+	faux_list_node_t *view_iter = NULL;
+	faux_list_node_t *iter = NULL;
+	kview_t *view = NULL;
+	kptype_t *ptype = NULL;
+	kvar_t *var = NULL;
+
+	view_iter = faux_list_head(kscheme_views(scheme));
+	while ((view = (kview_t *)faux_list_each(&view_iter))) {
+		knspace_t *nspace = NULL;
+		kcommand_t *command = NULL;
+
+		stat->views++;
+		stat_str_add(stat->strings, kview_name(view));
+		stat_str_add(stat->strings, kview_prompt(view));
+		if (kview_is_template(view))
+			stat->templates++;
+		stat->binds += kview_binds_num(view);
+		if (kview_template(view)) {
+			// The chain has no loops. It's checked by link.
+			const kview_t *tmpl = kview_template(view);
+			stat->instances++;
+			while (tmpl) {
+				stat->shared += faux_list_len(
+					kview_commands(tmpl));
+				tmpl = kview_template(tmpl);
+			}
+		}
+
+		iter = faux_list_head(kview_nspaces(view));
+		while ((nspace = (knspace_t *)faux_list_each(&iter))) {
+			stat->nspaces++;
+			stat_str_add(stat->strings, knspace_view_ref(nspace));
+			stat_str_add(stat->strings, knspace_prefix(nspace));
+		}
+
+		iter = faux_list_head(kview_commands(view));
+		while ((command = (kcommand_t *)faux_list_each(&iter))) {
+			stat->commands++;
+			if (kcommand_cond(command))
+				stat->conds++;
+			stat_str_add(stat->strings, kcommand_name(command));
+			stat_str_add(stat->strings, kcommand_help(command));
+			stat_str_add(stat->strings, kcommand_detail(command));
+			stat_str_add(stat->strings, kcommand_access(command));
+			stat_str_add(stat->strings, kcommand_cond(command));
+			stat_str_add(stat->strings,
+				kcommand_nav_view_name(command));
+			stat_action(stat, kcommand_action(command));
+			stat_params(stat, kcommand_params(command), 1);
+		}
+	}
+
+	iter = faux_list_head(kscheme_ptypes(scheme));
+	while ((ptype = (kptype_t *)faux_list_each(&iter))) {
+		stat->ptypes++;
+		stat_str_add(stat->strings, kptype_name(ptype));
+		stat_str_add(stat->strings, kptype_help(ptype));
+		stat_str_add(stat->strings, kptype_pattern(ptype));
+		stat_action(stat, kptype_action(ptype));
+	}
+
+	iter = faux_list_head(kscheme_vars(scheme));
+	while ((var = (kvar_t *)faux_list_each(&iter))) {
+		stat->vars++;
+		stat_str_add(stat->strings, kvar_name(var));
+		stat_str_add(stat->strings, kvar_help(var));
+		stat_str_add(stat->strings, kvar_value(var));
+		stat_action(stat, kvar_action(var));
+	}
+}
+
+
+static int stat_trie_compare(const void *first, const void *second)
+{
+	const stat_trie_t *f = (const stat_trie_t *)first;
+	const stat_trie_t *s = (const stat_trie_t *)second;
+
+	return strcmp(f->word, s->word);
+}
+
+
+static int stat_trie_kcompare(const void *key, const void *list_item)
+{
+	const char *f = (const char *)key;
+	const stat_trie_t *s = (const stat_trie_t *)list_item;
+
+	return strcmp(f, s->word);
+}
+
+
+static void stat_trie_free(void *data)
+{
+	stat_trie_t *node = (stat_trie_t *)data;
+
+	if (!node)
+		return;
+
+	faux_str_free(node->word);
+	faux_list_free(node->children);
+	faux_free(node);
+}
+
+
+static stat_trie_t *stat_trie_new(const char *word)
+{
+	stat_trie_t *node = NULL;
+
+	node = faux_zmalloc(sizeof(*node));
+	assert(node);
+	node->word = faux_str_dup(word);
+	node->children = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		stat_trie_compare, stat_trie_kcompare, stat_trie_free);
+	assert(node->children);
+
+	return node;
+}
+
+
+/** @brief Adds multi-word command name to the trie
+ */
+static void stat_trie_add(stat_trie_t *root, const char *name)
+{
+	stat_trie_t *node = root;
+	const char *pos = name;
+
+	while (*pos) {
+		const char *end = NULL;
+		char *word = NULL;
+		stat_trie_t *child = NULL;
+
+		while (*pos && isspace((unsigned char)*pos))
+			pos++;
+		if ('\0' == *pos)
+			break;
+		end = pos;
+		while (*end && !isspace((unsigned char)*end))
+			end++;
+		word = faux_str_dupn(pos, end - pos);
+		child = (stat_trie_t *)faux_list_kfind(node->children, word);
+		if (!child) {
+			child = stat_trie_new(word);
+			faux_list_add(node->children, child);
+		}
+		faux_str_free(word);
+		node = child;
+		pos = end;
+	}
+}
+
+
+static void stat_trie_walk(const stat_trie_t *node, size_t depth,
+	const char *view, stat_trie_info_t *info)
+{
+	faux_list_node_t *iter = NULL;
+	stat_trie_t *child = NULL;
+	size_t fanout = 0;
+
+	if (depth > 0)
+		info->nodes++;
+	if (depth > info->max_depth) {
+		info->max_depth = depth;
+		info->max_depth_view = view;
+	}
+	fanout = faux_list_len(node->children);
+	if (0 == fanout)
+		return;
+	info->inner_nodes++;
+	info->fanout_sum += fanout;
+	if (fanout > info->max_fanout) {
+		info->max_fanout = fanout;
+		info->max_fanout_view = view;
+	}
+
+	iter = faux_list_head(node->children);
+	while ((child = (stat_trie_t *)faux_list_each(&iter)))
+		stat_trie_walk(child, depth + 1, view, info);
+}
+
+
+/** @brief Shows depth and fanout of per-view tries of command words
+ */
+static void stat_show_trie(const kscheme_t *scheme)
+{
+	faux_list_node_t *view_iter = NULL;
+	kview_t *view = NULL;
+	stat_trie_info_t info = {};
+
+	view_iter = faux_list_head(kscheme_views(scheme));
+	while ((view = (kview_t *)faux_list_each(&view_iter))) {
+		faux_list_node_t *iter = NULL;
+		kcommand_t *command = NULL;
+		stat_trie_t *root = stat_trie_new("");
+
+		iter = faux_list_head(kview_commands(view));
+		while ((command = (kcommand_t *)faux_list_each(&iter)))
+			stat_trie_add(root, kcommand_name(command));
+		stat_trie_walk(root, 0, kview_name(view), &info);
+		stat_trie_free(root);
+	}
+
+	printf("Trie: %zu nodes, max depth %zu", info.nodes, info.max_depth);
+	if (info.max_depth_view)
+		printf(" (VIEW \"%s\")", info.max_depth_view);
+	printf(", max fanout %zu", info.max_fanout);
+	if (info.max_fanout_view)
+		printf(" (VIEW \"%s\")", info.max_fanout_view);
+	printf(", average fanout %.2f\n", info.inner_nodes ?
+		(double)info.fanout_sum / info.inner_nodes : 0.0);
+}
+
+
+static int stat_dup_compare(const void *first, const void *second)
+{
+	const stat_str_t *f = *(const stat_str_t * const *)first;
+	const stat_str_t *s = *(const stat_str_t * const *)second;
+	size_t fw = (f->count - 1) * (strlen(f->str) + 1);
+	size_t sw = (s->count - 1) * (strlen(s->str) + 1);
+
+	if (fw != sw)
+		return (fw < sw) ? 1 : -1;
+
+	return strcmp(f->str, s->str);
+}
+
+
+/** @brief Shows strings stored more than once
+ */
+static void stat_show_dups(const faux_list_t *strings, bool_t verbose)
+{
+	faux_list_node_t *iter = NULL;
+	stat_str_t *entry = NULL;
+	stat_str_t **dups = NULL;
+	size_t dups_num = 0;
+	size_t total = 0;
+	size_t total_bytes = 0;
+	size_t wasted = 0;
+	size_t i = 0;
+
+	dups = faux_zmalloc(sizeof(*dups) * (faux_list_len(strings) + 1));
+	assert(dups);
+	iter = faux_list_head(strings);
+	while ((entry = (stat_str_t *)faux_list_each(&iter))) {
+		size_t size = strlen(entry->str) + 1;
+		total += entry->count;
+		total_bytes += entry->count * size;
+		if (entry->count < 2)
+			continue;
+		wasted += (entry->count - 1) * size;
+		dups[dups_num++] = entry;
+	}
+	qsort(dups, dups_num, sizeof(*dups), stat_dup_compare);
+
+	printf("Strings: %zu total, %zu unique, %zu bytes\n", total,
+		faux_list_len(strings), total_bytes);
+	printf("Duplicate strings: %zu, wasted %zu bytes\n", dups_num, wasted);
+	for (i = 0; i < dups_num; i++) {
+		if (!verbose && (i >= STAT_TOP))
+			break;
+		printf("\t%zu x \"%.40s%s\"\n", dups[i]->count, dups[i]->str,
+			(strlen(dups[i]->str) > 40) ? "..." : "");
+	}
+	faux_free(dups);
+}
+
+
+/** @brief Estimates complexity of regular expression
+ *
+ * The score is the weighted number of regex constructs. The quantified
+ * group containing quantifiers (like "(a+)*") is marked as nested. It's
+ * a typical source of slow matching.
+ */
+static unsigned int stat_regex_score(const char *pattern, bool_t *nested)
+{
+	bool_t quant[STAT_REGEX_NESTING] = {};
+	size_t depth = 0;
+	unsigned int score = 0;
+	const char *pos = pattern;
+
+	*nested = BOOL_FALSE;
+	while (*pos) {
+		bool_t group_quant = BOOL_FALSE;
+
+		switch (*pos) {
+		case '\\':
+			if (*(pos + 1))
+				pos++;
+			score += 1;
+			break;
+		case '[':
+			// Bracket expression. The ']' at the start is literal.
+			pos++;
+			if ('^' == *pos)
+				pos++;
+			if (']' == *pos)
+				pos++;
+			while (*pos && (']' != *pos))
+				pos++;
+			if (!*pos)
+				continue;
+			score += 3;
+			break;
+		case '(':
+			score += 3;
+			if (depth < STAT_REGEX_NESTING - 1)
+				depth++;
+			quant[depth] = BOOL_FALSE;
+			break;
+		case ')':
+			if (depth > 0) {
+				group_quant = quant[depth];
+				depth--;
+				if (group_quant)
+					quant[depth] = BOOL_TRUE;
+			}
+			if (group_quant && *(pos + 1) &&
+				strchr("*+?{", *(pos + 1))) {
+				*nested = BOOL_TRUE;
+				score += 50;
+			}
+			break;
+		case '|':
+			score += 5;
+			break;
+		case '*':
+		case '+':
+		case '?':
+			score += 5;
+			quant[depth] = BOOL_TRUE;
+			break;
+		case '{':
+			score += 5;
+			quant[depth] = BOOL_TRUE;
+			while (*pos && ('}' != *pos))
+				pos++;
+			if (!*pos)
+				continue;
+			break;
+		default:
+			score += 1;
+			break;
+		}
+		pos++;
+	}
+
+	return score;
+}
+
+
+static int stat_regex_compare(const void *first, const void *second)
+{
+	const stat_regex_t *f = (const stat_regex_t *)first;
+	const stat_regex_t *s = (const stat_regex_t *)second;
+
+	if (f->score != s->score)
+		return (f->score < s->score) ? 1 : -1;
+
+	return strcmp(kptype_name(f->ptype), kptype_name(s->ptype));
+}
+
+
+/** @brief Compiles PTYPE regular expression
+ *
+ * @return BOOL_TRUE if regular expression is legal.
+ */
+static bool_t stat_regex_legal(const kptype_t *ptype, bool_t report)
+{
+	regex_t re = {};
+	int rc = 0;
+
+	rc = regcomp(&re, kptype_pattern(ptype), REG_EXTENDED | REG_NOSUB);
+	if (rc != 0) {
+		if (report) {
+			char msg[256] = {};
+			regerror(rc, &re, msg, sizeof(msg));
+			fprintf(stderr, "Error: PTYPE \"%s\": Illegal regular "
+				"expression \"%s\": %s\n", kptype_name(ptype),
+				kptype_pattern(ptype), msg);
+		}
+		return BOOL_FALSE;
+	}
+	regfree(&re);
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Shows complexity of PTYPE regular expressions
+ *
+ * The illegal regular expressions are skipped. They are reported by
+ * stat_check().
+ */
+static void stat_show_regex(const kscheme_t *scheme,
+	const faux_list_t *ptype_refs, bool_t verbose)
+{
+	faux_list_node_t *iter = NULL;
+	kptype_t *ptype = NULL;
+	stat_regex_t *regexs = NULL;
+	size_t regexs_num = 0;
+	size_t nested = 0;
+	size_t unused = 0;
+	size_t i = 0;
+
+	regexs = faux_zmalloc(sizeof(*regexs) *
+		(faux_list_len(kscheme_ptypes(scheme)) + 1));
+	assert(regexs);
+
+	iter = faux_list_head(kscheme_ptypes(scheme));
+	while ((ptype = (kptype_t *)faux_list_each(&iter))) {
+		if (!faux_list_kfind(ptype_refs, kptype_name(ptype))) {
+			unused++;
+			if (verbose)
+				printf("Warning: PTYPE \"%s\" is not used\n",
+					kptype_name(ptype));
+		}
+		if (kptype_method(ptype) != KPTYPE_METHOD_REGEXP)
+			continue;
+		if (!stat_regex_legal(ptype, BOOL_FALSE))
+			continue;
+		regexs[regexs_num].ptype = ptype;
+		regexs[regexs_num].score = stat_regex_score(
+			kptype_pattern(ptype), &regexs[regexs_num].nested);
+		if (regexs[regexs_num].nested)
+			nested++;
+		regexs_num++;
+	}
+	qsort(regexs, regexs_num, sizeof(*regexs), stat_regex_compare);
+
+	printf("PTYPE regexps: %zu, nested quantifiers %zu, unused PTYPEs %zu\n",
+		regexs_num, nested, unused);
+	for (i = 0; i < regexs_num; i++) {
+		if (!verbose && (i >= STAT_TOP))
+			break;
+		printf("\t%u\t%s%s\n", regexs[i].score,
+			kptype_name(regexs[i].ptype),
+			regexs[i].nested ? " (nested quantifier)" : "");
+	}
+	faux_free(regexs);
+}
+
+
+/** @brief Gets estimated size of current level
+ */
+static size_t stat_level_bytes(kpath_t *path)
+{
+	size_t num = 0;
+
+	kpath_find_prefix(path, "", &num);
+
+	return num * sizeof(klevel_cmd_t) + STAT_LEVEL_OVERHEAD;
+}
+
+
+/** @brief Walks through views reachable by "down" navigation
+ *
+ * Each view is visited once. The size of path (sum of level indexes) is
+ * measured on each step.
+ *
+ * @param [in] bytes Size of current path.
+ */
+static void stat_walk_path(kpath_t *path, const kview_t **visited,
+	size_t *visited_num, size_t bytes, size_t *max_bytes, size_t *max_depth)
+{
+	const klevel_cmd_t *index = NULL;
+	size_t num = 0;
+	size_t i = 0;
+
+	if (bytes > *max_bytes)
+		*max_bytes = bytes;
+	if (kpath_depth(path) > *max_depth)
+		*max_depth = kpath_depth(path);
+
+	// The index of current level stays valid while nested levels are
+	// added and removed.
+	index = kpath_find_prefix(path, "", &num);
+	for (i = 0; i < num; i++) {
+		kview_t *target = NULL;
+		size_t j = 0;
+
+		if (kcommand_nav(index[i].command) != KNAV_DOWN)
+			continue;
+		target = kcommand_nav_view(index[i].command);
+		for (j = 0; j < *visited_num; j++) {
+			if (visited[j] == target)
+				break;
+		}
+		if (j < *visited_num)
+			continue;
+		visited[(*visited_num)++] = target;
+		if (!kpath_down(path, target))
+			continue;
+		stat_walk_path(path, visited, visited_num,
+			bytes + stat_level_bytes(path), max_bytes, max_depth);
+		kpath_up(path, 1);
+	}
+}
+
+
+/** @brief Shows estimated memory consumption of single session
+ *
+ * The session keeps three visibility bitmaps and the indexes of current
+ * path's levels.
+ */
+static void stat_show_memory(const kscheme_t *scheme)
+{
+	kview_t *start = NULL;
+	kpath_t *path = NULL;
+	const kview_t **visited = NULL;
+	size_t visited_num = 0;
+	size_t bits = sizeof(unsigned long) * 8;
+	size_t bitmaps = 0;
+	size_t start_bytes = 0;
+	size_t max_bytes = 0;
+	size_t max_depth = 0;
+
+	bitmaps = 3 * ((kscheme_commands_num(scheme) + bits - 1) / bits) *
+		sizeof(unsigned long);
+
+	start = kscheme_startup(scheme);
+	if (!start) {
+		printf("Memory per session: %zu bytes of visibility bitmaps. "
+			"No STARTUP to estimate path.\n", bitmaps);
+		return;
+	}
+
+	// Levels 0 (global view) and 1 (starting view). The index of
+	// level 1 includes inherited commands of level 0.
+	path = kpath_new(kscheme_global(scheme), start);
+	assert(path);
+	start_bytes = STAT_LEVEL_OVERHEAD + stat_level_bytes(path);
+
+	visited = faux_zmalloc(sizeof(*visited) *
+		(faux_list_len(kscheme_views(scheme)) + 1));
+	assert(visited);
+	visited[visited_num++] = start;
+	stat_walk_path(path, visited, &visited_num, start_bytes,
+		&max_bytes, &max_depth);
+	faux_free(visited);
+	kpath_free(path);
+
+	printf("Memory per session: %zu bytes on start, up to %zu bytes "
+		"(path depth %zu, %zu reachable views)\n",
+		bitmaps + start_bytes, bitmaps + max_bytes, max_depth,
+		visited_num);
+}
+
+
+/** @brief Validates linked scheme
+ *
+ * The check doesn't depend on statistics output.
+ *
+ * @return 0 - success, < 0 - errors found.
+ */
+int stat_check(const kscheme_t *scheme)
+{
+	faux_list_node_t *iter = NULL;
+	kptype_t *ptype = NULL;
+	size_t errors = 0;
+
+	assert(scheme);
+	if (!scheme)
+		return -1;
+
+	iter = faux_list_head(kscheme_ptypes(scheme));
+	while ((ptype = (kptype_t *)faux_list_each(&iter))) {
+		if (kptype_method(ptype) != KPTYPE_METHOD_REGEXP)
+			continue;
+		if (!stat_regex_legal(ptype, BOOL_TRUE))
+			errors++;
+	}
+
+	return (errors > 0) ? -1 : 0;
+}
+
+
+/** @brief Shows statistics of linked scheme
+ *
+ * @return 0 - success, < 0 - error.
+ */
+int stat_show(kscheme_t *scheme, bool_t verbose)
+{
+	stat_t stat = {};
+
+	assert(scheme);
+	if (!scheme)
+		return -1;
+
+	stat.strings = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		stat_str_compare, stat_str_kcompare, faux_free);
+	assert(stat.strings);
+	stat.ptype_refs = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		stat_str_compare, stat_str_kcompare, faux_free);
+	assert(stat.ptype_refs);
+	stat_collect(&stat, scheme);
+
+	printf("VIEWs: %zu (TEMPLATEs %zu)\n", stat.views, stat.templates);
+	if (stat.instances > 0)
+		printf("TEMPLATE instances: %zu, shared COMMANDs %zu, "
+			"BINDs %zu\n", stat.instances, stat.shared, stat.binds);
+	printf("COMMANDs: %zu (with COND %zu)\n", stat.commands, stat.conds);
+	printf("PARAMs: %zu, max nesting %zu\n", stat.params,
+		stat.max_params_depth > 0 ? stat.max_params_depth - 1 : 0);
+	printf("PTYPEs: %zu\n", stat.ptypes);
+	printf("NAMESPACEs: %zu\n", stat.nspaces);
+	printf("VARs: %zu\n", stat.vars);
+	printf("ACTIONs: %zu\n", stat.actions);
+	stat_show_trie(scheme);
+	stat_show_dups(stat.strings, verbose);
+	stat_show_regex(scheme, stat.ptype_refs, verbose);
+	stat_show_memory(scheme);
+
+	faux_list_free(stat.strings);
+	faux_list_free(stat.ptype_refs);
+
+	return 0;
+}
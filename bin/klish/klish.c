@@ -11,22 +11,353 @@
 #include <getopt.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/time.h>
+#include <time.h>
 
 #include <faux/faux.h>
 #include <faux/str.h>
 
 #include <klish/ktp.h>
 #include <klish/ktp_session.h>
+#include <klish/krecord.h>
 
 #include "private.h"
 
 
+/** @brief Sets receive timeout of socket
+ *
+ * @param [in] sock Socket.
+ * @param [in] timeout Seconds. The 0 - no timeout.
+ */
+bool_t set_recv_timeout(int sock, unsigned int timeout)
+{
+	struct timeval tv = {};
+
+	tv.tv_sec = timeout;
+	if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Writes the whole buffer
+ */
+bool_t write_all(int fd, const char *data, size_t len)
+{
+	while (len > 0) {
+		ssize_t r = write(fd, data, len);
+		if (r < 0) {
+			if (EINTR == errno)
+				continue;
+			return BOOL_FALSE;
+		}
+		data += r;
+		len -= r;
+	}
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Renders complete records of stream and keeps the rest
+ *
+ * The records are not framed by KTP so the part of record is kept within
+ * buffer until the rest comes.
+ *
+ * @return BOOL_FALSE if stream is broken.
+ */
+static bool_t records_feed(char **buf, size_t *buf_len,
+	const char *data, size_t len, int fd, bool_t json)
+{
+	char *new_buf = NULL;
+	size_t pos = 0;
+	ssize_t size = 0;
+
+	new_buf = realloc(*buf, *buf_len + len);
+	assert(new_buf);
+	if (!new_buf)
+		return BOOL_FALSE;
+	*buf = new_buf;
+	memcpy(*buf + *buf_len, data, len);
+	*buf_len += len;
+
+	while ((size = krecord_size(*buf + pos, *buf_len - pos)) > 0) {
+		char *str = json ? krecord_json(*buf + pos, size) :
+			krecord_text(*buf + pos, size);
+		if (!str)
+			return BOOL_FALSE;
+		write_all(fd, str, strlen(str));
+		// The JSON is a stream of lines and the text records are
+		// separated by empty line.
+		write_all(fd, "\n", 1);
+		faux_str_free(str);
+		pos += size;
+	}
+	if (size < 0)
+		return BOOL_FALSE;
+	memmove(*buf, *buf + pos, *buf_len - pos);
+	*buf_len -= pos;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Stores view's data the server sends on change of view
+ *
+ * The map of hotkeys and the help index are kept by session. The help index
+ * is dropped if KTP_NOTIFICATION has another scheme version.
+ *
+ * @return BOOL_TRUE if message is view's data.
+ */
+static bool_t view_msg(ktp_session_t *session, const faux_msg_t *msg)
+{
+	switch (faux_msg_get_cmd(msg)) {
+	case KTP_HOTKEYS:
+		ktp_session_set_hotkeys(session, msg);
+		break;
+	case KTP_HELP_INDEX:
+		ktp_session_set_help_index(session, msg);
+		break;
+	case KTP_NOTIFICATION:
+		ktp_session_check_version(session, msg);
+		break;
+	default:
+		return BOOL_FALSE;
+	}
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Receives command's output and result
+ *
+ * The output is written to the specified descriptors as it comes. The
+ * structured records are rendered to stdout. The receive timeout of
+ * authentication is removed on KTP_AUTH_ACK because the command can run
+ * as long as it needs. The view's data is stored by session.
+ *
+ * @param [in] session KTP session.
+ * @param [in] fd_out Descriptor for stdout and records.
+ * @param [in] fd_err Descriptor for stderr.
+ * @param [in] json Render records as JSON lines instead of text.
+ * @return Command's retcode or -1 on error.
+ */
+int cmd_result(ktp_session_t *session, int fd_out, int fd_err, bool_t json)
+{
+	faux_msg_t *msg = NULL;
+	int retcode = -1;
+	char *records = NULL;
+	size_t records_len = 0;
+	bool_t records_broken = BOOL_FALSE;
+
+	while ((msg = ktp_session_recv(session))) {
+		ktp_cmd_e cmd = faux_msg_get_cmd(msg);
+		void *data = NULL;
+		uint32_t len = 0;
+		bool_t done = BOOL_FALSE;
+
+		switch (cmd) {
+		case KTP_AUTH_ACK:
+			if (faux_msg_get_status(msg) != 0) {
+				fprintf(stderr, "Error: Authentication failed\n");
+				done = BOOL_TRUE;
+				break;
+			}
+			set_recv_timeout(ktp_session_get_socket(session), 0);
+			break;
+		case KTP_STDOUT:
+		case KTP_STDERR:
+			if (faux_msg_get_param_by_type(msg, KTP_PARAM_DATA,
+				&data, &len))
+				write_all((KTP_STDOUT == cmd) ? fd_out : fd_err,
+					(const char *)data, len);
+			break;
+		case KTP_RECORD:
+			if (records_broken)
+				break;
+			if (!faux_msg_get_param_by_type(msg, KTP_PARAM_DATA,
+				&data, &len))
+				break;
+			if (!records_feed(&records, &records_len,
+				(const char *)data, len, fd_out, json)) {
+				fprintf(stderr, "Error: Broken records stream\n");
+				records_broken = BOOL_TRUE;
+			}
+			break;
+		case KTP_CMD_ACK:
+			retcode = (int)faux_msg_get_status(msg);
+			done = BOOL_TRUE;
+			break;
+		default:
+			view_msg(session, msg);
+			break;
+		}
+		faux_msg_free(msg);
+		if (done) {
+			free(records);
+			return retcode;
+		}
+	}
+	if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+		fprintf(stderr, "Error: Server doesn't answer\n");
+	else
+		fprintf(stderr, "Error: Connection is broken\n");
+	free(records);
+
+	return -1;
+}
+
+
+/** @brief Executes one-shot command
+ *
+ * @return Command's retcode or -1 on error.
+ */
+static int oneshot(ktp_session_t *session, const char *line, bool_t json)
+{
+	set_recv_timeout(ktp_session_get_socket(session), AUTH_TIMEOUT);
+	if (ktp_session_oneshot(session, line) < 0) {
+		fprintf(stderr, "Error: Can't send command\n");
+		return -1;
+	}
+
+	return cmd_result(session, STDOUT_FILENO, STDERR_FILENO, json);
+}
+
+
+/** @brief Receives context help from server
+ *
+ * @return Number of entries or -1 on error.
+ */
+static ssize_t help_result(ktp_session_t *session, ktp_help_t **help)
+{
+	faux_msg_t *msg = NULL;
+
+	while ((msg = ktp_session_recv(session))) {
+		ssize_t num = -1;
+		if (faux_msg_get_cmd(msg) != KTP_HELP_ACK) {
+			view_msg(session, msg);
+			faux_msg_free(msg);
+			continue;
+		}
+		num = ktp_help_ack(msg, help);
+		faux_msg_free(msg);
+		return num;
+	}
+	fprintf(stderr, "Error: Connection is broken\n");
+
+	return -1;
+}
+
+
+/** @brief Prints context help for the line
+ *
+ * The help is found within local help index. The server is asked if the
+ * index is not received yet, is outdated or the answer depends on server's
+ * state.
+ *
+ * @return 0 - success, -1 - error.
+ */
+static int line_help(ktp_session_t *session, const char *line)
+{
+	ktp_help_t *help = NULL;
+	ssize_t num = 0;
+	ssize_t i = 0;
+
+	num = ktp_session_help(session, line, &help);
+	if (num < 0) {
+		if (ktp_session_req_help(session, line) < 0) {
+			fprintf(stderr, "Error: Can't send help request\n");
+			return -1;
+		}
+		num = help_result(session, &help);
+		if (num < 0)
+			return -1;
+	}
+	for (i = 0; i < num; i++)
+		printf("  %-20s %s\n", help[i].prefix, help[i].line);
+	fflush(stdout);
+	ktp_help_free(help, num);
+
+	return 0;
+}
+
+
+/** @brief Executes command lines read from stdin
+ *
+ * The lines are executed one by one within regular session. The line of
+ * single control character is a pressed key. The command bound to it
+ * within current view is found by local map of hotkeys so the key doesn't
+ * need a request to server. The unbound key is ignored. The line ended by
+ * '?' asks context help for the text before it.
+ *
+ * @return Retcode of the last command or -1 on error.
+ */
+static int interactive(ktp_session_t *session, bool_t json)
+{
+	faux_msg_t *msg = NULL;
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len = 0;
+	int retcode = 0;
+
+	set_recv_timeout(ktp_session_get_socket(session), AUTH_TIMEOUT);
+	if (ktp_session_auth(session) < 0) {
+		fprintf(stderr, "Error: Can't send authentication request\n");
+		return -1;
+	}
+	msg = ktp_session_recv(session);
+	if (!msg || (faux_msg_get_cmd(msg) != KTP_AUTH_ACK) ||
+		(faux_msg_get_status(msg) != 0)) {
+		fprintf(stderr, "Error: Authentication failed\n");
+		faux_msg_free(msg);
+		return -1;
+	}
+	faux_msg_free(msg);
+	set_recv_timeout(ktp_session_get_socket(session), 0);
+
+	while ((len = getline(&line, &size, stdin)) >= 0) {
+		const char *cmd = line;
+		if ((len > 0) && ('\n' == line[len - 1]))
+			line[--len] = '\0';
+		if ((1 == len) &&
+			((unsigned char)line[0] < KVIEW_HOTKEY_NUM)) {
+			cmd = ktp_session_hotkey(session,
+				(unsigned char)line[0]);
+			if (!cmd)
+				continue;
+		}
+		if ((len > 0) && ('?' == line[len - 1])) {
+			line[--len] = '\0';
+			if (line_help(session, line) < 0) {
+				retcode = -1;
+				break;
+			}
+			continue;
+		}
+		if (ktp_session_cmd(session, cmd) < 0) {
+			fprintf(stderr, "Error: Can't send command\n");
+			retcode = -1;
+			break;
+		}
+		retcode = cmd_result(session, STDOUT_FILENO, STDERR_FILENO,
+			json);
+		if (!ktp_session_connected(session))
+			break;
+	}
+	free(line);
+
+	return retcode;
+}
+
+
 int main(int argc, char **argv)
 {
 	int retval = -1;
 	struct options *opts = NULL;
 	int unix_sock = -1;
 	ktp_session_t *session = NULL;
+	struct timespec start = {};
 
 	// Parse command line options
 	opts = opts_init();
@@ -35,6 +366,21 @@ int main(int argc, char **argv)
 		goto err;
 	}
 
+	// The latency includes connection to server
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (opts->master) {
+		retval = master_run(opts);
+		goto err;
+	}
+
+	// The command is executed by control master if it's running
+	if (opts->command && opts->control_path) {
+		retval = master_exec(opts->control_path, opts->command);
+		if (retval != MASTER_UNAVAILABLE)
+			goto done;
+	}
+
 	// Connect to server
 	unix_sock = ktp_connect_unix(opts->unix_socket_path);
 	if (unix_sock < 0) {
@@ -47,9 +393,22 @@ int main(int argc, char **argv)
 		fprintf(stderr, "Error: Can't create klish session\n");
 		goto err;
 	}
-	
 
-	retval = 0;
+	if (opts->command) {
+		retval = oneshot(session, opts->command, opts->json);
+		goto done;
+	}
+
+	retval = interactive(session, opts->json);
+
+done:
+	if (opts->command && opts->timing) {
+		struct timespec end = {};
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		fprintf(stderr, "Latency: %.3f ms\n",
+			(end.tv_sec - start.tv_sec) * 1000.0 +
+			(end.tv_nsec - start.tv_nsec) / 1000000.0);
+	}
 
 err:
 	ktp_session_free(session);
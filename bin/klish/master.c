@@ -0,0 +1,344 @@
+/** @file master.c
+ *
+ * @brief Control master
+ *
+ * The master is a long-lived client process that holds one authorized
+ * KTP session and listens on private UNIX socket. The other klish
+ * invocations don't connect to server. They send command line and their
+ * stdout and stderr descriptors (SCM_RIGHTS) to master and get retcode
+ * back. So the command costs neither connection nor authentication. The
+ * master writes command's output directly to the descriptors of
+ * invocation. The stdin is not forwarded like in one-shot mode.
+ *
+ * The socket is SOCK_SEQPACKET so request and answer are single messages.
+ * The commands are executed one by one in order of connection because the
+ * KTP session is sequential. The invocation that doesn't send request in
+ * time is dropped so it can't block the others.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <faux/faux.h>
+#include <faux/str.h>
+
+#include <klish/ktp.h>
+#include <klish/ktp_session.h>
+
+#include "private.h"
+
+#define MASTER_BACKLOG 64
+#define MASTER_LINE_MAX 65536
+#define MASTER_RECV_TIMEOUT 5 // Seconds to wait for request
+// Descriptors of invocation
+#define MASTER_FD_OUT 0
+#define MASTER_FD_ERR 1
+#define MASTER_FD_NUM 2
+
+static volatile int master_stop = 0;
+
+
+static void master_sighandler(int signo)
+{
+	master_stop = 1;
+	signo = signo; // Happy compiler
+}
+
+
+static int master_addr(const char *path, struct sockaddr_un *addr)
+{
+	if (strlen(path) >= sizeof(addr->sun_path))
+		return -1;
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+
+	return 0;
+}
+
+
+/** @brief Creates listen socket accessible for owner only
+ */
+static int master_listen(const char *path)
+{
+	int sock = -1;
+	struct sockaddr_un addr = {};
+	mode_t mask = 0;
+
+	if (master_addr(path, &addr) < 0)
+		return -1;
+	sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+		return -1;
+
+	// The socket of alive master is not replaced
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+		fprintf(stderr, "Error: Master is already running\n");
+		close(sock);
+		return -1;
+	}
+	unlink(path);
+
+	mask = umask(0077);
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		umask(mask);
+		close(sock);
+		return -1;
+	}
+	umask(mask);
+	if (listen(sock, MASTER_BACKLOG) < 0) {
+		close(sock);
+		unlink(path);
+		return -1;
+	}
+
+	return sock;
+}
+
+
+/** @brief Receives command line and descriptors of invocation
+ *
+ * @return Allocated command line or NULL on error.
+ */
+static char *master_recv(int conn, int *fds)
+{
+	char *line = NULL;
+	struct msghdr msg = {};
+	struct iovec iov = {};
+	union {
+		char buf[CMSG_SPACE(sizeof(int) * MASTER_FD_NUM)];
+		struct cmsghdr align;
+	} ctrl;
+	struct cmsghdr *cmsg = NULL;
+	ssize_t r = 0;
+
+	line = faux_zmalloc(MASTER_LINE_MAX + 1);
+	assert(line);
+	iov.iov_base = line;
+	iov.iov_len = MASTER_LINE_MAX;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctrl.buf;
+	msg.msg_controllen = sizeof(ctrl.buf);
+
+	do {
+		r = recvmsg(conn, &msg, MSG_CMSG_CLOEXEC);
+	} while ((r < 0) && (EINTR == errno));
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg && (SOL_SOCKET == cmsg->cmsg_level) &&
+		(SCM_RIGHTS == cmsg->cmsg_type)) {
+		size_t num = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		size_t i = 0;
+		int *data = (int *)CMSG_DATA(cmsg);
+		for (i = 0; i < num; i++) {
+			if (i < MASTER_FD_NUM)
+				fds[i] = data[i];
+			else
+				close(data[i]);
+		}
+	}
+	if ((r <= 0) || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) ||
+		(fds[MASTER_FD_OUT] < 0) || (fds[MASTER_FD_ERR] < 0)) {
+		faux_free(line);
+		return NULL;
+	}
+	line[r] = '\0';
+
+	return line;
+}
+
+
+/** @brief Serves one invocation
+ */
+static void master_serve(ktp_session_t *session, int conn, bool_t json)
+{
+	int fds[MASTER_FD_NUM] = { -1, -1 };
+	char *line = NULL;
+	int32_t retcode = -1;
+	struct ucred cred = {};
+	socklen_t len = sizeof(cred);
+	struct timeval timeout = {};
+	size_t i = 0;
+
+	// Only the owner of master can use it
+	if ((getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) ||
+		(cred.uid != geteuid()))
+		return;
+	timeout.tv_sec = MASTER_RECV_TIMEOUT;
+	if (setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO,
+		&timeout, sizeof(timeout)) < 0)
+		return;
+
+	line = master_recv(conn, fds);
+	if (line) {
+		if (ktp_session_cmd(session, line) == 0)
+			retcode = cmd_result(session, fds[MASTER_FD_OUT],
+				fds[MASTER_FD_ERR], json);
+		faux_free(line);
+	}
+	for (i = 0; i < MASTER_FD_NUM; i++) {
+		if (fds[i] >= 0)
+			close(fds[i]);
+	}
+	send(conn, &retcode, sizeof(retcode), MSG_NOSIGNAL);
+}
+
+
+/** @brief Runs control master
+ *
+ * Connects to server, authenticates and serves invocations until session
+ * is broken or signal is received.
+ *
+ * @return 0 - success, -1 - error.
+ */
+int master_run(const struct options *opts)
+{
+	int retval = -1;
+	int unix_sock = -1;
+	int listen_sock = -1;
+	ktp_session_t *session = NULL;
+	faux_msg_t *msg = NULL;
+	struct sigaction sig_act = {};
+
+	assert(opts);
+	if (!opts)
+		return -1;
+	if (!opts->control_path) {
+		fprintf(stderr, "Error: Control socket path is not specified\n");
+		return -1;
+	}
+
+	unix_sock = ktp_connect_unix(opts->unix_socket_path);
+	if (unix_sock < 0) {
+		fprintf(stderr, "Error: Can't connect to server\n");
+		return -1;
+	}
+	session = ktp_session_new(unix_sock);
+	assert(session);
+	if (!session)
+		goto err;
+	set_recv_timeout(unix_sock, AUTH_TIMEOUT);
+	if (ktp_session_auth(session) < 0)
+		goto err;
+	msg = ktp_session_recv(session);
+	if (!msg || (faux_msg_get_cmd(msg) != KTP_AUTH_ACK) ||
+		(faux_msg_get_status(msg) != 0)) {
+		fprintf(stderr, "Error: Authentication failed\n");
+		goto err;
+	}
+	set_recv_timeout(unix_sock, 0);
+
+	listen_sock = master_listen(opts->control_path);
+	if (listen_sock < 0) {
+		fprintf(stderr, "Error: Can't listen control socket %s\n",
+			opts->control_path);
+		goto err;
+	}
+
+	// The accept() must be interrupted by signal so no SA_RESTART
+	sigemptyset(&sig_act.sa_mask);
+	sig_act.sa_flags = 0;
+	sig_act.sa_handler = master_sighandler;
+	sigaction(SIGTERM, &sig_act, NULL);
+	sigaction(SIGINT, &sig_act, NULL);
+	sigaction(SIGHUP, &sig_act, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	while (!master_stop && ktp_session_connected(session)) {
+		int conn = accept4(listen_sock, NULL, NULL, SOCK_CLOEXEC);
+		if (conn < 0)
+			continue;
+		master_serve(session, conn, opts->json);
+		close(conn);
+	}
+	unlink(opts->control_path);
+	retval = 0;
+
+err:
+	faux_msg_free(msg);
+	if (listen_sock >= 0)
+		close(listen_sock);
+	ktp_session_free(session);
+	ktp_disconnect(unix_sock);
+
+	return retval;
+}
+
+
+/** @brief Executes command by control master
+ *
+ * @return Command's retcode, -1 on error or MASTER_UNAVAILABLE if there is
+ * no master so the command must be executed directly.
+ */
+int master_exec(const char *path, const char *line)
+{
+	int sock = -1;
+	struct sockaddr_un addr = {};
+	struct msghdr msg = {};
+	struct iovec iov = {};
+	union {
+		char buf[CMSG_SPACE(sizeof(int) * MASTER_FD_NUM)];
+		struct cmsghdr align;
+	} ctrl;
+	struct cmsghdr *cmsg = NULL;
+	int fds[MASTER_FD_NUM] = { STDOUT_FILENO, STDERR_FILENO };
+	int32_t retcode = -1;
+	ssize_t r = 0;
+
+	assert(path);
+	assert(line);
+	if (!path || !line)
+		return MASTER_UNAVAILABLE;
+	if (strlen(line) > MASTER_LINE_MAX)
+		return MASTER_UNAVAILABLE;
+	if (master_addr(path, &addr) < 0)
+		return MASTER_UNAVAILABLE;
+	sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+		return MASTER_UNAVAILABLE;
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(sock);
+		return MASTER_UNAVAILABLE;
+	}
+
+	iov.iov_base = (void *)line;
+	iov.iov_len = strlen(line);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	memset(&ctrl, 0, sizeof(ctrl));
+	msg.msg_control = ctrl.buf;
+	msg.msg_controllen = sizeof(ctrl.buf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	if (sendmsg(sock, &msg, MSG_NOSIGNAL) < 0) {
+		close(sock);
+		return MASTER_UNAVAILABLE;
+	}
+
+	// The master is alive so there is no fallback anymore
+	do {
+		r = recv(sock, &retcode, sizeof(retcode), 0);
+	} while ((r < 0) && (EINTR == errno));
+	close(sock);
+	if (r != sizeof(retcode)) {
+		fprintf(stderr, "Error: Master is gone\n");
+		return -1;
+	}
+
+	return retcode;
+}
@@ -30,6 +30,11 @@ struct options *opts_init(void)
 	// Initialize
 	opts->verbose = BOOL_FALSE;
 	opts->unix_socket_path = faux_str_dup(KLISH_DEFAULT_UNIX_SOCKET_PATH);
+	opts->command = NULL;
+	opts->timing = BOOL_FALSE;
+	opts->json = BOOL_FALSE;
+	opts->master = BOOL_FALSE;
+	opts->control_path = NULL;
 
 	return opts;
 }
@@ -42,6 +47,8 @@ void opts_free(struct options *opts)
 	if (!opts)
 		return;
 	faux_str_free(opts->unix_socket_path);
+	faux_str_free(opts->command);
+	faux_str_free(opts->control_path);
 	faux_free(opts);
 }
 
@@ -50,9 +57,14 @@ void opts_free(struct options *opts)
  */
 int opts_parse(int argc, char *argv[], struct options *opts)
 {
-	static const char *shortopts = "hvS:";
+	static const char *shortopts = "hvS:c:tjMC:";
 	static const struct option longopts[] = {
 		{"socket",		1, NULL, 'S'},
+		{"command",		1, NULL, 'c'},
+		{"timing",		0, NULL, 't'},
+		{"json",		0, NULL, 'j'},
+		{"master",		0, NULL, 'M'},
+		{"control",		1, NULL, 'C'},
 		{"help",		0, NULL, 'h'},
 		{"verbose",		0, NULL, 'v'},
 		{NULL,			0, NULL, 0}
@@ -70,6 +82,23 @@ int opts_parse(int argc, char *argv[], struct options *opts)
 			faux_str_free(opts->unix_socket_path);
 			opts->unix_socket_path = faux_str_dup(optarg);
 			break;
+		case 'c':
+			faux_str_free(opts->command);
+			opts->command = faux_str_dup(optarg);
+			break;
+		case 't':
+			opts->timing = BOOL_TRUE;
+			break;
+		case 'j':
+			opts->json = BOOL_TRUE;
+			break;
+		case 'M':
+			opts->master = BOOL_TRUE;
+			break;
+		case 'C':
+			faux_str_free(opts->control_path);
+			opts->control_path = faux_str_dup(optarg);
+			break;
 		case 'v':
 			opts->verbose = BOOL_TRUE;
 			break;
@@ -110,8 +139,14 @@ void help(int status, const char *argv0)
 		printf("Version : %s\n", VERSION);
 		printf("Usage   : %s [options]\n", name);
 		printf("Klish client\n");
+		printf("The command lines are read from stdin if no command is specified.\n");
 		printf("Options :\n");
 		printf("\t-S, --socket UNIX socket path.\n");
+		printf("\t-c <command>, --command=<command> Execute command and exit.\n");
+		printf("\t-t, --timing Print end-to-end latency of command.\n");
+		printf("\t-j, --json Print structured output of command as JSON lines.\n");
+		printf("\t-M, --master Run as control master.\n");
+		printf("\t-C <path>, --control=<path> Control master's socket path.\n");
 		printf("\t-h, --help Print this help.\n");
 		printf("\t-v, --verbose Be verbose.\n");
 	}
@@ -9,6 +9,11 @@
 struct options {
 	bool_t verbose;
 	char *unix_socket_path;
+	char *command; // One-shot command
+	bool_t timing; // Print end-to-end latency
+	bool_t json; // Render structured records as JSON
+	bool_t master; // Run as control master
+	char *control_path; // Control master's socket
 };
 
 // Options
@@ -16,3 +21,16 @@ void help(int status, const char *argv0);
 struct options *opts_init(void);
 void opts_free(struct options *opts);
 int opts_parse(int argc, char *argv[], struct options *opts);
+
+// Seconds to wait for KTP_AUTH_ACK. The server answers it at once.
+#define AUTH_TIMEOUT 10
+
+// Command execution
+bool_t set_recv_timeout(int sock, unsigned int timeout);
+bool_t write_all(int fd, const char *data, size_t len);
+int cmd_result(ktp_session_t *session, int fd_out, int fd_err, bool_t json);
+
+// Control master
+#define MASTER_UNAVAILABLE (-2)
+int master_run(const struct options *opts);
+int master_exec(const char *path, const char *line);
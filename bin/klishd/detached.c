@@ -0,0 +1,245 @@
+/** @file detached.c
+ *
+ * @brief Sessions which lost their clients
+ *
+ * The session is not destroyed when connection is broken. It keeps the
+ * current path, variables and running commands for a grace period so the
+ * client can reconnect and resume it by token. The output of commands is
+ * collected within the session's replay ring meanwhile. The session is
+ * expired when grace period is over.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <syslog.h>
+#include <time.h>
+
+#include <faux/faux.h>
+#include <faux/list.h>
+#include <faux/eloop.h>
+#include <klish/ktp_session.h>
+
+#include "private.h"
+
+typedef struct {
+	ktpd_session_t *session;
+	int id; // Identifier of grace timer
+} detached_entry_t;
+
+struct detached_s {
+	faux_eloop_t *eloop;
+	unsigned int grace; // Seconds
+	detached_expire_f expire_cb;
+	void *user_data;
+	faux_list_t *list;
+	int next_id;
+};
+
+
+/** @brief Creates registry of detached sessions
+ *
+ * @param [in] eloop Event loop for grace timers.
+ * @param [in] grace Grace period. Seconds.
+ * @param [in] expire_cb Callback to destroy expired session.
+ * @param [in] user_data Data for callback.
+ */
+detached_t *detached_new(faux_eloop_t *eloop, unsigned int grace,
+	detached_expire_f expire_cb, void *user_data)
+{
+	detached_t *detached = NULL;
+
+	assert(eloop);
+	if (!eloop)
+		return NULL;
+
+	detached = faux_zmalloc(sizeof(*detached));
+	assert(detached);
+	if (!detached)
+		return NULL;
+
+	// Initialize
+	detached->eloop = eloop;
+	detached->grace = grace;
+	detached->expire_cb = expire_cb;
+	detached->user_data = user_data;
+	detached->list = faux_list_new(FAUX_LIST_UNSORTED, FAUX_LIST_NONUNIQUE,
+		NULL, NULL, faux_free);
+	assert(detached->list);
+	// The positive timer identifiers are PIDs of ACTION's processes
+	detached->next_id = -1;
+
+	return detached;
+}
+
+
+/** @brief Frees registry and expires all the detached sessions
+ */
+void detached_free(detached_t *detached)
+{
+	faux_list_node_t *iter = NULL;
+	detached_entry_t *entry = NULL;
+
+	if (!detached)
+		return;
+
+	iter = faux_list_head(detached->list);
+	while ((entry = (detached_entry_t *)faux_list_each(&iter))) {
+		faux_eloop_del_sched_by_id(detached->eloop, entry->id);
+		if (detached->expire_cb)
+			detached->expire_cb(entry->session,
+				detached->user_data);
+	}
+	faux_list_free(detached->list);
+	faux_free(detached);
+}
+
+
+static faux_list_node_t *detached_find_node(detached_t *detached, int id)
+{
+	faux_list_node_t *iter = NULL;
+	faux_list_node_t *node = NULL;
+
+	iter = faux_list_head(detached->list);
+	while ((node = iter)) {
+		detached_entry_t *entry = NULL;
+		entry = (detached_entry_t *)faux_list_each(&iter);
+		if (entry->id == id)
+			return node;
+	}
+
+	return NULL;
+}
+
+
+static bool_t detached_expire_ev(faux_eloop_t *eloop, faux_eloop_type_e type,
+	void *associated_data, void *user_data)
+{
+	faux_eloop_info_sched_t *info = (faux_eloop_info_sched_t *)associated_data;
+	detached_t *detached = (detached_t *)user_data;
+	faux_list_node_t *node = NULL;
+	detached_entry_t *entry = NULL;
+
+	node = detached_find_node(detached, info->ev_id);
+	if (!node)
+		return BOOL_TRUE;
+	entry = (detached_entry_t *)faux_list_takeaway(detached->list, node);
+	syslog(LOG_INFO, "Detached session is expired\n");
+	if (detached->expire_cb)
+		detached->expire_cb(entry->session, detached->user_data);
+	faux_free(entry);
+
+	// Happy compiler
+	eloop = eloop;
+	type = type;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Detaches session and starts its grace timer
+ *
+ * @return BOOL_TRUE - session is kept, BOOL_FALSE - session can't be
+ * resumed so the caller must destroy it.
+ */
+bool_t detached_add(detached_t *detached, ktpd_session_t *session)
+{
+	detached_entry_t *entry = NULL;
+	struct timespec delay = {};
+
+	assert(detached);
+	if (!detached)
+		return BOOL_FALSE;
+	assert(session);
+	if (!session)
+		return BOOL_FALSE;
+	if (0 == detached->grace)
+		return BOOL_FALSE;
+
+	if (!ktpd_session_detach(session))
+		return BOOL_FALSE;
+
+	entry = faux_zmalloc(sizeof(*entry));
+	assert(entry);
+	entry->session = session;
+	entry->id = detached->next_id;
+	detached->next_id = (detached->next_id > INT32_MIN + 1) ?
+		(detached->next_id - 1) : -1;
+	delay.tv_sec = detached->grace;
+	if (!faux_eloop_add_sched_once_delayed(detached->eloop, &delay,
+		entry->id, detached_expire_ev, detached)) {
+		faux_free(entry);
+		return BOOL_FALSE;
+	}
+	faux_list_add(detached->list, entry);
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Takes detached session by resumption token
+ *
+ * The grace timer is stopped and session is removed from registry. The
+ * session can be resumed by its own user only. The token is not enough.
+ *
+ * @param [in] detached Registry.
+ * @param [in] token Resumption token.
+ * @param [in] uid Peer's user ID of new connection.
+ * @return Detached session or NULL if token is unknown.
+ */
+ktpd_session_t *detached_take(detached_t *detached, const uint8_t *token,
+	uid_t uid)
+{
+	faux_list_node_t *iter = NULL;
+	faux_list_node_t *node = NULL;
+
+	assert(detached);
+	if (!detached)
+		return NULL;
+	if (!token)
+		return NULL;
+
+	iter = faux_list_head(detached->list);
+	while ((node = iter)) {
+		detached_entry_t *entry = NULL;
+		ktpd_session_t *session = NULL;
+		entry = (detached_entry_t *)faux_list_each(&iter);
+		if (!ktpd_session_token_match(entry->session, token))
+			continue;
+		if (ktpd_session_uid(entry->session) != uid)
+			return NULL;
+		faux_eloop_del_sched_by_id(detached->eloop, entry->id);
+		session = entry->session;
+		faux_list_del(detached->list, node);
+		return session;
+	}
+
+	return NULL;
+}
+
+
+/** @brief Removes session from registry without expiration
+ *
+ * The grace timer is stopped. The caller destroys session itself.
+ */
+void detached_del(detached_t *detached, ktpd_session_t *session)
+{
+	faux_list_node_t *iter = NULL;
+	faux_list_node_t *node = NULL;
+
+	assert(detached);
+	if (!detached)
+		return;
+
+	iter = faux_list_head(detached->list);
+	while ((node = iter)) {
+		detached_entry_t *entry = NULL;
+		entry = (detached_entry_t *)faux_list_each(&iter);
+		if (entry->session != session)
+			continue;
+		faux_eloop_del_sched_by_id(detached->eloop, entry->id);
+		faux_list_del(detached->list, node);
+		return;
+	}
+}
@@ -16,13 +16,13 @@
 #include <sys/fsuid.h>
 #include <sys/wait.h>
 #include <poll.h>
+#include <pwd.h>
 #include <time.h>
 
 #include <faux/faux.h>
 #include <faux/str.h>
 #include <faux/ini.h>
 #include <faux/log.h>
-#include <faux/sched.h>
 #include <faux/sysdb.h>
 #include <faux/net.h>
 #include <faux/list.h>
@@ -32,9 +32,66 @@
 
 #include <klish/ktp.h>
 #include <klish/ktp_session.h>
+#include <klish/kscheme.h>
+#include <klish/ksession.h>
+#include <klish/ktoken.h>
+#include <klish/kxml.h>
+#include <klish/kexec.h>
+#include <klish/kexecq.h>
+#include <klish/kpty.h>
+#include <klish/kjob.h>
+#include <klish/kbatch.h>
+#include <klish/kcache.h>
+#include <klish/kflight.h>
 
 #include "private.h"
 
+/** @brief ACTION's processes of daemon
+ */
+typedef struct {
+	kexecq_t *queue; // Fair queue of processes
+	kjobs_t *jobs; // Background jobs. Their processes are queued too.
+	kcache_t *cache; // Output of cacheable commands. NULL - disabled.
+	kflights_t *flights; // Running cacheable commands. Own their processes.
+} execs_t;
+
+/** @brief Daemon's state shared by event handlers
+ */
+typedef struct {
+	struct options *opts;
+	kscheme_t *scheme;
+	execs_t *execs;
+	kpty_pool_t *ptys; // Ready pseudo-terminals of interactive commands
+	faux_list_t *clients; // Connected and detached clients
+	detached_t *detached; // Sessions which wait for resume
+	faux_eloop_t *eloop;
+} klishd_t;
+
+/** @brief Client's connection
+ *
+ * The KTP session is a protocol state. The klish session is a current path,
+ * user and VARs of client within loaded scheme.
+ */
+typedef struct {
+	klishd_t *klishd;
+	ktpd_session_t *ktpd;
+	ksession_t *ksession;
+	struct ucred cred; // Credentials of peer process
+	kexec_t *exec; // Process of current command. NULL - idle.
+	kbatch_t *batch; // Batch of current commands. Owns exec.
+	kflight_t *flight; // Flight of current cacheable command
+	const kcommand_t *command; // Current command. For navigation.
+	faux_list_t *lines; // Pipelined command lines
+	bool_t oneshot; // Close connection when command is finished
+} client_t;
+
+/** @brief Pipelined command line
+ */
+typedef struct {
+	char *line;
+	bool_t background; // Execute as background job
+} client_line_t;
+
 // Signal handlers
 static volatile int sigterm = 0; // Exit if 1
 static void sighandler(int signo);
@@ -46,12 +103,23 @@ static void sigchld_handler(int signo);
 // Network
 static int create_listen_unix_sock(const char *path);
 
+// Clients
+static bool_t client_event(faux_eloop_t *eloop, faux_eloop_type_e type,
+	void *associated_data, void *user_data);
+static bool_t client_answer(client_t *client, const kexec_t *exec);
+static bool_t client_next(client_t *client);
+static void client_close(client_t *client);
+
+// Processes
+static void exec_dispatch(klishd_t *klishd);
+
 
 static bool_t stop_loop(faux_eloop_t *eloop, faux_eloop_type_e type,
 	void *associated_data, void *user_data)
 {
 	faux_eloop_info_signal_t *info = (faux_eloop_info_signal_t *)associated_data;
-printf("SIGNAL %d\n", info->signo);
+
+	syslog(LOG_DEBUG, "Signal %d\n", info->signo);
 
 	// Happy compiler
 	eloop = eloop;
@@ -62,54 +130,1479 @@ printf("SIGNAL %d\n", info->signo);
 	return BOOL_FALSE; // Stop Event Loop
 }
 
-static bool_t unix_socket_event(faux_eloop_t *eloop, faux_eloop_type_e type,
+/** @brief Spools output of background job and sends it to attached sessions
+ *
+ * @return BOOL_FALSE on EOF or error.
+ */
+static bool_t job_read(kjob_t *job, int fd)
+{
+	char buf[4096];
+	ssize_t r = 0;
+
+	while ((r = read(fd, buf, sizeof(buf))) != 0) {
+		faux_list_node_t *iter = NULL;
+		ktpd_session_t *session = NULL;
+		if (r < 0)
+			return ((EAGAIN == errno) || (EINTR == errno)) ?
+				BOOL_TRUE : BOOL_FALSE;
+		kjob_spool(job, buf, r);
+		iter = kjob_watchers_iter(job);
+		while ((session = (ktpd_session_t *)kjob_watchers_each(&iter)))
+			ktpd_session_send_stdout(session, buf, r);
+	}
+
+	return BOOL_FALSE;
+}
+
+
+static bool_t job_output_event(faux_eloop_t *eloop, faux_eloop_type_e type,
 	void *associated_data, void *user_data)
 {
 	faux_eloop_info_fd_t *info = (faux_eloop_info_fd_t *)associated_data;
+	kjob_t *job = (kjob_t *)user_data;
 
-	if (info->revents & POLLIN) {
-		char buf[1000];
-		ssize_t s = 0;
+	if (!job_read(job, info->fd))
+		faux_eloop_del_fd(eloop, info->fd);
+
+	type = type; // Happy compiler
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Sends structured records of background job to attached sessions
+ *
+ * The records are not spooled. The session attached later gets the text
+ * output only.
+ *
+ * @return BOOL_FALSE on EOF or error.
+ */
+static bool_t job_records_read(kjob_t *job, int fd)
+{
+	char buf[4096];
+	ssize_t r = 0;
+
+	while ((r = read(fd, buf, sizeof(buf))) != 0) {
+		faux_list_node_t *iter = NULL;
+		ktpd_session_t *session = NULL;
+		if (r < 0)
+			return ((EAGAIN == errno) || (EINTR == errno)) ?
+				BOOL_TRUE : BOOL_FALSE;
+		iter = kjob_watchers_iter(job);
+		while ((session = (ktpd_session_t *)kjob_watchers_each(&iter)))
+			ktpd_session_send_records(session, buf, r);
+	}
+
+	return BOOL_FALSE;
+}
+
+
+static bool_t job_records_event(faux_eloop_t *eloop, faux_eloop_type_e type,
+	void *associated_data, void *user_data)
+{
+	faux_eloop_info_fd_t *info = (faux_eloop_info_fd_t *)associated_data;
+	kjob_t *job = (kjob_t *)user_data;
+
+	if (!job_records_read(job, info->fd))
+		faux_eloop_del_fd(eloop, info->fd);
+
+	type = type; // Happy compiler
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Removes job
+ *
+ * The job is a session of execution queue itself so it's removed from
+ * queue too.
+ */
+static void job_del(execs_t *execs, kjob_t *job)
+{
+	kexecq_del_session(execs->queue, job);
+	kjobs_del(execs->jobs, job);
+}
+
+
+/** @brief Delivers result of finished background job
+ *
+ * The rest of output is spooled first. The job is removed when its result
+ * is delivered to any attached session. Otherwise it's kept until somebody
+ * fetches it.
+ */
+static void job_done(execs_t *execs, kjob_t *job, faux_eloop_t *eloop)
+{
+	kexec_t *exec = kjob_exec(job);
+	faux_list_node_t *iter = NULL;
+	ktpd_session_t *session = NULL;
+	bool_t delivered = BOOL_FALSE;
+
+	faux_eloop_del_fd(eloop, kexec_stdout(exec));
+	faux_eloop_del_fd(eloop, kexec_stderr(exec));
+	job_read(job, kexec_stdout(exec));
+	job_read(job, kexec_stderr(exec));
+	if (kexec_records(exec) >= 0) {
+		faux_eloop_del_fd(eloop, kexec_records(exec));
+		job_records_read(job, kexec_records(exec));
+	}
+
+	iter = kjob_watchers_iter(job);
+	while ((session = (ktpd_session_t *)kjob_watchers_each(&iter))) {
+		if (ktpd_session_send_job_done(session, job) == 0)
+			delivered = BOOL_TRUE;
+	}
+	if (delivered)
+		job_del(execs, job);
+}
+
+
+/** @brief Drops background job which process can't be started
+ *
+ * The attached sessions get retcode -1.
+ */
+static void job_fail(execs_t *execs, kjob_t *job)
+{
+	faux_list_node_t *iter = NULL;
+	ktpd_session_t *session = NULL;
+
+	syslog(LOG_ERR, "Can't start job %u\n", kjob_id(job));
+	iter = kjob_watchers_iter(job);
+	while ((session = (ktpd_session_t *)kjob_watchers_each(&iter)))
+		ktpd_session_send_job_done(session, job);
+	job_del(execs, job);
+}
+
+
+/** @brief Collects output of flight and sends it to all subscribers
+ *
+ * @return BOOL_FALSE on EOF or error.
+ */
+static bool_t flight_read(kflight_t *flight, int fd, bool_t is_stderr)
+{
+	char buf[4096];
+	ssize_t r = 0;
+
+	while ((r = read(fd, buf, sizeof(buf))) != 0) {
+		faux_list_node_t *iter = NULL;
+		ktpd_session_t *session = NULL;
+		if (r < 0)
+			return ((EAGAIN == errno) || (EINTR == errno)) ?
+				BOOL_TRUE : BOOL_FALSE;
+		if (is_stderr)
+			kflight_add_stderr(flight, buf, r);
+		else
+			kflight_add_stdout(flight, buf, r);
+		iter = kflight_subscribers_iter(flight);
+		while ((session = (ktpd_session_t *)kflight_subscribers_each(&iter))) {
+			if (is_stderr)
+				ktpd_session_send_stderr(session, buf, r);
+			else
+				ktpd_session_send_stdout(session, buf, r);
+		}
+	}
+
+	return BOOL_FALSE;
+}
+
+
+static bool_t flight_output_event(faux_eloop_t *eloop, faux_eloop_type_e type,
+	void *associated_data, void *user_data)
+{
+	faux_eloop_info_fd_t *info = (faux_eloop_info_fd_t *)associated_data;
+	kflight_t *flight = (kflight_t *)user_data;
+	bool_t is_stderr = BOOL_FALSE;
+
+	is_stderr = (kexec_stderr(kflight_exec(flight)) == info->fd) ?
+		BOOL_TRUE : BOOL_FALSE;
+	if (!flight_read(flight, info->fd, is_stderr))
+		faux_eloop_del_fd(eloop, info->fd);
+
+	type = type; // Happy compiler
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Sends structured records of flight to all subscribers
+ *
+ * The records are not cached like job's ones are not spooled.
+ *
+ * @return BOOL_FALSE on EOF or error.
+ */
+static bool_t flight_records_read(kflight_t *flight, int fd)
+{
+	char buf[4096];
+	ssize_t r = 0;
+
+	while ((r = read(fd, buf, sizeof(buf))) != 0) {
+		faux_list_node_t *iter = NULL;
+		ktpd_session_t *session = NULL;
+		if (r < 0)
+			return ((EAGAIN == errno) || (EINTR == errno)) ?
+				BOOL_TRUE : BOOL_FALSE;
+		iter = kflight_subscribers_iter(flight);
+		while ((session = (ktpd_session_t *)kflight_subscribers_each(&iter)))
+			ktpd_session_send_records(session, buf, r);
+	}
+
+	return BOOL_FALSE;
+}
+
+
+static bool_t flight_records_event(faux_eloop_t *eloop, faux_eloop_type_e type,
+	void *associated_data, void *user_data)
+{
+	faux_eloop_info_fd_t *info = (faux_eloop_info_fd_t *)associated_data;
+	kflight_t *flight = (kflight_t *)user_data;
+
+	if (!flight_records_read(flight, info->fd))
+		faux_eloop_del_fd(eloop, info->fd);
+
+	type = type; // Happy compiler
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Removes flight which process is not finished
+ *
+ * The flight owns its process so the pending one is removed from queue
+ * first.
+ */
+static void flight_del(execs_t *execs, kflight_t *flight)
+{
+	kexecq_remove(execs->queue, kflight_exec(flight));
+	kexecq_del_session(execs->queue, flight);
+	kflights_del(execs->flights, flight);
+}
+
+
+/** @brief Delivers result of finished flight to all subscribers
+ *
+ * The rest of output is read first. Then the output is put to cache and
+ * the flight is removed. The flight that can't be started is finished the
+ * same way but its output is not cached. The subscribers continue with
+ * their pipelined lines when flight is removed so they can't join it
+ * again.
+ */
+static void flight_done(execs_t *execs, kflight_t *flight,
+	faux_eloop_t *eloop)
+{
+	kexec_t *exec = kflight_exec(flight);
+	faux_list_node_t *iter = NULL;
+	ktpd_session_t *session = NULL;
+	faux_list_t *clients = NULL;
+	client_t *client = NULL;
+
+	if (kexec_state(exec) != KEXEC_STATE_NEW) {
+		faux_eloop_del_fd(eloop, kexec_stdout(exec));
+		faux_eloop_del_fd(eloop, kexec_stderr(exec));
+		flight_read(flight, kexec_stdout(exec), BOOL_FALSE);
+		flight_read(flight, kexec_stderr(exec), BOOL_TRUE);
+		if (kexec_records(exec) >= 0) {
+			faux_eloop_del_fd(eloop, kexec_records(exec));
+			flight_records_read(flight, kexec_records(exec));
+		}
+	}
+
+	clients = faux_list_new(FAUX_LIST_UNSORTED, FAUX_LIST_NONUNIQUE,
+		NULL, NULL, NULL);
+	assert(clients);
+	while ((iter = kflight_subscribers_iter(flight))) {
+		session = (ktpd_session_t *)kflight_subscribers_each(&iter);
+		kflight_leave(flight, session);
+		client = (client_t *)ktpd_session_udata(session);
+		client->flight = NULL;
+		if (client_answer(client, exec))
+			faux_list_add(clients, client);
+		else
+			client_close(client);
+	}
+	kexecq_del_session(execs->queue, flight);
+	kflights_done(execs->flights, flight, execs->cache);
 
-		s = read(info->fd, buf, 1000);
-printf("Received %ld bytes on fd %d\n", s, info->fd);
-//faux_eloop_add_signal(eloop, SIGINT, stop_loop, NULL);
+	iter = faux_list_head(clients);
+	while ((client = (client_t *)faux_list_each(&iter))) {
+		if (!client_next(client))
+			client_close(client);
 	}
+	faux_list_free(clients);
+}
+
+
+static void client_line_free(void *data)
+{
+	client_line_t *line = (client_line_t *)data;
+
+	if (!line)
+		return;
+
+	faux_str_free(line->line);
+	faux_free(line);
+}
+
+
+static int client_compare(const void *first, const void *second)
+{
+	uintptr_t f = (uintptr_t)first;
+	uintptr_t s = (uintptr_t)second;
+
+	if (f == s)
+		return 0;
+
+	return (f < s) ? -1 : 1;
+}
+
+
+/** @brief Creates client for accepted connection
+ *
+ * The peer's credentials are got at once. The client is authenticated by
+ * them later on KTP_AUTH.
+ */
+static client_t *client_new(klishd_t *klishd, int sock)
+{
+	client_t *client = NULL;
+	socklen_t len = sizeof(client->cred);
+
+	client = faux_zmalloc(sizeof(*client));
+	assert(client);
+	if (!client)
+		return NULL;
+
+	// Init
+	client->klishd = klishd;
+	if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED,
+		&client->cred, &len) < 0) {
+		syslog(LOG_ERR, "Can't get peer credentials: %s\n",
+			strerror(errno));
+		faux_free(client);
+		return NULL;
+	}
+	client->ktpd = ktpd_session_new(sock);
+	assert(client->ktpd);
+	ktpd_session_set_udata(client->ktpd, client);
+	client->ksession = ksession_new(klishd->scheme,
+		kscheme_startup(klishd->scheme));
+	assert(client->ksession);
+	client->exec = NULL;
+	client->flight = NULL;
+	client->batch = NULL;
+	client->command = NULL;
+	client->lines = faux_list_new(FAUX_LIST_UNSORTED, FAUX_LIST_NONUNIQUE,
+		NULL, NULL, client_line_free);
+	assert(client->lines);
+	client->oneshot = BOOL_FALSE;
+	faux_list_add(klishd->clients, client);
+
+	return client;
+}
+
+
+/** @brief Frees client but doesn't close its connection
+ *
+ * The pending command is dropped and the running one is killed. The
+ * session is removed from jobs and flights. They keep running without
+ * it. The detached session is removed from registry.
+ */
+static void client_free(client_t *client)
+{
+	klishd_t *klishd = client->klishd;
+	kexec_t *exec = client->exec;
+
+	if (ktpd_session_detached(client->ktpd))
+		detached_del(klishd->detached, client->ktpd);
+	// The pending process is dropped with session's queue. The running
+	// one releases its slot. Both are killed by kexec_free().
+	if (exec && (kexec_state(exec) != KEXEC_STATE_NEW)) {
+		faux_eloop_del_fd(klishd->eloop, kexec_stdout(exec));
+		faux_eloop_del_fd(klishd->eloop, kexec_stderr(exec));
+		if (kexec_records(exec) >= 0)
+			faux_eloop_del_fd(klishd->eloop, kexec_records(exec));
+		kexecq_done(klishd->execs->queue, exec);
+	}
+	kexecq_del_session(klishd->execs->queue, client->ktpd);
+	if (client->batch)
+		kbatch_free(client->batch);
+	else
+		kexec_free(exec);
+	// Nobody waits for output of the pending flight anymore
+	if (client->flight) {
+		kflight_leave(client->flight, client->ktpd);
+		if ((0 == kflight_subscribers_len(client->flight)) &&
+			(kexec_state(kflight_exec(client->flight)) ==
+			KEXEC_STATE_NEW))
+			flight_del(klishd->execs, client->flight);
+	}
+	faux_list_free(client->lines);
+	kjobs_detach_all(klishd->execs->jobs, client->ktpd);
+	kflights_leave_all(klishd->execs->flights, client->ktpd);
+	ktpd_session_free(client->ktpd);
+	ksession_free(client->ksession);
+	faux_list_del(klishd->clients,
+		faux_list_kfind_node(klishd->clients, client));
+	faux_free(client);
+}
+
+
+/** @brief Closes client's connection and frees client
+ */
+static void client_close(client_t *client)
+{
+	int sock = ktpd_session_get_socket(client->ktpd);
+
+	syslog(LOG_DEBUG, "Close connection %d\n", sock);
+	faux_eloop_del_fd(client->klishd->eloop, sock);
+	client_free(client);
+	ktp_disconnect(sock);
+}
+
+
+/** @brief Detaches session of lost connection
+ *
+ * The session is kept for grace period so the client can resume it. The
+ * command keeps running meanwhile. The unauthorized and one-shot sessions
+ * are closed.
+ */
+static void client_lost(client_t *client)
+{
+	klishd_t *klishd = client->klishd;
+	int sock = ktpd_session_get_socket(client->ktpd);
 
-	if (info->revents & POLLHUP) {
-		close(info->fd);
+	if (client->oneshot || !ktpd_session_authorized(client->ktpd)) {
+		client_close(client);
+		return;
+	}
+	faux_eloop_del_fd(klishd->eloop, sock);
+	if (!detached_add(klishd->detached, client->ktpd)) {
+		client_close(client);
+		return;
+	}
+	syslog(LOG_INFO, "Session of user %s is detached\n",
+		ktpd_session_user(client->ktpd));
+}
+
+
+static client_t *client_find_by_exec(const klishd_t *klishd,
+	const kexec_t *exec)
+{
+	faux_list_node_t *iter = faux_list_head(klishd->clients);
+	client_t *client = NULL;
+
+	while ((client = (client_t *)faux_list_each(&iter))) {
+		if (client->exec == exec)
+			return client;
+	}
+
+	return NULL;
+}
+
+
+/** @brief Sends output of client's command to client
+ *
+ * @return BOOL_FALSE on EOF or error.
+ */
+static bool_t client_read(client_t *client, int fd, bool_t is_stderr)
+{
+	char buf[4096];
+	ssize_t r = 0;
+
+	while ((r = read(fd, buf, sizeof(buf))) != 0) {
+		if (r < 0)
+			return ((EAGAIN == errno) || (EINTR == errno)) ?
+				BOOL_TRUE : BOOL_FALSE;
+		if (is_stderr)
+			ktpd_session_send_stderr(client->ktpd, buf, r);
+		else
+			ktpd_session_send_stdout(client->ktpd, buf, r);
+	}
+
+	return BOOL_FALSE;
+}
+
+
+static bool_t client_output_event(faux_eloop_t *eloop, faux_eloop_type_e type,
+	void *associated_data, void *user_data)
+{
+	faux_eloop_info_fd_t *info = (faux_eloop_info_fd_t *)associated_data;
+	client_t *client = (client_t *)user_data;
+	bool_t is_stderr = BOOL_FALSE;
+
+	is_stderr = (kexec_stderr(client->exec) == info->fd) ?
+		BOOL_TRUE : BOOL_FALSE;
+	if (!client_read(client, info->fd, is_stderr))
 		faux_eloop_del_fd(eloop, info->fd);
-		syslog(LOG_DEBUG, "Close connection %d", info->fd);
+
+	type = type; // Happy compiler
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Sends structured records of client's command to client
+ *
+ * @return BOOL_FALSE on EOF or error.
+ */
+static bool_t client_records_read(client_t *client, int fd)
+{
+	char buf[4096];
+	ssize_t r = 0;
+
+	while ((r = read(fd, buf, sizeof(buf))) != 0) {
+		if (r < 0)
+			return ((EAGAIN == errno) || (EINTR == errno)) ?
+				BOOL_TRUE : BOOL_FALSE;
+		ktpd_session_send_records(client->ktpd, buf, r);
 	}
 
+	return BOOL_FALSE;
+}
+
+
+static bool_t client_records_event(faux_eloop_t *eloop, faux_eloop_type_e type,
+	void *associated_data, void *user_data)
+{
+	faux_eloop_info_fd_t *info = (faux_eloop_info_fd_t *)associated_data;
+	client_t *client = (client_t *)user_data;
+
+	if (!client_records_read(client, info->fd))
+		faux_eloop_del_fd(eloop, info->fd);
+
 	type = type; // Happy compiler
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Connects output of started command to client
+ *
+ * The interactive command gets client's input. The stdin of others is
+ * closed at once.
+ */
+static void client_started(client_t *client)
+{
+	kexec_t *exec = client->exec;
+	faux_eloop_t *eloop = client->klishd->eloop;
+
+	if (kaction_interactive(kcommand_action(client->command)))
+		fcntl(kexec_stdin(exec), F_SETFL, O_NONBLOCK);
+	else
+		kexec_close_stdin(exec);
+	fcntl(kexec_stdout(exec), F_SETFL, O_NONBLOCK);
+	fcntl(kexec_stderr(exec), F_SETFL, O_NONBLOCK);
+	faux_eloop_add_fd(eloop, kexec_stdout(exec), POLLIN,
+		client_output_event, client);
+	faux_eloop_add_fd(eloop, kexec_stderr(exec), POLLIN,
+		client_output_event, client);
+	if (kexec_records(exec) >= 0) {
+		fcntl(kexec_records(exec), F_SETFL, O_NONBLOCK);
+		faux_eloop_add_fd(eloop, kexec_records(exec), POLLIN,
+			client_records_event, client);
+	}
+}
+
+
+/** @brief Sends hotkeys and help index of current view to client
+ *
+ * The one-shot client executes nothing but its command so it needs
+ * neither.
+ */
+static void client_view(client_t *client)
+{
+	if (client->oneshot)
+		return;
+	ktpd_session_send_hotkeys(client->ktpd,
+		ksession_hotkeys(client->ksession));
+	ktpd_session_send_help_index(client->ktpd, client->ksession);
+}
+
+
+/** @brief Navigates by finished command
+ *
+ * The navigation of command is done if command is successful only.
+ *
+ * @return 0 - success, 1 - session must be closed, < 0 - error.
+ */
+static int client_nav(client_t *client, const kcommand_t *command,
+	int retcode)
+{
+	int nav = 0;
+
+	if (retcode != 0)
+		return 0;
+	nav = kpath_nav(ksession_path(client->ksession), command);
+	if (nav < 0)
+		syslog(LOG_ERR, "Can't navigate by command %s\n",
+			kcommand_name(command));
+	else if ((0 == nav) && (kcommand_nav(command) != KNAV_NONE))
+		client_view(client);
+
+	return nav;
+}
+
+
+/** @brief Answers command by retcode of its process
+ *
+ * @return BOOL_FALSE if session must be closed.
+ */
+static bool_t client_answer(client_t *client, const kexec_t *exec)
+{
+	int nav = 0;
+
+	nav = client_nav(client, client->command, kexec_retcode(exec));
+	ktpd_session_send_cmd_ack(client->ktpd, exec);
+	client->command = NULL;
+
+	return ((1 == nav) || client->oneshot) ? BOOL_FALSE : BOOL_TRUE;
+}
+
+
+/** @brief Answers client's command from cache
+ *
+ * The cached command navigates like the executed one.
+ *
+ * @return BOOL_FALSE if session must be closed.
+ */
+static bool_t client_cached(client_t *client, const kcommand_t *command,
+	const kcache_entry_t *entry)
+{
+	int nav = 0;
+
+	nav = client_nav(client, command, kcache_entry_retcode(entry));
+	ktpd_session_send_cached(client->ktpd, entry);
+
+	return ((1 == nav) || client->oneshot) ? BOOL_FALSE : BOOL_TRUE;
+}
+
+
+/** @brief Answers each command of finished batch by its own retcode
+ *
+ * @return BOOL_FALSE if session must be closed.
+ */
+static bool_t client_batch_answer(client_t *client)
+{
+	faux_list_node_t *iter = NULL;
+	int retcode = -1;
+
+	kbatch_done(client->batch);
+	iter = kbatch_iter(client->batch);
+	while (kbatch_each_result(&iter, &retcode))
+		ktpd_session_send_cmd_result(client->ktpd, retcode, NULL);
+	client->command = NULL;
+
+	return client->oneshot ? BOOL_FALSE : BOOL_TRUE;
+}
+
+
+/** @brief Delivers result of client's command
+ *
+ * The rest of output is sent first. The command that can't be started is
+ * finished the same way.
+ *
+ * @return BOOL_FALSE if session must be closed.
+ */
+static bool_t client_done(client_t *client)
+{
+	kexec_t *exec = client->exec;
+	faux_eloop_t *eloop = client->klishd->eloop;
+	bool_t keep = BOOL_FALSE;
+
+	if (kexec_state(exec) != KEXEC_STATE_NEW) {
+		faux_eloop_del_fd(eloop, kexec_stdout(exec));
+		faux_eloop_del_fd(eloop, kexec_stderr(exec));
+		client_read(client, kexec_stdout(exec), BOOL_FALSE);
+		client_read(client, kexec_stderr(exec), BOOL_TRUE);
+		if (kexec_records(exec) >= 0) {
+			faux_eloop_del_fd(eloop, kexec_records(exec));
+			client_records_read(client, kexec_records(exec));
+		}
+	}
+	if (client->batch) {
+		keep = client_batch_answer(client);
+		kbatch_free(client->batch);
+		client->batch = NULL;
+	} else {
+		keep = client_answer(client, exec);
+		kexec_free(exec);
+	}
+	client->exec = NULL;
+
+	return keep;
+}
+
+
+/** @brief Exports BINDs of command's level to ACTION's environment
+ *
+ * So the ACTION of template's command is parameterized by instance. The
+ * BIND "name" is KLISH_BIND_name variable.
+ */
+static void exec_binds(kexec_t *exec, const klevel_t *level)
+{
+	kview_t *view = klevel_view(level);
+	const kview_t *tmpl = NULL;
+
+	// The instance's BIND overrides the template's default one
+	for (tmpl = view; tmpl; tmpl = kview_template(tmpl)) {
+		size_t num = kview_binds_num(tmpl);
+		size_t i = 0;
+		for (i = 0; i < num; i++) {
+			const char *name = kview_bind_name(tmpl, i);
+			char *env = faux_str_sprintf("%s%s",
+				KVIEW_BIND_ENV_PREFIX, name);
+			kexec_add_env(exec, env, kview_bind(view, name));
+			faux_str_free(env);
+		}
+	}
+}
+
+
+/** @brief Starts command as background job
+ *
+ * The job is a batch session of execution queue itself so it outlives the
+ * client. The command is answered at once by job's identifier. The
+ * command without ACTION can't be a job because it navigates only.
+ */
+static void client_job(client_t *client, const klevel_cmd_t *cmd,
+	const char *line)
+{
+	klishd_t *klishd = client->klishd;
+	execs_t *execs = klishd->execs;
+	kaction_t *action = kcommand_action(cmd->command);
+	kexec_t *exec = NULL;
+	kjob_t *job = NULL;
+
+	if (action)
+		exec = kexec_new(action, &klishd->opts->exec_limits);
+	if (!exec) {
+		ktpd_session_send_cmd_result(client->ktpd, -1,
+			"Error: Can't execute command in background\n");
+		return;
+	}
+	exec_binds(exec, cmd->level);
+	job = kjobs_add(execs->jobs, ktpd_session_user(client->ktpd),
+		line, exec);
+	if (!job) {
+		kexec_free(exec);
+		ktpd_session_send_cmd_result(client->ktpd, -1,
+			"Error: Too many jobs\n");
+		return;
+	}
+	if (!kexecq_add_session(execs->queue, job, kjob_user(job),
+		klishd->opts->weight_batch) ||
+		!kexecq_push(execs->queue, job, exec)) {
+		job_del(execs, job);
+		ktpd_session_send_cmd_result(client->ktpd, -1,
+			"Error: Can't execute command in background\n");
+		return;
+	}
+	syslog(LOG_INFO, "User %s started job %u\n",
+		kjob_user(job), kjob_id(job));
+	ktpd_session_send_job_started(client->ktpd, job);
+}
+
+
+/** @brief Executes cacheable command by flight
+ *
+ * The client joins the running flight of identical command or starts the
+ * new one. The flight is a session of execution queue itself because it
+ * doesn't belong to any client. The late subscriber gets the output
+ * collected so far first.
+ *
+ * @return BOOL_FALSE if command must be executed by its own process.
+ */
+static bool_t client_flight(client_t *client, const klevel_cmd_t *cmd,
+	kaction_t *action, const char *key)
+{
+	const kcommand_t *command = cmd->command;
+	klishd_t *klishd = client->klishd;
+	execs_t *execs = klishd->execs;
+	kflight_t *flight = NULL;
+	kexec_t *exec = NULL;
+
+	flight = kflights_find(execs->flights, key);
+	if (flight) {
+		const kcache_entry_t *entry = kflight_entry(flight);
+		const char *data = NULL;
+		size_t len = 0;
+		data = kcache_entry_stdout(entry, &len);
+		ktpd_session_send_stdout(client->ktpd, data, len);
+		data = kcache_entry_stderr(entry, &len);
+		ktpd_session_send_stderr(client->ktpd, data, len);
+	} else {
+		exec = kexec_new(action, &klishd->opts->exec_limits);
+		if (!exec)
+			return BOOL_FALSE;
+		exec_binds(exec, cmd->level);
+		// The flight which output is oversized can't be joined
+		flight = kflights_add(execs->flights, key,
+			kcommand_cache(command), exec);
+		if (!flight) {
+			kexec_free(exec);
+			return BOOL_FALSE;
+		}
+		if (!kexecq_add_session(execs->queue, flight,
+			ktpd_session_user(client->ktpd), client->oneshot ?
+			klishd->opts->weight_batch :
+			klishd->opts->weight_interactive) ||
+			!kexecq_push(execs->queue, flight, exec)) {
+			flight_del(execs, flight);
+			return BOOL_FALSE;
+		}
+	}
+	kflight_join(flight, client->ktpd);
+	client->flight = flight;
+	client->command = command;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Checks if command can be executed within batch
+ *
+ * The navigating command changes path the following lines are parsed
+ * within. The cacheable one is served by cache.
+ */
+static bool_t client_batchable(const kcommand_t *command)
+{
+	const kaction_t *action = kcommand_action(command);
+
+	if (!kbatch_action_batchable(action) || !kaction_script(action))
+		return BOOL_FALSE;
+	if ((kcommand_nav(command) != KNAV_NONE) || kcommand_cache(command))
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Adds pipelined line to batch
+ *
+ * The batch's process has BINDs of one level so the commands found on the
+ * other levels can't join it.
+ *
+ * @return BOOL_FALSE if line can't be batched.
+ */
+static bool_t client_batch_add(client_t *client, kbatch_t *batch,
+	const klevel_t *level, const char *line)
+{
+	ktokens_t *tokens = NULL;
+	const klevel_cmd_t *cmd = NULL;
+
+	tokens = ktokens_new();
+	assert(tokens);
+	ktokens_parse(tokens, line, strlen(line));
+	if (ktokens_len(tokens) > 0)
+		cmd = ksession_parse_command(client->ksession, tokens, NULL);
+	ktokens_free(tokens);
+	if (!cmd || (cmd->level != level) || !client_batchable(cmd->command))
+		return BOOL_FALSE;
+
+	return kbatch_add(batch, kcommand_action(cmd->command), line, client);
+}
+
+
+/** @brief Executes command with pipelined ones by single process
+ *
+ * The following pipelined lines join the batch while their commands have
+ * the same script. The first line that can't join stays pipelined. The
+ * single command is a batch too so the script always gets its lines on
+ * stdin. Each command is answered by its own retcode when process is
+ * finished.
+ *
+ * @return BOOL_FALSE if command can't be batched so it must be executed
+ * by its own process.
+ */
+static bool_t client_batch(client_t *client, const klevel_cmd_t *cmd,
+	const char *line)
+{
+	klishd_t *klishd = client->klishd;
+	const kcommand_t *command = cmd->command;
+	kbatch_t *batch = NULL;
+	faux_list_node_t *node = NULL;
+	kexec_t *exec = NULL;
+
+	if (!client_batchable(command))
+		return BOOL_FALSE;
+	batch = kbatch_new(0);
+	assert(batch);
+	if (!kbatch_add(batch, kcommand_action(command), line, client)) {
+		kbatch_free(batch);
+		return BOOL_FALSE;
+	}
+	while ((node = faux_list_head(client->lines))) {
+		client_line_t *next = (client_line_t *)faux_list_data(node);
+		if (next->background ||
+			!client_batch_add(client, batch, cmd->level, next->line))
+			break;
+		faux_list_del(client->lines, node);
+	}
+
+	exec = kbatch_exec(batch, &klishd->opts->exec_limits);
+	if (exec)
+		exec_binds(exec, cmd->level);
+	if (!exec || !kexecq_push(klishd->execs->queue, client->ktpd, exec)) {
+		size_t i = 0;
+		for (i = 0; i < kbatch_len(batch); i++)
+			ktpd_session_send_cmd_result(client->ktpd, -1,
+				"Error: Can't execute command\n");
+		kbatch_free(batch);
+		return BOOL_TRUE;
+	}
+	syslog(LOG_DEBUG, "Batch of %zu commands\n", kbatch_len(batch));
+	client->batch = batch;
+	client->exec = exec;
+	client->command = command;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Executes command line
+ *
+ * The command without ACTION is a navigation only so it's answered at
+ * once. The ACTION's process is queued. The command is answered when its
+ * process is finished. The background command is answered when its job
+ * is queued.
+ *
+ * @return BOOL_FALSE if session must be closed.
+ */
+static bool_t client_exec(client_t *client, const char *line,
+	bool_t background)
+{
+	klishd_t *klishd = client->klishd;
+	ktokens_t *tokens = NULL;
+	const klevel_cmd_t *cmd = NULL;
+	kaction_t *action = NULL;
+	kexec_t *exec = NULL;
+	char *key = NULL;
+	int nav = 0;
+
+	tokens = ktokens_new();
+	assert(tokens);
+	ktokens_parse(tokens, line, strlen(line));
+	// Empty line
+	if (0 == ktokens_len(tokens)) {
+		ktokens_free(tokens);
+		ktpd_session_send_cmd_result(client->ktpd, 0, NULL);
+		return BOOL_TRUE;
+	}
+	cmd = ksession_parse_command(client->ksession, tokens, NULL);
+	if (cmd && !background)
+		key = ksession_cache_key(client->ksession, cmd, tokens);
+	ktokens_free(tokens);
+	if (!cmd) {
+		ktpd_session_send_cmd_result(client->ktpd, -1,
+			"Error: Illegal command\n");
+		return BOOL_TRUE;
+	}
+
+	action = kcommand_action(cmd->command);
+	if (background) {
+		client_job(client, cmd, line);
+		return BOOL_TRUE;
+	}
+	if (!action) {
+		faux_str_free(key);
+		nav = kpath_nav(ksession_path(client->ksession), cmd->command);
+		if ((0 == nav) && (kcommand_nav(cmd->command) != KNAV_NONE))
+			client_view(client);
+		ktpd_session_send_cmd_result(client->ktpd, (nav < 0) ? -1 : 0,
+			(nav < 0) ? "Error: Can't navigate\n" : NULL);
+		return (1 == nav) ? BOOL_FALSE : BOOL_TRUE;
+	}
+	// The output of cacheable command is served from cache or the
+	// identical commands share one process
+	if (key) {
+		kcache_t *cache = klishd->execs->cache;
+		const kcache_entry_t *entry = NULL;
+		bool_t joined = BOOL_FALSE;
+		if (cache)
+			entry = kcache_get(cache, key);
+		if (!entry)
+			joined = client_flight(client, cmd, action, key);
+		faux_str_free(key);
+		if (entry)
+			return client_cached(client, cmd->command, entry);
+		if (joined)
+			return BOOL_TRUE;
+	}
+	// The consecutive config commands share one process
+	if (client_batch(client, cmd, line))
+		return BOOL_TRUE;
+	// The builtin ACTION has no script so it can't be executed. The
+	// daemon's limits are the defaults of ACTION's own ones.
+	exec = kexec_new(action, &klishd->opts->exec_limits);
+	if (!exec) {
+		ktpd_session_send_cmd_result(client->ktpd, -1,
+			"Error: Can't execute command\n");
+		return BOOL_TRUE;
+	}
+	exec_binds(exec, cmd->level);
+	kexec_set_pty_pool(exec, klishd->ptys);
+	if (!kexecq_push(klishd->execs->queue, client->ktpd, exec)) {
+		kexec_free(exec);
+		ktpd_session_send_cmd_result(client->ktpd, -1,
+			"Error: Can't execute command\n");
+		return BOOL_TRUE;
+	}
+	client->exec = exec;
+	client->command = cmd->command;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Executes pipelined lines until one of them starts a process
+ *
+ * @return BOOL_FALSE if session must be closed.
+ */
+static bool_t client_next(client_t *client)
+{
+	faux_list_node_t *node = NULL;
+
+	// The answer is kept for one command only
+	if (ktpd_session_detached(client->ktpd))
+		return BOOL_TRUE;
+	while (!client->exec && !client->flight &&
+		(node = faux_list_head(client->lines))) {
+		client_line_t *line = (client_line_t *)faux_list_takeaway(
+			client->lines, node);
+		bool_t keep = client_exec(client, line->line, line->background);
+		client_line_free(line);
+		if (!keep)
+			return BOOL_FALSE;
+	}
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Processes KTP_CMD
+ *
+ * The session is sequential because command can change current path. So
+ * the pipelined line waits until the previous commands are finished.
+ *
+ * @return BOOL_FALSE if session must be closed.
+ */
+static bool_t client_cmd(client_t *client, const faux_msg_t *msg)
+{
+	char *line = NULL;
+	bool_t background = BOOL_FALSE;
+	bool_t keep = BOOL_FALSE;
+
+	line = ktpd_cmd_line(msg);
+	if (!line) {
+		ktpd_session_send_cmd_result(client->ktpd, -1,
+			"Error: No command line\n");
+		return BOOL_TRUE;
+	}
+	background = ktpd_cmd_background(msg);
+	if (client->exec || client->flight ||
+		!faux_list_is_empty(client->lines)) {
+		client_line_t *pending = faux_zmalloc(sizeof(*pending));
+		assert(pending);
+		pending->line = line;
+		pending->background = background;
+		faux_list_add(client->lines, pending);
+		return BOOL_TRUE;
+	}
+	keep = client_exec(client, line, background);
+	faux_str_free(line);
+
+	return keep;
+}
+
+
+/** @brief Resumes detached session
+ *
+ * The session can be resumed by its own user only. The connection is
+ * moved to resumed session and the new client is freed. The client gets
+ * the output it has missed and the answer of command that is finished
+ * meanwhile.
+ *
+ * @return BOOL_FALSE if connection must be closed. The client is freed
+ * already if BOOL_TRUE.
+ */
+static bool_t client_resume(client_t *client, const uint8_t *token,
+	uint64_t received)
+{
+	klishd_t *klishd = client->klishd;
+	ktpd_session_t *ktpd = NULL;
+	client_t *resumed = NULL;
+	int sock = -1;
+	uint64_t lost = 0;
+
+	ktpd = detached_take(klishd->detached, token, client->cred.uid);
+	if (!ktpd) {
+		syslog(LOG_WARNING, "Can't resume session for user %u\n",
+			client->cred.uid);
+		ktpd_session_send_auth_ack(client->ktpd, (uint32_t)-1);
+		return BOOL_FALSE;
+	}
+	resumed = (client_t *)ktpd_session_udata(ktpd);
+
+	sock = ktpd_session_get_socket(client->ktpd);
+	faux_eloop_del_fd(klishd->eloop, sock);
+	client_free(client);
+	if (ktpd_session_resume(ktpd, sock, received, &lost) < 0) {
+		syslog(LOG_ERR, "Can't resume session of user %s\n",
+			ktpd_session_user(ktpd));
+		// The bad request doesn't take connection
+		if (ktpd_session_get_socket(ktpd) != sock)
+			ktp_disconnect(sock);
+		client_close(resumed);
+		return BOOL_TRUE;
+	}
+	if (lost > 0)
+		syslog(LOG_WARNING, "Session of user %s lost %llu bytes of output\n",
+			ktpd_session_user(ktpd), (unsigned long long)lost);
+	syslog(LOG_INFO, "Session of user %s is resumed\n",
+		ktpd_session_user(ktpd));
+	faux_eloop_add_fd(klishd->eloop, sock, POLLIN, client_event, resumed);
+	// The new client process has no help index and map of hotkeys
+	ktpd_session_send_version(ktpd, kscheme_version(klishd->scheme));
+	client_view(resumed);
+	if (!client_next(resumed))
+		client_close(resumed);
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Authenticates client by credentials of peer process
+ *
+ * The KTP_AUTH with command line is a one-shot request. The command is
+ * executed just after authentication and the connection is closed when
+ * command is answered. The one-shot session has batch weight within the
+ * queue.
+ *
+ * @return BOOL_FALSE if connection must be closed.
+ */
+static bool_t client_auth(client_t *client, const faux_msg_t *msg)
+{
+	struct passwd *pw = NULL;
+	char *line = NULL;
+	bool_t keep = BOOL_FALSE;
+	uint8_t token[KTP_TOKEN_LEN] = {};
+	uint64_t received = 0;
+
+	if (ktpd_auth_resume(msg, token, &received))
+		return client_resume(client, token, received);
+	pw = getpwuid(client->cred.uid);
+	if (!pw) {
+		syslog(LOG_WARNING, "Unknown user %u\n", client->cred.uid);
+		ktpd_session_send_auth_ack(client->ktpd, (uint32_t)-1);
+		return BOOL_FALSE;
+	}
+	ktpd_session_login(client->ktpd, pw->pw_name, pw->pw_uid, pw->pw_gid);
+	ksession_login(client->ksession, pw->pw_name, pw->pw_uid, pw->pw_gid);
+	line = ktpd_auth_line(msg);
+	// The one-shot session is not resumed so it needs no replay
+	if (!line)
+		ktpd_session_set_replay_size(client->ktpd,
+			client->klishd->opts->replay_size);
+	kexecq_add_session(client->klishd->execs->queue, client->ktpd,
+		pw->pw_name, line ? client->klishd->opts->weight_batch :
+		client->klishd->opts->weight_interactive);
+	syslog(LOG_INFO, "User %s is logged in\n", pw->pw_name);
+	if (ktpd_session_send_auth_ack(client->ktpd, 0) < 0) {
+		faux_str_free(line);
+		return BOOL_FALSE;
+	}
+	if (!line) {
+		// The client drops the help index it keeps if scheme differs
+		ktpd_session_send_version(client->ktpd,
+			kscheme_version(client->klishd->scheme));
+		client_view(client);
+		return BOOL_TRUE;
+	}
+
+	client->oneshot = BOOL_TRUE;
+	keep = client_exec(client, line, BOOL_FALSE);
+	faux_str_free(line);
+
+	// The command without process is answered already
+	return (keep && (client->exec || client->flight)) ?
+		BOOL_TRUE : BOOL_FALSE;
+}
+
+
+/** @brief Forwards KTP_STDIN to running command
+ *
+ * The input of command that is not started yet or is not interactive is
+ * dropped. The input is dropped too if command doesn't read it in time.
+ */
+static void client_stdin(client_t *client, const faux_msg_t *msg)
+{
+	kexec_t *exec = client->exec;
+	void *data = NULL;
+	uint32_t len = 0;
+	const char *p = NULL;
+
+	if (!exec || (kexec_stdin(exec) < 0))
+		return;
+	if (!faux_msg_get_param_by_type(msg, KTP_PARAM_DATA, &data, &len))
+		return;
+
+	p = (const char *)data;
+	while (len > 0) {
+		ssize_t r = write(kexec_stdin(exec), p, len);
+		if (r < 0) {
+			if (EINTR == errno)
+				continue;
+			syslog(LOG_WARNING, "Can't write to stdin of command %s: %s\n",
+				kcommand_name(client->command), strerror(errno));
+			return;
+		}
+		p += r;
+		len -= r;
+	}
+}
+
+
+/** @brief Attaches client to background job by KTP_JOB_ATTACH
+ *
+ * The result of finished job is delivered at once so the job is removed.
+ */
+static void client_job_attach(client_t *client, const faux_msg_t *msg)
+{
+	execs_t *execs = client->klishd->execs;
+	kjob_t *job = NULL;
+
+	job = ktpd_session_job_attach(client->ktpd, execs->jobs, msg);
+	if (job && kjob_finished(job))
+		job_del(execs, job);
+}
+
+
+/** @brief Processes message of client
+ *
+ * @return BOOL_FALSE if connection must be closed.
+ */
+/** @brief Answers context help the client can't find within its index
+ *
+ * The help doesn't depend on running command so it's answered at once.
+ */
+static void client_help(client_t *client, const faux_msg_t *msg)
+{
+	char *line = ktpd_cmd_line(msg);
+
+	syslog(LOG_DEBUG, "Help request for \"%s\"\n", line ? line : "");
+	ktpd_session_send_help(client->ktpd, client->ksession,
+		line ? line : "");
+	faux_str_free(line);
+}
+
+
+static bool_t client_msg(client_t *client, const faux_msg_t *msg)
+{
+	ktp_cmd_e cmd = (ktp_cmd_e)faux_msg_get_cmd(msg);
+
+	// Unauthorized client can authenticate only
+	if (!ktpd_session_authorized(client->ktpd))
+		return (KTP_AUTH == cmd) ? client_auth(client, msg) : BOOL_FALSE;
+
+	switch (cmd) {
+	case KTP_CMD:
+		return client_cmd(client, msg);
+	case KTP_STDIN:
+		client_stdin(client, msg);
+		break;
+	case KTP_HELP:
+		client_help(client, msg);
+		break;
+	case KTP_JOBS:
+		ktpd_session_send_jobs(client->ktpd, client->klishd->execs->jobs);
+		break;
+	case KTP_JOB_ATTACH:
+		client_job_attach(client, msg);
+		break;
+	case KTP_KEEPALIVE:
+		break;
+	default:
+		syslog(LOG_WARNING, "Unsupported command '%c'\n", cmd);
+		break;
+	}
+
+	return BOOL_TRUE;
+}
+
+
+static bool_t client_event(faux_eloop_t *eloop, faux_eloop_type_e type,
+	void *associated_data, void *user_data)
+{
+	faux_eloop_info_fd_t *info = (faux_eloop_info_fd_t *)associated_data;
+	client_t *client = (client_t *)user_data;
+	klishd_t *klishd = client->klishd;
+
+	// The buffer of disconnected socket can still contain data. So the
+	// POLLHUP is processed when all messages are read.
+	if (info->revents & POLLIN) {
+		faux_msg_t *msg = ktpd_session_recv(client->ktpd);
+		// The client is freed by resumption of other session so it's
+		// not used after message is processed
+		if (!msg)
+			client_lost(client);
+		else if (!client_msg(client, msg))
+			client_close(client);
+		faux_msg_free(msg);
+		exec_dispatch(klishd);
+	} else if (info->revents & (POLLHUP | POLLERR | POLLNVAL)) {
+		client_lost(client);
+	}
+
+	eloop = eloop; // Happy compiler
+	type = type; // Happy compiler
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Starts queued processes while there are free slots
+ *
+ * The background job has no terminal. Its stdin is closed at once and its
+ * output is spooled. The flight has no terminal too because its output is
+ * shared by many sessions. Its output is fanned out to subscribers and
+ * collected for cache. The output of client's command is sent to client.
+ */
+static void exec_dispatch(klishd_t *klishd)
+{
+	execs_t *execs = klishd->execs;
+	faux_eloop_t *eloop = klishd->eloop;
+	kexec_t *exec = NULL;
+
+	while ((exec = kexecq_pop(execs->queue))) {
+		kjob_t *job = NULL;
+		kflight_t *flight = NULL;
+		client_t *client = NULL;
+		if (!kexec_start(exec, eloop)) {
+			syslog(LOG_ERR, "Can't start ACTION's process\n");
+			kexecq_done(execs->queue, exec);
+			if ((flight = kflights_find_by_exec(execs->flights, exec)))
+				flight_done(execs, flight, eloop);
+			else if ((job = kjobs_find_by_exec(execs->jobs, exec)))
+				job_fail(execs, job);
+			else if ((client = client_find_by_exec(klishd, exec)) &&
+				(!client_done(client) || !client_next(client)))
+				client_close(client);
+			continue;
+		}
+		if ((client = client_find_by_exec(klishd, exec))) {
+			client_started(client);
+			continue;
+		}
+		if ((flight = kflights_find_by_exec(execs->flights, exec))) {
+			kexec_close_stdin(exec);
+			fcntl(kexec_stdout(exec), F_SETFL, O_NONBLOCK);
+			fcntl(kexec_stderr(exec), F_SETFL, O_NONBLOCK);
+			faux_eloop_add_fd(eloop, kexec_stdout(exec), POLLIN,
+				flight_output_event, flight);
+			faux_eloop_add_fd(eloop, kexec_stderr(exec), POLLIN,
+				flight_output_event, flight);
+			if (kexec_records(exec) >= 0) {
+				fcntl(kexec_records(exec), F_SETFL, O_NONBLOCK);
+				faux_eloop_add_fd(eloop, kexec_records(exec), POLLIN,
+					flight_records_event, flight);
+			}
+			continue;
+		}
+		job = kjobs_find_by_exec(execs->jobs, exec);
+		if (!job)
+			continue;
+		kexec_close_stdin(exec);
+		fcntl(kexec_stdout(exec), F_SETFL, O_NONBLOCK);
+		fcntl(kexec_stderr(exec), F_SETFL, O_NONBLOCK);
+		faux_eloop_add_fd(eloop, kexec_stdout(exec), POLLIN,
+			job_output_event, job);
+		faux_eloop_add_fd(eloop, kexec_stderr(exec), POLLIN,
+			job_output_event, job);
+		if (kexec_records(exec) >= 0) {
+			fcntl(kexec_records(exec), F_SETFL, O_NONBLOCK);
+			faux_eloop_add_fd(eloop, kexec_records(exec), POLLIN,
+				job_records_event, job);
+		}
+	}
+}
+
+
+/** @brief Destroys detached session when grace period is over
+ *
+ * The running command of session is killed.
+ */
+static void detached_expire(ktpd_session_t *session, void *user_data)
+{
+	client_close((client_t *)ktpd_session_udata(session));
+
 	user_data = user_data; // Happy compiler
+}
+
+
+/** @brief Reaps finished children
+ *
+ * The ACTION's process is found by PID within the running ones so its
+ * timers are cancelled and its slot is given to the next queued process.
+ */
+static bool_t sigchld_event(faux_eloop_t *eloop, faux_eloop_type_e type,
+	void *associated_data, void *user_data)
+{
+	klishd_t *klishd = (klishd_t *)user_data;
+	execs_t *execs = klishd->execs;
+	pid_t pid = -1;
+	int status = 0;
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		kexec_t *exec = kexecq_find(execs->queue, pid);
+		kjob_t *job = NULL;
+		kflight_t *flight = NULL;
+		client_t *client = NULL;
+		syslog(LOG_DEBUG, "Exit child process %d\n", pid);
+		if (!exec)
+			continue;
+		kexec_done(exec, status);
+		kexecq_done(execs->queue, exec);
+		if ((job = kjobs_find_by_exec(execs->jobs, exec)))
+			job_done(execs, job, eloop);
+		else if ((flight = kflights_find_by_exec(execs->flights, exec)))
+			flight_done(execs, flight, eloop);
+		else if ((client = client_find_by_exec(klishd, exec)) &&
+			(!client_done(client) || !client_next(client)))
+			client_close(client);
+	}
+	exec_dispatch(klishd);
+
+	type = type; // Happy compiler
+	associated_data = associated_data; // Happy compiler
 
 	return BOOL_TRUE;
 }
 
+
 static bool_t listen_unix_socket_event(faux_eloop_t *eloop, faux_eloop_type_e type,
 	void *associated_data, void *user_data)
 {
 	int new_conn = -1;
 	faux_eloop_info_fd_t *info = (faux_eloop_info_fd_t *)associated_data;
+	klishd_t *klishd = (klishd_t *)user_data;
+	client_t *client = NULL;
 
-	new_conn = accept(info->fd, NULL, NULL);
+	new_conn = accept4(info->fd, NULL, NULL, SOCK_CLOEXEC);
 	if (new_conn < 0) {
 		syslog(LOG_ERR, "Can't accept() new connection");
 		return BOOL_TRUE;
 	}
-	faux_eloop_add_fd(eloop, new_conn, POLLIN, unix_socket_event, NULL);
+	client = client_new(klishd, new_conn);
+	if (!client) {
+		close(new_conn);
+		return BOOL_TRUE;
+	}
+	faux_eloop_add_fd(eloop, new_conn, POLLIN, client_event, client);
 	syslog(LOG_DEBUG, "New connection %d", new_conn);
 
 	type = type; // Happy compiler
-	user_data = user_data; // Happy compiler
 
 	return BOOL_TRUE;
 }
 
 
-
 /** @brief Main function
  */
 int main(int argc, char **argv)
@@ -119,13 +1612,16 @@ int main(int argc, char **argv)
 	int pidfd = -1;
 	int logoptions = 0;
 	faux_eloop_t *eloop = NULL;
+	kscheme_t *scheme = NULL;
+	char *error = NULL;
+	execs_t execs = {}; // ACTION's processes
+	klishd_t klishd = {};
+	kpty_pool_t *ptys = NULL; // Ready pseudo-terminals for processes
 
 	// Network
 	int listen_unix_sock = -1;
 	faux_pollfd_t *fds = NULL;
 
-	// Event scheduler
-	faux_sched_t *sched = NULL;
 
 	// Signal vars
 	struct sigaction sig_act = {};
@@ -160,6 +1656,24 @@ int main(int argc, char **argv)
 	// DEBUG: Show options
 	opts_show(opts);
 
+	// Prepare delegated cgroup subtree for ACTION's processes
+	if (opts->cgroup_path && !kexec_cgroup_init(opts->cgroup_path)) {
+		syslog(LOG_ERR, "Can't use cgroup v2 subtree %s\n",
+			opts->cgroup_path);
+		goto err;
+	}
+
+	// Load scheme. Files are parsed concurrently. Do it before
+	// daemonization to show errors to user. The sessions are created
+	// within this scheme so daemon can't work without it.
+	syslog(LOG_DEBUG, "Load scheme: %s\n", opts->xml_path);
+	scheme = kxml_load(opts->xml_path, opts->xml_jobs, &error);
+	if (!scheme) {
+		syslog(LOG_ERR, "Can't load scheme:\n%s", error);
+		faux_str_free(error);
+		goto err;
+	}
+
 	syslog(LOG_INFO, "Start daemon.\n");
 
 	// Fork the daemon
@@ -227,12 +1741,8 @@ int main(int argc, char **argv)
 	sig_act.sa_handler = &sigchld_handler;
 	sigaction(SIGCHLD, &sig_act, NULL);
 
-	// Initialize event scheduler
-	sched = faux_sched_new();
-	if (!sched) {
-		syslog(LOG_ERR, "Can't init event scheduler");
-		goto err;
-	}
+	// The client can close connection at any time
+	signal(SIGPIPE, SIG_IGN);
 
 	// The struct pollfd vector for ppoll()
 	fds = faux_pollfd_new();
@@ -255,12 +1765,48 @@ syslog(LOG_DEBUG, "Listen socket %d", listen_unix_sock);
 	sigprocmask(SIG_BLOCK, &sig_set, &orig_sig_set);
 
 
+	// Processes are owned by sessions. The queue limits the number of
+	// running ones and finds them by PID.
+	execs.queue = kexecq_new(opts->exec_max_running,
+		opts->exec_max_per_user);
+	assert(execs.queue);
+	execs.jobs = kjobs_new(opts->job_spool_size, opts->job_max_per_user);
+	assert(execs.jobs);
+	if (opts->cache_size > 0)
+		execs.cache = kcache_new(opts->cache_size);
+	// The identical cacheable commands share one process even if cache is
+	// disabled
+	execs.flights = kflights_new(opts->cache_size);
+	assert(execs.flights);
+	ptys = kpty_pool_new(opts->pty_pool_size, 0, 0);
+	if (!ptys) {
+		syslog(LOG_ERR, "Can't create pool of pseudo-terminals\n");
+		goto err;
+	}
+
 	eloop = faux_eloop_new(NULL);
+	klishd.opts = opts;
+	klishd.scheme = scheme;
+	klishd.execs = &execs;
+	klishd.ptys = ptys;
+	klishd.clients = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		client_compare, client_compare, NULL);
+	assert(klishd.clients);
+	klishd.eloop = eloop;
 	faux_eloop_add_signal(eloop, SIGINT, stop_loop, NULL);
 	faux_eloop_add_signal(eloop, SIGTERM, stop_loop, NULL);
 	faux_eloop_add_signal(eloop, SIGQUIT, stop_loop, NULL);
-	faux_eloop_add_fd(eloop, listen_unix_sock, POLLIN, listen_unix_socket_event, NULL);
+	faux_eloop_add_signal(eloop, SIGCHLD, sigchld_event, &klishd);
+	klishd.detached = detached_new(eloop, opts->session_grace,
+		detached_expire, &klishd);
+	assert(klishd.detached);
+	faux_eloop_add_fd(eloop, listen_unix_sock, POLLIN, listen_unix_socket_event, &klishd);
 	faux_eloop_loop(eloop);
+	while (!faux_list_is_empty(klishd.clients))
+		client_close((client_t *)faux_list_data(
+			faux_list_head(klishd.clients)));
+	faux_list_free(klishd.clients);
+	detached_free(klishd.detached);
 	faux_eloop_free(eloop);
 
 /*
@@ -365,8 +1911,12 @@ err:
 	syslog(LOG_DEBUG, "Cleanup.\n");
 
 	sigprocmask(SIG_BLOCK, &orig_sig_set, NULL);
+	kexecq_free(execs.queue);
+	kjobs_free(execs.jobs);
+	kflights_free(execs.flights);
+	kcache_free(execs.cache);
+	kpty_pool_free(ptys);
 	faux_pollfd_free(fds);
-	faux_sched_free(sched);
 
 	// Close listen socket
 	if (listen_unix_sock >= 0)
@@ -380,6 +1930,8 @@ err:
 		}
 	}
 
+	kscheme_free(scheme);
+
 	// Free command line options
 	opts_free(opts);
 	syslog(LOG_INFO, "Stop daemon.\n");
@@ -3,6 +3,8 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
+#include <limits.h>
 #include <assert.h>
 #include <syslog.h>
 #include <unistd.h>
@@ -37,6 +39,27 @@ struct options *opts_init(void)
 	opts->pidfile = faux_str_dup(DEFAULT_PIDFILE);
 	opts->cfgfile = faux_str_dup(DEFAULT_CFGFILE);
 	opts->unix_socket_path = faux_str_dup(KLISH_DEFAULT_UNIX_SOCKET_PATH);
+	opts->xml_path = faux_str_dup(DEFAULT_XML_PATH);
+	opts->xml_jobs = 0;
+	opts->exec_limits.timeout = 0; // Unlimited
+	opts->exec_limits.cpu = 0; // Unlimited
+	opts->exec_limits.kill_delay = KEXEC_KILL_DELAY;
+	opts->exec_limits.cgroup = NULL; // Don't use cgroups
+	opts->exec_limits.cpu_weight = 0; // Default
+	opts->exec_limits.memory_max = 0; // Unlimited
+	opts->exec_limits.pids_max = 0; // Unlimited
+	opts->exec_limits.pipe_size = DEFAULT_PIPE_SIZE;
+	opts->cgroup_path = NULL;
+	opts->exec_max_running = DEFAULT_MAX_RUNNING;
+	opts->exec_max_per_user = 0; // Unlimited
+	opts->weight_interactive = KEXECQ_WEIGHT_INTERACTIVE;
+	opts->weight_batch = KEXECQ_WEIGHT_BATCH;
+	opts->pty_pool_size = DEFAULT_PTY_POOL_SIZE;
+	opts->session_grace = DEFAULT_SESSION_GRACE;
+	opts->replay_size = DEFAULT_REPLAY_SIZE;
+	opts->job_spool_size = KJOB_SPOOL_MAX;
+	opts->cache_size = KCACHE_SIZE;
+	opts->job_max_per_user = DEFAULT_JOB_MAX_PER_USER;
 	opts->cfgfile_userdefined = BOOL_FALSE;
 	opts->foreground = BOOL_FALSE; // Daemonize by default
 	opts->verbose = BOOL_FALSE;
@@ -53,6 +76,8 @@ void opts_free(struct options *opts)
 	faux_str_free(opts->pidfile);
 	faux_str_free(opts->cfgfile);
 	faux_str_free(opts->unix_socket_path);
+	faux_str_free(opts->xml_path);
+	faux_str_free(opts->cgroup_path);
 	faux_free(opts);
 }
 
@@ -151,6 +176,51 @@ void help(int status, const char *argv0)
 }
 
 
+/** @brief Converts size with optional K, M or G suffix to bytes
+ */
+static bool_t opts_conv_size(const char *str, unsigned long long *val)
+{
+	char *endptr = NULL;
+	unsigned long long res = 0;
+	unsigned int shift = 0;
+
+	if (!str || !isdigit(*str))
+		return BOOL_FALSE;
+	errno = 0;
+	res = strtoull(str, &endptr, 10);
+	if (errno != 0)
+		return BOOL_FALSE;
+	switch (*endptr) {
+	case '\0':
+		break;
+	case 'K':
+	case 'k':
+		shift = 10;
+		endptr++;
+		break;
+	case 'M':
+	case 'm':
+		shift = 20;
+		endptr++;
+		break;
+	case 'G':
+	case 'g':
+		shift = 30;
+		endptr++;
+		break;
+	default:
+		return BOOL_FALSE;
+	}
+	if (*endptr != '\0')
+		return BOOL_FALSE;
+	if (res > (ULLONG_MAX >> shift))
+		return BOOL_FALSE;
+	*val = res << shift;
+
+	return BOOL_TRUE;
+}
+
+
 /** @brief Parse config file
  */
 int config_parse(const char *cfgfile, struct options *opts)
@@ -173,6 +243,176 @@ int config_parse(const char *cfgfile, struct options *opts)
 		opts->unix_socket_path = faux_str_dup(tmp);
 	}
 
+	if ((tmp = faux_ini_find(ini, "XMLPath"))) {
+		faux_str_free(opts->xml_path);
+		opts->xml_path = faux_str_dup(tmp);
+	}
+
+	if ((tmp = faux_ini_find(ini, "XMLLoadJobs"))) {
+		if (!faux_conv_atoui(tmp, &opts->xml_jobs, 0)) {
+			syslog(LOG_ERR, "Illegal XMLLoadJobs value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+	}
+
+	if ((tmp = faux_ini_find(ini, "ActionTimeout"))) {
+		if (!faux_conv_atoui(tmp, &opts->exec_limits.timeout, 0)) {
+			syslog(LOG_ERR, "Illegal ActionTimeout value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+	}
+
+	if ((tmp = faux_ini_find(ini, "ActionCPULimit"))) {
+		if (!faux_conv_atoui(tmp, &opts->exec_limits.cpu, 0)) {
+			syslog(LOG_ERR, "Illegal ActionCPULimit value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+	}
+
+	if ((tmp = faux_ini_find(ini, "ActionKillDelay"))) {
+		if (!faux_conv_atoui(tmp, &opts->exec_limits.kill_delay, 0) ||
+			(0 == opts->exec_limits.kill_delay)) {
+			syslog(LOG_ERR, "Illegal ActionKillDelay value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+	}
+
+	if ((tmp = faux_ini_find(ini, "ActionMaxRunning"))) {
+		if (!faux_conv_atoui(tmp, &opts->exec_max_running, 0)) {
+			syslog(LOG_ERR, "Illegal ActionMaxRunning value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+	}
+
+	if ((tmp = faux_ini_find(ini, "ActionMaxPerUser"))) {
+		if (!faux_conv_atoui(tmp, &opts->exec_max_per_user, 0)) {
+			syslog(LOG_ERR, "Illegal ActionMaxPerUser value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+	}
+
+	if ((tmp = faux_ini_find(ini, "InteractiveWeight"))) {
+		if (!faux_conv_atoui(tmp, &opts->weight_interactive, 0) ||
+			(0 == opts->weight_interactive)) {
+			syslog(LOG_ERR, "Illegal InteractiveWeight value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+	}
+
+	if ((tmp = faux_ini_find(ini, "BatchWeight"))) {
+		if (!faux_conv_atoui(tmp, &opts->weight_batch, 0) ||
+			(0 == opts->weight_batch)) {
+			syslog(LOG_ERR, "Illegal BatchWeight value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+	}
+
+	if ((tmp = faux_ini_find(ini, "PtyPoolSize"))) {
+		if (!faux_conv_atoui(tmp, &opts->pty_pool_size, 0)) {
+			syslog(LOG_ERR, "Illegal PtyPoolSize value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+	}
+
+	if ((tmp = faux_ini_find(ini, "PipeSize"))) {
+		unsigned long long size = 0;
+		if (!opts_conv_size(tmp, &size) || (size > INT_MAX)) {
+			syslog(LOG_ERR, "Illegal PipeSize value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+		opts->exec_limits.pipe_size = (unsigned int)size;
+	}
+
+	if ((tmp = faux_ini_find(ini, "SessionGraceTime"))) {
+		if (!faux_conv_atoui(tmp, &opts->session_grace, 0)) {
+			syslog(LOG_ERR, "Illegal SessionGraceTime value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+	}
+
+	if ((tmp = faux_ini_find(ini, "ReplayBufferSize"))) {
+		unsigned long long size = 0;
+		if (!opts_conv_size(tmp, &size) || (size > INT_MAX)) {
+			syslog(LOG_ERR, "Illegal ReplayBufferSize value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+		opts->replay_size = (unsigned int)size;
+	}
+
+	if ((tmp = faux_ini_find(ini, "JobSpoolSize"))) {
+		unsigned long long size = 0;
+		if (!opts_conv_size(tmp, &size) || (0 == size) ||
+			(size > INT_MAX)) {
+			syslog(LOG_ERR, "Illegal JobSpoolSize value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+		opts->job_spool_size = (unsigned int)size;
+	}
+
+	if ((tmp = faux_ini_find(ini, "CacheSize"))) {
+		unsigned long long size = 0;
+		if (!opts_conv_size(tmp, &size) || (size > INT_MAX)) {
+			syslog(LOG_ERR, "Illegal CacheSize value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+		opts->cache_size = (unsigned int)size;
+	}
+
+	if ((tmp = faux_ini_find(ini, "JobMaxPerUser"))) {
+		if (!faux_conv_atoui(tmp, &opts->job_max_per_user, 0)) {
+			syslog(LOG_ERR, "Illegal JobMaxPerUser value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+	}
+
+	if ((tmp = faux_ini_find(ini, "CgroupPath"))) {
+		faux_str_free(opts->cgroup_path);
+		opts->cgroup_path = NULL;
+		if (strlen(tmp) > 0)
+			opts->cgroup_path = faux_str_dup(tmp);
+		opts->exec_limits.cgroup = opts->cgroup_path;
+	}
+
+	if ((tmp = faux_ini_find(ini, "CgroupCPUWeight"))) {
+		if (!faux_conv_atoui(tmp, &opts->exec_limits.cpu_weight, 0) ||
+			(opts->exec_limits.cpu_weight > 10000)) {
+			syslog(LOG_ERR, "Illegal CgroupCPUWeight value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+	}
+
+	if ((tmp = faux_ini_find(ini, "CgroupMemoryMax"))) {
+		if (!opts_conv_size(tmp, &opts->exec_limits.memory_max)) {
+			syslog(LOG_ERR, "Illegal CgroupMemoryMax value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+	}
+
+	if ((tmp = faux_ini_find(ini, "CgroupPidsMax"))) {
+		if (!faux_conv_atoui(tmp, &opts->exec_limits.pids_max, 0)) {
+			syslog(LOG_ERR, "Illegal CgroupPidsMax value: %s\n", tmp);
+			faux_ini_free(ini);
+			return -1;
+		}
+	}
+
 	faux_ini_free(ini);
 	return 0;
 }
@@ -192,6 +432,26 @@ int opts_show(struct options *opts)
 	syslog(LOG_DEBUG, "opts: PIDPath = %s\n", opts->pidfile);
 	syslog(LOG_DEBUG, "opts: ConfigPath = %s\n", opts->cfgfile);
 	syslog(LOG_DEBUG, "opts: UnixSocketPath = %s\n", opts->unix_socket_path);
+	syslog(LOG_DEBUG, "opts: XMLPath = %s\n", opts->xml_path);
+	syslog(LOG_DEBUG, "opts: XMLLoadJobs = %u\n", opts->xml_jobs);
+	syslog(LOG_DEBUG, "opts: ActionTimeout = %u\n", opts->exec_limits.timeout);
+	syslog(LOG_DEBUG, "opts: ActionCPULimit = %u\n", opts->exec_limits.cpu);
+	syslog(LOG_DEBUG, "opts: ActionKillDelay = %u\n", opts->exec_limits.kill_delay);
+	syslog(LOG_DEBUG, "opts: ActionMaxRunning = %u\n", opts->exec_max_running);
+	syslog(LOG_DEBUG, "opts: ActionMaxPerUser = %u\n", opts->exec_max_per_user);
+	syslog(LOG_DEBUG, "opts: InteractiveWeight = %u\n", opts->weight_interactive);
+	syslog(LOG_DEBUG, "opts: BatchWeight = %u\n", opts->weight_batch);
+	syslog(LOG_DEBUG, "opts: PtyPoolSize = %u\n", opts->pty_pool_size);
+	syslog(LOG_DEBUG, "opts: PipeSize = %u\n", opts->exec_limits.pipe_size);
+	syslog(LOG_DEBUG, "opts: SessionGraceTime = %u\n", opts->session_grace);
+	syslog(LOG_DEBUG, "opts: ReplayBufferSize = %u\n", opts->replay_size);
+	syslog(LOG_DEBUG, "opts: JobSpoolSize = %u\n", opts->job_spool_size);
+	syslog(LOG_DEBUG, "opts: JobMaxPerUser = %u\n", opts->job_max_per_user);
+	syslog(LOG_DEBUG, "opts: CacheSize = %u\n", opts->cache_size);
+	syslog(LOG_DEBUG, "opts: CgroupPath = %s\n", opts->cgroup_path ? opts->cgroup_path : "");
+	syslog(LOG_DEBUG, "opts: CgroupCPUWeight = %u\n", opts->exec_limits.cpu_weight);
+	syslog(LOG_DEBUG, "opts: CgroupMemoryMax = %llu\n", opts->exec_limits.memory_max);
+	syslog(LOG_DEBUG, "opts: CgroupPidsMax = %u\n", opts->exec_limits.pids_max);
 
 	return 0;
 }
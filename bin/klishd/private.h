@@ -1,3 +1,11 @@
+#include <klish/kexec.h>
+#include <klish/kexecq.h>
+#include <klish/kpty.h>
+#include <klish/ktp_session.h>
+#include <klish/kjob.h>
+#include <klish/kcache.h>
+#include <klish/kflight.h>
+
 #ifndef VERSION
 #define VERSION "1.0.0"
 #endif
@@ -5,6 +13,13 @@
 #define LOG_NAME "klishd"
 #define DEFAULT_PIDFILE "/var/run/klishd.pid"
 #define DEFAULT_CFGFILE "/etc/klish/klishd.conf"
+#define DEFAULT_XML_PATH "/etc/klish"
+#define DEFAULT_MAX_RUNNING 32
+#define DEFAULT_PTY_POOL_SIZE 4
+#define DEFAULT_PIPE_SIZE (1024 * 1024)
+#define DEFAULT_SESSION_GRACE 60
+#define DEFAULT_REPLAY_SIZE (64 * 1024)
+#define DEFAULT_JOB_MAX_PER_USER 8
 
 
 /** @brief Command line and config file options
@@ -13,6 +28,20 @@ struct options {
 	char *pidfile;
 	char *cfgfile;
 	char *unix_socket_path;
+	char *xml_path; // Scheme files and directories
+	unsigned int xml_jobs; // Threads to load scheme. 0 - number of CPUs.
+	kexec_limits_t exec_limits; // Default limits of ACTION's processes
+	char *cgroup_path; // Delegated cgroup v2 subtree
+	unsigned int exec_max_running; // Concurrent processes. 0 - unlimited.
+	unsigned int exec_max_per_user; // 0 - unlimited
+	unsigned int weight_interactive; // Fair share of interactive session
+	unsigned int weight_batch; // Fair share of non-interactive session
+	unsigned int pty_pool_size; // Ready pseudo-terminals
+	unsigned int session_grace; // Seconds to keep detached session
+	unsigned int replay_size; // Replay ring of session's stdout
+	unsigned int job_spool_size; // Output spool of background job
+	unsigned int job_max_per_user; // 0 - unlimited
+	unsigned int cache_size; // Cache of commands' output. 0 - disabled.
 	bool_t cfgfile_userdefined;
 	bool_t foreground; // Don't daemonize
 	bool_t verbose;
@@ -26,3 +55,14 @@ void opts_free(struct options *opts);
 int opts_parse(int argc, char *argv[], struct options *opts);
 int opts_show(struct options *opts);
 int config_parse(const char *cfgfile, struct options *opts);
+
+// Detached sessions
+typedef struct detached_s detached_t;
+typedef void (*detached_expire_f)(ktpd_session_t *session, void *user_data);
+detached_t *detached_new(faux_eloop_t *eloop, unsigned int grace,
+	detached_expire_f expire_cb, void *user_data);
+void detached_free(detached_t *detached);
+bool_t detached_add(detached_t *detached, ktpd_session_t *session);
+ktpd_session_t *detached_take(detached_t *detached, const uint8_t *token,
+	uid_t uid);
+void detached_del(detached_t *detached, ktpd_session_t *session);
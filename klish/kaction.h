@@ -0,0 +1,50 @@
+/** @file kaction.h
+ *
+ * @brief Klish scheme's "action" entry
+ */
+
+#ifndef _klish_kaction_h
+#define _klish_kaction_h
+
+#include <faux/faux.h>
+#include <klish/kplugin.h>
+
+typedef struct kaction_s kaction_t;
+
+// The execution limit is not set by ACTION. The 0 is unlimited.
+#define KACTION_LIMIT_DEFAULT ((unsigned int)-1)
+
+
+C_DECL_BEGIN
+
+kaction_t *kaction_new(void);
+void kaction_free(kaction_t *action);
+
+const char *kaction_sym(const kaction_t *action);
+bool_t kaction_set_sym(kaction_t *action, const char *sym);
+kplugin_t *kaction_plugin(const kaction_t *action);
+void kaction_set_plugin(kaction_t *action, kplugin_t *plugin);
+const char *kaction_script(const kaction_t *action);
+bool_t kaction_set_script(kaction_t *action, const char *script);
+const char *kaction_shebang(const kaction_t *action);
+bool_t kaction_set_shebang(kaction_t *action, const char *shebang);
+bool_t kaction_interactive(const kaction_t *action);
+void kaction_set_interactive(kaction_t *action, bool_t interactive);
+bool_t kaction_lock(const kaction_t *action);
+void kaction_set_lock(kaction_t *action, bool_t lock);
+bool_t kaction_interrupt(const kaction_t *action);
+void kaction_set_interrupt(kaction_t *action, bool_t interrupt);
+bool_t kaction_records(const kaction_t *action);
+void kaction_set_records(kaction_t *action, bool_t records);
+bool_t kaction_batch(const kaction_t *action);
+void kaction_set_batch(kaction_t *action, bool_t batch);
+// Execution limits in seconds. 0 - unlimited, KACTION_LIMIT_DEFAULT -
+// use daemon's default.
+unsigned int kaction_timeout(const kaction_t *action);
+void kaction_set_timeout(kaction_t *action, unsigned int timeout);
+unsigned int kaction_cpu(const kaction_t *action);
+void kaction_set_cpu(kaction_t *action, unsigned int cpu);
+
+C_DECL_END
+
+#endif // _klish_kaction_h
@@ -0,0 +1,57 @@
+/** @file kbatch.h
+ *
+ * @brief Batches of configuration commands
+ *
+ * The ACTION with batch="true" can be executed once for several
+ * consecutive commands. The daemon accumulates the pipelined commands
+ * while they have the same builtin symbol or the same script and then
+ * executes the whole list by single call. The script gets the command
+ * lines on stdin, one per line. So the thousands of pushed config lines
+ * cost a handful of processes instead of process per line.
+ *
+ * The batch is closed when the next command doesn't match, the batch is
+ * full or there is no more pipelined input. The script reports retcode of
+ * each command to descriptor from KBATCH_RESULT_FD_ENV environment
+ * variable, one per line. The commands it doesn't report get the retcode
+ * of batch. The entries have opaque user data of owner to send results to.
+ */
+
+#ifndef _klish_kbatch_h
+#define _klish_kbatch_h
+
+#include <faux/faux.h>
+#include <faux/list.h>
+#include <klish/kaction.h>
+#include <klish/kexec.h>
+
+// Default maximum number of commands within batch
+#define KBATCH_MAX 4096
+// Environment variable with descriptor to write commands' retcodes to
+#define KBATCH_RESULT_FD_ENV "KLISH_BATCH_RESULT_FD"
+
+typedef struct kbatch_s kbatch_t;
+
+
+C_DECL_BEGIN
+
+kbatch_t *kbatch_new(size_t max);
+void kbatch_free(kbatch_t *batch);
+
+bool_t kbatch_action_batchable(const kaction_t *action);
+bool_t kbatch_match(const kbatch_t *batch, const kaction_t *action);
+bool_t kbatch_add(kbatch_t *batch, const kaction_t *action,
+	const char *line, void *udata);
+size_t kbatch_len(const kbatch_t *batch);
+bool_t kbatch_full(const kbatch_t *batch);
+const kaction_t *kbatch_action(const kbatch_t *batch);
+faux_list_node_t *kbatch_iter(const kbatch_t *batch);
+void *kbatch_each(faux_list_node_t **iter);
+const char *kbatch_each_line(faux_list_node_t **iter);
+void *kbatch_each_result(faux_list_node_t **iter, int *retcode);
+
+kexec_t *kbatch_exec(kbatch_t *batch, const kexec_limits_t *defaults);
+bool_t kbatch_done(kbatch_t *batch);
+
+C_DECL_END
+
+#endif // _klish_kbatch_h
@@ -0,0 +1,60 @@
+/** @file kcache.h
+ *
+ * @brief Cache of commands' output
+ *
+ * The COMMAND can be marked as cacheable with TTL. The daemon keeps the
+ * output and retcode of such command in the cache shared by all the
+ * sessions. The repeated command is served from memory without execution.
+ * The key is built by ksession_cache_key() from user, normalized command
+ * line, the VARs the output depends on and the BINDs of template's
+ * instance.
+ *
+ * The cache is bounded by total size of entries. The least recently used
+ * entries are evicted first. The expired entry is removed on access.
+ *
+ * The entry collects output while command is executed and is put to the
+ * cache when it's finished. The entry that exceeds the size of cache is
+ * discarded.
+ */
+
+#ifndef _klish_kcache_h
+#define _klish_kcache_h
+
+#include <stdint.h>
+
+#include <faux/faux.h>
+
+// Default maximum size of cache
+#define KCACHE_SIZE (16 * 1024 * 1024)
+
+typedef struct kcache_s kcache_t;
+typedef struct kcache_entry_s kcache_entry_t;
+
+
+C_DECL_BEGIN
+
+kcache_t *kcache_new(size_t size_max);
+void kcache_free(kcache_t *cache);
+size_t kcache_size_max(const kcache_t *cache);
+size_t kcache_size(const kcache_t *cache);
+size_t kcache_len(const kcache_t *cache);
+void kcache_clear(kcache_t *cache);
+const kcache_entry_t *kcache_get(kcache_t *cache, const char *key);
+bool_t kcache_put(kcache_t *cache, kcache_entry_t *entry, int retcode);
+
+kcache_entry_t *kcache_entry_new(const char *key, unsigned int ttl,
+	size_t size_max);
+void kcache_entry_free(kcache_entry_t *entry);
+bool_t kcache_entry_add_stdout(kcache_entry_t *entry, const char *data,
+	size_t len);
+bool_t kcache_entry_add_stderr(kcache_entry_t *entry, const char *data,
+	size_t len);
+const char *kcache_entry_key(const kcache_entry_t *entry);
+int kcache_entry_retcode(const kcache_entry_t *entry);
+const char *kcache_entry_stdout(const kcache_entry_t *entry, size_t *len);
+const char *kcache_entry_stderr(const kcache_entry_t *entry, size_t *len);
+uint32_t kcache_entry_age(const kcache_entry_t *entry);
+
+C_DECL_END
+
+#endif // _klish_kcache_h
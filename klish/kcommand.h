@@ -0,0 +1,87 @@
+/** @file kcommand.h
+ *
+ * @brief Klish scheme's "command" entry
+ */
+
+#ifndef _klish_kcommand_h
+#define _klish_kcommand_h
+
+#include <faux/faux.h>
+#include <faux/list.h>
+#include <klish/kparam.h>
+#include <klish/kaction.h>
+
+typedef struct kcommand_s kcommand_t;
+typedef struct kview_s kview_t;
+
+
+/** @brief Navigation type of command (COMMAND's "nav" attribute)
+ */
+typedef enum {
+	KNAV_NONE = '\0', // Stay within current path
+	KNAV_DOWN = 'd', // down:<view>
+	KNAV_UP = 'u', // up[:<number>]
+	KNAV_REPLACE = 'r', // replace:<view>[@<level>]
+	KNAV_EXIT = 'x', // exit
+} knav_e;
+
+
+/** @brief Class of command's visibility condition
+ *
+ * The class defines when the condition must be evaluated.
+ */
+typedef enum {
+	KCOND_NONE = '\0', // No condition. Access rights only.
+	KCOND_STATIC = 's', // Expression without VARs. Once per session.
+	KCOND_VAR = 'v', // Expression with VARs. When VARs are changed.
+	KCOND_DYNAMIC = 'd', // External code. Each time.
+} kcond_e;
+
+
+C_DECL_BEGIN
+
+kcommand_t *kcommand_new(const char *name, const char *help);
+void kcommand_free(kcommand_t *command);
+
+const char *kcommand_name(const kcommand_t *command);
+const char *kcommand_help(const kcommand_t *command);
+const char *kcommand_detail(const kcommand_t *command);
+bool_t kcommand_set_detail(kcommand_t *command, const char *detail);
+bool_t kcommand_add_param(kcommand_t *command, kparam_t *param);
+const faux_list_t *kcommand_params(const kcommand_t *command);
+kaction_t *kcommand_action(const kcommand_t *command);
+void kcommand_set_action(kcommand_t *command, kaction_t *action);
+
+// Navigation
+bool_t kcommand_set_nav(kcommand_t *command, const char *nav);
+knav_e kcommand_nav(const kcommand_t *command);
+const char *kcommand_nav_view_name(const kcommand_t *command);
+kview_t *kcommand_nav_view(const kcommand_t *command);
+void kcommand_set_nav_view(kcommand_t *command, kview_t *view);
+ssize_t kcommand_nav_num(const kcommand_t *command);
+
+// Visibility
+size_t kcommand_id(const kcommand_t *command);
+void kcommand_set_id(kcommand_t *command, size_t id);
+const char *kcommand_access(const kcommand_t *command);
+bool_t kcommand_set_access(kcommand_t *command, const char *access);
+const char *kcommand_cond(const kcommand_t *command);
+bool_t kcommand_set_cond(kcommand_t *command, const char *cond,
+	bool_t dynamic);
+kcond_e kcommand_cond_class(const kcommand_t *command);
+size_t kcommand_cond_vars_num(const kcommand_t *command);
+const char *kcommand_cond_var(const kcommand_t *command, size_t index);
+// Condition depends on BIND of template's instance. Evaluated per level.
+bool_t kcommand_bound(const kcommand_t *command);
+void kcommand_set_bound(kcommand_t *command, bool_t bound);
+
+// Output cache
+unsigned int kcommand_cache(const kcommand_t *command);
+void kcommand_set_cache(kcommand_t *command, unsigned int ttl);
+bool_t kcommand_set_cache_vars(kcommand_t *command, const char *vars);
+size_t kcommand_cache_vars_num(const kcommand_t *command);
+const char *kcommand_cache_var(const kcommand_t *command, size_t index);
+
+C_DECL_END
+
+#endif // _klish_kcommand_h
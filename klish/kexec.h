@@ -0,0 +1,97 @@
+/** @file kexec.h
+ *
+ * @brief Execution of ACTION's script within separate process
+ *
+ * The process is a leader of its own process group so the signals reach
+ * all the processes the script started. The wall-clock limit is a timer
+ * of event loop. When it expires the group gets SIGTERM and then SIGKILL
+ * after the kill delay if it's still alive. The CPU limit is applied by
+ * setrlimit(RLIMIT_CPU) so the kernel enforces it without any polling.
+ *
+ * The process can be placed into its own cgroup v2 within the subtree
+ * delegated to daemon. The cgroup limits CPU share, memory and number of
+ * processes. The CPU time and memory peak of the process and all its
+ * descendants are taken from cgroup when process is finished.
+ */
+
+#ifndef _klish_kexec_h
+#define _klish_kexec_h
+
+#include <sys/types.h>
+
+#include <faux/faux.h>
+#include <faux/eloop.h>
+#include <klish/kaction.h>
+#include <klish/kpty.h>
+
+// The default time between SIGTERM and SIGKILL
+#define KEXEC_KILL_DELAY 5
+
+typedef struct kexec_s kexec_t;
+
+/** @brief Limits of process execution. The 0 is unlimited.
+ */
+typedef struct {
+	unsigned int timeout; // Wall-clock seconds
+	unsigned int cpu; // CPU seconds
+	unsigned int kill_delay; // Seconds between SIGTERM and SIGKILL
+	// Delegated cgroup v2 subtree. NULL - don't use cgroups. The string
+	// is not copied.
+	const char *cgroup;
+	unsigned int cpu_weight; // The cpu.weight (1-10000). 0 - default.
+	unsigned long long memory_max; // Bytes
+	unsigned int pids_max; // Number of processes
+	unsigned int pipe_size; // Size of stdout and stderr pipes. 0 - default.
+} kexec_limits_t;
+
+/** @brief Resource usage of finished process. The 0 is unknown.
+ */
+typedef struct {
+	unsigned long long cpu_usec; // CPU time. Microseconds.
+	unsigned long long memory_peak; // Bytes
+} kexec_usage_t;
+
+/** @brief State of execution
+ */
+typedef enum {
+	KEXEC_STATE_NEW = 'n',
+	KEXEC_STATE_RUNNING = 'r',
+	KEXEC_STATE_TERMINATING = 't', // SIGTERM is sent on timeout
+	KEXEC_STATE_KILLED = 'k', // SIGKILL is sent
+	KEXEC_STATE_DONE = 'd',
+} kexec_state_e;
+
+
+C_DECL_BEGIN
+
+kexec_t *kexec_new(const kaction_t *action, const kexec_limits_t *defaults);
+void kexec_free(kexec_t *exec);
+
+bool_t kexec_set_pty_pool(kexec_t *exec, kpty_pool_t *pool);
+bool_t kexec_set_input(kexec_t *exec, int fd);
+bool_t kexec_set_result(kexec_t *exec, int fd);
+bool_t kexec_add_env(kexec_t *exec, const char *name,
+	const char *value);
+const kexec_limits_t *kexec_limits(const kexec_t *exec);
+kexec_state_e kexec_state(const kexec_t *exec);
+pid_t kexec_pid(const kexec_t *exec);
+int kexec_stdin(const kexec_t *exec);
+int kexec_stdout(const kexec_t *exec);
+int kexec_stderr(const kexec_t *exec);
+int kexec_records(const kexec_t *exec);
+bool_t kexec_close_stdin(kexec_t *exec);
+bool_t kexec_timed_out(const kexec_t *exec);
+int kexec_status(const kexec_t *exec);
+int kexec_retcode(const kexec_t *exec);
+unsigned long kexec_wait(const kexec_t *exec);
+const kexec_usage_t *kexec_usage(const kexec_t *exec);
+
+bool_t kexec_cgroup_init(const char *root);
+
+bool_t kexec_start(kexec_t *exec, faux_eloop_t *eloop);
+bool_t kexec_done(kexec_t *exec, int status);
+bool_t kexec_terminate(kexec_t *exec);
+
+C_DECL_END
+
+#endif // _klish_kexec_h
@@ -0,0 +1,455 @@
+/** @file kbatch.c
+ *
+ * @brief Batches of configuration commands
+ *
+ * The command lines are written to memfd which becomes the process's
+ * stdin. So the daemon doesn't need to feed the pipe by event loop and the
+ * batch size is not limited by pipe capacity. The results are written to
+ * another memfd the same way so the process can't block on them too.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <faux/str.h>
+#include <faux/list.h>
+#include <klish/kbatch.h>
+
+#include "private.h"
+
+
+static void kbatch_entry_free(void *data)
+{
+	kbatch_entry_t *entry = (kbatch_entry_t *)data;
+
+	if (!entry)
+		return;
+
+	faux_str_free(entry->line);
+	faux_free(entry);
+}
+
+
+/** @brief Creates empty batch
+ *
+ * @param [in] max Maximum number of commands. 0 - default.
+ */
+kbatch_t *kbatch_new(size_t max)
+{
+	kbatch_t *batch = NULL;
+
+	batch = faux_zmalloc(sizeof(*batch));
+	assert(batch);
+	if (!batch)
+		return NULL;
+
+	// Initialize
+	batch->action = NULL;
+	batch->max = max ? max : KBATCH_MAX;
+	batch->entries = faux_list_new(FAUX_LIST_UNSORTED, FAUX_LIST_NONUNIQUE,
+		NULL, NULL, kbatch_entry_free);
+	assert(batch->entries);
+	batch->exec = NULL;
+	batch->fd_result = -1;
+
+	return batch;
+}
+
+
+/** @brief Frees batch and its process
+ */
+void kbatch_free(kbatch_t *batch)
+{
+	if (!batch)
+		return;
+
+	kexec_free(batch->exec);
+	if (batch->fd_result >= 0)
+		close(batch->fd_result);
+	faux_list_free(batch->entries);
+	faux_free(batch);
+}
+
+
+/** @brief Checks if ACTION can be batched at all
+ */
+bool_t kbatch_action_batchable(const kaction_t *action)
+{
+	if (!action)
+		return BOOL_FALSE;
+	if (!kaction_batch(action) || kaction_interactive(action))
+		return BOOL_FALSE;
+	if (!kaction_sym(action) && !kaction_script(action))
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Checks if command with ACTION can be added to batch
+ *
+ * The ACTIONs of different commands are different objects so they are
+ * compared by builtin symbol and plugin or by script and shebang.
+ */
+bool_t kbatch_match(const kbatch_t *batch, const kaction_t *action)
+{
+	const kaction_t *first = NULL;
+
+	assert(batch);
+	if (!batch)
+		return BOOL_FALSE;
+	if (!kbatch_action_batchable(action))
+		return BOOL_FALSE;
+	if (batch->exec)
+		return BOOL_FALSE; // Already executed
+	first = batch->action;
+	if (!first)
+		return BOOL_TRUE;
+	if (first == action)
+		return BOOL_TRUE;
+
+	if (kaction_sym(first) || kaction_sym(action)) {
+		return ((faux_str_cmp(kaction_sym(first),
+			kaction_sym(action)) == 0) &&
+			(kaction_plugin(first) == kaction_plugin(action))) ?
+			BOOL_TRUE : BOOL_FALSE;
+	}
+
+	return ((faux_str_cmp(kaction_script(first),
+		kaction_script(action)) == 0) &&
+		(faux_str_cmp(kaction_shebang(first),
+		kaction_shebang(action)) == 0)) ? BOOL_TRUE : BOOL_FALSE;
+}
+
+
+/** @brief Adds command to batch
+ *
+ * @param [in] batch Batch.
+ * @param [in] action Command's ACTION.
+ * @param [in] line Command line. It's copied.
+ * @param [in] udata Owner's data to send result to.
+ * @return BOOL_FALSE if command doesn't match batch or batch is full. The
+ * batch must be executed then and the new one started.
+ */
+bool_t kbatch_add(kbatch_t *batch, const kaction_t *action,
+	const char *line, void *udata)
+{
+	kbatch_entry_t *entry = NULL;
+
+	assert(batch);
+	if (!batch)
+		return BOOL_FALSE;
+	assert(line);
+	if (!line)
+		return BOOL_FALSE;
+	// The lines are separated by newline
+	if (strchr(line, '\n'))
+		return BOOL_FALSE;
+	if (kbatch_full(batch) || !kbatch_match(batch, action))
+		return BOOL_FALSE;
+
+	entry = faux_zmalloc(sizeof(*entry));
+	assert(entry);
+	if (!entry)
+		return BOOL_FALSE;
+	entry->line = faux_str_dup(line);
+	entry->udata = udata;
+	entry->retcode = -1;
+	if (!faux_list_add(batch->entries, entry)) {
+		kbatch_entry_free(entry);
+		return BOOL_FALSE;
+	}
+	if (!batch->action)
+		batch->action = action;
+
+	return BOOL_TRUE;
+}
+
+
+size_t kbatch_len(const kbatch_t *batch)
+{
+	assert(batch);
+	if (!batch)
+		return 0;
+
+	return faux_list_len(batch->entries);
+}
+
+
+bool_t kbatch_full(const kbatch_t *batch)
+{
+	assert(batch);
+	if (!batch)
+		return BOOL_TRUE;
+
+	return (faux_list_len(batch->entries) >= batch->max) ?
+		BOOL_TRUE : BOOL_FALSE;
+}
+
+
+/** @brief Gets ACTION of batch
+ *
+ * The builtin symbol gets the list of lines by kbatch_each_line().
+ */
+const kaction_t *kbatch_action(const kbatch_t *batch)
+{
+	assert(batch);
+	if (!batch)
+		return NULL;
+
+	return batch->action;
+}
+
+
+faux_list_node_t *kbatch_iter(const kbatch_t *batch)
+{
+	assert(batch);
+	if (!batch)
+		return NULL;
+
+	return faux_list_head(batch->entries);
+}
+
+
+/** @brief Iterates owner's data of commands in order of adding
+ */
+void *kbatch_each(faux_list_node_t **iter)
+{
+	kbatch_entry_t *entry = (kbatch_entry_t *)faux_list_each(iter);
+
+	return entry ? entry->udata : NULL;
+}
+
+
+/** @brief Iterates command lines in order of adding
+ */
+const char *kbatch_each_line(faux_list_node_t **iter)
+{
+	kbatch_entry_t *entry = (kbatch_entry_t *)faux_list_each(iter);
+
+	return entry ? entry->line : NULL;
+}
+
+
+/** @brief Iterates owner's data of commands with their retcodes
+ *
+ * The retcodes are known after kbatch_done() only.
+ *
+ * @param [in,out] iter Iterator from kbatch_iter().
+ * @param [out] retcode Command's retcode.
+ */
+void *kbatch_each_result(faux_list_node_t **iter, int *retcode)
+{
+	kbatch_entry_t *entry = (kbatch_entry_t *)faux_list_each(iter);
+
+	if (!entry)
+		return NULL;
+	if (retcode)
+		*retcode = entry->retcode;
+
+	return entry->udata;
+}
+
+
+/** @brief Writes command lines to memfd
+ *
+ * @return Descriptor positioned at the start or -1 on error.
+ */
+static int kbatch_input(const kbatch_t *batch)
+{
+	faux_list_node_t *iter = NULL;
+	const char *line = NULL;
+	char *buf = NULL;
+	size_t len = 0;
+	size_t pos = 0;
+	int fd = -1;
+
+	iter = faux_list_head(batch->entries);
+	while ((line = kbatch_each_line(&iter)))
+		len += strlen(line) + 1;
+	buf = faux_zmalloc(len + 1);
+	assert(buf);
+	if (!buf)
+		return -1;
+	iter = faux_list_head(batch->entries);
+	while ((line = kbatch_each_line(&iter))) {
+		size_t line_len = strlen(line);
+		memcpy(buf + pos, line, line_len);
+		pos += line_len;
+		buf[pos++] = '\n';
+	}
+
+	fd = memfd_create("kbatch", MFD_CLOEXEC);
+	if (fd < 0)
+		goto err;
+	pos = 0;
+	while (pos < len) {
+		ssize_t r = write(fd, buf + pos, len - pos);
+		if (r < 0) {
+			if (EINTR == errno)
+				continue;
+			goto err;
+		}
+		pos += r;
+	}
+	if (lseek(fd, 0, SEEK_SET) < 0)
+		goto err;
+	faux_free(buf);
+
+	return fd;
+
+err:
+	if (fd >= 0)
+		close(fd);
+	faux_free(buf);
+
+	return -1;
+}
+
+
+/** @brief Creates process for batch
+ *
+ * The batch owns the process. No commands can be added after that. The
+ * builtin ACTION has no process so the owner executes symbol itself.
+ *
+ * @param [in] batch Non-empty batch.
+ * @param [in] defaults Daemon's default limits.
+ * @return Process ready to be queued or NULL on error.
+ */
+kexec_t *kbatch_exec(kbatch_t *batch, const kexec_limits_t *defaults)
+{
+	kexec_t *exec = NULL;
+	int fd = -1;
+
+	assert(batch);
+	if (!batch)
+		return NULL;
+	if (batch->exec)
+		return batch->exec;
+	if (!batch->action)
+		return NULL;
+
+	exec = kexec_new(batch->action, defaults);
+	if (!exec)
+		return NULL;
+	fd = kbatch_input(batch);
+	if ((fd < 0) || !kexec_set_input(exec, fd)) {
+		if (fd >= 0)
+			close(fd);
+		kexec_free(exec);
+		return NULL;
+	}
+	// The process gets its own descriptor of the same file
+	batch->fd_result = memfd_create("kbatch-result", MFD_CLOEXEC);
+	if (batch->fd_result >= 0)
+		fd = dup(batch->fd_result);
+	else
+		fd = -1;
+	if ((fd < 0) || !kexec_set_result(exec, fd)) {
+		if (fd >= 0)
+			close(fd);
+		if (batch->fd_result >= 0)
+			close(batch->fd_result);
+		batch->fd_result = -1;
+		kexec_free(exec);
+		return NULL;
+	}
+	batch->exec = exec;
+
+	return exec;
+}
+
+
+/** @brief Reads results written by process
+ *
+ * @return Allocated string or NULL on error.
+ */
+static char *kbatch_read_result(const kbatch_t *batch)
+{
+	struct stat st = {};
+	char *buf = NULL;
+	size_t pos = 0;
+
+	if (fstat(batch->fd_result, &st) < 0)
+		return NULL;
+	buf = faux_zmalloc(st.st_size + 1);
+	assert(buf);
+	if (!buf)
+		return NULL;
+	while (pos < (size_t)st.st_size) {
+		ssize_t r = pread(batch->fd_result, buf + pos,
+			st.st_size - pos, pos);
+		if (r < 0) {
+			if (EINTR == errno)
+				continue;
+			faux_free(buf);
+			return NULL;
+		}
+		if (0 == r)
+			break;
+		pos += r;
+	}
+	buf[pos] = '\0';
+
+	return buf;
+}
+
+
+/** @brief Sets retcodes of commands when batch process is finished
+ *
+ * The process writes retcode of each command to descriptor from
+ * KBATCH_RESULT_FD_ENV environment variable. It's a decimal number per
+ * line in order of commands. The commands without valid result get the
+ * retcode of process. So the script that reports nothing fails or
+ * succeeds all the commands at once.
+ *
+ * @param [in] batch Batch with finished process.
+ */
+bool_t kbatch_done(kbatch_t *batch)
+{
+	faux_list_node_t *iter = NULL;
+	kbatch_entry_t *entry = NULL;
+	char *result = NULL;
+	char *pos = NULL;
+	int retcode = -1;
+
+	assert(batch);
+	if (!batch)
+		return BOOL_FALSE;
+	if (!batch->exec || (kexec_state(batch->exec) != KEXEC_STATE_DONE))
+		return BOOL_FALSE;
+
+	retcode = kexec_retcode(batch->exec);
+	if (batch->fd_result >= 0)
+		result = kbatch_read_result(batch);
+	pos = result;
+	iter = faux_list_head(batch->entries);
+	while ((entry = (kbatch_entry_t *)faux_list_each(&iter))) {
+		char *endptr = NULL;
+		long val = 0;
+
+		entry->retcode = retcode;
+		if (!pos || ('\0' == *pos))
+			continue;
+		errno = 0;
+		val = strtol(pos, &endptr, 10);
+		// The garbage stops parsing
+		if ((endptr == pos) || (errno != 0) ||
+			((*endptr != '\n') && (*endptr != '\0'))) {
+			pos = NULL;
+			continue;
+		}
+		entry->retcode = (int)val;
+		pos = ('\n' == *endptr) ? (endptr + 1) : endptr;
+	}
+	faux_free(result);
+
+	return BOOL_TRUE;
+}
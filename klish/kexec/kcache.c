@@ -0,0 +1,487 @@
+/** @file kcache.c
+ *
+ * @brief Cache of commands' output
+ *
+ * The entries are within hash table for lookup and within doubly linked
+ * list for LRU eviction. The table grows when the number of entries
+ * exceeds the number of buckets twice.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include <faux/str.h>
+#include <klish/kcache.h>
+
+#include "private.h"
+
+#define KCACHE_BUCKETS 64
+
+
+/** @brief FNV-1a hash of key
+ */
+static uint32_t kcache_hash(const char *key)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*key) {
+		hash ^= (unsigned char)*key++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+
+/** @brief Gets memory used by entry
+ */
+static size_t kcache_entry_size(const kcache_entry_t *entry)
+{
+	return sizeof(*entry) + strlen(entry->key) + entry->out_len +
+		entry->err_len;
+}
+
+
+/** @brief Creates entry to collect command's output
+ *
+ * @param [in] key Cache key.
+ * @param [in] ttl Seconds to keep entry within cache.
+ * @param [in] size_max Maximum size of entry. It's a cache size usually.
+ * The output is not collected after that.
+ * @return Allocated entry or NULL on error.
+ */
+kcache_entry_t *kcache_entry_new(const char *key, unsigned int ttl,
+	size_t size_max)
+{
+	kcache_entry_t *entry = NULL;
+
+	assert(key);
+	if (!key)
+		return NULL;
+
+	entry = faux_zmalloc(sizeof(*entry));
+	assert(entry);
+	if (!entry)
+		return NULL;
+
+	// Initialize
+	entry->key = faux_str_dup(key);
+	entry->hash = kcache_hash(key);
+	entry->ttl = ttl;
+	entry->size_max = size_max;
+	entry->oversized = (kcache_entry_size(entry) > size_max) ?
+		BOOL_TRUE : BOOL_FALSE;
+	entry->retcode = -1;
+	entry->out = NULL;
+	entry->out_len = 0;
+	entry->err = NULL;
+	entry->err_len = 0;
+	entry->hnext = NULL;
+	entry->prev = NULL;
+	entry->next = NULL;
+
+	return entry;
+}
+
+
+void kcache_entry_free(kcache_entry_t *entry)
+{
+	if (!entry)
+		return;
+
+	faux_str_free(entry->key);
+	free(entry->out);
+	free(entry->err);
+	faux_free(entry);
+}
+
+
+static bool_t kcache_entry_add(kcache_entry_t *entry, char **buf,
+	size_t *buf_len, const char *data, size_t len)
+{
+	char *new_buf = NULL;
+
+	assert(entry);
+	if (!entry)
+		return BOOL_FALSE;
+	if (entry->oversized)
+		return BOOL_FALSE;
+	if (!data || (0 == len))
+		return BOOL_TRUE;
+
+	// Don't keep the output that can't be cached anyway
+	if (kcache_entry_size(entry) + len > entry->size_max) {
+		entry->oversized = BOOL_TRUE;
+		free(entry->out);
+		entry->out = NULL;
+		entry->out_len = 0;
+		free(entry->err);
+		entry->err = NULL;
+		entry->err_len = 0;
+		return BOOL_FALSE;
+	}
+	new_buf = realloc(*buf, *buf_len + len);
+	assert(new_buf);
+	if (!new_buf)
+		return BOOL_FALSE;
+	memcpy(new_buf + *buf_len, data, len);
+	*buf = new_buf;
+	*buf_len += len;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Appends command's stdout to entry
+ *
+ * @return BOOL_FALSE if entry is oversized and it will not be cached.
+ */
+bool_t kcache_entry_add_stdout(kcache_entry_t *entry, const char *data,
+	size_t len)
+{
+	return kcache_entry_add(entry, &entry->out, &entry->out_len, data, len);
+}
+
+
+bool_t kcache_entry_add_stderr(kcache_entry_t *entry, const char *data,
+	size_t len)
+{
+	return kcache_entry_add(entry, &entry->err, &entry->err_len, data, len);
+}
+
+
+const char *kcache_entry_key(const kcache_entry_t *entry)
+{
+	assert(entry);
+	if (!entry)
+		return NULL;
+
+	return entry->key;
+}
+
+
+int kcache_entry_retcode(const kcache_entry_t *entry)
+{
+	assert(entry);
+	if (!entry)
+		return -1;
+
+	return entry->retcode;
+}
+
+
+const char *kcache_entry_stdout(const kcache_entry_t *entry, size_t *len)
+{
+	assert(entry);
+	if (!entry)
+		return NULL;
+	if (len)
+		*len = entry->out_len;
+
+	return entry->out;
+}
+
+
+const char *kcache_entry_stderr(const kcache_entry_t *entry, size_t *len)
+{
+	assert(entry);
+	if (!entry)
+		return NULL;
+	if (len)
+		*len = entry->err_len;
+
+	return entry->err;
+}
+
+
+static uint64_t kcache_msec(const struct timespec *from,
+	const struct timespec *to)
+{
+	int64_t msec = (int64_t)(to->tv_sec - from->tv_sec) * 1000 +
+		(to->tv_nsec - from->tv_nsec) / 1000000;
+
+	return (msec > 0) ? (uint64_t)msec : 0;
+}
+
+
+/** @brief Gets age of cached output
+ *
+ * @return Milliseconds since entry is put to cache.
+ */
+uint32_t kcache_entry_age(const kcache_entry_t *entry)
+{
+	struct timespec now = {};
+	uint64_t age = 0;
+
+	assert(entry);
+	if (!entry)
+		return 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	age = kcache_msec(&entry->created, &now);
+
+	return (age > UINT32_MAX) ? UINT32_MAX : (uint32_t)age;
+}
+
+
+/** @brief Creates cache
+ *
+ * @param [in] size_max Maximum total size of entries. 0 - default.
+ */
+kcache_t *kcache_new(size_t size_max)
+{
+	kcache_t *cache = NULL;
+
+	cache = faux_zmalloc(sizeof(*cache));
+	assert(cache);
+	if (!cache)
+		return NULL;
+
+	// Initialize
+	cache->size_max = size_max ? size_max : KCACHE_SIZE;
+	cache->size = 0;
+	cache->len = 0;
+	cache->buckets_num = KCACHE_BUCKETS;
+	cache->buckets = faux_zmalloc(cache->buckets_num *
+		sizeof(*cache->buckets));
+	assert(cache->buckets);
+	cache->head = NULL;
+	cache->tail = NULL;
+
+	return cache;
+}
+
+
+void kcache_free(kcache_t *cache)
+{
+	if (!cache)
+		return;
+
+	kcache_clear(cache);
+	faux_free(cache->buckets);
+	faux_free(cache);
+}
+
+
+size_t kcache_size_max(const kcache_t *cache)
+{
+	assert(cache);
+	if (!cache)
+		return 0;
+
+	return cache->size_max;
+}
+
+
+size_t kcache_size(const kcache_t *cache)
+{
+	assert(cache);
+	if (!cache)
+		return 0;
+
+	return cache->size;
+}
+
+
+size_t kcache_len(const kcache_t *cache)
+{
+	assert(cache);
+	if (!cache)
+		return 0;
+
+	return cache->len;
+}
+
+
+static void kcache_lru_unlink(kcache_t *cache, kcache_entry_t *entry)
+{
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		cache->head = entry->next;
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	else
+		cache->tail = entry->prev;
+	entry->prev = NULL;
+	entry->next = NULL;
+}
+
+
+static void kcache_lru_push(kcache_t *cache, kcache_entry_t *entry)
+{
+	entry->prev = NULL;
+	entry->next = cache->head;
+	if (cache->head)
+		cache->head->prev = entry;
+	cache->head = entry;
+	if (!cache->tail)
+		cache->tail = entry;
+}
+
+
+/** @brief Removes entry from cache and frees it
+ */
+static void kcache_del(kcache_t *cache, kcache_entry_t *entry)
+{
+	kcache_entry_t **link = NULL;
+
+	link = &cache->buckets[entry->hash & (cache->buckets_num - 1)];
+	while (*link && (*link != entry))
+		link = &(*link)->hnext;
+	if (*link)
+		*link = entry->hnext;
+	kcache_lru_unlink(cache, entry);
+	cache->size -= kcache_entry_size(entry);
+	cache->len--;
+	kcache_entry_free(entry);
+}
+
+
+/** @brief Removes all entries
+ *
+ * Must be called when scheme is reloaded because the key contains
+ * command's identifier.
+ */
+void kcache_clear(kcache_t *cache)
+{
+	assert(cache);
+	if (!cache)
+		return;
+
+	while (cache->head)
+		kcache_del(cache, cache->head);
+}
+
+
+static void kcache_grow(kcache_t *cache)
+{
+	kcache_entry_t **buckets = NULL;
+	size_t num = cache->buckets_num * 2;
+	kcache_entry_t *entry = NULL;
+
+	buckets = faux_zmalloc(num * sizeof(*buckets));
+	if (!buckets)
+		return; // The longer chains are not fatal
+	for (entry = cache->head; entry; entry = entry->next) {
+		size_t i = entry->hash & (num - 1);
+		entry->hnext = buckets[i];
+		buckets[i] = entry;
+	}
+	faux_free(cache->buckets);
+	cache->buckets = buckets;
+	cache->buckets_num = num;
+}
+
+
+static bool_t kcache_expired(const kcache_entry_t *entry,
+	const struct timespec *now)
+{
+	return (kcache_msec(&entry->created, now) >=
+		(uint64_t)entry->ttl * 1000) ? BOOL_TRUE : BOOL_FALSE;
+}
+
+
+static kcache_entry_t *kcache_find(const kcache_t *cache, const char *key,
+	uint32_t hash)
+{
+	kcache_entry_t *entry = NULL;
+
+	entry = cache->buckets[hash & (cache->buckets_num - 1)];
+	while (entry) {
+		if ((entry->hash == hash) && (strcmp(entry->key, key) == 0))
+			return entry;
+		entry = entry->hnext;
+	}
+
+	return NULL;
+}
+
+
+/** @brief Finds actual entry by key
+ *
+ * The found entry becomes the most recently used one. The pointer is
+ * valid until the next kcache_put() or kcache_clear().
+ *
+ * @return Entry or NULL if there is no actual entry.
+ */
+const kcache_entry_t *kcache_get(kcache_t *cache, const char *key)
+{
+	kcache_entry_t *entry = NULL;
+	struct timespec now = {};
+
+	assert(cache);
+	if (!cache)
+		return NULL;
+	assert(key);
+	if (!key)
+		return NULL;
+
+	entry = kcache_find(cache, key, kcache_hash(key));
+	if (!entry)
+		return NULL;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (kcache_expired(entry, &now)) {
+		kcache_del(cache, entry);
+		return NULL;
+	}
+	kcache_lru_unlink(cache, entry);
+	kcache_lru_push(cache, entry);
+
+	return entry;
+}
+
+
+/** @brief Puts entry of finished command to cache
+ *
+ * The cache takes ownership of entry. The entry with the same key is
+ * replaced. The least recently used entries are evicted to free space.
+ *
+ * @param [in] cache Cache.
+ * @param [in] entry Entry with collected output.
+ * @param [in] retcode Command's retcode.
+ * @return BOOL_TRUE - entry is cached, BOOL_FALSE - entry is oversized and
+ * it's freed.
+ */
+bool_t kcache_put(kcache_t *cache, kcache_entry_t *entry, int retcode)
+{
+	kcache_entry_t *old = NULL;
+	size_t size = 0;
+	size_t i = 0;
+
+	assert(cache);
+	if (!cache) {
+		kcache_entry_free(entry);
+		return BOOL_FALSE;
+	}
+	assert(entry);
+	if (!entry)
+		return BOOL_FALSE;
+
+	size = kcache_entry_size(entry);
+	if (entry->oversized || (0 == entry->ttl) || (size > cache->size_max)) {
+		kcache_entry_free(entry);
+		return BOOL_FALSE;
+	}
+	old = kcache_find(cache, entry->key, entry->hash);
+	if (old)
+		kcache_del(cache, old);
+	while (cache->tail && (cache->size + size > cache->size_max))
+		kcache_del(cache, cache->tail);
+
+	entry->retcode = retcode;
+	clock_gettime(CLOCK_MONOTONIC, &entry->created);
+	if (cache->len >= cache->buckets_num * 2)
+		kcache_grow(cache);
+	i = entry->hash & (cache->buckets_num - 1);
+	entry->hnext = cache->buckets[i];
+	cache->buckets[i] = entry;
+	kcache_lru_push(cache, entry);
+	cache->size += size;
+	cache->len++;
+
+	return BOOL_TRUE;
+}
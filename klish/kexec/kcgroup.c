@@ -0,0 +1,297 @@
+/** @file kcgroup.c
+ *
+ * @brief The cgroup v2 support of ACTION's processes
+ *
+ * Each process gets its own cgroup within the subtree delegated to daemon.
+ * The cgroup is created by parent before fork() and the child moves itself
+ * there before exec. So all the processes the script starts are accounted
+ * and limited together. The usage is read from cgroup files when process
+ * is finished and then the cgroup is removed. Only the cgroupfs is used so
+ * systemd is not required.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <faux/str.h>
+#include <faux/list.h>
+#include <klish/kexec.h>
+
+#include "private.h"
+
+// The leaf cgroup of daemon within delegated subtree
+#define KCGROUP_DAEMON "klishd"
+
+// The cgroups that were still populated on removal. The killed processes
+// leave cgroup asynchronously so the removal is retried later.
+static faux_list_t *kcgroup_stale = NULL;
+
+
+/** @brief Writes string to cgroup's file
+ *
+ * Async-signal-safe so the child can use it after fork().
+ */
+static bool_t kcgroup_write(const char *path, const char *file,
+	const char *str)
+{
+	char name[PATH_MAX];
+	int fd = -1;
+	ssize_t len = (ssize_t)strlen(str);
+	ssize_t r = 0;
+
+	if (snprintf(name, sizeof(name), "%s/%s", path, file) >=
+		(int)sizeof(name))
+		return BOOL_FALSE;
+	fd = open(name, O_WRONLY | O_CLOEXEC);
+	if (fd < 0)
+		return BOOL_FALSE;
+	r = write(fd, str, len);
+	close(fd);
+
+	return (r == len) ? BOOL_TRUE : BOOL_FALSE;
+}
+
+
+static bool_t kcgroup_read(const char *path, const char *file,
+	char *buf, size_t size)
+{
+	char *name = NULL;
+	int fd = -1;
+	ssize_t r = 0;
+
+	name = faux_str_sprintf("%s/%s", path, file);
+	fd = open(name, O_RDONLY | O_CLOEXEC);
+	faux_str_free(name);
+	if (fd < 0)
+		return BOOL_FALSE;
+	r = read(fd, buf, size - 1);
+	close(fd);
+	if (r < 0)
+		return BOOL_FALSE;
+	buf[r] = '\0';
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Checks if calling process is a member of cgroup
+ */
+static bool_t kcgroup_member(const char *path)
+{
+	char *name = NULL;
+	FILE *f = NULL;
+	long pid = 0;
+	bool_t found = BOOL_FALSE;
+
+	name = faux_str_sprintf("%s/cgroup.procs", path);
+	f = fopen(name, "r");
+	faux_str_free(name);
+	if (!f)
+		return BOOL_FALSE;
+	while (!found && (fscanf(f, "%ld", &pid) == 1)) {
+		if ((pid_t)pid == getpid())
+			found = BOOL_TRUE;
+	}
+	fclose(f);
+
+	return found;
+}
+
+
+/** @brief Prepares delegated cgroup subtree
+ *
+ * Enables cpu, memory and pids controllers for the children of subtree.
+ * The cgroup v2 doesn't allow processes within the inner nodes. So the
+ * daemon started within the subtree's root moves itself to the leaf
+ * cgroup first.
+ *
+ * @param [in] root Path to subtree within cgroupfs.
+ * @return BOOL_TRUE - success, BOOL_FALSE - it's not a cgroup v2 or the
+ * controllers are not delegated.
+ */
+bool_t kexec_cgroup_init(const char *root)
+{
+	char buf[256];
+	const char *controllers[] = { "cpu", "memory", "pids" };
+	size_t i = 0;
+
+	assert(root);
+	if (!root)
+		return BOOL_FALSE;
+
+	// Only cgroup v2 has this file
+	if (!kcgroup_read(root, "cgroup.controllers", buf, sizeof(buf)))
+		return BOOL_FALSE;
+	if (kcgroup_member(root)) {
+		char *leaf = faux_str_sprintf("%s/%s", root, KCGROUP_DAEMON);
+		bool_t res = BOOL_FALSE;
+		if ((mkdir(leaf, 0755) == 0) || (EEXIST == errno))
+			res = kcgroup_write(leaf, "cgroup.procs", "0");
+		faux_str_free(leaf);
+		if (!res)
+			return BOOL_FALSE;
+	}
+	for (i = 0; i < sizeof(controllers) / sizeof(controllers[0]); i++) {
+		char *str = faux_str_sprintf("+%s", controllers[i]);
+		bool_t res = kcgroup_write(root, "cgroup.subtree_control", str);
+		faux_str_free(str);
+		if (!res)
+			return BOOL_FALSE;
+	}
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Removes stale cgroups which are not populated already
+ */
+static void kcgroup_sweep(void)
+{
+	faux_list_node_t *node = NULL;
+
+	if (!kcgroup_stale)
+		return;
+
+	node = faux_list_head(kcgroup_stale);
+	while (node) {
+		faux_list_node_t *next = faux_list_next_node(node);
+		const char *path = (const char *)faux_list_data(node);
+		if ((rmdir(path) == 0) || (errno != EBUSY))
+			faux_list_del(kcgroup_stale, node);
+		node = next;
+	}
+}
+
+
+/** @brief Creates cgroup for process and applies limits
+ */
+bool_t kcgroup_create(kexec_t *exec)
+{
+	static unsigned long counter = 0;
+	const kexec_limits_t *limits = &exec->limits;
+	char *str = NULL;
+	bool_t res = BOOL_TRUE;
+
+	if (!limits->cgroup)
+		return BOOL_TRUE; // Cgroups are not used
+	kcgroup_sweep();
+
+	counter++;
+	exec->cgroup = faux_str_sprintf("%s/kexec-%ld-%lu",
+		limits->cgroup, (long)getpid(), counter);
+	if (mkdir(exec->cgroup, 0755) < 0) {
+		faux_str_free(exec->cgroup);
+		exec->cgroup = NULL;
+		return BOOL_FALSE;
+	}
+
+	if (limits->cpu_weight > 0) {
+		str = faux_str_sprintf("%u", limits->cpu_weight);
+		res = res && kcgroup_write(exec->cgroup, "cpu.weight", str);
+		faux_str_free(str);
+	}
+	if (limits->memory_max > 0) {
+		str = faux_str_sprintf("%llu", limits->memory_max);
+		res = res && kcgroup_write(exec->cgroup, "memory.max", str);
+		// Don't let swap to hide the memory limit. The swap
+		// accounting can be disabled so it's optional.
+		kcgroup_write(exec->cgroup, "memory.swap.max", "0");
+		faux_str_free(str);
+	}
+	if (limits->pids_max > 0) {
+		str = faux_str_sprintf("%u", limits->pids_max);
+		res = res && kcgroup_write(exec->cgroup, "pids.max", str);
+		faux_str_free(str);
+	}
+	if (!res) {
+		kcgroup_remove(exec);
+		return BOOL_FALSE;
+	}
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Moves calling process to the exec's cgroup
+ *
+ * Is called by child after fork().
+ */
+bool_t kcgroup_join(const kexec_t *exec)
+{
+	if (!exec->cgroup)
+		return BOOL_TRUE;
+
+	// The "0" is a calling process
+	return kcgroup_write(exec->cgroup, "cgroup.procs", "0");
+}
+
+
+static unsigned long long kcgroup_key(const char *buf, const char *key)
+{
+	const char *p = buf;
+	size_t len = strlen(key);
+
+	while (p && *p) {
+		if ((strncmp(p, key, len) == 0) && (' ' == p[len]))
+			return strtoull(p + len + 1, NULL, 10);
+		p = strchr(p, '\n');
+		if (p)
+			p++;
+	}
+
+	return 0;
+}
+
+
+/** @brief Reads resource usage of finished process
+ */
+void kcgroup_collect(kexec_t *exec)
+{
+	char buf[1024];
+
+	if (!exec->cgroup)
+		return;
+
+	if (kcgroup_read(exec->cgroup, "cpu.stat", buf, sizeof(buf)))
+		exec->usage.cpu_usec = kcgroup_key(buf, "usage_usec");
+	// The memory.peak is available since Linux 5.19
+	if (kcgroup_read(exec->cgroup, "memory.peak", buf, sizeof(buf)))
+		exec->usage.memory_peak = strtoull(buf, NULL, 10);
+}
+
+
+/** @brief Kills the rest of processes and removes cgroup
+ *
+ * The cgroup can't be removed while it's populated. The cgroup.kill is
+ * available since Linux 5.14 and it's asynchronous. So the populated
+ * cgroup is put to the stale list and its removal is retried on creation
+ * of the next one.
+ */
+void kcgroup_remove(kexec_t *exec)
+{
+	if (!exec->cgroup)
+		return;
+
+	kcgroup_write(exec->cgroup, "cgroup.kill", "1");
+	if ((rmdir(exec->cgroup) < 0) && (EBUSY == errno)) {
+		if (!kcgroup_stale)
+			kcgroup_stale = faux_list_new(FAUX_LIST_UNSORTED,
+				FAUX_LIST_NONUNIQUE, NULL, NULL,
+				(void (*)(void *))faux_str_free);
+		if (kcgroup_stale && faux_list_add(kcgroup_stale,
+			exec->cgroup)) {
+			exec->cgroup = NULL;
+			return;
+		}
+	}
+	faux_str_free(exec->cgroup);
+	exec->cgroup = NULL;
+}
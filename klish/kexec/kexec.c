@@ -0,0 +1,781 @@
+#define _GNU_SOURCE
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <termios.h>
+
+#include <faux/str.h>
+#include <faux/eloop.h>
+#include <klish/kexec.h>
+#include <klish/krecord.h>
+
+#include "private.h"
+
+
+kexec_t *kexec_new(const kaction_t *action, const kexec_limits_t *defaults)
+{
+	kexec_t *exec = NULL;
+
+	assert(action);
+	if (!action)
+		return NULL;
+	// The builtin ACTION is executed by plugin not by script
+	if (!kaction_script(action))
+		return NULL;
+
+	exec = faux_zmalloc(sizeof(*exec));
+	assert(exec);
+	if (!exec)
+		return NULL;
+
+	// Initialize. The ACTION's own limits override the defaults.
+	if (defaults)
+		exec->limits = *defaults;
+	if (kaction_timeout(action) != KACTION_LIMIT_DEFAULT)
+		exec->limits.timeout = kaction_timeout(action);
+	if (kaction_cpu(action) != KACTION_LIMIT_DEFAULT)
+		exec->limits.cpu = kaction_cpu(action);
+	if (0 == exec->limits.kill_delay)
+		exec->limits.kill_delay = KEXEC_KILL_DELAY;
+	exec->interactive = kaction_interactive(action);
+	exec->records = kaction_records(action);
+	exec->script = faux_str_dup(kaction_script(action));
+	exec->shebang = faux_str_dup(kaction_shebang(action) ?
+		kaction_shebang(action) : KEXEC_SHEBANG);
+	exec->state = KEXEC_STATE_NEW;
+	exec->pid = -1;
+	exec->fd_in = -1;
+	exec->fd_out = -1;
+	exec->fd_err = -1;
+	exec->fd_rec = -1;
+	exec->fd_input = -1;
+	exec->fd_result = -1;
+	exec->env = faux_list_new(FAUX_LIST_UNSORTED, FAUX_LIST_NONUNIQUE,
+		NULL, NULL, (void (*)(void *))faux_str_free);
+	assert(exec->env);
+	exec->eloop = NULL;
+	exec->timed_out = BOOL_FALSE;
+	exec->status = 0;
+	exec->cgroup = NULL;
+	exec->pty_pool = NULL;
+	exec->pty = NULL;
+
+	return exec;
+}
+
+
+/** @brief Signals process group of running script
+ *
+ * The child on pseudo-terminal creates its group by setsid() and the parent
+ * can't do it instead because setsid() fails for group leader. The signal
+ * sent before the child's setsid() finds no group so the process itself is
+ * signalled. Must not be used for reaped process because its PID can be
+ * reused.
+ */
+static void kexec_kill(kexec_t *exec, int signo)
+{
+	if ((kill(-exec->pid, signo) < 0) && (ESRCH == errno))
+		kill(exec->pid, signo);
+}
+
+
+void kexec_free(kexec_t *exec)
+{
+	if (!exec)
+		return;
+
+	// The owner is gone so nobody will wait for process
+	if ((exec->pid > 0) && (exec->state != KEXEC_STATE_DONE)) {
+		kexec_kill(exec, SIGKILL);
+		if (exec->eloop)
+			faux_eloop_del_sched_by_id(exec->eloop, exec->pid);
+	}
+	if (exec->pty) {
+		kpty_pool_put(exec->pty_pool, exec->pty, exec->pid);
+	} else {
+		if (exec->fd_in >= 0)
+			close(exec->fd_in);
+		if (exec->fd_out >= 0)
+			close(exec->fd_out);
+		if (exec->fd_err >= 0)
+			close(exec->fd_err);
+	}
+	if (exec->fd_rec >= 0)
+		close(exec->fd_rec);
+	if (exec->fd_input >= 0)
+		close(exec->fd_input);
+	if (exec->fd_result >= 0)
+		close(exec->fd_result);
+	kcgroup_remove(exec);
+	faux_list_free(exec->env);
+	faux_str_free(exec->script);
+	faux_str_free(exec->shebang);
+	faux_free(exec);
+}
+
+
+/** @brief Sets pool to get pseudo-terminal for stdin and stdout from
+ *
+ * The pseudo-terminal is used by interactive ACTIONs only. The
+ * non-interactive ones use pipes anyway because the line discipline
+ * limits throughput and converts line endings. With pseudo-terminal the
+ * kexec_stdin() and kexec_stdout() return the same master descriptor and
+ * the terminal is returned to pool by kexec_free().
+ */
+bool_t kexec_set_pty_pool(kexec_t *exec, kpty_pool_t *pool)
+{
+	assert(exec);
+	if (!exec)
+		return BOOL_FALSE;
+	if (exec->state != KEXEC_STATE_NEW)
+		return BOOL_FALSE;
+
+	exec->pty_pool = pool;
+
+	return BOOL_TRUE;
+}
+
+
+const kexec_limits_t *kexec_limits(const kexec_t *exec)
+{
+	assert(exec);
+	if (!exec)
+		return NULL;
+
+	return &exec->limits;
+}
+
+
+kexec_state_e kexec_state(const kexec_t *exec)
+{
+	assert(exec);
+	if (!exec)
+		return KEXEC_STATE_DONE;
+
+	return exec->state;
+}
+
+
+pid_t kexec_pid(const kexec_t *exec)
+{
+	assert(exec);
+	if (!exec)
+		return -1;
+
+	return exec->pid;
+}
+
+
+int kexec_stdin(const kexec_t *exec)
+{
+	assert(exec);
+	if (!exec)
+		return -1;
+
+	return exec->fd_in;
+}
+
+
+int kexec_stdout(const kexec_t *exec)
+{
+	assert(exec);
+	if (!exec)
+		return -1;
+
+	return exec->fd_out;
+}
+
+
+int kexec_stderr(const kexec_t *exec)
+{
+	assert(exec);
+	if (!exec)
+		return -1;
+
+	return exec->fd_err;
+}
+
+
+/** @brief Sets file to use as process's stdin
+ *
+ * The process has no stdin pipe then and it never gets pseudo-terminal.
+ * The exec takes ownership of descriptor.
+ *
+ * @param [in] exec Execution object. Not started yet.
+ * @param [in] fd Descriptor of file positioned at the start of input.
+ */
+bool_t kexec_set_input(kexec_t *exec, int fd)
+{
+	assert(exec);
+	if (!exec)
+		return BOOL_FALSE;
+	if (exec->state != KEXEC_STATE_NEW)
+		return BOOL_FALSE;
+
+	if (exec->fd_input >= 0)
+		close(exec->fd_input);
+	exec->fd_input = fd;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Sets file for process to write results of batched commands to
+ *
+ * The process gets it as descriptor from KBATCH_RESULT_FD_ENV environment
+ * variable. The exec takes ownership of descriptor.
+ *
+ * @param [in] exec Execution object. Not started yet.
+ * @param [in] fd Writable descriptor.
+ */
+bool_t kexec_set_result(kexec_t *exec, int fd)
+{
+	assert(exec);
+	if (!exec)
+		return BOOL_FALSE;
+	if (exec->state != KEXEC_STATE_NEW)
+		return BOOL_FALSE;
+
+	if (exec->fd_result >= 0)
+		close(exec->fd_result);
+	exec->fd_result = fd;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Adds variable to process's environment
+ *
+ * The later value of the same variable wins.
+ *
+ * @param [in] exec Execution object. Not started yet.
+ * @param [in] name Variable's name.
+ * @param [in] value Variable's value.
+ */
+bool_t kexec_add_env(kexec_t *exec, const char *name, const char *value)
+{
+	assert(exec);
+	if (!exec)
+		return BOOL_FALSE;
+	assert(name);
+	if (!name)
+		return BOOL_FALSE;
+	assert(value);
+	if (!value)
+		return BOOL_FALSE;
+	if (exec->state != KEXEC_STATE_NEW)
+		return BOOL_FALSE;
+	if (('\0' == *name) || strchr(name, '='))
+		return BOOL_FALSE;
+
+	if (!faux_list_add(exec->env, faux_str_sprintf("%s=%s", name, value)))
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Gets descriptor to read structured records from
+ *
+ * @return Descriptor or -1 if ACTION doesn't write records.
+ */
+int kexec_records(const kexec_t *exec)
+{
+	assert(exec);
+	if (!exec)
+		return -1;
+
+	return exec->fd_rec;
+}
+
+
+/** @brief Closes process's stdin so it gets EOF
+ *
+ * The master of pseudo-terminal is stdout too so it can't be closed. The
+ * EOF character is written to it instead.
+ */
+bool_t kexec_close_stdin(kexec_t *exec)
+{
+	assert(exec);
+	if (!exec)
+		return BOOL_FALSE;
+	if (exec->fd_in < 0)
+		return BOOL_TRUE;
+
+	if (exec->pty) {
+		struct termios t = {};
+		if (tcgetattr(exec->fd_in, &t) == 0)
+			write(exec->fd_in, &t.c_cc[VEOF], 1);
+	} else {
+		close(exec->fd_in);
+	}
+	exec->fd_in = -1;
+
+	return BOOL_TRUE;
+}
+
+
+bool_t kexec_timed_out(const kexec_t *exec)
+{
+	assert(exec);
+	if (!exec)
+		return BOOL_FALSE;
+
+	return exec->timed_out;
+}
+
+
+int kexec_status(const kexec_t *exec)
+{
+	assert(exec);
+	if (!exec)
+		return -1;
+
+	return exec->status;
+}
+
+
+/** @brief Gets return code of finished process
+ *
+ * The process killed by signal gets 128 + signal number like in shell.
+ */
+int kexec_retcode(const kexec_t *exec)
+{
+	assert(exec);
+	if (!exec)
+		return -1;
+	if (exec->state != KEXEC_STATE_DONE)
+		return -1;
+
+	if (WIFEXITED(exec->status))
+		return WEXITSTATUS(exec->status);
+	if (WIFSIGNALED(exec->status))
+		return 128 + WTERMSIG(exec->status);
+
+	return -1;
+}
+
+
+/** @brief Gets time the process was waiting for start within queue
+ *
+ * @return Wait time in milliseconds.
+ */
+unsigned long kexec_wait(const kexec_t *exec)
+{
+	long sec = 0;
+	long nsec = 0;
+
+	assert(exec);
+	if (!exec)
+		return 0;
+	if ((KEXEC_STATE_NEW == exec->state) ||
+		(0 == exec->queued.tv_sec && 0 == exec->queued.tv_nsec))
+		return 0;
+
+	sec = exec->started.tv_sec - exec->queued.tv_sec;
+	nsec = exec->started.tv_nsec - exec->queued.tv_nsec;
+	if (nsec < 0) {
+		sec--;
+		nsec += 1000000000l;
+	}
+	if (sec < 0)
+		return 0;
+
+	return (unsigned long)sec * 1000 + nsec / 1000000;
+}
+
+
+/** @brief Gets resource usage of process and its descendants
+ *
+ * The usage is known when process is finished and cgroups are used.
+ */
+const kexec_usage_t *kexec_usage(const kexec_t *exec)
+{
+	assert(exec);
+	if (!exec)
+		return NULL;
+
+	return &exec->usage;
+}
+
+
+static bool_t kexec_kill_ev(faux_eloop_t *eloop, faux_eloop_type_e type,
+	void *associated_data, void *user_data)
+{
+	kexec_t *exec = (kexec_t *)user_data;
+
+	if (KEXEC_STATE_TERMINATING == exec->state) {
+		kexec_kill(exec, SIGKILL);
+		exec->state = KEXEC_STATE_KILLED;
+	}
+
+	eloop = eloop; // Happy compiler
+	type = type; // Happy compiler
+	associated_data = associated_data; // Happy compiler
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Sends SIGTERM and schedules SIGKILL
+ */
+static void kexec_escalate(kexec_t *exec)
+{
+	struct timespec delay = {};
+
+	kexec_kill(exec, SIGTERM);
+	exec->state = KEXEC_STATE_TERMINATING;
+	delay.tv_sec = exec->limits.kill_delay;
+	if (!exec->eloop || !faux_eloop_add_sched_once_delayed(exec->eloop,
+		&delay, exec->pid, kexec_kill_ev, exec))
+		kexec_kill_ev(exec->eloop, FAUX_ELOOP_SCHED, NULL, exec);
+}
+
+
+static bool_t kexec_timeout_ev(faux_eloop_t *eloop, faux_eloop_type_e type,
+	void *associated_data, void *user_data)
+{
+	kexec_t *exec = (kexec_t *)user_data;
+
+	if (KEXEC_STATE_RUNNING == exec->state) {
+		exec->timed_out = BOOL_TRUE;
+		kexec_escalate(exec);
+	}
+
+	eloop = eloop; // Happy compiler
+	type = type; // Happy compiler
+	associated_data = associated_data; // Happy compiler
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Closes all the descriptors starting from the specified one
+ *
+ * The daemon's sockets and the other sessions' pipes must not leak into
+ * ACTION's process. Not all of them are close-on-exec.
+ */
+static void kexec_close_from(int first)
+{
+	long max = 0;
+	int fd = 0;
+
+#ifdef HAVE_CLOSE_RANGE
+	if (close_range((unsigned int)first, ~0U, 0) == 0)
+		return;
+#endif
+	max = sysconf(_SC_OPEN_MAX);
+	if (max < 0)
+		max = 1024;
+	for (fd = first; fd < max; fd++)
+		close(fd);
+}
+
+
+/** @brief Child's part of kexec_start(). Never returns.
+ */
+static void kexec_child(kexec_t *exec, int fd_in, int fd_out, int fd_err,
+	int fd_rec)
+{
+	sigset_t sig_set;
+	int signo = 0;
+	int fd_result = exec->fd_result;
+	faux_list_node_t *iter = NULL;
+	char *env = NULL;
+
+	// New process group to signal all the script's processes at once.
+	// The pseudo-terminal needs new session to become controlling one.
+	if (exec->pty) {
+		setsid();
+		ioctl(fd_in, TIOCSCTTY, 0);
+	} else {
+		setpgid(0, 0);
+	}
+
+	// Don't run script without configured resource limits
+	if (!kcgroup_join(exec))
+		_exit(126);
+
+	// The daemon blocks and catches signals. Restore defaults.
+	for (signo = 1; signo < NSIG; signo++)
+		signal(signo, SIG_DFL);
+	sigemptyset(&sig_set);
+	sigprocmask(SIG_SETMASK, &sig_set, NULL);
+
+	if (exec->limits.cpu > 0) {
+		struct rlimit rlim = {};
+		// The SIGXCPU on soft limit then SIGKILL on hard one
+		rlim.rlim_cur = exec->limits.cpu;
+		rlim.rlim_max = exec->limits.cpu + exec->limits.kill_delay;
+		setrlimit(RLIMIT_CPU, &rlim);
+	}
+
+	// The strings belong to child's copy of memory
+	iter = faux_list_head(exec->env);
+	while ((env = (char *)faux_list_each(&iter)))
+		putenv(env);
+
+	dup2(fd_in, STDIN_FILENO);
+	dup2(fd_out, STDOUT_FILENO);
+	dup2(fd_err, STDERR_FILENO);
+	// The records must not overwrite results descriptor
+	if ((fd_rec >= 0) && (KEXEC_RECORD_FD == fd_result))
+		fd_result = dup(fd_result);
+	if (fd_rec >= 0) {
+		// The dup2() to itself doesn't clear close-on-exec
+		if (KEXEC_RECORD_FD == fd_rec)
+			fcntl(fd_rec, F_SETFD, 0);
+		else
+			dup2(fd_rec, KEXEC_RECORD_FD);
+		setenv(KRECORD_FD_ENV, KEXEC_RECORD_FD_STR, 1);
+	}
+	if (fd_result >= 0) {
+		if (KEXEC_RESULT_FD == fd_result)
+			fcntl(fd_result, F_SETFD, 0);
+		else
+			dup2(fd_result, KEXEC_RESULT_FD);
+		setenv(KBATCH_RESULT_FD_ENV, KEXEC_RESULT_FD_STR, 1);
+		if (fd_rec < 0)
+			close(KEXEC_RECORD_FD);
+	}
+	if (fd_result >= 0)
+		kexec_close_from(KEXEC_RESULT_FD + 1);
+	else
+		kexec_close_from((fd_rec >= 0) ? (KEXEC_RECORD_FD + 1) : 3);
+
+	execl(exec->shebang, exec->shebang, "-c", exec->script, (char *)NULL);
+	_exit(127);
+}
+
+
+/** @brief Parent's part of kexec_start() after fork()
+ */
+static bool_t kexec_started(kexec_t *exec, pid_t pid, faux_eloop_t *eloop)
+{
+	exec->pid = pid;
+	exec->eloop = eloop;
+	exec->state = KEXEC_STATE_RUNNING;
+	clock_gettime(CLOCK_MONOTONIC, &exec->started);
+
+	if (exec->limits.timeout > 0) {
+		struct timespec timeout = {};
+		timeout.tv_sec = exec->limits.timeout;
+		if (!eloop || !faux_eloop_add_sched_once_delayed(eloop,
+			&timeout, pid, kexec_timeout_ev, exec)) {
+			kexec_terminate(exec);
+			return BOOL_FALSE;
+		}
+	}
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Starts script on pseudo-terminal from pool
+ *
+ * The stderr is a pipe anyway to distinguish it from stdout.
+ */
+static bool_t kexec_start_pty(kexec_t *exec, faux_eloop_t *eloop,
+	int fd_rec)
+{
+	pid_t pid = -1;
+
+	exec->pty = kpty_pool_get(exec->pty_pool);
+	if (!exec->pty) {
+		kcgroup_remove(exec);
+		return BOOL_FALSE;
+	}
+	exec->fd_in = kpty_master(exec->pty);
+	exec->fd_out = kpty_master(exec->pty);
+	exec->fd_err = kpty_stderr_rd(exec->pty);
+
+	pid = fork();
+	if (pid < 0) {
+		kpty_pool_put(exec->pty_pool, exec->pty, -1);
+		exec->pty = NULL;
+		exec->fd_in = -1;
+		exec->fd_out = -1;
+		exec->fd_err = -1;
+		kcgroup_remove(exec);
+		return BOOL_FALSE;
+	}
+	if (0 == pid)
+		kexec_child(exec, kpty_slave(exec->pty),
+			kpty_slave(exec->pty), kpty_stderr_wr(exec->pty),
+			fd_rec);
+	kpty_close_child_ends(exec->pty);
+
+	return kexec_started(exec, pid, eloop);
+}
+
+
+/** @brief Starts script
+ *
+ * The standard streams of process are pipes. The interactive ACTION gets
+ * pseudo-terminal from pool (see kexec_set_pty_pool()) if any. The
+ * parent's ends are available by kexec_stdin(), kexec_stdout() and
+ * kexec_stderr(). The ACTION with records gets one more pipe, see
+ * kexec_records(). The daemon must call kexec_done() when process is
+ * reaped.
+ *
+ * @param [in] exec Execution object.
+ * @param [in] eloop Event loop to schedule timers within. Timers use
+ * process's PID as event identifier.
+ * @return BOOL_TRUE - success, BOOL_FALSE - error.
+ */
+bool_t kexec_start(kexec_t *exec, faux_eloop_t *eloop)
+{
+	int in[2] = { -1, -1 };
+	int out[2] = { -1, -1 };
+	int err[2] = { -1, -1 };
+	int rec[2] = { -1, -1 };
+	pid_t pid = -1;
+	bool_t res = BOOL_FALSE;
+
+	assert(exec);
+	if (!exec)
+		return BOOL_FALSE;
+	if (exec->state != KEXEC_STATE_NEW)
+		return BOOL_FALSE;
+
+	if (!kcgroup_create(exec))
+		return BOOL_FALSE;
+	// The records pipe is used with pseudo-terminal too
+	if (exec->records) {
+		if (pipe2(rec, O_CLOEXEC) < 0)
+			goto err;
+		exec->fd_rec = rec[0];
+	}
+	if (exec->pty_pool && exec->interactive && (exec->fd_input < 0)) {
+		res = kexec_start_pty(exec, eloop, rec[1]);
+		if (rec[1] >= 0)
+			close(rec[1]);
+		return res;
+	}
+	if ((exec->fd_input < 0) && (pipe2(in, O_CLOEXEC) < 0))
+		goto err;
+	if ((pipe2(out, O_CLOEXEC) < 0) || (pipe2(err, O_CLOEXEC) < 0))
+		goto err;
+	// Larger pipe needs less wakeups of daemon on bulk output. The
+	// unprivileged daemon is limited by /proc/sys/fs/pipe-max-size so
+	// the error is not fatal.
+	if (exec->limits.pipe_size > 0) {
+		fcntl(out[0], F_SETPIPE_SZ, (int)exec->limits.pipe_size);
+		fcntl(err[0], F_SETPIPE_SZ, (int)exec->limits.pipe_size);
+	}
+
+	pid = fork();
+	if (pid < 0)
+		goto err;
+	if (0 == pid)
+		kexec_child(exec, (exec->fd_input >= 0) ? exec->fd_input :
+			in[0], out[1], err[1], rec[1]);
+
+	// Parent. Set group too to avoid race with kill() of group.
+	setpgid(pid, pid);
+	if (exec->fd_input >= 0) {
+		close(exec->fd_input);
+		exec->fd_input = -1;
+	} else {
+		close(in[0]);
+	}
+	// The process has its own copy
+	if (exec->fd_result >= 0) {
+		close(exec->fd_result);
+		exec->fd_result = -1;
+	}
+	close(out[1]);
+	close(err[1]);
+	if (rec[1] >= 0)
+		close(rec[1]);
+	exec->fd_in = in[1];
+	exec->fd_out = out[0];
+	exec->fd_err = err[0];
+
+	return kexec_started(exec, pid, eloop);
+err:
+	if (in[0] >= 0) {
+		close(in[0]);
+		close(in[1]);
+	}
+	if (out[0] >= 0) {
+		close(out[0]);
+		close(out[1]);
+	}
+	if (err[0] >= 0) {
+		close(err[0]);
+		close(err[1]);
+	}
+	if (rec[0] >= 0) {
+		close(rec[0]);
+		close(rec[1]);
+		exec->fd_rec = -1;
+	}
+	kcgroup_remove(exec);
+
+	return BOOL_FALSE;
+}
+
+
+/** @brief Process is finished
+ *
+ * Cancels timers. The processes of terminated group which are still alive
+ * are killed. The process's cgroup is removed with all its processes.
+ *
+ * @param [in] exec Execution object.
+ * @param [in] status Status from waitpid().
+ */
+bool_t kexec_done(kexec_t *exec, int status)
+{
+	assert(exec);
+	if (!exec)
+		return BOOL_FALSE;
+	if ((exec->state != KEXEC_STATE_RUNNING) &&
+		(exec->state != KEXEC_STATE_TERMINATING) &&
+		(exec->state != KEXEC_STATE_KILLED))
+		return BOOL_FALSE;
+
+	if (exec->state != KEXEC_STATE_RUNNING)
+		kill(-exec->pid, SIGKILL);
+	if (exec->eloop)
+		faux_eloop_del_sched_by_id(exec->eloop, exec->pid);
+	exec->status = status;
+	exec->state = KEXEC_STATE_DONE;
+	kcgroup_collect(exec);
+	kcgroup_remove(exec);
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Terminates running process by SIGTERM and then by SIGKILL
+ */
+bool_t kexec_terminate(kexec_t *exec)
+{
+	assert(exec);
+	if (!exec)
+		return BOOL_FALSE;
+	if (exec->state != KEXEC_STATE_RUNNING)
+		return BOOL_FALSE;
+
+	if (exec->eloop)
+		faux_eloop_del_sched_by_id(exec->eloop, exec->pid);
+	kexec_escalate(exec);
+
+	return BOOL_TRUE;
+}
@@ -0,0 +1,519 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include <faux/str.h>
+#include <faux/list.h>
+#include <klish/kexec.h>
+#include <klish/kexecq.h>
+
+#include "private.h"
+
+
+static int kexecq_user_compare(const void *first, const void *second)
+{
+	const kexecq_user_t *f = (const kexecq_user_t *)first;
+	const kexecq_user_t *s = (const kexecq_user_t *)second;
+
+	return strcmp(f->name, s->name);
+}
+
+
+static int kexecq_user_kcompare(const void *key, const void *list_item)
+{
+	const char *f = (const char *)key;
+	const kexecq_user_t *s = (const kexecq_user_t *)list_item;
+
+	return strcmp(f, s->name);
+}
+
+
+static void kexecq_user_free(void *data)
+{
+	kexecq_user_t *user = (kexecq_user_t *)data;
+
+	if (!user)
+		return;
+
+	faux_list_free(user->sessions);
+	faux_str_free(user->name);
+	faux_free(user);
+}
+
+
+static int kexecq_ptr_compare(const void *first, const void *second)
+{
+	uintptr_t f = (uintptr_t)first;
+	uintptr_t s = (uintptr_t)second;
+
+	if (f == s)
+		return 0;
+
+	return (f < s) ? -1 : 1;
+}
+
+
+static int kexecq_session_compare(const void *first, const void *second)
+{
+	const kexecq_session_t *f = (const kexecq_session_t *)first;
+	const kexecq_session_t *s = (const kexecq_session_t *)second;
+
+	return kexecq_ptr_compare(f->owner, s->owner);
+}
+
+
+static int kexecq_session_kcompare(const void *key, const void *list_item)
+{
+	const kexecq_session_t *s = (const kexecq_session_t *)list_item;
+
+	return kexecq_ptr_compare(key, s->owner);
+}
+
+
+static void kexecq_session_free(void *data)
+{
+	kexecq_session_t *session = (kexecq_session_t *)data;
+
+	if (!session)
+		return;
+
+	faux_list_free(session->pending);
+	faux_free(session);
+}
+
+
+kexecq_t *kexecq_new(unsigned int max_running, unsigned int max_per_user)
+{
+	kexecq_t *queue = NULL;
+
+	queue = faux_zmalloc(sizeof(*queue));
+	assert(queue);
+	if (!queue)
+		return NULL;
+
+	// Initialize
+	queue->max_running = max_running;
+	queue->max_per_user = max_per_user;
+	queue->vclock = 0;
+	queue->pending = 0;
+	queue->users = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		kexecq_user_compare, kexecq_user_kcompare, kexecq_user_free);
+	assert(queue->users);
+	queue->sessions = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		kexecq_session_compare, kexecq_session_kcompare,
+		kexecq_session_free);
+	assert(queue->sessions);
+	queue->running = faux_list_new(FAUX_LIST_UNSORTED, FAUX_LIST_NONUNIQUE,
+		NULL, NULL, faux_free);
+	assert(queue->running);
+
+	return queue;
+}
+
+
+void kexecq_free(kexecq_t *queue)
+{
+	if (!queue)
+		return;
+
+	faux_list_free(queue->running);
+	faux_list_free(queue->sessions);
+	faux_list_free(queue->users);
+	faux_free(queue);
+}
+
+
+unsigned int kexecq_max_running(const kexecq_t *queue)
+{
+	assert(queue);
+	if (!queue)
+		return 0;
+
+	return queue->max_running;
+}
+
+
+bool_t kexecq_set_max_running(kexecq_t *queue, unsigned int max_running)
+{
+	assert(queue);
+	if (!queue)
+		return BOOL_FALSE;
+
+	queue->max_running = max_running;
+
+	return BOOL_TRUE;
+}
+
+
+unsigned int kexecq_max_per_user(const kexecq_t *queue)
+{
+	assert(queue);
+	if (!queue)
+		return 0;
+
+	return queue->max_per_user;
+}
+
+
+bool_t kexecq_set_max_per_user(kexecq_t *queue, unsigned int max_per_user)
+{
+	assert(queue);
+	if (!queue)
+		return BOOL_FALSE;
+
+	queue->max_per_user = max_per_user;
+
+	return BOOL_TRUE;
+}
+
+
+size_t kexecq_running(const kexecq_t *queue)
+{
+	assert(queue);
+	if (!queue)
+		return 0;
+
+	return faux_list_len(queue->running);
+}
+
+
+size_t kexecq_pending(const kexecq_t *queue)
+{
+	assert(queue);
+	if (!queue)
+		return 0;
+
+	return queue->pending;
+}
+
+
+/** @brief Frees user if it has neither sessions nor running processes
+ */
+static void kexecq_user_release(kexecq_t *queue, kexecq_user_t *user)
+{
+	faux_list_node_t *node = NULL;
+
+	if (user->running > 0)
+		return;
+	if (faux_list_len(user->sessions) > 0)
+		return;
+	node = faux_list_kfind_node(queue->users, user->name);
+	if (node)
+		faux_list_del(queue->users, node);
+}
+
+
+/** @brief Registers session
+ *
+ * @param [in] queue Queue.
+ * @param [in] session Owner's session. Used as a key only.
+ * @param [in] user User name. The sessions of the same user share the
+ * user's part of slots.
+ * @param [in] weight Weight of session. The 0 is treated as 1.
+ * @return BOOL_TRUE - success, BOOL_FALSE - error.
+ */
+bool_t kexecq_add_session(kexecq_t *queue, const void *session,
+	const char *user, unsigned int weight)
+{
+	kexecq_user_t *u = NULL;
+	kexecq_session_t *s = NULL;
+
+	assert(queue);
+	if (!queue)
+		return BOOL_FALSE;
+	assert(session);
+	if (!session)
+		return BOOL_FALSE;
+	assert(user);
+	if (!user)
+		return BOOL_FALSE;
+	if (faux_list_kfind(queue->sessions, session))
+		return BOOL_FALSE;
+
+	u = (kexecq_user_t *)faux_list_kfind(queue->users, user);
+	if (!u) {
+		u = faux_zmalloc(sizeof(*u));
+		assert(u);
+		if (!u)
+			return BOOL_FALSE;
+		u->name = faux_str_dup(user);
+		u->vtime = queue->vclock;
+		u->vclock = 0;
+		u->running = 0;
+		u->active = 0;
+		u->sessions = faux_list_new(FAUX_LIST_SORTED,
+			FAUX_LIST_UNIQUE, kexecq_session_compare,
+			kexecq_session_kcompare, NULL);
+		assert(u->sessions);
+		if (!faux_list_add(queue->users, u)) {
+			kexecq_user_free(u);
+			return BOOL_FALSE;
+		}
+	}
+
+	s = faux_zmalloc(sizeof(*s));
+	assert(s);
+	if (!s)
+		return BOOL_FALSE;
+	s->owner = session;
+	s->user = u;
+	s->weight = (weight > 0) ? weight : 1;
+	s->vtime = u->vclock;
+	s->pending = faux_list_new(FAUX_LIST_UNSORTED, FAUX_LIST_NONUNIQUE,
+		NULL, NULL, NULL);
+	assert(s->pending);
+	faux_list_add(queue->sessions, s);
+	faux_list_add(u->sessions, s);
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Unregisters session
+ *
+ * The pending processes are dropped. The owner frees them. The running
+ * processes still occupy their slots until kexecq_done().
+ */
+bool_t kexecq_del_session(kexecq_t *queue, const void *session)
+{
+	faux_list_node_t *node = NULL;
+	kexecq_session_t *s = NULL;
+	kexecq_user_t *u = NULL;
+
+	assert(queue);
+	if (!queue)
+		return BOOL_FALSE;
+
+	node = faux_list_kfind_node(queue->sessions, session);
+	if (!node)
+		return BOOL_FALSE;
+	s = (kexecq_session_t *)faux_list_data(node);
+	u = s->user;
+
+	if (faux_list_len(s->pending) > 0) {
+		queue->pending -= faux_list_len(s->pending);
+		u->active--;
+	}
+	faux_list_del(u->sessions, faux_list_kfind_node(u->sessions, session));
+	faux_list_del(queue->sessions, node);
+	kexecq_user_release(queue, u);
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Puts process to the session's queue
+ *
+ * The session that has nothing to run joins the competition at current
+ * virtual time. So the idle time doesn't give it the credit to take over
+ * the slots later.
+ */
+bool_t kexecq_push(kexecq_t *queue, const void *session, kexec_t *exec)
+{
+	kexecq_session_t *s = NULL;
+	kexecq_user_t *u = NULL;
+
+	assert(queue);
+	if (!queue)
+		return BOOL_FALSE;
+	assert(exec);
+	if (!exec)
+		return BOOL_FALSE;
+	if (exec->state != KEXEC_STATE_NEW)
+		return BOOL_FALSE;
+
+	s = (kexecq_session_t *)faux_list_kfind(queue->sessions, session);
+	if (!s)
+		return BOOL_FALSE;
+	u = s->user;
+
+	if (0 == faux_list_len(s->pending)) {
+		if (0 == u->active) {
+			if (u->vtime < queue->vclock)
+				u->vtime = queue->vclock;
+		}
+		if (s->vtime < u->vclock)
+			s->vtime = u->vclock;
+		u->active++;
+	}
+	if (!faux_list_add(s->pending, exec))
+		return BOOL_FALSE;
+	queue->pending++;
+	clock_gettime(CLOCK_MONOTONIC, &exec->queued);
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Removes pending process from queue
+ *
+ * The owner must remove process before it frees the pending one. The
+ * process that is dispatched already is released by kexecq_done().
+ *
+ * @return BOOL_TRUE - removed, BOOL_FALSE - process is not pending.
+ */
+bool_t kexecq_remove(kexecq_t *queue, const kexec_t *exec)
+{
+	faux_list_node_t *iter = NULL;
+	kexecq_session_t *s = NULL;
+
+	assert(queue);
+	if (!queue)
+		return BOOL_FALSE;
+	if (!exec)
+		return BOOL_FALSE;
+
+	iter = faux_list_head(queue->sessions);
+	while ((s = (kexecq_session_t *)faux_list_each(&iter))) {
+		faux_list_node_t *node = faux_list_head(s->pending);
+		while (node) {
+			if (faux_list_data(node) == exec)
+				break;
+			node = faux_list_next_node(node);
+		}
+		if (!node)
+			continue;
+		faux_list_del(s->pending, node);
+		queue->pending--;
+		if (0 == faux_list_len(s->pending))
+			s->user->active--;
+		return BOOL_TRUE;
+	}
+
+	return BOOL_FALSE;
+}
+
+
+/** @brief Gets next process to start
+ *
+ * The user with the least virtual time is chosen first and then the
+ * user's session with the least virtual time. Both are charged by the
+ * session's weight. The caller must start process and then call
+ * kexecq_done() when process is finished or can't be started.
+ *
+ * @return Process to start or NULL if all slots are busy or queue is
+ * empty.
+ */
+kexec_t *kexecq_pop(kexecq_t *queue)
+{
+	faux_list_node_t *iter = NULL;
+	kexecq_user_t *u = NULL;
+	kexecq_user_t *user = NULL;
+	kexecq_session_t *s = NULL;
+	kexecq_session_t *session = NULL;
+	kexecq_job_t *job = NULL;
+	kexec_t *exec = NULL;
+	uint64_t delta = 0;
+
+	assert(queue);
+	if (!queue)
+		return NULL;
+	if (0 == queue->pending)
+		return NULL;
+	if ((queue->max_running > 0) &&
+		(faux_list_len(queue->running) >= queue->max_running))
+		return NULL;
+
+	iter = faux_list_head(queue->users);
+	while ((u = (kexecq_user_t *)faux_list_each(&iter))) {
+		if (0 == u->active)
+			continue;
+		if ((queue->max_per_user > 0) &&
+			(u->running >= queue->max_per_user))
+			continue;
+		if (!user || (u->vtime < user->vtime))
+			user = u;
+	}
+	if (!user)
+		return NULL;
+
+	iter = faux_list_head(user->sessions);
+	while ((s = (kexecq_session_t *)faux_list_each(&iter))) {
+		if (0 == faux_list_len(s->pending))
+			continue;
+		if (!session || (s->vtime < session->vtime))
+			session = s;
+	}
+	assert(session);
+	if (!session)
+		return NULL;
+
+	job = faux_zmalloc(sizeof(*job));
+	assert(job);
+	if (!job)
+		return NULL;
+	exec = (kexec_t *)faux_list_takeaway(session->pending,
+		faux_list_head(session->pending));
+	job->exec = exec;
+	job->user = user;
+	faux_list_add(queue->running, job);
+
+	queue->pending--;
+	if (0 == faux_list_len(session->pending))
+		user->active--;
+	user->running++;
+
+	delta = KEXECQ_STRIDE / session->weight;
+	queue->vclock = user->vtime;
+	user->vclock = session->vtime;
+	user->vtime += delta;
+	session->vtime += delta;
+
+	return exec;
+}
+
+
+/** @brief Finds dispatched process by PID
+ */
+kexec_t *kexecq_find(const kexecq_t *queue, pid_t pid)
+{
+	faux_list_node_t *iter = NULL;
+	kexecq_job_t *job = NULL;
+
+	assert(queue);
+	if (!queue)
+		return NULL;
+
+	// The number of running processes is limited so list is short
+	iter = faux_list_head(queue->running);
+	while ((job = (kexecq_job_t *)faux_list_each(&iter))) {
+		if (kexec_pid(job->exec) == pid)
+			return job->exec;
+	}
+
+	return NULL;
+}
+
+
+/** @brief Releases slot of dispatched process
+ */
+bool_t kexecq_done(kexecq_t *queue, kexec_t *exec)
+{
+	faux_list_node_t *node = NULL;
+	kexecq_job_t *job = NULL;
+	kexecq_user_t *user = NULL;
+
+	assert(queue);
+	if (!queue)
+		return BOOL_FALSE;
+
+	node = faux_list_head(queue->running);
+	while (node) {
+		job = (kexecq_job_t *)faux_list_data(node);
+		if (job->exec == exec)
+			break;
+		node = faux_list_next_node(node);
+	}
+	if (!node)
+		return BOOL_FALSE;
+
+	user = job->user;
+	user->running--;
+	faux_list_del(queue->running, node);
+	kexecq_user_release(queue, user);
+
+	return BOOL_TRUE;
+}
@@ -0,0 +1,390 @@
+/** @file kflight.c
+ *
+ * @brief Single-flight execution of identical cacheable commands
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/wait.h>
+
+#include <faux/str.h>
+#include <faux/list.h>
+#include <klish/kflight.h>
+
+#include "private.h"
+
+
+static int kflight_compare(const void *first, const void *second)
+{
+	const kflight_t *f = (const kflight_t *)first;
+	const kflight_t *s = (const kflight_t *)second;
+
+	return strcmp(f->key, s->key);
+}
+
+
+static int kflight_kcompare(const void *key, const void *list_item)
+{
+	const char *f = (const char *)key;
+	const kflight_t *s = (const kflight_t *)list_item;
+
+	return strcmp(f, s->key);
+}
+
+
+static void kflight_free(void *data)
+{
+	kflight_t *flight = (kflight_t *)data;
+
+	if (!flight)
+		return;
+
+	faux_list_free(flight->subscribers);
+	kcache_entry_free(flight->entry);
+	kexec_free(flight->exec);
+	faux_str_free(flight->key);
+	faux_free(flight);
+}
+
+
+/** @brief Creates registry of flights
+ *
+ * @param [in] entry_max Maximum size of collected output. It's a cache
+ * size usually. 0 - default cache size.
+ */
+kflights_t *kflights_new(size_t entry_max)
+{
+	kflights_t *flights = NULL;
+
+	flights = faux_zmalloc(sizeof(*flights));
+	assert(flights);
+	if (!flights)
+		return NULL;
+
+	// Initialize
+	flights->entry_max = entry_max ? entry_max : KCACHE_SIZE;
+	flights->list = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		kflight_compare, kflight_kcompare, kflight_free);
+	assert(flights->list);
+
+	return flights;
+}
+
+
+/** @brief Frees registry
+ *
+ * The processes are killed. The pending ones must be removed from
+ * execution queue before.
+ */
+void kflights_free(kflights_t *flights)
+{
+	if (!flights)
+		return;
+
+	faux_list_free(flights->list);
+	faux_free(flights);
+}
+
+
+/** @brief Starts new flight
+ *
+ * The flight takes ownership of exec on success. The requester joins it
+ * by kflight_join() like the others.
+ *
+ * @param [in] flights Registry.
+ * @param [in] key Cache key of command.
+ * @param [in] ttl Seconds to keep output within cache.
+ * @param [in] exec Process. It's not started yet usually.
+ * @return New flight or NULL if there is a flight with the same key.
+ */
+kflight_t *kflights_add(kflights_t *flights, const char *key,
+	unsigned int ttl, kexec_t *exec)
+{
+	kflight_t *flight = NULL;
+
+	assert(flights);
+	if (!flights)
+		return NULL;
+	assert(key);
+	if (!key)
+		return NULL;
+	assert(exec);
+	if (!exec)
+		return NULL;
+
+	flight = faux_zmalloc(sizeof(*flight));
+	assert(flight);
+	if (!flight)
+		return NULL;
+	flight->key = faux_str_dup(key);
+	flight->entry = kcache_entry_new(key, ttl, flights->entry_max);
+	flight->subscribers = faux_list_new(FAUX_LIST_UNSORTED,
+		FAUX_LIST_NONUNIQUE, NULL, NULL, NULL);
+	assert(flight->subscribers);
+	if (!flight->entry || !faux_list_add(flights->list, flight)) {
+		kflight_free(flight);
+		return NULL;
+	}
+	flight->exec = exec;
+
+	return flight;
+}
+
+
+/** @brief Removes flight and frees it
+ *
+ * The process is killed if it's still running. The caller must remove the
+ * process from execution queue before.
+ */
+void kflights_del(kflights_t *flights, kflight_t *flight)
+{
+	faux_list_node_t *node = NULL;
+
+	assert(flights);
+	if (!flights)
+		return;
+	if (!flight)
+		return;
+
+	node = faux_list_kfind_node(flights->list, flight->key);
+	if (node)
+		faux_list_del(flights->list, node);
+}
+
+
+/** @brief Finds flight to join
+ *
+ * @return Flight or NULL if there is no flight with the key or its output
+ * is not kept completely.
+ */
+kflight_t *kflights_find(const kflights_t *flights, const char *key)
+{
+	kflight_t *flight = NULL;
+
+	assert(flights);
+	if (!flights)
+		return NULL;
+	assert(key);
+	if (!key)
+		return NULL;
+
+	flight = (kflight_t *)faux_list_kfind(flights->list, key);
+	if (!flight || flight->entry->oversized)
+		return NULL;
+
+	return flight;
+}
+
+
+kflight_t *kflights_find_by_exec(const kflights_t *flights,
+	const kexec_t *exec)
+{
+	faux_list_node_t *iter = NULL;
+	kflight_t *flight = NULL;
+
+	assert(flights);
+	if (!flights)
+		return NULL;
+
+	iter = faux_list_head(flights->list);
+	while ((flight = (kflight_t *)faux_list_each(&iter))) {
+		if (flight->exec == exec)
+			return flight;
+	}
+
+	return NULL;
+}
+
+
+size_t kflights_len(const kflights_t *flights)
+{
+	assert(flights);
+	if (!flights)
+		return 0;
+
+	return faux_list_len(flights->list);
+}
+
+
+/** @brief Removes gone session from all the flights
+ *
+ * The flights are not stopped. Their output will be cached anyway.
+ */
+void kflights_leave_all(kflights_t *flights, const void *subscriber)
+{
+	faux_list_node_t *iter = NULL;
+	kflight_t *flight = NULL;
+
+	assert(flights);
+	if (!flights)
+		return;
+
+	iter = faux_list_head(flights->list);
+	while ((flight = (kflight_t *)faux_list_each(&iter)))
+		kflight_leave(flight, subscriber);
+}
+
+
+/** @brief Finishes flight
+ *
+ * The collected output is put to cache with process's retcode and the
+ * flight is removed. The caller sends results to subscribers before.
+ *
+ * @param [in] flights Registry.
+ * @param [in] flight Flight with finished process.
+ * @param [in] cache Cache. NULL - don't cache output.
+ * @return BOOL_TRUE if output is cached.
+ */
+bool_t kflights_done(kflights_t *flights, kflight_t *flight,
+	kcache_t *cache)
+{
+	bool_t cached = BOOL_FALSE;
+
+	assert(flights);
+	if (!flights)
+		return BOOL_FALSE;
+	assert(flight);
+	if (!flight)
+		return BOOL_FALSE;
+
+	// The killed or timed out command must not be cached
+	if (cache && (kexec_state(flight->exec) == KEXEC_STATE_DONE) &&
+		!kexec_timed_out(flight->exec) &&
+		WIFEXITED(kexec_status(flight->exec))) {
+		cached = kcache_put(cache, flight->entry,
+			kexec_retcode(flight->exec));
+		flight->entry = NULL; // Cache takes ownership anyway
+	}
+	kflights_del(flights, flight);
+
+	return cached;
+}
+
+
+const char *kflight_key(const kflight_t *flight)
+{
+	assert(flight);
+	if (!flight)
+		return NULL;
+
+	return flight->key;
+}
+
+
+kexec_t *kflight_exec(const kflight_t *flight)
+{
+	assert(flight);
+	if (!flight)
+		return NULL;
+
+	return flight->exec;
+}
+
+
+/** @brief Gets output collected so far
+ *
+ * The late subscriber gets it before the live output.
+ */
+const kcache_entry_t *kflight_entry(const kflight_t *flight)
+{
+	assert(flight);
+	if (!flight)
+		return NULL;
+
+	return flight->entry;
+}
+
+
+/** @brief Collects stdout of flight's process
+ *
+ * The daemon sends the same data to all the subscribers itself.
+ */
+bool_t kflight_add_stdout(kflight_t *flight, const char *data, size_t len)
+{
+	assert(flight);
+	if (!flight)
+		return BOOL_FALSE;
+
+	return kcache_entry_add_stdout(flight->entry, data, len);
+}
+
+
+bool_t kflight_add_stderr(kflight_t *flight, const char *data, size_t len)
+{
+	assert(flight);
+	if (!flight)
+		return BOOL_FALSE;
+
+	return kcache_entry_add_stderr(flight->entry, data, len);
+}
+
+
+bool_t kflight_join(kflight_t *flight, void *subscriber)
+{
+	faux_list_node_t *iter = NULL;
+
+	assert(flight);
+	if (!flight)
+		return BOOL_FALSE;
+	assert(subscriber);
+	if (!subscriber)
+		return BOOL_FALSE;
+
+	iter = faux_list_head(flight->subscribers);
+	while (iter) {
+		if (faux_list_each(&iter) == subscriber)
+			return BOOL_TRUE;
+	}
+	if (!faux_list_add(flight->subscribers, subscriber))
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+bool_t kflight_leave(kflight_t *flight, const void *subscriber)
+{
+	faux_list_node_t *iter = NULL;
+	faux_list_node_t *node = NULL;
+
+	assert(flight);
+	if (!flight)
+		return BOOL_FALSE;
+
+	iter = faux_list_head(flight->subscribers);
+	while ((node = iter)) {
+		if (faux_list_each(&iter) == subscriber) {
+			faux_list_del(flight->subscribers, node);
+			return BOOL_TRUE;
+		}
+	}
+
+	return BOOL_FALSE;
+}
+
+
+size_t kflight_subscribers_len(const kflight_t *flight)
+{
+	assert(flight);
+	if (!flight)
+		return 0;
+
+	return faux_list_len(flight->subscribers);
+}
+
+
+faux_list_node_t *kflight_subscribers_iter(const kflight_t *flight)
+{
+	assert(flight);
+	if (!flight)
+		return NULL;
+
+	return faux_list_head(flight->subscribers);
+}
+
+
+void *kflight_subscribers_each(faux_list_node_t **iter)
+{
+	return faux_list_each(iter);
+}
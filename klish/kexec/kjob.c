@@ -0,0 +1,503 @@
+/** @file kjob.c
+ *
+ * @brief Background jobs and their output spools
+ *
+ * The spool is a ring within memfd. The memfd is used instead of heap
+ * because the spool can be large and the pages of memory file are not
+ * accounted to the daemon's heap fragmentation. The ring is allocated
+ * lazily by the file's size growing.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#include <faux/str.h>
+#include <faux/list.h>
+#include <klish/kjob.h>
+
+#include "private.h"
+
+
+static int kjob_compare(const void *first, const void *second)
+{
+	const kjob_t *f = (const kjob_t *)first;
+	const kjob_t *s = (const kjob_t *)second;
+
+	if (f->id == s->id)
+		return 0;
+
+	return (f->id < s->id) ? -1 : 1;
+}
+
+
+static int kjob_kcompare(const void *key, const void *list_item)
+{
+	uint32_t id = *(const uint32_t *)key;
+	const kjob_t *job = (const kjob_t *)list_item;
+
+	if (id == job->id)
+		return 0;
+
+	return (id < job->id) ? -1 : 1;
+}
+
+
+static void kjob_free(void *data)
+{
+	kjob_t *job = (kjob_t *)data;
+
+	if (!job)
+		return;
+
+	faux_list_free(job->watchers);
+	kexec_free(job->exec);
+	if (job->spool_fd >= 0)
+		close(job->spool_fd);
+	faux_str_free(job->line);
+	faux_str_free(job->user);
+	faux_free(job);
+}
+
+
+/** @brief Creates registry of background jobs
+ *
+ * @param [in] spool_max Size of each job's output spool. 0 - default.
+ * @param [in] max_per_user Number of jobs (running or not fetched) per
+ * user. 0 - unlimited.
+ */
+kjobs_t *kjobs_new(size_t spool_max, unsigned int max_per_user)
+{
+	kjobs_t *jobs = NULL;
+
+	jobs = faux_zmalloc(sizeof(*jobs));
+	assert(jobs);
+	if (!jobs)
+		return NULL;
+
+	// Initialize
+	jobs->spool_max = spool_max ? spool_max : KJOB_SPOOL_MAX;
+	jobs->max_per_user = max_per_user;
+	jobs->next_id = 1;
+	jobs->list = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		kjob_compare, kjob_kcompare, kjob_free);
+	assert(jobs->list);
+
+	return jobs;
+}
+
+
+void kjobs_free(kjobs_t *jobs)
+{
+	if (!jobs)
+		return;
+
+	faux_list_free(jobs->list);
+	faux_free(jobs);
+}
+
+
+static unsigned int kjobs_user_num(const kjobs_t *jobs, const char *user)
+{
+	faux_list_node_t *iter = NULL;
+	kjob_t *job = NULL;
+	unsigned int num = 0;
+
+	iter = faux_list_head(jobs->list);
+	while ((job = (kjob_t *)faux_list_each(&iter))) {
+		if (faux_str_cmp(job->user, user) == 0)
+			num++;
+	}
+
+	return num;
+}
+
+
+/** @brief Registers new background job
+ *
+ * The job takes ownership of exec on success.
+ *
+ * @param [in] jobs Registry.
+ * @param [in] user Owner of job.
+ * @param [in] line Command line for listing.
+ * @param [in] exec Process. It's not started yet usually.
+ * @return New job or NULL if user has too many jobs or memfd can't be
+ * created.
+ */
+kjob_t *kjobs_add(kjobs_t *jobs, const char *user, const char *line,
+	kexec_t *exec)
+{
+	kjob_t *job = NULL;
+
+	assert(jobs);
+	if (!jobs)
+		return NULL;
+	assert(exec);
+	if (!exec)
+		return NULL;
+
+	if ((jobs->max_per_user > 0) &&
+		(kjobs_user_num(jobs, user) >= jobs->max_per_user))
+		return NULL;
+
+	job = faux_zmalloc(sizeof(*job));
+	assert(job);
+	if (!job)
+		return NULL;
+	job->spool_fd = memfd_create("kjob", MFD_CLOEXEC);
+	if (job->spool_fd < 0) {
+		faux_free(job);
+		return NULL;
+	}
+	job->user = faux_str_dup(user);
+	job->line = faux_str_dup(line);
+	job->spool_max = jobs->spool_max;
+	job->spooled = 0;
+	job->watchers = faux_list_new(FAUX_LIST_UNSORTED, FAUX_LIST_NONUNIQUE,
+		NULL, NULL, NULL);
+	assert(job->watchers);
+
+	// The 0 is not a valid identifier
+	do {
+		job->id = jobs->next_id++;
+		if (0 == jobs->next_id)
+			jobs->next_id = 1;
+	} while (kjobs_find(jobs, job->id));
+	if (!faux_list_add(jobs->list, job)) {
+		kjob_free(job);
+		return NULL;
+	}
+	job->exec = exec;
+
+	return job;
+}
+
+
+/** @brief Removes job and frees it
+ *
+ * The process is killed if it's still running. The caller must remove the
+ * process from execution queue before.
+ */
+void kjobs_del(kjobs_t *jobs, kjob_t *job)
+{
+	faux_list_node_t *node = NULL;
+
+	assert(jobs);
+	if (!jobs)
+		return;
+	if (!job)
+		return;
+
+	node = faux_list_kfind_node(jobs->list, &job->id);
+	if (node)
+		faux_list_del(jobs->list, node);
+}
+
+
+kjob_t *kjobs_find(const kjobs_t *jobs, uint32_t id)
+{
+	assert(jobs);
+	if (!jobs)
+		return NULL;
+
+	return (kjob_t *)faux_list_kfind(jobs->list, &id);
+}
+
+
+kjob_t *kjobs_find_by_exec(const kjobs_t *jobs, const kexec_t *exec)
+{
+	faux_list_node_t *iter = NULL;
+	kjob_t *job = NULL;
+
+	assert(jobs);
+	if (!jobs)
+		return NULL;
+
+	iter = faux_list_head(jobs->list);
+	while ((job = (kjob_t *)faux_list_each(&iter))) {
+		if (job->exec == exec)
+			return job;
+	}
+
+	return NULL;
+}
+
+
+size_t kjobs_len(const kjobs_t *jobs)
+{
+	assert(jobs);
+	if (!jobs)
+		return 0;
+
+	return faux_list_len(jobs->list);
+}
+
+
+faux_list_node_t *kjobs_iter(const kjobs_t *jobs)
+{
+	assert(jobs);
+	if (!jobs)
+		return NULL;
+
+	return faux_list_head(jobs->list);
+}
+
+
+kjob_t *kjobs_each(faux_list_node_t **iter)
+{
+	return (kjob_t *)faux_list_each(iter);
+}
+
+
+/** @brief Detaches gone session from all the jobs
+ */
+void kjobs_detach_all(kjobs_t *jobs, const void *watcher)
+{
+	faux_list_node_t *iter = NULL;
+	kjob_t *job = NULL;
+
+	assert(jobs);
+	if (!jobs)
+		return;
+
+	iter = faux_list_head(jobs->list);
+	while ((job = (kjob_t *)faux_list_each(&iter)))
+		kjob_detach(job, watcher);
+}
+
+
+uint32_t kjob_id(const kjob_t *job)
+{
+	assert(job);
+	if (!job)
+		return 0;
+
+	return job->id;
+}
+
+
+const char *kjob_user(const kjob_t *job)
+{
+	assert(job);
+	if (!job)
+		return NULL;
+
+	return job->user;
+}
+
+
+const char *kjob_line(const kjob_t *job)
+{
+	assert(job);
+	if (!job)
+		return NULL;
+
+	return job->line;
+}
+
+
+kexec_t *kjob_exec(const kjob_t *job)
+{
+	assert(job);
+	if (!job)
+		return NULL;
+
+	return job->exec;
+}
+
+
+bool_t kjob_finished(const kjob_t *job)
+{
+	assert(job);
+	if (!job)
+		return BOOL_FALSE;
+
+	return (kexec_state(job->exec) == KEXEC_STATE_DONE) ?
+		BOOL_TRUE : BOOL_FALSE;
+}
+
+
+/** @brief Gets total number of bytes the job has written
+ */
+uint64_t kjob_spooled(const kjob_t *job)
+{
+	assert(job);
+	if (!job)
+		return 0;
+
+	return job->spooled;
+}
+
+
+/** @brief Gets offset of the oldest byte kept within spool
+ */
+uint64_t kjob_spool_start(const kjob_t *job)
+{
+	assert(job);
+	if (!job)
+		return 0;
+
+	if (job->spooled <= job->spool_max)
+		return 0;
+
+	return job->spooled - job->spool_max;
+}
+
+
+/** @brief Appends job's output to spool
+ *
+ * The oldest data is overwritten when spool is full.
+ *
+ * @return Number of bytes consumed or -1 on error.
+ */
+ssize_t kjob_spool(kjob_t *job, const void *data, size_t len)
+{
+	const char *p = (const char *)data;
+	size_t left = len;
+
+	assert(job);
+	if (!job)
+		return -1;
+	if (!data)
+		return -1;
+
+	// Only the tail fits the spool
+	if (left > job->spool_max) {
+		job->spooled += left - job->spool_max;
+		p += left - job->spool_max;
+		left = job->spool_max;
+	}
+	while (left > 0) {
+		off_t pos = (off_t)(job->spooled % job->spool_max);
+		size_t chunk = job->spool_max - (size_t)pos;
+		ssize_t r = 0;
+		if (chunk > left)
+			chunk = left;
+		r = pwrite(job->spool_fd, p, chunk, pos);
+		if (r < 0) {
+			if (EINTR == errno)
+				continue;
+			return -1;
+		}
+		p += r;
+		left -= r;
+		job->spooled += r;
+	}
+
+	return len;
+}
+
+
+/** @brief Reads job's output from spool
+ *
+ * @param [in] job Job.
+ * @param [in,out] offset Absolute offset to read from. It's moved forward
+ * to the oldest kept byte if data is lost and then by the number of read
+ * bytes.
+ * @param [out] buf Buffer.
+ * @param [in] len Size of buffer.
+ * @return Number of read bytes, 0 if there is no more data or -1 on error.
+ */
+ssize_t kjob_read(const kjob_t *job, uint64_t *offset, void *buf,
+	size_t len)
+{
+	uint64_t start = 0;
+	off_t pos = 0;
+	size_t chunk = 0;
+	ssize_t r = 0;
+
+	assert(job);
+	if (!job)
+		return -1;
+	if (!offset || !buf)
+		return -1;
+
+	start = kjob_spool_start(job);
+	if (*offset < start)
+		*offset = start;
+	if (*offset >= job->spooled)
+		return 0;
+
+	pos = (off_t)(*offset % job->spool_max);
+	chunk = job->spool_max - (size_t)pos;
+	if (chunk > job->spooled - *offset)
+		chunk = (size_t)(job->spooled - *offset);
+	if (chunk > len)
+		chunk = len;
+	do {
+		r = pread(job->spool_fd, buf, chunk, pos);
+	} while ((r < 0) && (EINTR == errno));
+	if (r > 0)
+		*offset += r;
+
+	return r;
+}
+
+
+/** @brief Attaches session to stream job's live output
+ */
+bool_t kjob_attach(kjob_t *job, void *watcher)
+{
+	faux_list_node_t *iter = NULL;
+
+	assert(job);
+	if (!job)
+		return BOOL_FALSE;
+	assert(watcher);
+	if (!watcher)
+		return BOOL_FALSE;
+
+	iter = faux_list_head(job->watchers);
+	while (iter) {
+		if (faux_list_each(&iter) == watcher)
+			return BOOL_TRUE;
+	}
+	if (!faux_list_add(job->watchers, watcher))
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+bool_t kjob_detach(kjob_t *job, const void *watcher)
+{
+	faux_list_node_t *iter = NULL;
+	faux_list_node_t *node = NULL;
+
+	assert(job);
+	if (!job)
+		return BOOL_FALSE;
+
+	iter = faux_list_head(job->watchers);
+	while ((node = iter)) {
+		if (faux_list_each(&iter) == watcher) {
+			faux_list_del(job->watchers, node);
+			return BOOL_TRUE;
+		}
+	}
+
+	return BOOL_FALSE;
+}
+
+
+faux_list_node_t *kjob_watchers_iter(const kjob_t *job)
+{
+	assert(job);
+	if (!job)
+		return NULL;
+
+	return faux_list_head(job->watchers);
+}
+
+
+void *kjob_watchers_each(faux_list_node_t **iter)
+{
+	return faux_list_each(iter);
+}
@@ -0,0 +1,334 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+
+#include <faux/list.h>
+#include <klish/kpty.h>
+
+#include "private.h"
+
+
+static void kpty_free(void *data)
+{
+	kpty_t *pty = (kpty_t *)data;
+
+	if (!pty)
+		return;
+
+	if (pty->master >= 0)
+		close(pty->master);
+	if (pty->slave >= 0)
+		close(pty->slave);
+	if (pty->err_rd >= 0)
+		close(pty->err_rd);
+	if (pty->err_wr >= 0)
+		close(pty->err_wr);
+	faux_free(pty);
+}
+
+
+/** @brief Sets terminal settings and window size of pool
+ */
+static bool_t kpty_configure(const kpty_pool_t *pool, kpty_t *pty)
+{
+	if (tcsetattr(pty->slave, TCSANOW, &pool->termios) < 0)
+		return BOOL_FALSE;
+	if (ioctl(pty->slave, TIOCSWINSZ, &pool->ws) < 0)
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Opens child's ends of pair
+ *
+ * The slave is opened by name of master's terminal. The stderr pipe is
+ * created again because its write end was closed by owner.
+ */
+static bool_t kpty_open_child_ends(kpty_t *pty)
+{
+	char name[64];
+	int err[2] = { -1, -1 };
+
+	if (pty->slave < 0) {
+		if (ptsname_r(pty->master, name, sizeof(name)) != 0)
+			return BOOL_FALSE;
+		pty->slave = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+		if (pty->slave < 0)
+			return BOOL_FALSE;
+	}
+	if (pty->err_wr < 0) {
+		if (pipe2(err, O_CLOEXEC) < 0)
+			return BOOL_FALSE;
+		if (pty->err_rd >= 0)
+			close(pty->err_rd);
+		pty->err_rd = err[0];
+		pty->err_wr = err[1];
+		fcntl(pty->err_rd, F_SETFL, O_NONBLOCK);
+	}
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Creates pseudo-terminal and stderr pipe
+ *
+ * The daemon's ends are non-blocking. All descriptors are close-on-exec.
+ * The child gets them by dup2().
+ */
+static kpty_t *kpty_new(kpty_pool_t *pool)
+{
+	kpty_t *pty = NULL;
+
+	pty = faux_zmalloc(sizeof(*pty));
+	assert(pty);
+	if (!pty)
+		return NULL;
+	pty->master = -1;
+	pty->slave = -1;
+	pty->err_rd = -1;
+	pty->err_wr = -1;
+
+	pty->master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC | O_NONBLOCK);
+	if (pty->master < 0)
+		goto err;
+	if ((grantpt(pty->master) < 0) || (unlockpt(pty->master) < 0))
+		goto err;
+	if (!kpty_open_child_ends(pty))
+		goto err;
+
+	// The settings of the first terminal are the reference ones
+	if (!pool->termios_valid) {
+		if (tcgetattr(pty->slave, &pool->termios) < 0)
+			goto err;
+		pool->termios_valid = BOOL_TRUE;
+	}
+	if (!kpty_configure(pool, pty))
+		goto err;
+
+	return pty;
+
+err:
+	kpty_free(pty);
+
+	return NULL;
+}
+
+
+/** @brief Creates pool and fills it with ready pseudo-terminals
+ *
+ * @param [in] size Number of pairs to keep ready.
+ * @param [in] cols Window width. 0 - default.
+ * @param [in] rows Window height. 0 - default.
+ * @return Allocated pool or NULL on error.
+ */
+kpty_pool_t *kpty_pool_new(size_t size, unsigned short cols,
+	unsigned short rows)
+{
+	kpty_pool_t *pool = NULL;
+	size_t i = 0;
+
+	pool = faux_zmalloc(sizeof(*pool));
+	assert(pool);
+	if (!pool)
+		return NULL;
+
+	// Initialize
+	pool->size = size;
+	pool->termios_valid = BOOL_FALSE;
+	pool->ws.ws_col = cols ? cols : KPTY_COLS;
+	pool->ws.ws_row = rows ? rows : KPTY_ROWS;
+	pool->ptys = faux_list_new(FAUX_LIST_UNSORTED, FAUX_LIST_NONUNIQUE,
+		NULL, NULL, kpty_free);
+	assert(pool->ptys);
+
+	for (i = 0; i < size; i++) {
+		kpty_t *pty = kpty_new(pool);
+		if (!pty) {
+			kpty_pool_free(pool);
+			return NULL;
+		}
+		faux_list_add(pool->ptys, pty);
+	}
+
+	return pool;
+}
+
+
+void kpty_pool_free(kpty_pool_t *pool)
+{
+	if (!pool)
+		return;
+
+	faux_list_free(pool->ptys);
+	faux_free(pool);
+}
+
+
+size_t kpty_pool_size(const kpty_pool_t *pool)
+{
+	assert(pool);
+	if (!pool)
+		return 0;
+
+	return pool->size;
+}
+
+
+/** @brief Gets number of ready pairs within pool
+ */
+size_t kpty_pool_len(const kpty_pool_t *pool)
+{
+	assert(pool);
+	if (!pool)
+		return 0;
+
+	return faux_list_len(pool->ptys);
+}
+
+
+/** @brief Gets ready pair from pool
+ *
+ * The new pair is created if pool is empty.
+ */
+kpty_t *kpty_pool_get(kpty_pool_t *pool)
+{
+	faux_list_node_t *node = NULL;
+
+	assert(pool);
+	if (!pool)
+		return NULL;
+
+	node = faux_list_head(pool->ptys);
+	if (node)
+		return (kpty_t *)faux_list_takeaway(pool->ptys, node);
+
+	return kpty_new(pool);
+}
+
+
+/** @brief Discards unread data of descriptor
+ */
+static void kpty_drain(int fd)
+{
+	char buf[4096];
+
+	while (read(fd, buf, sizeof(buf)) > 0);
+}
+
+
+/** @brief Closes child's ends of pair within owner
+ *
+ * It's called by owner after fork(). So reading of master gets EOF (EIO
+ * for terminal) and reading of stderr gets EOF when the process and its
+ * descendants are gone.
+ */
+void kpty_close_child_ends(kpty_t *pty)
+{
+	assert(pty);
+	if (!pty)
+		return;
+
+	if (pty->slave >= 0) {
+		close(pty->slave);
+		pty->slave = -1;
+	}
+	if (pty->err_wr >= 0) {
+		close(pty->err_wr);
+		pty->err_wr = -1;
+	}
+}
+
+
+/** @brief Returns pair to pool
+ *
+ * The process group that used terminal gets hangup. The pair is closed if
+ * any process of group is still alive because it can write to terminal.
+ * So the next command never gets somebody else's output. The child's ends
+ * closed by owner are opened again.
+ *
+ * @param [in] pool Pool.
+ * @param [in] pty Pair to recycle.
+ * @param [in] pgid Process group that used pair. The <= 0 if pair was not
+ * used.
+ */
+void kpty_pool_put(kpty_pool_t *pool, kpty_t *pty, pid_t pgid)
+{
+	assert(pool);
+	if (!pool)
+		return;
+	if (!pty)
+		return;
+
+	if (pgid > 0) {
+		kill(-pgid, SIGHUP);
+		if ((kill(-pgid, 0) == 0) || (errno != ESRCH))
+			goto close;
+	}
+	if (faux_list_len(pool->ptys) >= pool->size)
+		goto close;
+
+	if (!kpty_open_child_ends(pty))
+		goto close;
+	if (tcflush(pty->slave, TCIOFLUSH) < 0)
+		goto close;
+	kpty_drain(pty->master);
+	kpty_drain(pty->err_rd);
+	if (!kpty_configure(pool, pty))
+		goto close;
+	faux_list_add(pool->ptys, pty);
+
+	return;
+
+close:
+	kpty_free(pty);
+}
+
+
+int kpty_master(const kpty_t *pty)
+{
+	assert(pty);
+	if (!pty)
+		return -1;
+
+	return pty->master;
+}
+
+
+int kpty_slave(const kpty_t *pty)
+{
+	assert(pty);
+	if (!pty)
+		return -1;
+
+	return pty->slave;
+}
+
+
+int kpty_stderr_rd(const kpty_t *pty)
+{
+	assert(pty);
+	if (!pty)
+		return -1;
+
+	return pty->err_rd;
+}
+
+
+int kpty_stderr_wr(const kpty_t *pty)
+{
+	assert(pty);
+	if (!pty)
+		return -1;
+
+	return pty->err_wr;
+}
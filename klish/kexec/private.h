@@ -0,0 +1,185 @@
+#ifndef _klish_kexec_private_h
+#define _klish_kexec_private_h
+
+#include <stdint.h>
+#include <time.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+#include <faux/list.h>
+#include <faux/eloop.h>
+#include <klish/kexec.h>
+#include <klish/kexecq.h>
+#include <klish/kpty.h>
+#include <klish/kjob.h>
+#include <klish/kbatch.h>
+#include <klish/kcache.h>
+#include <klish/kflight.h>
+
+#define KEXEC_SHEBANG "/bin/sh"
+// Child's descriptor of structured records. The string is for environment.
+#define KEXEC_RECORD_FD 3
+#define KEXEC_RECORD_FD_STR "3"
+// Child's descriptor of batched commands' results
+#define KEXEC_RESULT_FD 4
+#define KEXEC_RESULT_FD_STR "4"
+
+
+struct kexec_s {
+	kexec_limits_t limits;
+	char *script;
+	char *shebang;
+	bool_t interactive; // Needs terminal
+	bool_t records; // Writes structured records
+	kexec_state_e state;
+	pid_t pid;
+	kpty_pool_t *pty_pool; // Pool to get pseudo-terminal from
+	kpty_t *pty; // Owned by pool. The fd_* are its descriptors then.
+	int fd_in; // Parent's ends of pipes
+	int fd_out;
+	int fd_err;
+	int fd_rec; // Structured records
+	int fd_input; // File to use as stdin instead of pipe
+	int fd_result; // File to write batched commands' results to
+	faux_list_t *env; // "name=value" strings to add to environment
+	faux_eloop_t *eloop; // The loop the timers are scheduled within
+	bool_t timed_out;
+	int status; // Status from waitpid()
+	struct timespec queued; // Monotonic time of enqueueing
+	struct timespec started; // Monotonic time of start
+	char *cgroup; // Path of process's own cgroup
+	kexec_usage_t usage;
+};
+
+struct kpty_s {
+	int master;
+	int slave; // Closed by owner while process is running
+	int err_rd;
+	int err_wr;
+};
+
+struct kpty_pool_s {
+	size_t size;
+	struct termios termios; // Settings to restore on recycling
+	bool_t termios_valid;
+	struct winsize ws;
+	faux_list_t *ptys; // Ready pairs
+};
+
+// Cgroups
+bool_t kcgroup_create(kexec_t *exec);
+bool_t kcgroup_join(const kexec_t *exec);
+void kcgroup_collect(kexec_t *exec);
+void kcgroup_remove(kexec_t *exec);
+
+
+// The virtual time of session is advanced by KEXECQ_STRIDE / weight
+// on each dispatched process.
+#define KEXECQ_STRIDE 0x10000
+
+typedef struct kexecq_user_s kexecq_user_t;
+
+typedef struct {
+	const void *owner;
+	kexecq_user_t *user;
+	unsigned int weight;
+	uint64_t vtime;
+	faux_list_t *pending; // FIFO of kexec_t
+} kexecq_session_t;
+
+struct kexecq_user_s {
+	char *name;
+	uint64_t vtime;
+	uint64_t vclock; // Virtual time of the last dispatched session
+	unsigned int running;
+	size_t active; // Number of sessions with pending processes
+	faux_list_t *sessions; // Doesn't own sessions
+};
+
+typedef struct {
+	kexec_t *exec;
+	kexecq_user_t *user; // Outlives deleted session
+} kexecq_job_t;
+
+struct kexecq_s {
+	unsigned int max_running; // 0 - unlimited
+	unsigned int max_per_user; // 0 - unlimited
+	uint64_t vclock; // Virtual time of the last dispatched user
+	size_t pending;
+	faux_list_t *users; // Sorted by name
+	faux_list_t *sessions; // Sorted by owner
+	faux_list_t *running; // Dispatched jobs
+};
+
+struct kjob_s {
+	uint32_t id;
+	char *user;
+	char *line; // Command line
+	kexec_t *exec;
+	int spool_fd; // The memfd
+	size_t spool_max;
+	uint64_t spooled; // Total number of bytes ever written
+	faux_list_t *watchers; // Attached sessions. Doesn't own them.
+};
+
+typedef struct {
+	char *line;
+	void *udata;
+	int retcode;
+} kbatch_entry_t;
+
+struct kbatch_s {
+	const kaction_t *action; // The first command's ACTION
+	size_t max;
+	faux_list_t *entries; // FIFO of kbatch_entry_t
+	kexec_t *exec;
+	int fd_result; // Results written by process
+};
+
+struct kjobs_s {
+	size_t spool_max;
+	unsigned int max_per_user; // 0 - unlimited
+	uint32_t next_id;
+	faux_list_t *list; // Sorted by id
+};
+
+struct kcache_entry_s {
+	char *key;
+	uint32_t hash;
+	unsigned int ttl;
+	size_t size_max; // Entry is oversized when it exceeds this size
+	bool_t oversized;
+	struct timespec created; // Monotonic time of putting into cache
+	int retcode;
+	char *out;
+	size_t out_len;
+	char *err;
+	size_t err_len;
+	kcache_entry_t *hnext; // Hash chain
+	kcache_entry_t *prev; // LRU list. The head is the most recent.
+	kcache_entry_t *next;
+};
+
+struct kcache_s {
+	size_t size_max;
+	size_t size;
+	size_t len;
+	kcache_entry_t **buckets;
+	size_t buckets_num; // Power of two
+	kcache_entry_t *head;
+	kcache_entry_t *tail;
+};
+
+struct kflight_s {
+	char *key;
+	kexec_t *exec;
+	kcache_entry_t *entry; // Collected output
+	faux_list_t *subscribers; // Doesn't own them
+};
+
+struct kflights_s {
+	size_t entry_max;
+	faux_list_t *list; // Sorted by key
+};
+
+#endif // _klish_kexec_private_h
@@ -0,0 +1,378 @@
+/*
+ * testc.c
+ *
+ * Tests of kexec module. The queue is checked without running processes:
+ * the popped process is marked as finished at once. The cache is checked
+ * by entries filled by hand.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "klish/kaction.h"
+#include "klish/kexec.h"
+#include "klish/kexecq.h"
+#include "klish/kcache.h"
+
+#define TESTC_EXECS 12
+
+/*-------------------------------------------------------- */
+/*
+ * Push specified number of processes for session. The processes are
+ * stored to array to identify the popped ones.
+ */
+static int testc_kexecq_push(kexecq_t *queue, const void *session,
+	const kaction_t *action, kexec_t **execs, unsigned int num)
+{
+	unsigned int i = 0;
+
+	for (i = 0; i < num; i++) {
+		execs[i] = kexec_new(action, NULL);
+		if (!execs[i]) {
+			printf("Can't create kexec\n");
+			return -1;
+		}
+		if (!kexecq_push(queue, session, execs[i])) {
+			printf("Can't push kexec %u\n", i);
+			kexec_free(execs[i]);
+			execs[i] = NULL;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*-------------------------------------------------------- */
+static int testc_kexecq_owner(kexec_t *exec, kexec_t **execs)
+{
+	unsigned int i = 0;
+
+	for (i = 0; i < TESTC_EXECS; i++) {
+		if (execs[i] == exec)
+			return 1;
+	}
+
+	return 0;
+}
+
+/*-------------------------------------------------------- */
+static void testc_kexecq_free(kexec_t **execs)
+{
+	unsigned int i = 0;
+
+	for (i = 0; i < TESTC_EXECS; i++)
+		kexec_free(execs[i]);
+}
+
+/*-------------------------------------------------------- */
+/*
+ * The user can't get more slots by opening more sessions. The user with
+ * three sessions and the user with single one alternate.
+ */
+int testc_kexecq_users(void)
+{
+	kexecq_t *queue = NULL;
+	kaction_t *action = NULL;
+	int session[4] = {};
+	kexec_t *alice[3][TESTC_EXECS] = {};
+	kexec_t *bob[TESTC_EXECS] = {};
+	unsigned int i = 0;
+	int retval = -1;
+
+	queue = kexecq_new(1, 0);
+	action = kaction_new();
+	kaction_set_script(action, "true");
+	for (i = 0; i < 3; i++) {
+		kexecq_add_session(queue, &session[i], "alice", 1);
+		if (testc_kexecq_push(queue, &session[i], action,
+			alice[i], 4) < 0)
+			goto out;
+	}
+	kexecq_add_session(queue, &session[3], "bob", 1);
+	if (testc_kexecq_push(queue, &session[3], action, bob, 4) < 0)
+		goto out;
+
+	for (i = 0; i < 8; i++) {
+		kexec_t *exec = kexecq_pop(queue);
+		int is_bob = 0;
+		if (!exec) {
+			printf("Pop %u: nothing\n", i);
+			goto out;
+		}
+		if (kexecq_pop(queue)) {
+			printf("Pop %u: limit of running is exceeded\n", i);
+			goto out;
+		}
+		is_bob = testc_kexecq_owner(exec, bob);
+		if (is_bob != (int)(i % 2)) {
+			printf("Pop %u: %s got slot out of turn\n",
+				i, is_bob ? "bob" : "alice");
+			goto out;
+		}
+		kexecq_done(queue, exec);
+	}
+	if (kexecq_pending(queue) != 8) {
+		printf("Pending %zu instead of 8\n", kexecq_pending(queue));
+		goto out;
+	}
+	retval = 0;
+
+out:
+	kexecq_free(queue);
+	for (i = 0; i < 3; i++)
+		testc_kexecq_free(alice[i]);
+	testc_kexecq_free(bob);
+	kaction_free(action);
+
+	return retval;
+}
+
+/*-------------------------------------------------------- */
+/*
+ * The sessions of the same user share slots in proportion to their
+ * weights.
+ */
+int testc_kexecq_weights(void)
+{
+	kexecq_t *queue = NULL;
+	kaction_t *action = NULL;
+	int session[2] = {};
+	kexec_t *interactive[TESTC_EXECS] = {};
+	kexec_t *batch[TESTC_EXECS] = {};
+	unsigned int i = 0;
+	unsigned int num = 0;
+	int retval = -1;
+
+	queue = kexecq_new(1, 0);
+	action = kaction_new();
+	kaction_set_script(action, "true");
+	kexecq_add_session(queue, &session[0], "alice",
+		KEXECQ_WEIGHT_INTERACTIVE);
+	kexecq_add_session(queue, &session[1], "alice",
+		KEXECQ_WEIGHT_BATCH);
+	if (testc_kexecq_push(queue, &session[0], action,
+		interactive, TESTC_EXECS) < 0)
+		goto out;
+	if (testc_kexecq_push(queue, &session[1], action,
+		batch, TESTC_EXECS) < 0)
+		goto out;
+
+	for (i = 0; i < 10; i++) {
+		kexec_t *exec = kexecq_pop(queue);
+		if (!exec) {
+			printf("Pop %u: nothing\n", i);
+			goto out;
+		}
+		num += testc_kexecq_owner(exec, interactive);
+		kexecq_done(queue, exec);
+	}
+	if (num != 10 * KEXECQ_WEIGHT_INTERACTIVE /
+		(KEXECQ_WEIGHT_INTERACTIVE + KEXECQ_WEIGHT_BATCH)) {
+		printf("Interactive session got %u slots of 10\n", num);
+		goto out;
+	}
+	retval = 0;
+
+out:
+	kexecq_free(queue);
+	testc_kexecq_free(interactive);
+	testc_kexecq_free(batch);
+	kaction_free(action);
+
+	return retval;
+}
+
+/*-------------------------------------------------------- */
+/*
+ * The user's limit of running processes leaves the slots to others.
+ */
+int testc_kexecq_per_user(void)
+{
+	kexecq_t *queue = NULL;
+	kaction_t *action = NULL;
+	int session[2] = {};
+	kexec_t *alice[TESTC_EXECS] = {};
+	kexec_t *bob[TESTC_EXECS] = {};
+	kexec_t *exec = NULL;
+	unsigned int i = 0;
+	int retval = -1;
+
+	queue = kexecq_new(0, 2);
+	action = kaction_new();
+	kaction_set_script(action, "true");
+	kexecq_add_session(queue, &session[0], "alice", 1);
+	kexecq_add_session(queue, &session[1], "bob", 1);
+	if (testc_kexecq_push(queue, &session[0], action, alice, 3) < 0)
+		goto out;
+
+	for (i = 0; i < 2; i++) {
+		if (!kexecq_pop(queue)) {
+			printf("Pop %u: nothing\n", i);
+			goto out;
+		}
+	}
+	if (kexecq_pop(queue)) {
+		printf("Limit per user is exceeded\n");
+		goto out;
+	}
+	if (testc_kexecq_push(queue, &session[1], action, bob, 1) < 0)
+		goto out;
+	exec = kexecq_pop(queue);
+	if (!exec || !testc_kexecq_owner(exec, bob)) {
+		printf("Another user doesn't get slot\n");
+		goto out;
+	}
+	if (kexecq_running(queue) != 3) {
+		printf("Running %zu instead of 3\n", kexecq_running(queue));
+		goto out;
+	}
+	retval = 0;
+
+out:
+	kexecq_free(queue);
+	testc_kexecq_free(alice);
+	testc_kexecq_free(bob);
+	kaction_free(action);
+
+	return retval;
+}
+
+/*-------------------------------------------------------- */
+/*
+ * Create entry with output of fixed length so the all entries have the
+ * same size.
+ */
+static kcache_entry_t *testc_kcache_entry(const char *key, unsigned int ttl)
+{
+	kcache_entry_t *entry = NULL;
+	char out[100];
+
+	memset(out, 'x', sizeof(out));
+	entry = kcache_entry_new(key, ttl, KCACHE_SIZE);
+	kcache_entry_add_stdout(entry, out, sizeof(out));
+	kcache_entry_add_stderr(entry, key, strlen(key));
+
+	return entry;
+}
+
+/*-------------------------------------------------------- */
+/*
+ * The cache holds two entries. The least recently used one is evicted by
+ * the third entry. The access makes entry the most recently used one.
+ */
+int testc_kcache_evict(void)
+{
+	kcache_t *cache = NULL;
+	const kcache_entry_t *entry = NULL;
+	kcache_entry_t *huge = NULL;
+	char *buf = NULL;
+	size_t size = 0;
+	int retval = -1;
+
+	// Size of single entry
+	cache = kcache_new(0);
+	kcache_put(cache, testc_kcache_entry("a", 60), 0);
+	size = kcache_size(cache);
+	kcache_free(cache);
+
+	cache = kcache_new(size * 2 + size / 2);
+	kcache_put(cache, testc_kcache_entry("a", 60), 1);
+	kcache_put(cache, testc_kcache_entry("b", 60), 2);
+	if (!kcache_get(cache, "a")) {
+		printf("Entry a is not found\n");
+		goto out;
+	}
+	kcache_put(cache, testc_kcache_entry("c", 60), 3);
+
+	if (kcache_get(cache, "b")) {
+		printf("Least recently used entry is not evicted\n");
+		goto out;
+	}
+	entry = kcache_get(cache, "a");
+	if (!entry || (kcache_entry_retcode(entry) != 1)) {
+		printf("Recently used entry is evicted\n");
+		goto out;
+	}
+	entry = kcache_get(cache, "c");
+	if (!entry || (kcache_entry_retcode(entry) != 3)) {
+		printf("New entry is not found\n");
+		goto out;
+	}
+	if ((kcache_len(cache) != 2) || (kcache_size(cache) != size * 2)) {
+		printf("Cache has %zu entries of %zu bytes\n",
+			kcache_len(cache), kcache_size(cache));
+		goto out;
+	}
+
+	// The entry larger than cache is not cached
+	huge = kcache_entry_new("huge", 60, size);
+	buf = faux_zmalloc(size);
+	if (kcache_entry_add_stdout(huge, buf, size)) {
+		printf("Oversized entry collects output\n");
+		kcache_entry_free(huge);
+		goto out;
+	}
+	if (kcache_put(cache, huge, 0) || (kcache_len(cache) != 2)) {
+		printf("Oversized entry is cached\n");
+		goto out;
+	}
+	retval = 0;
+
+out:
+	faux_free(buf);
+	kcache_free(cache);
+
+	return retval;
+}
+
+/*-------------------------------------------------------- */
+/*
+ * The expired entry is removed on access. The entry with the same key
+ * replaces the old one.
+ */
+int testc_kcache_ttl(void)
+{
+	kcache_t *cache = NULL;
+	const kcache_entry_t *entry = NULL;
+	const char *out = NULL;
+	size_t len = 0;
+	int retval = -1;
+
+	cache = kcache_new(0);
+	kcache_put(cache, testc_kcache_entry("short", 1), 1);
+	kcache_put(cache, testc_kcache_entry("long", 60), 2);
+	kcache_put(cache, testc_kcache_entry("long", 60), 3);
+	if (kcache_len(cache) != 2) {
+		printf("Entry with the same key is not replaced\n");
+		goto out;
+	}
+	entry = kcache_get(cache, "short");
+	out = entry ? kcache_entry_stderr(entry, &len) : NULL;
+	if (!out || (len != strlen("short")) || strncmp(out, "short", len)) {
+		printf("Actual entry is not found\n");
+		goto out;
+	}
+
+	sleep(2);
+	if (kcache_get(cache, "short")) {
+		printf("Expired entry is found\n");
+		goto out;
+	}
+	entry = kcache_get(cache, "long");
+	if (!entry || (kcache_entry_retcode(entry) != 3)) {
+		printf("Actual entry is not found after expiration\n");
+		goto out;
+	}
+	if (kcache_len(cache) != 1) {
+		printf("Expired entry is not removed\n");
+		goto out;
+	}
+	retval = 0;
+
+out:
+	kcache_free(cache);
+
+	return retval;
+}
@@ -0,0 +1,55 @@
+/** @file kexecq.h
+ *
+ * @brief Fair queue of ACTION's processes
+ *
+ * The queue limits the number of concurrently running processes. The
+ * pending processes are queued per session and the sessions are grouped
+ * by user. The dequeueing is weighted fair on both levels. The users share
+ * the slots in proportion to the weights of their active sessions and the
+ * sessions of the same user share them in proportion to their own weights.
+ * So the interactive session with higher weight gets slot earlier than
+ * the batch one and the user can't take over the daemon by opening a lot
+ * of sessions.
+ *
+ * The session is an opaque pointer of owner. The queue doesn't own the
+ * kexec_t objects.
+ */
+
+#ifndef _klish_kexecq_h
+#define _klish_kexecq_h
+
+#include <faux/faux.h>
+#include <klish/kexec.h>
+
+// Default weights of sessions
+#define KEXECQ_WEIGHT_INTERACTIVE 4
+#define KEXECQ_WEIGHT_BATCH 1
+
+typedef struct kexecq_s kexecq_t;
+
+
+C_DECL_BEGIN
+
+kexecq_t *kexecq_new(unsigned int max_running, unsigned int max_per_user);
+void kexecq_free(kexecq_t *queue);
+
+unsigned int kexecq_max_running(const kexecq_t *queue);
+bool_t kexecq_set_max_running(kexecq_t *queue, unsigned int max_running);
+unsigned int kexecq_max_per_user(const kexecq_t *queue);
+bool_t kexecq_set_max_per_user(kexecq_t *queue, unsigned int max_per_user);
+size_t kexecq_running(const kexecq_t *queue);
+size_t kexecq_pending(const kexecq_t *queue);
+
+bool_t kexecq_add_session(kexecq_t *queue, const void *session,
+	const char *user, unsigned int weight);
+bool_t kexecq_del_session(kexecq_t *queue, const void *session);
+
+bool_t kexecq_push(kexecq_t *queue, const void *session, kexec_t *exec);
+bool_t kexecq_remove(kexecq_t *queue, const kexec_t *exec);
+kexec_t *kexecq_pop(kexecq_t *queue);
+kexec_t *kexecq_find(const kexecq_t *queue, pid_t pid);
+bool_t kexecq_done(kexecq_t *queue, kexec_t *exec);
+
+C_DECL_END
+
+#endif // _klish_kexecq_h
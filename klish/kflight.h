@@ -0,0 +1,58 @@
+/** @file kflight.h
+ *
+ * @brief Single-flight execution of identical cacheable commands
+ *
+ * When many sessions run the same cacheable command at once the command
+ * is executed only once. The first request starts the flight. The next
+ * requests with the same cache key join the flight as subscribers while
+ * it's running. The output is read once and fanned out to all the
+ * subscribers. The late subscriber gets the output collected so far and
+ * then the live one. The collected output is put to cache when process is
+ * finished so the later requests are served from cache.
+ *
+ * The flight owns its process so it keeps running when all subscribers are
+ * gone. The flight which output exceeds cache size can't be joined because
+ * the beginning of output is not kept.
+ */
+
+#ifndef _klish_kflight_h
+#define _klish_kflight_h
+
+#include <faux/faux.h>
+#include <faux/list.h>
+#include <klish/kexec.h>
+#include <klish/kcache.h>
+
+typedef struct kflights_s kflights_t;
+typedef struct kflight_s kflight_t;
+
+
+C_DECL_BEGIN
+
+kflights_t *kflights_new(size_t entry_max);
+void kflights_free(kflights_t *flights);
+kflight_t *kflights_add(kflights_t *flights, const char *key,
+	unsigned int ttl, kexec_t *exec);
+void kflights_del(kflights_t *flights, kflight_t *flight);
+kflight_t *kflights_find(const kflights_t *flights, const char *key);
+kflight_t *kflights_find_by_exec(const kflights_t *flights,
+	const kexec_t *exec);
+size_t kflights_len(const kflights_t *flights);
+void kflights_leave_all(kflights_t *flights, const void *subscriber);
+bool_t kflights_done(kflights_t *flights, kflight_t *flight,
+	kcache_t *cache);
+
+const char *kflight_key(const kflight_t *flight);
+kexec_t *kflight_exec(const kflight_t *flight);
+const kcache_entry_t *kflight_entry(const kflight_t *flight);
+bool_t kflight_add_stdout(kflight_t *flight, const char *data, size_t len);
+bool_t kflight_add_stderr(kflight_t *flight, const char *data, size_t len);
+bool_t kflight_join(kflight_t *flight, void *subscriber);
+bool_t kflight_leave(kflight_t *flight, const void *subscriber);
+size_t kflight_subscribers_len(const kflight_t *flight);
+faux_list_node_t *kflight_subscribers_iter(const kflight_t *flight);
+void *kflight_subscribers_each(faux_list_node_t **iter);
+
+C_DECL_END
+
+#endif // _klish_kflight_h
@@ -0,0 +1,69 @@
+/** @file kjob.h
+ *
+ * @brief Background jobs
+ *
+ * The command can be executed in background. The job outlives the
+ * operator's session and its output is spooled to anonymous memory file
+ * (memfd). The spool is size-capped and keeps the tail of output. Any
+ * session of the same user can list the jobs, attach to job to get the
+ * spooled output and then stream the live one, or fetch the final output
+ * and exit code of finished job.
+ *
+ * The offsets of output are absolute. The offset is a number of bytes the
+ * job has ever written so the reader knows how many bytes are lost when
+ * the spool is overflowed.
+ *
+ * The attached sessions are opaque pointers of owner. The registry owns
+ * the jobs and the jobs own their kexec_t objects.
+ */
+
+#ifndef _klish_kjob_h
+#define _klish_kjob_h
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <faux/faux.h>
+#include <faux/list.h>
+#include <klish/kexec.h>
+
+// Default size of job's output spool
+#define KJOB_SPOOL_MAX (1024 * 1024)
+
+typedef struct kjobs_s kjobs_t;
+typedef struct kjob_s kjob_t;
+
+
+C_DECL_BEGIN
+
+kjobs_t *kjobs_new(size_t spool_max, unsigned int max_per_user);
+void kjobs_free(kjobs_t *jobs);
+kjob_t *kjobs_add(kjobs_t *jobs, const char *user, const char *line,
+	kexec_t *exec);
+void kjobs_del(kjobs_t *jobs, kjob_t *job);
+kjob_t *kjobs_find(const kjobs_t *jobs, uint32_t id);
+kjob_t *kjobs_find_by_exec(const kjobs_t *jobs, const kexec_t *exec);
+size_t kjobs_len(const kjobs_t *jobs);
+faux_list_node_t *kjobs_iter(const kjobs_t *jobs);
+kjob_t *kjobs_each(faux_list_node_t **iter);
+void kjobs_detach_all(kjobs_t *jobs, const void *watcher);
+
+uint32_t kjob_id(const kjob_t *job);
+const char *kjob_user(const kjob_t *job);
+const char *kjob_line(const kjob_t *job);
+kexec_t *kjob_exec(const kjob_t *job);
+bool_t kjob_finished(const kjob_t *job);
+uint64_t kjob_spooled(const kjob_t *job);
+uint64_t kjob_spool_start(const kjob_t *job);
+ssize_t kjob_spool(kjob_t *job, const void *data, size_t len);
+ssize_t kjob_read(const kjob_t *job, uint64_t *offset, void *buf,
+	size_t len);
+
+bool_t kjob_attach(kjob_t *job, void *watcher);
+bool_t kjob_detach(kjob_t *job, const void *watcher);
+faux_list_node_t *kjob_watchers_iter(const kjob_t *job);
+void *kjob_watchers_each(faux_list_node_t **iter);
+
+C_DECL_END
+
+#endif // _klish_kjob_h
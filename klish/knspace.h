@@ -0,0 +1,34 @@
+/** @file knspace.h
+ *
+ * @brief Klish scheme's "namespace" entry
+ */
+
+#ifndef _klish_knspace_h
+#define _klish_knspace_h
+
+#include <faux/faux.h>
+
+typedef struct knspace_s knspace_t;
+typedef struct kview_s kview_t;
+
+
+C_DECL_BEGIN
+
+knspace_t *knspace_new(const char *view_ref);
+void knspace_free(knspace_t *nspace);
+
+const char *knspace_view_ref(const knspace_t *nspace);
+kview_t *knspace_view(const knspace_t *nspace);
+void knspace_set_view(knspace_t *nspace, kview_t *view);
+const char *knspace_prefix(const knspace_t *nspace);
+bool_t knspace_set_prefix(knspace_t *nspace, const char *prefix);
+bool_t knspace_inherit(const knspace_t *nspace);
+void knspace_set_inherit(knspace_t *nspace, bool_t inherit);
+bool_t knspace_completion(const knspace_t *nspace);
+void knspace_set_completion(knspace_t *nspace, bool_t completion);
+bool_t knspace_context_help(const knspace_t *nspace);
+void knspace_set_context_help(knspace_t *nspace, bool_t context_help);
+
+C_DECL_END
+
+#endif // _klish_knspace_h
@@ -0,0 +1,51 @@
+/** @file kparam.h
+ *
+ * @brief Klish scheme's "param" entry
+ */
+
+#ifndef _klish_kparam_h
+#define _klish_kparam_h
+
+#include <faux/faux.h>
+#include <faux/list.h>
+#include <klish/kptype.h>
+
+typedef struct kparam_s kparam_t;
+
+typedef enum {
+	KPARAM_MODE_COMMON = 'c',
+	KPARAM_MODE_SWITCH = 's',
+	KPARAM_MODE_SUBCOMMAND = 'b',
+} kparam_mode_e;
+
+
+C_DECL_BEGIN
+
+kparam_t *kparam_new(const char *name, const char *help);
+void kparam_free(kparam_t *param);
+
+const char *kparam_name(const kparam_t *param);
+const char *kparam_help(const kparam_t *param);
+const char *kparam_ptype_ref(const kparam_t *param);
+bool_t kparam_set_ptype_ref(kparam_t *param, const char *ptype_ref);
+kptype_t *kparam_ptype(const kparam_t *param);
+void kparam_set_ptype(kparam_t *param, kptype_t *ptype);
+kparam_mode_e kparam_mode(const kparam_t *param);
+void kparam_set_mode(kparam_t *param, kparam_mode_e mode);
+bool_t kparam_mode_resolve(const char *str, kparam_mode_e *mode);
+bool_t kparam_optional(const kparam_t *param);
+void kparam_set_optional(kparam_t *param, bool_t optional);
+const char *kparam_defval(const kparam_t *param);
+bool_t kparam_set_defval(kparam_t *param, const char *defval);
+const char *kparam_prefix(const kparam_t *param);
+bool_t kparam_set_prefix(kparam_t *param, const char *prefix);
+const char *kparam_value(const kparam_t *param);
+bool_t kparam_set_value(kparam_t *param, const char *value);
+
+// Nested params
+bool_t kparam_add_param(kparam_t *param, kparam_t *nested);
+const faux_list_t *kparam_params(const kparam_t *param);
+
+C_DECL_END
+
+#endif // _klish_kparam_h
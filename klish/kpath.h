@@ -0,0 +1,66 @@
+/** @file kpath.h
+ *
+ * @brief Current path. The dynamic tree of nested views.
+ *
+ * The level 0 is a global view. The level 1 is a starting view. Nested
+ * views are levels 2, 3 and so on. Each level keeps a link to its parent
+ * so "down", "up" and "replace" don't copy anything. The sorted index of
+ * commands available on the level (own view, its namespaces and inherited
+ * lower levels) is built lazily on first search and is reused until the
+ * level is removed from the path. The commands of view's TEMPLATE are
+ * referenced by index the same way as the view's own commands. The map of
+ * hotkeys is resolved the same lazy way.
+ */
+
+#ifndef _klish_kpath_h
+#define _klish_kpath_h
+
+#include <faux/faux.h>
+#include <klish/kview.h>
+#include <klish/kcommand.h>
+
+typedef struct klevel_s klevel_t;
+typedef struct kpath_s kpath_t;
+
+// Flags of indexed command
+#define KLEVEL_CMD_COMPLETION 0x01 // Use command for completion
+#define KLEVEL_CMD_CONTEXT_HELP 0x02 // Use command for context help
+
+/** @brief Indexed command. Result of search within current path.
+ */
+typedef struct klevel_cmd_s {
+	const char *name; // Full name (including namespace prefix)
+	kcommand_t *command;
+	klevel_t *level; // The level the command was found on
+	unsigned int flags;
+} klevel_cmd_t;
+
+
+C_DECL_BEGIN
+
+// Level
+kview_t *klevel_view(const klevel_t *level);
+klevel_t *klevel_parent(const klevel_t *level);
+size_t klevel_depth(const klevel_t *level);
+const char *klevel_bind(const klevel_t *level, const char *name);
+const char * const *klevel_hotkeys(klevel_t *level);
+
+// Path
+kpath_t *kpath_new(kview_t *global, kview_t *start);
+void kpath_free(kpath_t *path);
+size_t kpath_depth(const kpath_t *path);
+klevel_t *kpath_current(const kpath_t *path);
+klevel_t *kpath_level(const kpath_t *path, size_t depth);
+bool_t kpath_down(kpath_t *path, kview_t *view);
+bool_t kpath_up(kpath_t *path, size_t num);
+bool_t kpath_replace(kpath_t *path, kview_t *view, size_t depth);
+int kpath_nav(kpath_t *path, const kcommand_t *command);
+
+// Search
+const klevel_cmd_t *kpath_find(kpath_t *path, const char *name);
+const klevel_cmd_t *kpath_find_prefix(kpath_t *path, const char *prefix,
+	size_t *num);
+
+C_DECL_END
+
+#endif // _klish_kpath_h
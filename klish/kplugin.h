@@ -0,0 +1,31 @@
+/** @file kplugin.h
+ *
+ * @brief Klish scheme's "plugin" entry
+ */
+
+#ifndef _klish_kplugin_h
+#define _klish_kplugin_h
+
+#include <faux/faux.h>
+
+typedef struct kplugin_s kplugin_t;
+
+
+C_DECL_BEGIN
+
+kplugin_t *kplugin_new(const char *name);
+void kplugin_free(kplugin_t *plugin);
+
+const char *kplugin_name(const kplugin_t *plugin);
+const char *kplugin_alias(const kplugin_t *plugin);
+bool_t kplugin_set_alias(kplugin_t *plugin, const char *alias);
+const char *kplugin_file(const kplugin_t *plugin);
+bool_t kplugin_set_file(kplugin_t *plugin, const char *file);
+bool_t kplugin_rtld_global(const kplugin_t *plugin);
+void kplugin_set_rtld_global(kplugin_t *plugin, bool_t rtld_global);
+const char *kplugin_conf(const kplugin_t *plugin);
+bool_t kplugin_set_conf(kplugin_t *plugin, const char *conf);
+
+C_DECL_END
+
+#endif // _klish_kplugin_h
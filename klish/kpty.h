@@ -0,0 +1,52 @@
+/** @file kpty.h
+ *
+ * @brief Pool of pseudo-terminals for ACTION's processes
+ *
+ * The process's stdin and stdout are the slave side of pseudo-terminal
+ * and stderr is a pipe. Creating and configuring the pseudo-terminal for
+ * each command costs several syscalls so the daemon keeps a warm pool of
+ * ready pairs. The pair is recycled when the owner is done with process.
+ * The process group gets hangup, the buffers are flushed and the terminal
+ * settings are restored. The pair that is still used by somebody is
+ * closed instead of recycling.
+ *
+ * The owner closes the child's ends of pair after fork() by
+ * kpty_close_child_ends() so reading of master gets EOF (EIO) when the
+ * process is gone. The pool opens them again on recycling.
+ */
+
+#ifndef _klish_kpty_h
+#define _klish_kpty_h
+
+#include <sys/types.h>
+
+#include <faux/faux.h>
+
+// Default window size of pseudo-terminal
+#define KPTY_COLS 80
+#define KPTY_ROWS 24
+
+typedef struct kpty_pool_s kpty_pool_t;
+typedef struct kpty_s kpty_t;
+
+
+C_DECL_BEGIN
+
+kpty_pool_t *kpty_pool_new(size_t size, unsigned short cols,
+	unsigned short rows);
+void kpty_pool_free(kpty_pool_t *pool);
+size_t kpty_pool_size(const kpty_pool_t *pool);
+size_t kpty_pool_len(const kpty_pool_t *pool);
+
+kpty_t *kpty_pool_get(kpty_pool_t *pool);
+void kpty_pool_put(kpty_pool_t *pool, kpty_t *pty, pid_t pgid);
+
+int kpty_master(const kpty_t *pty);
+int kpty_slave(const kpty_t *pty);
+int kpty_stderr_rd(const kpty_t *pty);
+int kpty_stderr_wr(const kpty_t *pty);
+void kpty_close_child_ends(kpty_t *pty);
+
+C_DECL_END
+
+#endif // _klish_kpty_h
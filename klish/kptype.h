@@ -0,0 +1,52 @@
+/** @file kptype.h
+ *
+ * @brief Klish scheme's "ptype" entry
+ */
+
+#ifndef _klish_kptype_h
+#define _klish_kptype_h
+
+#include <faux/faux.h>
+#include <klish/kaction.h>
+
+typedef struct kptype_s kptype_t;
+
+typedef enum {
+	KPTYPE_METHOD_REGEXP = 'r',
+	KPTYPE_METHOD_INTEGER = 'i',
+	KPTYPE_METHOD_UNSIGNEDINTEGER = 'u',
+	KPTYPE_METHOD_SELECT = 's',
+	KPTYPE_METHOD_CHOICE = 'c',
+	KPTYPE_METHOD_SUBCOMMAND = 'b',
+	KPTYPE_METHOD_CODE = 'x',
+} kptype_method_e;
+
+typedef enum {
+	KPTYPE_PREPROCESS_NONE = 'n',
+	KPTYPE_PREPROCESS_TOUPPER = 'u',
+	KPTYPE_PREPROCESS_TOLOWER = 'l',
+} kptype_preprocess_e;
+
+
+C_DECL_BEGIN
+
+kptype_t *kptype_new(const char *name, const char *help);
+void kptype_free(kptype_t *ptype);
+
+const char *kptype_name(const kptype_t *ptype);
+const char *kptype_help(const kptype_t *ptype);
+const char *kptype_pattern(const kptype_t *ptype);
+bool_t kptype_set_pattern(kptype_t *ptype, const char *pattern);
+kptype_method_e kptype_method(const kptype_t *ptype);
+void kptype_set_method(kptype_t *ptype, kptype_method_e method);
+bool_t kptype_method_resolve(const char *str, kptype_method_e *method);
+kptype_preprocess_e kptype_preprocess(const kptype_t *ptype);
+void kptype_set_preprocess(kptype_t *ptype, kptype_preprocess_e preprocess);
+bool_t kptype_preprocess_resolve(const char *str,
+	kptype_preprocess_e *preprocess);
+kaction_t *kptype_action(const kptype_t *ptype);
+void kptype_set_action(kptype_t *ptype, kaction_t *action);
+
+C_DECL_END
+
+#endif // _klish_kptype_h
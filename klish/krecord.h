@@ -0,0 +1,82 @@
+/** @file krecord.h
+ *
+ * @brief Structured records of ACTION's output
+ *
+ * The ACTION with records="true" gets additional descriptor to write
+ * structured records to. The descriptor number is in KLISH_RECORD_FD
+ * environment variable. The records are delivered to client by separate
+ * KTP_RECORD stream so the automation doesn't need to parse the text
+ * output. The client renders records as text or passes them through as
+ * JSON.
+ *
+ * The record is a compact TLV. All the integers are in network byte order.
+ *
+ * record: length of fields (uint32_t), fields
+ * field: type (single byte), key length (single byte), key, value
+ *
+ * The value depends on type:
+ * 's' - string. Length (uint32_t) and bytes. Not terminated.
+ * 'i' - signed integer. The int64_t.
+ * 'b' - boolean. Single byte: 0 or 1.
+ * 'n' - null. No value.
+ */
+
+#ifndef _klish_krecord_h
+#define _klish_krecord_h
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <faux/faux.h>
+
+// Environment variable with descriptor number
+#define KRECORD_FD_ENV "KLISH_RECORD_FD"
+// Maximum length of record's fields. The longer one is a garbage.
+#define KRECORD_MAX (1024 * 1024)
+// Length of record header
+#define KRECORD_HEADER_LEN sizeof(uint32_t)
+
+typedef enum {
+	KRECORD_NULL = 'n',
+	KRECORD_STR = 's',
+	KRECORD_INT = 'i',
+	KRECORD_BOOL = 'b',
+} krecord_type_e;
+
+/** @brief Decoded field. Strings point to the record's data.
+ */
+typedef struct {
+	krecord_type_e type;
+	const char *key;
+	size_t key_len;
+	const char *str; // KRECORD_STR
+	size_t str_len;
+	int64_t num; // KRECORD_INT and KRECORD_BOOL
+} krecord_field_t;
+
+typedef struct krecord_s krecord_t;
+
+
+C_DECL_BEGIN
+
+// Encoder
+krecord_t *krecord_new(void);
+void krecord_free(krecord_t *record);
+void krecord_reset(krecord_t *record);
+bool_t krecord_add_str(krecord_t *record, const char *key, const char *str);
+bool_t krecord_add_int(krecord_t *record, const char *key, int64_t num);
+bool_t krecord_add_bool(krecord_t *record, const char *key, bool_t flag);
+bool_t krecord_add_null(krecord_t *record, const char *key);
+const char *krecord_data(const krecord_t *record, size_t *len);
+
+// Decoder
+ssize_t krecord_size(const char *data, size_t len);
+bool_t krecord_valid(const char *data, size_t len);
+bool_t krecord_field_each(const char **pos, const char *end,
+	krecord_field_t *field);
+char *krecord_text(const char *data, size_t len);
+char *krecord_json(const char *data, size_t len);
+
+C_DECL_END
+
+#endif // _klish_krecord_h
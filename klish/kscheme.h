@@ -0,0 +1,56 @@
+/** @file kscheme.h
+ *
+ * @brief Klish scheme. The set of all views, commands and so on.
+ */
+
+#ifndef _klish_kscheme_h
+#define _klish_kscheme_h
+
+#include <stdint.h>
+
+#include <faux/faux.h>
+#include <faux/list.h>
+#include <klish/kview.h>
+#include <klish/kptype.h>
+#include <klish/kvar.h>
+#include <klish/kplugin.h>
+
+#define KSCHEME_VIEW_GLOBAL "__view_global"
+
+typedef struct kscheme_s kscheme_t;
+
+
+C_DECL_BEGIN
+
+kscheme_t *kscheme_new(void);
+void kscheme_free(kscheme_t *scheme);
+
+kview_t *kscheme_global(const kscheme_t *scheme);
+bool_t kscheme_add_view(kscheme_t *scheme, kview_t *view);
+kview_t *kscheme_find_view(const kscheme_t *scheme, const char *name);
+const faux_list_t *kscheme_views(const kscheme_t *scheme);
+bool_t kscheme_add_ptype(kscheme_t *scheme, kptype_t *ptype);
+kptype_t *kscheme_find_ptype(const kscheme_t *scheme, const char *name);
+const faux_list_t *kscheme_ptypes(const kscheme_t *scheme);
+bool_t kscheme_add_var(kscheme_t *scheme, kvar_t *var);
+kvar_t *kscheme_find_var(const kscheme_t *scheme, const char *name);
+const faux_list_t *kscheme_vars(const kscheme_t *scheme);
+bool_t kscheme_add_plugin(kscheme_t *scheme, kplugin_t *plugin);
+kplugin_t *kscheme_find_plugin(const kscheme_t *scheme, const char *name);
+const faux_list_t *kscheme_plugins(const kscheme_t *scheme);
+const char *kscheme_startup_ref(const kscheme_t *scheme);
+bool_t kscheme_set_startup_ref(kscheme_t *scheme, const char *startup_ref);
+kview_t *kscheme_startup(const kscheme_t *scheme);
+
+int kscheme_merge(kscheme_t *scheme, kscheme_t *src, char **error);
+int kscheme_link(kscheme_t *scheme, char **error);
+uint32_t kscheme_version(const kscheme_t *scheme);
+
+// Visibility conditions
+size_t kscheme_commands_num(const kscheme_t *scheme);
+const size_t *kscheme_cond_deps(const kscheme_t *scheme, const char *var,
+	size_t *num);
+
+C_DECL_END
+
+#endif // _klish_kscheme_h
@@ -0,0 +1,278 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <faux/str.h>
+#include <faux/list.h>
+#include <klish/kaction.h>
+
+#include "private.h"
+
+
+kaction_t *kaction_new(void)
+{
+	kaction_t *action = NULL;
+
+	action = faux_zmalloc(sizeof(*action));
+	assert(action);
+	if (!action)
+		return NULL;
+
+	// Initialize. Defaults are the same as klish.xsd ones.
+	action->sym = NULL;
+	action->plugin = NULL;
+	action->script = NULL;
+	action->shebang = NULL;
+	action->interactive = BOOL_FALSE;
+	action->lock = BOOL_TRUE;
+	action->interrupt = BOOL_FALSE;
+	action->records = BOOL_FALSE;
+	action->batch = BOOL_FALSE;
+	action->timeout = KACTION_LIMIT_DEFAULT;
+	action->cpu = KACTION_LIMIT_DEFAULT;
+
+	return action;
+}
+
+
+void kaction_free(kaction_t *action)
+{
+	if (!action)
+		return;
+
+	faux_str_free(action->sym);
+	faux_str_free(action->script);
+	faux_str_free(action->shebang);
+	faux_free(action);
+}
+
+
+const char *kaction_sym(const kaction_t *action)
+{
+	assert(action);
+	if (!action)
+		return NULL;
+
+	return action->sym;
+}
+
+
+bool_t kaction_set_sym(kaction_t *action, const char *sym)
+{
+	assert(action);
+	if (!action)
+		return BOOL_FALSE;
+
+	faux_str_free(action->sym);
+	action->sym = faux_str_dup(sym);
+
+	return BOOL_TRUE;
+}
+
+
+kplugin_t *kaction_plugin(const kaction_t *action)
+{
+	assert(action);
+	if (!action)
+		return NULL;
+
+	return action->plugin;
+}
+
+
+void kaction_set_plugin(kaction_t *action, kplugin_t *plugin)
+{
+	assert(action);
+	if (!action)
+		return;
+
+	action->plugin = plugin;
+}
+
+
+const char *kaction_script(const kaction_t *action)
+{
+	assert(action);
+	if (!action)
+		return NULL;
+
+	return action->script;
+}
+
+
+bool_t kaction_set_script(kaction_t *action, const char *script)
+{
+	assert(action);
+	if (!action)
+		return BOOL_FALSE;
+
+	faux_str_free(action->script);
+	faux_str_free(action->shebang);
+	action->script = faux_str_dup(script);
+
+	return BOOL_TRUE;
+}
+
+
+const char *kaction_shebang(const kaction_t *action)
+{
+	assert(action);
+	if (!action)
+		return NULL;
+
+	return action->shebang;
+}
+
+
+bool_t kaction_set_shebang(kaction_t *action, const char *shebang)
+{
+	assert(action);
+	if (!action)
+		return BOOL_FALSE;
+
+	faux_str_free(action->shebang);
+	action->shebang = faux_str_dup(shebang);
+
+	return BOOL_TRUE;
+}
+
+
+bool_t kaction_interactive(const kaction_t *action)
+{
+	assert(action);
+	if (!action)
+		return BOOL_FALSE;
+
+	return action->interactive;
+}
+
+
+void kaction_set_interactive(kaction_t *action, bool_t interactive)
+{
+	assert(action);
+	if (!action)
+		return;
+
+	action->interactive = interactive;
+}
+
+
+bool_t kaction_lock(const kaction_t *action)
+{
+	assert(action);
+	if (!action)
+		return BOOL_FALSE;
+
+	return action->lock;
+}
+
+
+void kaction_set_lock(kaction_t *action, bool_t lock)
+{
+	assert(action);
+	if (!action)
+		return;
+
+	action->lock = lock;
+}
+
+
+bool_t kaction_interrupt(const kaction_t *action)
+{
+	assert(action);
+	if (!action)
+		return BOOL_FALSE;
+
+	return action->interrupt;
+}
+
+
+void kaction_set_interrupt(kaction_t *action, bool_t interrupt)
+{
+	assert(action);
+	if (!action)
+		return;
+
+	action->interrupt = interrupt;
+}
+
+
+bool_t kaction_records(const kaction_t *action)
+{
+	assert(action);
+	if (!action)
+		return BOOL_FALSE;
+
+	return action->records;
+}
+
+
+void kaction_set_records(kaction_t *action, bool_t records)
+{
+	assert(action);
+	if (!action)
+		return;
+
+	action->records = records;
+}
+
+
+bool_t kaction_batch(const kaction_t *action)
+{
+	assert(action);
+	if (!action)
+		return BOOL_FALSE;
+
+	return action->batch;
+}
+
+
+void kaction_set_batch(kaction_t *action, bool_t batch)
+{
+	assert(action);
+	if (!action)
+		return;
+
+	action->batch = batch;
+}
+
+
+unsigned int kaction_timeout(const kaction_t *action)
+{
+	assert(action);
+	if (!action)
+		return 0;
+
+	return action->timeout;
+}
+
+
+void kaction_set_timeout(kaction_t *action, unsigned int timeout)
+{
+	assert(action);
+	if (!action)
+		return;
+
+	action->timeout = timeout;
+}
+
+
+unsigned int kaction_cpu(const kaction_t *action)
+{
+	assert(action);
+	if (!action)
+		return 0;
+
+	return action->cpu;
+}
+
+
+void kaction_set_cpu(kaction_t *action, unsigned int cpu)
+{
+	assert(action);
+	if (!action)
+		return;
+
+	action->cpu = cpu;
+}
@@ -0,0 +1,562 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <faux/str.h>
+#include <faux/conv.h>
+#include <klish/kcommand.h>
+
+#include "private.h"
+
+
+kcommand_t *kcommand_new(const char *name, const char *help)
+{
+	kcommand_t *command = NULL;
+
+	if (!name)
+		return NULL;
+
+	command = faux_zmalloc(sizeof(*command));
+	assert(command);
+	if (!command)
+		return NULL;
+
+	// Initialize
+	command->name = faux_str_dup(name);
+	command->help = faux_str_dup(help);
+	command->nav = KNAV_NONE;
+	command->nav_view_name = NULL;
+	command->nav_view = NULL;
+	command->nav_num = -1;
+	command->id = 0;
+	command->access = NULL;
+	command->cond = NULL;
+	command->cond_class = KCOND_NONE;
+	command->cond_vars = NULL;
+	command->cond_vars_num = 0;
+	command->detail = NULL;
+	command->params = faux_list_new(FAUX_LIST_UNSORTED, FAUX_LIST_NONUNIQUE,
+		NULL, NULL, (void (*)(void *))kparam_free);
+	assert(command->params);
+	command->action = NULL;
+	command->bound = BOOL_FALSE;
+	command->cache_ttl = 0;
+	command->cache_vars = NULL;
+	command->cache_vars_num = 0;
+
+	return command;
+}
+
+
+void kcommand_free(kcommand_t *command)
+{
+	if (!command)
+		return;
+
+	faux_str_free(command->name);
+	faux_str_free(command->help);
+	faux_str_free(command->nav_view_name);
+	faux_str_free(command->access);
+	kcommand_set_cond(command, NULL, BOOL_FALSE);
+	kcommand_set_cache_vars(command, NULL);
+	faux_str_free(command->detail);
+	faux_list_free(command->params);
+	kaction_free(command->action);
+	faux_free(command);
+}
+
+
+const char *kcommand_name(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return NULL;
+
+	return command->name;
+}
+
+
+const char *kcommand_help(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return NULL;
+
+	return command->help;
+}
+
+
+const char *kcommand_detail(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return NULL;
+
+	return command->detail;
+}
+
+
+bool_t kcommand_set_detail(kcommand_t *command, const char *detail)
+{
+	assert(command);
+	if (!command)
+		return BOOL_FALSE;
+
+	faux_str_free(command->detail);
+	command->detail = faux_str_dup(detail);
+
+	return BOOL_TRUE;
+}
+
+
+bool_t kcommand_add_param(kcommand_t *command, kparam_t *param)
+{
+	assert(command);
+	if (!command)
+		return BOOL_FALSE;
+	assert(param);
+	if (!param)
+		return BOOL_FALSE;
+
+	if (!faux_list_add(command->params, param))
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+const faux_list_t *kcommand_params(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return NULL;
+
+	return command->params;
+}
+
+
+kaction_t *kcommand_action(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return NULL;
+
+	return command->action;
+}
+
+
+void kcommand_set_action(kcommand_t *command, kaction_t *action)
+{
+	assert(command);
+	if (!command)
+		return;
+
+	kaction_free(command->action);
+	command->action = action;
+}
+
+
+/** @brief Parse navigation string
+ *
+ * Possible values are:
+ * "down:<view>", "up[:<number>]", "replace:<view>[@<level>]", "exit".
+ *
+ * @param [in] command Command object.
+ * @param [in] nav Navigation string (COMMAND's "nav" attribute).
+ * @return BOOL_TRUE on success, BOOL_FALSE on malformed string.
+ */
+bool_t kcommand_set_nav(kcommand_t *command, const char *nav)
+{
+	const char *arg = NULL;
+	knav_e type = KNAV_NONE;
+	char *view_name = NULL;
+	ssize_t num = -1;
+
+	assert(command);
+	if (!command)
+		return BOOL_FALSE;
+
+	if (!nav || ('\0' == *nav)) {
+		type = KNAV_NONE;
+	} else if (strncmp(nav, "down:", 5) == 0) {
+		type = KNAV_DOWN;
+		arg = nav + 5;
+		if ('\0' == *arg)
+			return BOOL_FALSE;
+		view_name = faux_str_dup(arg);
+	} else if (strcmp(nav, "up") == 0) {
+		type = KNAV_UP;
+		num = 1;
+	} else if (strncmp(nav, "up:", 3) == 0) {
+		unsigned int n = 0;
+		type = KNAV_UP;
+		arg = nav + 3;
+		if (!faux_conv_atoui(arg, &n, 10) || (0 == n))
+			return BOOL_FALSE;
+		num = n;
+	} else if (strncmp(nav, "replace:", 8) == 0) {
+		const char *at = NULL;
+		type = KNAV_REPLACE;
+		arg = nav + 8;
+		at = strchr(arg, '@');
+		if (at) {
+			unsigned int n = 0;
+			if (!faux_conv_atoui(at + 1, &n, 10) || (0 == n))
+				return BOOL_FALSE;
+			num = n;
+			view_name = faux_str_dupn(arg, at - arg);
+		} else {
+			view_name = faux_str_dup(arg);
+		}
+		if ('\0' == *view_name) {
+			faux_str_free(view_name);
+			return BOOL_FALSE;
+		}
+	} else if (strcmp(nav, "exit") == 0) {
+		type = KNAV_EXIT;
+	} else {
+		return BOOL_FALSE;
+	}
+
+	faux_str_free(command->nav_view_name);
+	command->nav = type;
+	command->nav_view_name = view_name;
+	command->nav_view = NULL;
+	command->nav_num = num;
+
+	return BOOL_TRUE;
+}
+
+
+knav_e kcommand_nav(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return KNAV_NONE;
+
+	return command->nav;
+}
+
+
+const char *kcommand_nav_view_name(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return NULL;
+
+	return command->nav_view_name;
+}
+
+
+kview_t *kcommand_nav_view(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return NULL;
+
+	return command->nav_view;
+}
+
+
+void kcommand_set_nav_view(kcommand_t *command, kview_t *view)
+{
+	assert(command);
+	if (!command)
+		return;
+
+	command->nav_view = view;
+}
+
+
+ssize_t kcommand_nav_num(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return -1;
+
+	return command->nav_num;
+}
+
+
+size_t kcommand_id(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return 0;
+
+	return command->id;
+}
+
+
+void kcommand_set_id(kcommand_t *command, size_t id)
+{
+	assert(command);
+	if (!command)
+		return;
+
+	command->id = id;
+}
+
+
+const char *kcommand_access(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return NULL;
+
+	return command->access;
+}
+
+
+bool_t kcommand_set_access(kcommand_t *command, const char *access)
+{
+	assert(command);
+	if (!command)
+		return BOOL_FALSE;
+
+	faux_str_free(command->access);
+	command->access = faux_str_dup(access);
+
+	return BOOL_TRUE;
+}
+
+
+const char *kcommand_cond(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return NULL;
+
+	return command->cond;
+}
+
+
+static bool_t kcommand_add_cond_var(kcommand_t *command, const char *name,
+	size_t len)
+{
+	char **new_vars = NULL;
+	size_t i = 0;
+
+	for (i = 0; i < command->cond_vars_num; i++) {
+		if ((strlen(command->cond_vars[i]) == len) &&
+			(strncmp(command->cond_vars[i], name, len) == 0))
+			return BOOL_TRUE;
+	}
+	new_vars = realloc(command->cond_vars,
+		(command->cond_vars_num + 1) * sizeof(*new_vars));
+	assert(new_vars);
+	if (!new_vars)
+		return BOOL_FALSE;
+	command->cond_vars = new_vars;
+	command->cond_vars[command->cond_vars_num] = faux_str_dupn(name, len);
+	command->cond_vars_num++;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Sets visibility condition and classifies it
+ *
+ * The non-dynamic condition is an expression like the 'test' utility one.
+ * The "${name}" references to session VARs are collected so the condition
+ * will be re-evaluated only when these VARs are changed. The expression
+ * without VAR references is evaluated once per session. The dynamic
+ * condition is evaluated by external code each time.
+ *
+ * @param [in] command Command object.
+ * @param [in] cond Condition. The NULL removes condition.
+ * @param [in] dynamic The condition must be evaluated by external code.
+ * @return BOOL_TRUE on success, BOOL_FALSE on error.
+ */
+bool_t kcommand_set_cond(kcommand_t *command, const char *cond,
+	bool_t dynamic)
+{
+	const char *pos = NULL;
+	size_t i = 0;
+
+	assert(command);
+	if (!command)
+		return BOOL_FALSE;
+
+	// Reset previous condition
+	faux_str_free(command->cond);
+	command->cond = NULL;
+	for (i = 0; i < command->cond_vars_num; i++)
+		faux_str_free(command->cond_vars[i]);
+	free(command->cond_vars);
+	command->cond_vars = NULL;
+	command->cond_vars_num = 0;
+	command->cond_class = KCOND_NONE;
+
+	if (!cond)
+		return BOOL_TRUE;
+	command->cond = faux_str_dup(cond);
+	if (dynamic) {
+		command->cond_class = KCOND_DYNAMIC;
+		return BOOL_TRUE;
+	}
+
+	pos = cond;
+	while ((pos = strstr(pos, "${"))) {
+		const char *end = NULL;
+		pos += 2;
+		end = strchr(pos, '}');
+		if (!end || ((end > pos) &&
+			!kcommand_add_cond_var(command, pos, end - pos))) {
+			kcommand_set_cond(command, NULL, BOOL_FALSE);
+			return BOOL_FALSE;
+		}
+		pos = end + 1;
+	}
+	command->cond_class = (command->cond_vars_num > 0) ?
+		KCOND_VAR : KCOND_STATIC;
+
+	return BOOL_TRUE;
+}
+
+
+kcond_e kcommand_cond_class(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return KCOND_NONE;
+
+	return command->cond_class;
+}
+
+
+size_t kcommand_cond_vars_num(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return 0;
+
+	return command->cond_vars_num;
+}
+
+
+const char *kcommand_cond_var(const kcommand_t *command, size_t index)
+{
+	assert(command);
+	if (!command)
+		return NULL;
+	if (index >= command->cond_vars_num)
+		return NULL;
+
+	return command->cond_vars[index];
+}
+
+
+bool_t kcommand_bound(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return BOOL_FALSE;
+
+	return command->bound;
+}
+
+
+void kcommand_set_bound(kcommand_t *command, bool_t bound)
+{
+	assert(command);
+	if (!command)
+		return;
+
+	command->bound = bound;
+}
+
+
+/** @brief Gets time to keep command's output within cache
+ *
+ * @return Seconds. The 0 - command is not cacheable.
+ */
+unsigned int kcommand_cache(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return 0;
+
+	return command->cache_ttl;
+}
+
+
+void kcommand_set_cache(kcommand_t *command, unsigned int ttl)
+{
+	assert(command);
+	if (!command)
+		return;
+
+	command->cache_ttl = ttl;
+}
+
+
+/** @brief Sets names of VARs the cached output depends on
+ *
+ * The values of these VARs are a part of cache key so the sessions with
+ * different values don't share output.
+ *
+ * @param [in] command Command object.
+ * @param [in] vars Names separated by spaces or commas. The NULL removes
+ * list.
+ * @return BOOL_TRUE on success, BOOL_FALSE on error.
+ */
+bool_t kcommand_set_cache_vars(kcommand_t *command, const char *vars)
+{
+	const char *pos = vars;
+	size_t i = 0;
+
+	assert(command);
+	if (!command)
+		return BOOL_FALSE;
+
+	for (i = 0; i < command->cache_vars_num; i++)
+		faux_str_free(command->cache_vars[i]);
+	free(command->cache_vars);
+	command->cache_vars = NULL;
+	command->cache_vars_num = 0;
+
+	while (pos && *pos) {
+		char **new_vars = NULL;
+		size_t len = 0;
+		pos += strspn(pos, " \t,");
+		len = strcspn(pos, " \t,");
+		if (0 == len)
+			break;
+		new_vars = realloc(command->cache_vars,
+			(command->cache_vars_num + 1) * sizeof(*new_vars));
+		assert(new_vars);
+		if (!new_vars)
+			return BOOL_FALSE;
+		command->cache_vars = new_vars;
+		command->cache_vars[command->cache_vars_num] =
+			faux_str_dupn(pos, len);
+		command->cache_vars_num++;
+		pos += len;
+	}
+
+	return BOOL_TRUE;
+}
+
+
+size_t kcommand_cache_vars_num(const kcommand_t *command)
+{
+	assert(command);
+	if (!command)
+		return 0;
+
+	return command->cache_vars_num;
+}
+
+
+const char *kcommand_cache_var(const kcommand_t *command, size_t index)
+{
+	assert(command);
+	if (!command)
+		return NULL;
+	if (index >= command->cache_vars_num)
+		return NULL;
+
+	return command->cache_vars[index];
+}
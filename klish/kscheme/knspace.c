@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <faux/str.h>
+#include <klish/knspace.h>
+
+#include "private.h"
+
+
+knspace_t *knspace_new(const char *view_ref)
+{
+	knspace_t *nspace = NULL;
+
+	if (!view_ref)
+		return NULL;
+
+	nspace = faux_zmalloc(sizeof(*nspace));
+	assert(nspace);
+	if (!nspace)
+		return NULL;
+
+	// Initialize. Defaults are the same as klish.xsd ones.
+	nspace->view_ref = faux_str_dup(view_ref);
+	nspace->view = NULL;
+	nspace->prefix = NULL;
+	nspace->inherit = BOOL_TRUE;
+	nspace->completion = BOOL_TRUE;
+	nspace->context_help = BOOL_FALSE;
+
+	return nspace;
+}
+
+
+void knspace_free(knspace_t *nspace)
+{
+	if (!nspace)
+		return;
+
+	faux_str_free(nspace->view_ref);
+	faux_str_free(nspace->prefix);
+	faux_free(nspace);
+}
+
+
+const char *knspace_view_ref(const knspace_t *nspace)
+{
+	assert(nspace);
+	if (!nspace)
+		return NULL;
+
+	return nspace->view_ref;
+}
+
+
+kview_t *knspace_view(const knspace_t *nspace)
+{
+	assert(nspace);
+	if (!nspace)
+		return NULL;
+
+	return nspace->view;
+}
+
+
+void knspace_set_view(knspace_t *nspace, kview_t *view)
+{
+	assert(nspace);
+	if (!nspace)
+		return;
+
+	nspace->view = view;
+}
+
+
+const char *knspace_prefix(const knspace_t *nspace)
+{
+	assert(nspace);
+	if (!nspace)
+		return NULL;
+
+	return nspace->prefix;
+}
+
+
+bool_t knspace_set_prefix(knspace_t *nspace, const char *prefix)
+{
+	assert(nspace);
+	if (!nspace)
+		return BOOL_FALSE;
+
+	faux_str_free(nspace->prefix);
+	nspace->prefix = faux_str_dup(prefix);
+
+	return BOOL_TRUE;
+}
+
+
+bool_t knspace_inherit(const knspace_t *nspace)
+{
+	assert(nspace);
+	if (!nspace)
+		return BOOL_FALSE;
+
+	return nspace->inherit;
+}
+
+
+void knspace_set_inherit(knspace_t *nspace, bool_t inherit)
+{
+	assert(nspace);
+	if (!nspace)
+		return;
+
+	nspace->inherit = inherit;
+}
+
+
+bool_t knspace_completion(const knspace_t *nspace)
+{
+	assert(nspace);
+	if (!nspace)
+		return BOOL_FALSE;
+
+	return nspace->completion;
+}
+
+
+void knspace_set_completion(knspace_t *nspace, bool_t completion)
+{
+	assert(nspace);
+	if (!nspace)
+		return;
+
+	nspace->completion = completion;
+}
+
+
+bool_t knspace_context_help(const knspace_t *nspace)
+{
+	assert(nspace);
+	if (!nspace)
+		return BOOL_FALSE;
+
+	return nspace->context_help;
+}
+
+
+void knspace_set_context_help(knspace_t *nspace, bool_t context_help)
+{
+	assert(nspace);
+	if (!nspace)
+		return;
+
+	nspace->context_help = context_help;
+}
@@ -0,0 +1,272 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <faux/str.h>
+#include <faux/list.h>
+#include <klish/kparam.h>
+
+#include "private.h"
+
+
+kparam_t *kparam_new(const char *name, const char *help)
+{
+	kparam_t *param = NULL;
+
+	if (!name)
+		return NULL;
+
+	param = faux_zmalloc(sizeof(*param));
+	assert(param);
+	if (!param)
+		return NULL;
+
+	// Initialize
+	param->name = faux_str_dup(name);
+	param->help = faux_str_dup(help);
+	param->ptype_ref = NULL;
+	param->ptype = NULL;
+	param->mode = KPARAM_MODE_COMMON;
+	param->optional = BOOL_FALSE;
+	param->defval = NULL;
+	param->prefix = NULL;
+	param->value = NULL;
+	param->params = faux_list_new(FAUX_LIST_UNSORTED, FAUX_LIST_NONUNIQUE,
+		NULL, NULL, (void (*)(void *))kparam_free);
+	assert(param->params);
+
+	return param;
+}
+
+
+void kparam_free(kparam_t *param)
+{
+	if (!param)
+		return;
+
+	faux_str_free(param->name);
+	faux_str_free(param->help);
+	faux_str_free(param->ptype_ref);
+	faux_str_free(param->defval);
+	faux_str_free(param->prefix);
+	faux_str_free(param->value);
+	faux_list_free(param->params);
+	faux_free(param);
+}
+
+
+const char *kparam_name(const kparam_t *param)
+{
+	assert(param);
+	if (!param)
+		return NULL;
+
+	return param->name;
+}
+
+
+const char *kparam_help(const kparam_t *param)
+{
+	assert(param);
+	if (!param)
+		return NULL;
+
+	return param->help;
+}
+
+
+const char *kparam_ptype_ref(const kparam_t *param)
+{
+	assert(param);
+	if (!param)
+		return NULL;
+
+	return param->ptype_ref;
+}
+
+
+bool_t kparam_set_ptype_ref(kparam_t *param, const char *ptype_ref)
+{
+	assert(param);
+	if (!param)
+		return BOOL_FALSE;
+
+	faux_str_free(param->ptype_ref);
+	param->ptype_ref = faux_str_dup(ptype_ref);
+
+	return BOOL_TRUE;
+}
+
+
+kptype_t *kparam_ptype(const kparam_t *param)
+{
+	assert(param);
+	if (!param)
+		return NULL;
+
+	return param->ptype;
+}
+
+
+void kparam_set_ptype(kparam_t *param, kptype_t *ptype)
+{
+	assert(param);
+	if (!param)
+		return;
+
+	param->ptype = ptype;
+}
+
+
+kparam_mode_e kparam_mode(const kparam_t *param)
+{
+	assert(param);
+	if (!param)
+		return KPARAM_MODE_COMMON;
+
+	return param->mode;
+}
+
+
+void kparam_set_mode(kparam_t *param, kparam_mode_e mode)
+{
+	assert(param);
+	if (!param)
+		return;
+
+	param->mode = mode;
+}
+
+
+bool_t kparam_optional(const kparam_t *param)
+{
+	assert(param);
+	if (!param)
+		return BOOL_FALSE;
+
+	return param->optional;
+}
+
+
+void kparam_set_optional(kparam_t *param, bool_t optional)
+{
+	assert(param);
+	if (!param)
+		return;
+
+	param->optional = optional;
+}
+
+
+const char *kparam_defval(const kparam_t *param)
+{
+	assert(param);
+	if (!param)
+		return NULL;
+
+	return param->defval;
+}
+
+
+bool_t kparam_set_defval(kparam_t *param, const char *defval)
+{
+	assert(param);
+	if (!param)
+		return BOOL_FALSE;
+
+	faux_str_free(param->defval);
+	param->defval = faux_str_dup(defval);
+
+	return BOOL_TRUE;
+}
+
+
+const char *kparam_prefix(const kparam_t *param)
+{
+	assert(param);
+	if (!param)
+		return NULL;
+
+	return param->prefix;
+}
+
+
+bool_t kparam_set_prefix(kparam_t *param, const char *prefix)
+{
+	assert(param);
+	if (!param)
+		return BOOL_FALSE;
+
+	faux_str_free(param->prefix);
+	param->prefix = faux_str_dup(prefix);
+
+	return BOOL_TRUE;
+}
+
+
+const char *kparam_value(const kparam_t *param)
+{
+	assert(param);
+	if (!param)
+		return NULL;
+
+	return param->value;
+}
+
+
+bool_t kparam_set_value(kparam_t *param, const char *value)
+{
+	assert(param);
+	if (!param)
+		return BOOL_FALSE;
+
+	faux_str_free(param->value);
+	param->value = faux_str_dup(value);
+
+	return BOOL_TRUE;
+}
+
+
+bool_t kparam_mode_resolve(const char *str, kparam_mode_e *mode)
+{
+	if (!str || !mode)
+		return BOOL_FALSE;
+
+	if (!strcmp(str, "common"))
+		*mode = KPARAM_MODE_COMMON;
+	else if (!strcmp(str, "switch"))
+		*mode = KPARAM_MODE_SWITCH;
+	else if (!strcmp(str, "subcommand"))
+		*mode = KPARAM_MODE_SUBCOMMAND;
+	else
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+bool_t kparam_add_param(kparam_t *param, kparam_t *nested)
+{
+	assert(param);
+	if (!param)
+		return BOOL_FALSE;
+	assert(nested);
+	if (!nested)
+		return BOOL_FALSE;
+
+	if (!faux_list_add(param->params, nested))
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+const faux_list_t *kparam_params(const kparam_t *param)
+{
+	assert(param);
+	if (!param)
+		return NULL;
+
+	return param->params;
+}
@@ -0,0 +1,145 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <faux/str.h>
+#include <klish/kplugin.h>
+
+#include "private.h"
+
+
+kplugin_t *kplugin_new(const char *name)
+{
+	kplugin_t *plugin = NULL;
+
+	if (!name)
+		return NULL;
+
+	plugin = faux_zmalloc(sizeof(*plugin));
+	assert(plugin);
+	if (!plugin)
+		return NULL;
+
+	// Initialize
+	plugin->name = faux_str_dup(name);
+	plugin->alias = NULL;
+	plugin->file = NULL;
+	plugin->rtld_global = BOOL_FALSE;
+	plugin->conf = NULL;
+
+	return plugin;
+}
+
+
+void kplugin_free(kplugin_t *plugin)
+{
+	if (!plugin)
+		return;
+
+	faux_str_free(plugin->name);
+	faux_str_free(plugin->alias);
+	faux_str_free(plugin->file);
+	faux_str_free(plugin->conf);
+	faux_free(plugin);
+}
+
+
+const char *kplugin_name(const kplugin_t *plugin)
+{
+	assert(plugin);
+	if (!plugin)
+		return NULL;
+
+	return plugin->name;
+}
+
+
+const char *kplugin_alias(const kplugin_t *plugin)
+{
+	assert(plugin);
+	if (!plugin)
+		return NULL;
+
+	return plugin->alias;
+}
+
+
+bool_t kplugin_set_alias(kplugin_t *plugin, const char *alias)
+{
+	assert(plugin);
+	if (!plugin)
+		return BOOL_FALSE;
+
+	faux_str_free(plugin->alias);
+	plugin->alias = faux_str_dup(alias);
+
+	return BOOL_TRUE;
+}
+
+
+const char *kplugin_file(const kplugin_t *plugin)
+{
+	assert(plugin);
+	if (!plugin)
+		return NULL;
+
+	return plugin->file;
+}
+
+
+bool_t kplugin_set_file(kplugin_t *plugin, const char *file)
+{
+	assert(plugin);
+	if (!plugin)
+		return BOOL_FALSE;
+
+	faux_str_free(plugin->file);
+	plugin->file = faux_str_dup(file);
+
+	return BOOL_TRUE;
+}
+
+
+bool_t kplugin_rtld_global(const kplugin_t *plugin)
+{
+	assert(plugin);
+	if (!plugin)
+		return BOOL_FALSE;
+
+	return plugin->rtld_global;
+}
+
+
+void kplugin_set_rtld_global(kplugin_t *plugin, bool_t rtld_global)
+{
+	assert(plugin);
+	if (!plugin)
+		return;
+
+	plugin->rtld_global = rtld_global;
+}
+
+
+const char *kplugin_conf(const kplugin_t *plugin)
+{
+	assert(plugin);
+	if (!plugin)
+		return NULL;
+
+	return plugin->conf;
+}
+
+
+bool_t kplugin_set_conf(kplugin_t *plugin, const char *conf)
+{
+	assert(plugin);
+	if (!plugin)
+		return BOOL_FALSE;
+
+	faux_str_free(plugin->conf);
+	plugin->conf = faux_str_dup(conf);
+
+	return BOOL_TRUE;
+}
+
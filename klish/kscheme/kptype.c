@@ -0,0 +1,196 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <faux/str.h>
+#include <faux/list.h>
+#include <klish/kptype.h>
+
+#include "private.h"
+
+
+kptype_t *kptype_new(const char *name, const char *help)
+{
+	kptype_t *ptype = NULL;
+
+	if (!name)
+		return NULL;
+
+	ptype = faux_zmalloc(sizeof(*ptype));
+	assert(ptype);
+	if (!ptype)
+		return NULL;
+
+	// Initialize
+	ptype->name = faux_str_dup(name);
+	ptype->help = faux_str_dup(help);
+	ptype->pattern = NULL;
+	ptype->method = KPTYPE_METHOD_REGEXP;
+	ptype->preprocess = KPTYPE_PREPROCESS_NONE;
+	ptype->action = NULL;
+
+	return ptype;
+}
+
+
+void kptype_free(kptype_t *ptype)
+{
+	if (!ptype)
+		return;
+
+	faux_str_free(ptype->name);
+	faux_str_free(ptype->help);
+	faux_str_free(ptype->pattern);
+	kaction_free(ptype->action);
+	faux_free(ptype);
+}
+
+
+const char *kptype_name(const kptype_t *ptype)
+{
+	assert(ptype);
+	if (!ptype)
+		return NULL;
+
+	return ptype->name;
+}
+
+
+const char *kptype_help(const kptype_t *ptype)
+{
+	assert(ptype);
+	if (!ptype)
+		return NULL;
+
+	return ptype->help;
+}
+
+
+const char *kptype_pattern(const kptype_t *ptype)
+{
+	assert(ptype);
+	if (!ptype)
+		return NULL;
+
+	return ptype->pattern;
+}
+
+
+bool_t kptype_set_pattern(kptype_t *ptype, const char *pattern)
+{
+	assert(ptype);
+	if (!ptype)
+		return BOOL_FALSE;
+
+	faux_str_free(ptype->pattern);
+	ptype->pattern = faux_str_dup(pattern);
+
+	return BOOL_TRUE;
+}
+
+
+kptype_method_e kptype_method(const kptype_t *ptype)
+{
+	assert(ptype);
+	if (!ptype)
+		return KPTYPE_METHOD_REGEXP;
+
+	return ptype->method;
+}
+
+
+void kptype_set_method(kptype_t *ptype, kptype_method_e method)
+{
+	assert(ptype);
+	if (!ptype)
+		return;
+
+	ptype->method = method;
+}
+
+
+kptype_preprocess_e kptype_preprocess(const kptype_t *ptype)
+{
+	assert(ptype);
+	if (!ptype)
+		return KPTYPE_PREPROCESS_NONE;
+
+	return ptype->preprocess;
+}
+
+
+void kptype_set_preprocess(kptype_t *ptype, kptype_preprocess_e preprocess)
+{
+	assert(ptype);
+	if (!ptype)
+		return;
+
+	ptype->preprocess = preprocess;
+}
+
+
+kaction_t *kptype_action(const kptype_t *ptype)
+{
+	assert(ptype);
+	if (!ptype)
+		return NULL;
+
+	return ptype->action;
+}
+
+
+void kptype_set_action(kptype_t *ptype, kaction_t *action)
+{
+	assert(ptype);
+	if (!ptype)
+		return;
+
+	kaction_free(ptype->action);
+	ptype->action = action;
+}
+
+
+bool_t kptype_method_resolve(const char *str, kptype_method_e *method)
+{
+	if (!str || !method)
+		return BOOL_FALSE;
+
+	if (!strcmp(str, "regexp"))
+		*method = KPTYPE_METHOD_REGEXP;
+	else if (!strcmp(str, "integer"))
+		*method = KPTYPE_METHOD_INTEGER;
+	else if (!strcmp(str, "unsignedInteger"))
+		*method = KPTYPE_METHOD_UNSIGNEDINTEGER;
+	else if (!strcmp(str, "select"))
+		*method = KPTYPE_METHOD_SELECT;
+	else if (!strcmp(str, "choice"))
+		*method = KPTYPE_METHOD_CHOICE;
+	else if (!strcmp(str, "subcommand"))
+		*method = KPTYPE_METHOD_SUBCOMMAND;
+	else if (!strcmp(str, "code"))
+		*method = KPTYPE_METHOD_CODE;
+	else
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+bool_t kptype_preprocess_resolve(const char *str,
+	kptype_preprocess_e *preprocess)
+{
+	if (!str || !preprocess)
+		return BOOL_FALSE;
+
+	if (!strcmp(str, "none"))
+		*preprocess = KPTYPE_PREPROCESS_NONE;
+	else if (!strcmp(str, "toupper"))
+		*preprocess = KPTYPE_PREPROCESS_TOUPPER;
+	else if (!strcmp(str, "tolower"))
+		*preprocess = KPTYPE_PREPROCESS_TOLOWER;
+	else
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
@@ -0,0 +1,1087 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <faux/str.h>
+#include <faux/list.h>
+#include <klish/kscheme.h>
+
+#include "private.h"
+
+
+static int kscheme_view_compare(const void *first, const void *second)
+{
+	const kview_t *f = (const kview_t *)first;
+	const kview_t *s = (const kview_t *)second;
+
+	return strcmp(kview_name(f), kview_name(s));
+}
+
+
+static int kscheme_view_kcompare(const void *key, const void *list_item)
+{
+	const char *f = (const char *)key;
+	const kview_t *s = (const kview_t *)list_item;
+
+	return strcmp(f, kview_name(s));
+}
+
+
+static int kscheme_ptype_compare(const void *first, const void *second)
+{
+	const kptype_t *f = (const kptype_t *)first;
+	const kptype_t *s = (const kptype_t *)second;
+
+	return strcmp(kptype_name(f), kptype_name(s));
+}
+
+
+static int kscheme_ptype_kcompare(const void *key, const void *list_item)
+{
+	const char *f = (const char *)key;
+	const kptype_t *s = (const kptype_t *)list_item;
+
+	return strcmp(f, kptype_name(s));
+}
+
+
+static int kscheme_var_compare(const void *first, const void *second)
+{
+	const kvar_t *f = (const kvar_t *)first;
+	const kvar_t *s = (const kvar_t *)second;
+
+	return strcmp(kvar_name(f), kvar_name(s));
+}
+
+
+static int kscheme_var_kcompare(const void *key, const void *list_item)
+{
+	const char *f = (const char *)key;
+	const kvar_t *s = (const kvar_t *)list_item;
+
+	return strcmp(f, kvar_name(s));
+}
+
+
+static int kscheme_plugin_compare(const void *first, const void *second)
+{
+	const kplugin_t *f = (const kplugin_t *)first;
+	const kplugin_t *s = (const kplugin_t *)second;
+
+	return strcmp(kplugin_name(f), kplugin_name(s));
+}
+
+
+static int kscheme_plugin_kcompare(const void *key, const void *list_item)
+{
+	const char *f = (const char *)key;
+	const kplugin_t *s = (const kplugin_t *)list_item;
+
+	return strcmp(f, kplugin_name(s));
+}
+
+
+static int kscheme_dep_compare(const void *first, const void *second)
+{
+	const kscheme_dep_t *f = (const kscheme_dep_t *)first;
+	const kscheme_dep_t *s = (const kscheme_dep_t *)second;
+
+	return strcmp(f->var, s->var);
+}
+
+
+static int kscheme_dep_kcompare(const void *key, const void *list_item)
+{
+	const char *f = (const char *)key;
+	const kscheme_dep_t *s = (const kscheme_dep_t *)list_item;
+
+	return strcmp(f, s->var);
+}
+
+
+static int kscheme_str_compare(const void *first, const void *second)
+{
+	return strcmp((const char *)first, (const char *)second);
+}
+
+
+static void kscheme_dep_free(void *data)
+{
+	kscheme_dep_t *dep = (kscheme_dep_t *)data;
+
+	if (!dep)
+		return;
+
+	faux_str_free(dep->var);
+	free(dep->ids);
+	faux_free(dep);
+}
+
+
+kscheme_t *kscheme_new(void)
+{
+	kscheme_t *scheme = NULL;
+
+	scheme = faux_zmalloc(sizeof(*scheme));
+	assert(scheme);
+	if (!scheme)
+		return NULL;
+
+	// Initialize
+	scheme->views = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		kscheme_view_compare, kscheme_view_kcompare,
+		(void (*)(void *))kview_free);
+	assert(scheme->views);
+
+	// Global view is an ordinary view. It's a level 0 of any path.
+	scheme->global = kview_new(KSCHEME_VIEW_GLOBAL);
+	assert(scheme->global);
+	faux_list_add(scheme->views, scheme->global);
+
+	scheme->ptypes = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		kscheme_ptype_compare, kscheme_ptype_kcompare,
+		(void (*)(void *))kptype_free);
+	assert(scheme->ptypes);
+	scheme->vars = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		kscheme_var_compare, kscheme_var_kcompare,
+		(void (*)(void *))kvar_free);
+	assert(scheme->vars);
+	scheme->plugins = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		kscheme_plugin_compare, kscheme_plugin_kcompare,
+		(void (*)(void *))kplugin_free);
+	assert(scheme->plugins);
+	scheme->startup_ref = NULL;
+	scheme->startup = NULL;
+
+	scheme->commands_num = 0;
+	scheme->deps = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		kscheme_dep_compare, kscheme_dep_kcompare, kscheme_dep_free);
+	assert(scheme->deps);
+	scheme->version = 0;
+
+	return scheme;
+}
+
+
+void kscheme_free(kscheme_t *scheme)
+{
+	if (!scheme)
+		return;
+
+	faux_list_free(scheme->deps);
+	faux_list_free(scheme->views);
+	faux_list_free(scheme->ptypes);
+	faux_list_free(scheme->vars);
+	faux_list_free(scheme->plugins);
+	faux_str_free(scheme->startup_ref);
+	faux_free(scheme);
+}
+
+
+kview_t *kscheme_global(const kscheme_t *scheme)
+{
+	assert(scheme);
+	if (!scheme)
+		return NULL;
+
+	return scheme->global;
+}
+
+
+bool_t kscheme_add_view(kscheme_t *scheme, kview_t *view)
+{
+	assert(scheme);
+	if (!scheme)
+		return BOOL_FALSE;
+	assert(view);
+	if (!view)
+		return BOOL_FALSE;
+
+	if (!faux_list_add(scheme->views, view))
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+kview_t *kscheme_find_view(const kscheme_t *scheme, const char *name)
+{
+	assert(scheme);
+	if (!scheme)
+		return NULL;
+	assert(name);
+	if (!name)
+		return NULL;
+
+	return (kview_t *)faux_list_kfind(scheme->views, name);
+}
+
+
+const faux_list_t *kscheme_views(const kscheme_t *scheme)
+{
+	assert(scheme);
+	if (!scheme)
+		return NULL;
+
+	return scheme->views;
+}
+
+
+bool_t kscheme_add_ptype(kscheme_t *scheme, kptype_t *ptype)
+{
+	assert(scheme);
+	if (!scheme)
+		return BOOL_FALSE;
+	assert(ptype);
+	if (!ptype)
+		return BOOL_FALSE;
+
+	if (!faux_list_add(scheme->ptypes, ptype))
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+kptype_t *kscheme_find_ptype(const kscheme_t *scheme, const char *name)
+{
+	assert(scheme);
+	if (!scheme)
+		return NULL;
+	assert(name);
+	if (!name)
+		return NULL;
+
+	return (kptype_t *)faux_list_kfind(scheme->ptypes, name);
+}
+
+
+const faux_list_t *kscheme_ptypes(const kscheme_t *scheme)
+{
+	assert(scheme);
+	if (!scheme)
+		return NULL;
+
+	return scheme->ptypes;
+}
+
+
+bool_t kscheme_add_var(kscheme_t *scheme, kvar_t *var)
+{
+	assert(scheme);
+	if (!scheme)
+		return BOOL_FALSE;
+	assert(var);
+	if (!var)
+		return BOOL_FALSE;
+
+	if (!faux_list_add(scheme->vars, var))
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+kvar_t *kscheme_find_var(const kscheme_t *scheme, const char *name)
+{
+	assert(scheme);
+	if (!scheme)
+		return NULL;
+	assert(name);
+	if (!name)
+		return NULL;
+
+	return (kvar_t *)faux_list_kfind(scheme->vars, name);
+}
+
+
+const faux_list_t *kscheme_vars(const kscheme_t *scheme)
+{
+	assert(scheme);
+	if (!scheme)
+		return NULL;
+
+	return scheme->vars;
+}
+
+
+bool_t kscheme_add_plugin(kscheme_t *scheme, kplugin_t *plugin)
+{
+	assert(scheme);
+	if (!scheme)
+		return BOOL_FALSE;
+	assert(plugin);
+	if (!plugin)
+		return BOOL_FALSE;
+
+	if (!faux_list_add(scheme->plugins, plugin))
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Finds plugin by name or alias
+ */
+kplugin_t *kscheme_find_plugin(const kscheme_t *scheme, const char *name)
+{
+	faux_list_node_t *iter = NULL;
+	kplugin_t *plugin = NULL;
+
+	assert(scheme);
+	if (!scheme)
+		return NULL;
+	assert(name);
+	if (!name)
+		return NULL;
+
+	plugin = (kplugin_t *)faux_list_kfind(scheme->plugins, name);
+	if (plugin)
+		return plugin;
+
+	iter = faux_list_head(scheme->plugins);
+	while ((plugin = (kplugin_t *)faux_list_each(&iter))) {
+		const char *alias = kplugin_alias(plugin);
+		if (alias && !strcmp(alias, name))
+			return plugin;
+	}
+
+	return NULL;
+}
+
+
+const faux_list_t *kscheme_plugins(const kscheme_t *scheme)
+{
+	assert(scheme);
+	if (!scheme)
+		return NULL;
+
+	return scheme->plugins;
+}
+
+
+const char *kscheme_startup_ref(const kscheme_t *scheme)
+{
+	assert(scheme);
+	if (!scheme)
+		return NULL;
+
+	return scheme->startup_ref;
+}
+
+
+bool_t kscheme_set_startup_ref(kscheme_t *scheme, const char *startup_ref)
+{
+	assert(scheme);
+	if (!scheme)
+		return BOOL_FALSE;
+
+	faux_str_free(scheme->startup_ref);
+	scheme->startup_ref = faux_str_dup(startup_ref);
+	scheme->startup = NULL;
+
+	return BOOL_TRUE;
+}
+
+
+kview_t *kscheme_startup(const kscheme_t *scheme)
+{
+	assert(scheme);
+	if (!scheme)
+		return NULL;
+
+	return scheme->startup;
+}
+
+
+/** @brief Moves commands and namespaces of one view to another one
+ *
+ * The views with the same name can be defined within different files.
+ * The resulting view contains all the commands.
+ */
+static int kscheme_merge_view(kview_t *dst, kview_t *src, char **error)
+{
+	faux_list_node_t *iter = NULL;
+	kview_bind_t *bind = NULL;
+	int i = 0;
+
+	if (kview_is_template(dst) != kview_is_template(src)) {
+		if (error)
+			*error = faux_str_sprintf("VIEW \"%s\": Defined as both "
+				"VIEW and TEMPLATE", kview_name(dst));
+		return -1;
+	}
+
+	if (!kview_prompt(dst) && kview_prompt(src))
+		kview_set_prompt(dst, kview_prompt(src));
+
+	if (kview_template_ref(src)) {
+		if (kview_template_ref(dst) && strcmp(kview_template_ref(dst),
+			kview_template_ref(src))) {
+			if (error)
+				*error = faux_str_sprintf("VIEW \"%s\": "
+					"Conflicting templates \"%s\" and "
+					"\"%s\"", kview_name(dst),
+					kview_template_ref(dst),
+					kview_template_ref(src));
+			return -1;
+		}
+		kview_set_template_ref(dst, kview_template_ref(src));
+	}
+
+	iter = faux_list_head(src->binds);
+	while ((bind = (kview_bind_t *)faux_list_each(&iter))) {
+		if (!kview_add_bind(dst, bind->name, bind->value)) {
+			if (error)
+				*error = faux_str_sprintf("VIEW \"%s\": "
+					"Duplicate BIND \"%s\"",
+					kview_name(dst), bind->name);
+			return -1;
+		}
+	}
+
+	for (i = 0; i < KVIEW_HOTKEY_NUM; i++) {
+		if (!src->hotkeys[i])
+			continue;
+		if (dst->hotkeys[i]) {
+			if (error)
+				*error = faux_str_sprintf("VIEW \"%s\": "
+					"Duplicate HOTKEY \"^%c\"",
+					kview_name(dst), '@' + i);
+			return -1;
+		}
+		dst->hotkeys[i] = src->hotkeys[i];
+		src->hotkeys[i] = NULL;
+	}
+
+	while ((iter = faux_list_head(src->commands))) {
+		kcommand_t *command = (kcommand_t *)faux_list_data(iter);
+		if (kview_find_command(dst, kcommand_name(command))) {
+			if (error)
+				*error = faux_str_sprintf(
+					"VIEW \"%s\": Duplicate COMMAND \"%s\"",
+					kview_name(dst), kcommand_name(command));
+			return -1;
+		}
+		faux_list_takeaway(src->commands, iter);
+		kview_add_command(dst, command);
+	}
+
+	while ((iter = faux_list_head(src->nspaces))) {
+		knspace_t *nspace = (knspace_t *)faux_list_takeaway(
+			src->nspaces, iter);
+		kview_add_nspace(dst, nspace);
+	}
+
+	return 0;
+}
+
+
+/** @brief Moves all the objects from source scheme to the destination one
+ *
+ * The scheme can be loaded from several files. Each file is loaded into
+ * its own scheme object and then merged into the resulting one. The
+ * references are not resolved so kscheme_link() must be called after
+ * all the files are merged. The source scheme is not valid after merge
+ * and must be freed anyway.
+ *
+ * @param [in] scheme Destination scheme.
+ * @param [in] src Source scheme.
+ * @param [out] error Error message. Must be freed by faux_str_free().
+ * @return 0 - success, < 0 - error.
+ */
+int kscheme_merge(kscheme_t *scheme, kscheme_t *src, char **error)
+{
+	faux_list_node_t *iter = NULL;
+
+	assert(scheme);
+	if (!scheme)
+		return -1;
+	assert(src);
+	if (!src)
+		return -1;
+
+	// VIEWs. The global view is merged like any other one.
+	while ((iter = faux_list_head(src->views))) {
+		kview_t *view = (kview_t *)faux_list_data(iter);
+		kview_t *dst = kscheme_find_view(scheme, kview_name(view));
+		if (!dst) {
+			faux_list_takeaway(src->views, iter);
+			kscheme_add_view(scheme, view);
+			continue;
+		}
+		if (kscheme_merge_view(dst, view, error) < 0)
+			return -1;
+		faux_list_del(src->views, iter);
+	}
+	src->global = NULL;
+
+	// PTYPEs
+	while ((iter = faux_list_head(src->ptypes))) {
+		kptype_t *ptype = (kptype_t *)faux_list_data(iter);
+		if (kscheme_find_ptype(scheme, kptype_name(ptype))) {
+			if (error)
+				*error = faux_str_sprintf(
+					"Duplicate PTYPE \"%s\"",
+					kptype_name(ptype));
+			return -1;
+		}
+		faux_list_takeaway(src->ptypes, iter);
+		kscheme_add_ptype(scheme, ptype);
+	}
+
+	// VARs
+	while ((iter = faux_list_head(src->vars))) {
+		kvar_t *var = (kvar_t *)faux_list_data(iter);
+		if (kscheme_find_var(scheme, kvar_name(var))) {
+			if (error)
+				*error = faux_str_sprintf(
+					"Duplicate VAR \"%s\"",
+					kvar_name(var));
+			return -1;
+		}
+		faux_list_takeaway(src->vars, iter);
+		kscheme_add_var(scheme, var);
+	}
+
+	// PLUGINs
+	while ((iter = faux_list_head(src->plugins))) {
+		kplugin_t *plugin = (kplugin_t *)faux_list_data(iter);
+		if (kscheme_find_plugin(scheme, kplugin_name(plugin))) {
+			if (error)
+				*error = faux_str_sprintf(
+					"Duplicate PLUGIN \"%s\"",
+					kplugin_name(plugin));
+			return -1;
+		}
+		faux_list_takeaway(src->plugins, iter);
+		kscheme_add_plugin(scheme, plugin);
+	}
+
+	// STARTUP
+	if (src->startup_ref) {
+		if (scheme->startup_ref) {
+			if (error)
+				*error = faux_str_sprintf("Duplicate STARTUP");
+			return -1;
+		}
+		kscheme_set_startup_ref(scheme, src->startup_ref);
+	}
+
+	return 0;
+}
+
+
+/** @brief Resolves PTYPE references of parameters recursively
+ */
+static int kscheme_link_params(kscheme_t *scheme, const kview_t *view,
+	const kcommand_t *command, const faux_list_t *params, char **error)
+{
+	faux_list_node_t *iter = NULL;
+	kparam_t *param = NULL;
+
+	iter = faux_list_head(params);
+	while ((param = (kparam_t *)faux_list_each(&iter))) {
+		const char *ref = kparam_ptype_ref(param);
+		kptype_t *ptype = NULL;
+		if (ref) {
+			ptype = kscheme_find_ptype(scheme, ref);
+			if (!ptype) {
+				if (error)
+					*error = faux_str_sprintf(
+						"VIEW \"%s\", COMMAND \"%s\", "
+						"PARAM \"%s\": Unknown PTYPE "
+						"\"%s\"",
+						kview_name(view),
+						kcommand_name(command),
+						kparam_name(param), ref);
+				return -1;
+			}
+		}
+		kparam_set_ptype(param, ptype);
+		if (kscheme_link_params(scheme, view, command,
+			kparam_params(param), error) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+
+/** @brief Resolves ACTION's plugin
+ *
+ * The symbol can be specified as "<sym>@<plugin>" where plugin is
+ * a name or alias of PLUGIN. The symbol without plugin is searched
+ * within all plugins in runtime.
+ */
+static int kscheme_link_action(kscheme_t *scheme, kaction_t *action,
+	const char *owner, char **error)
+{
+	const char *sym = NULL;
+	const char *at = NULL;
+	kplugin_t *plugin = NULL;
+
+	if (!action)
+		return 0;
+	kaction_set_plugin(action, NULL);
+	sym = kaction_sym(action);
+	if (!sym)
+		return 0;
+	at = strrchr(sym, '@');
+	if (!at)
+		return 0;
+
+	plugin = kscheme_find_plugin(scheme, at + 1);
+	if (!plugin || (at == sym)) {
+		if (error)
+			*error = faux_str_sprintf("%s, ACTION \"%s\": Unknown "
+				"PLUGIN \"%s\"", owner, sym, at + 1);
+		return -1;
+	}
+	kaction_set_plugin(action, plugin);
+
+	return 0;
+}
+
+
+/** @brief Resolves plugins of all ACTIONs
+ */
+static int kscheme_link_actions(kscheme_t *scheme, char **error)
+{
+	faux_list_node_t *view_iter = NULL;
+	faux_list_node_t *iter = NULL;
+	kview_t *view = NULL;
+	kptype_t *ptype = NULL;
+	kvar_t *var = NULL;
+	char *owner = NULL;
+	int retval = 0;
+
+	view_iter = faux_list_head(scheme->views);
+	while ((view = (kview_t *)faux_list_each(&view_iter))) {
+		kcommand_t *command = NULL;
+		iter = faux_list_head(kview_commands(view));
+		while ((command = (kcommand_t *)faux_list_each(&iter))) {
+			owner = faux_str_sprintf("VIEW \"%s\", COMMAND \"%s\"",
+				kview_name(view), kcommand_name(command));
+			retval = kscheme_link_action(scheme,
+				kcommand_action(command), owner, error);
+			faux_str_free(owner);
+			if (retval < 0)
+				return -1;
+		}
+	}
+
+	iter = faux_list_head(scheme->ptypes);
+	while ((ptype = (kptype_t *)faux_list_each(&iter))) {
+		owner = faux_str_sprintf("PTYPE \"%s\"", kptype_name(ptype));
+		retval = kscheme_link_action(scheme, kptype_action(ptype),
+			owner, error);
+		faux_str_free(owner);
+		if (retval < 0)
+			return -1;
+	}
+
+	iter = faux_list_head(scheme->vars);
+	while ((var = (kvar_t *)faux_list_each(&iter))) {
+		owner = faux_str_sprintf("VAR \"%s\"", kvar_name(var));
+		retval = kscheme_link_action(scheme, kvar_action(var),
+			owner, error);
+		faux_str_free(owner);
+		if (retval < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+
+/** @brief Adds command to the list of VAR's dependent commands
+ */
+static bool_t kscheme_add_dep(kscheme_t *scheme, const char *var, size_t id)
+{
+	kscheme_dep_t *dep = NULL;
+	size_t *new_ids = NULL;
+
+	dep = (kscheme_dep_t *)faux_list_kfind(scheme->deps, var);
+	if (!dep) {
+		dep = faux_zmalloc(sizeof(*dep));
+		assert(dep);
+		if (!dep)
+			return BOOL_FALSE;
+		dep->var = faux_str_dup(var);
+		faux_list_add(scheme->deps, dep);
+	}
+	new_ids = realloc(dep->ids, (dep->ids_num + 1) * sizeof(*new_ids));
+	assert(new_ids);
+	if (!new_ids)
+		return BOOL_FALSE;
+	dep->ids = new_ids;
+	dep->ids[dep->ids_num] = id;
+	dep->ids_num++;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Numbers commands and builds VAR dependencies of conditions
+ *
+ * The dense command identifiers allow the session to keep visibility of
+ * all commands within bitmaps.
+ */
+static bool_t kscheme_index_commands(kscheme_t *scheme)
+{
+	faux_list_node_t *view_iter = NULL;
+	kview_t *view = NULL;
+	faux_list_t *binds = NULL;
+	size_t id = 0;
+
+	// Remove old dependencies. The link can be called more than once.
+	faux_list_free(scheme->deps);
+	scheme->deps = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		kscheme_dep_compare, kscheme_dep_kcompare, kscheme_dep_free);
+	assert(scheme->deps);
+
+	// Names of all BINDs. The condition which uses one of them depends
+	// on the template's instance the command is found within.
+	binds = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		kscheme_str_compare, kscheme_str_compare, NULL);
+	assert(binds);
+	view_iter = faux_list_head(scheme->views);
+	while ((view = (kview_t *)faux_list_each(&view_iter))) {
+		size_t i = 0;
+		for (i = 0; i < kview_binds_num(view); i++)
+			faux_list_add(binds, (void *)kview_bind_name(view, i));
+	}
+
+	view_iter = faux_list_head(scheme->views);
+	while ((view = (kview_t *)faux_list_each(&view_iter))) {
+		faux_list_node_t *iter = NULL;
+		kcommand_t *command = NULL;
+
+		iter = faux_list_head(kview_commands(view));
+		while ((command = (kcommand_t *)faux_list_each(&iter))) {
+			size_t i = 0;
+			bool_t bound = BOOL_FALSE;
+			kcommand_set_id(command, id);
+			if (kcommand_cond_class(command) == KCOND_VAR) {
+				for (i = 0; i < kcommand_cond_vars_num(command); i++) {
+					const char *var = kcommand_cond_var(
+						command, i);
+					if (faux_list_kfind(binds, var))
+						bound = BOOL_TRUE;
+					if (!kscheme_add_dep(scheme, var, id)) {
+						faux_list_free(binds);
+						return BOOL_FALSE;
+					}
+				}
+			}
+			kcommand_set_bound(command, bound);
+			id++;
+		}
+	}
+	scheme->commands_num = id;
+	faux_list_free(binds);
+
+	return BOOL_TRUE;
+}
+
+
+size_t kscheme_commands_num(const kscheme_t *scheme)
+{
+	assert(scheme);
+	if (!scheme)
+		return 0;
+
+	return scheme->commands_num;
+}
+
+
+// FNV-1a hash. The terminating zero is hashed too so "ab","c" differs from
+// "a","bc" and NULL differs from empty string.
+#define KSCHEME_FNV_BASIS 2166136261u
+#define KSCHEME_FNV_PRIME 16777619u
+
+static uint32_t kscheme_digest_str(uint32_t hash, const char *str)
+{
+	if (!str)
+		return (hash ^ 0xffu) * KSCHEME_FNV_PRIME;
+	do {
+		hash = (hash ^ (unsigned char)*str) * KSCHEME_FNV_PRIME;
+	} while (*str++);
+
+	return hash;
+}
+
+
+static uint32_t kscheme_digest_params(uint32_t hash, const faux_list_t *params)
+{
+	faux_list_node_t *iter = NULL;
+	kparam_t *param = NULL;
+
+	iter = faux_list_head(params);
+	while ((param = (kparam_t *)faux_list_each(&iter))) {
+		hash = kscheme_digest_str(hash, kparam_name(param));
+		hash = kscheme_digest_str(hash, kparam_help(param));
+		hash = kscheme_digest_str(hash, kparam_ptype_ref(param));
+		hash = kscheme_digest_params(hash, kparam_params(param));
+	}
+
+	return hash;
+}
+
+
+/** @brief Calculates version of scheme
+ *
+ * The version is a digest of data the client caches for local context help:
+ * names and help of commands, params and ptypes. So the client can detect
+ * the cached data is out of date.
+ */
+static void kscheme_digest(kscheme_t *scheme)
+{
+	faux_list_node_t *iter = NULL;
+	kview_t *view = NULL;
+	kptype_t *ptype = NULL;
+	uint32_t hash = KSCHEME_FNV_BASIS;
+
+	iter = faux_list_head(scheme->views);
+	while ((view = (kview_t *)faux_list_each(&iter))) {
+		faux_list_node_t *cmd_iter = NULL;
+		kcommand_t *command = NULL;
+		hash = kscheme_digest_str(hash, kview_name(view));
+		cmd_iter = faux_list_head(kview_commands(view));
+		while ((command = (kcommand_t *)faux_list_each(&cmd_iter))) {
+			hash = kscheme_digest_str(hash, kcommand_name(command));
+			hash = kscheme_digest_str(hash, kcommand_help(command));
+			hash = kscheme_digest_str(hash, kcommand_cond(command));
+			hash = kscheme_digest_params(hash,
+				kcommand_params(command));
+		}
+	}
+	iter = faux_list_head(scheme->ptypes);
+	while ((ptype = (kptype_t *)faux_list_each(&iter))) {
+		hash = kscheme_digest_str(hash, kptype_name(ptype));
+		hash = kscheme_digest_str(hash, kptype_help(ptype));
+	}
+
+	scheme->version = hash;
+}
+
+
+uint32_t kscheme_version(const kscheme_t *scheme)
+{
+	assert(scheme);
+	if (!scheme)
+		return 0;
+
+	return scheme->version;
+}
+
+
+/** @brief Gets identifiers of commands which conditions depend on VAR
+ *
+ * @param [in] scheme Scheme object.
+ * @param [in] var VAR name.
+ * @param [out] num Number of dependent commands.
+ * @return Array of command identifiers or NULL if there are no ones.
+ */
+const size_t *kscheme_cond_deps(const kscheme_t *scheme, const char *var,
+	size_t *num)
+{
+	kscheme_dep_t *dep = NULL;
+
+	assert(scheme);
+	if (!scheme)
+		return NULL;
+	assert(var);
+	if (!var)
+		return NULL;
+
+	dep = (kscheme_dep_t *)faux_list_kfind(scheme->deps, var);
+	if (!dep)
+		return NULL;
+	if (num)
+		*num = dep->ids_num;
+
+	return dep->ids;
+}
+
+
+/** @brief Check for namespace and template loops
+ *
+ * The inherited namespaces and templates are expanded recursively while
+ * path's level index building so the loop will lead to infinite recursion.
+ */
+static bool_t kscheme_nspace_loop(const kview_t *view, const kview_t **stack,
+	size_t depth, size_t max_depth)
+{
+	faux_list_node_t *iter = NULL;
+	knspace_t *nspace = NULL;
+	size_t i = 0;
+
+	for (i = 0; i < depth; i++) {
+		if (stack[i] == view)
+			return BOOL_TRUE;
+	}
+	if (depth >= max_depth)
+		return BOOL_TRUE;
+	stack[depth] = view;
+
+	iter = faux_list_head(kview_nspaces(view));
+	while ((nspace = (knspace_t *)faux_list_each(&iter))) {
+		if (!knspace_inherit(nspace))
+			continue;
+		if (kscheme_nspace_loop(knspace_view(nspace),
+			stack, depth + 1, max_depth))
+			return BOOL_TRUE;
+	}
+
+	if (kview_template(view) && kscheme_nspace_loop(kview_template(view),
+		stack, depth + 1, max_depth))
+		return BOOL_TRUE;
+
+	return BOOL_FALSE;
+}
+
+
+/** @brief Resolve references between scheme objects
+ *
+ * Resolves NAMESPACE's view references, VIEW's templates, COMMAND's
+ * navigation targets, PARAM's PTYPE references, ACTION's plugins and
+ * STARTUP view, numbers commands and collects VARs the visibility
+ * conditions depend on.
+ * Must be called after the whole scheme is loaded.
+ *
+ * @param [in] scheme Scheme object.
+ * @param [out] error Error message. Must be freed by faux_str_free().
+ * @return 0 - success, < 0 - error.
+ */
+int kscheme_link(kscheme_t *scheme, char **error)
+{
+	faux_list_node_t *view_iter = NULL;
+	kview_t *view = NULL;
+	const kview_t **stack = NULL;
+	size_t views_num = 0;
+	int retval = -1;
+
+	assert(scheme);
+	if (!scheme)
+		return -1;
+
+	view_iter = faux_list_head(scheme->views);
+	while ((view = (kview_t *)faux_list_each(&view_iter))) {
+		faux_list_node_t *iter = NULL;
+		knspace_t *nspace = NULL;
+		kcommand_t *command = NULL;
+
+		// TEMPLATE reference
+		kview_set_template(view, NULL);
+		if (kview_template_ref(view)) {
+			kview_t *ref = kscheme_find_view(scheme,
+				kview_template_ref(view));
+			if (!ref || !kview_is_template(ref)) {
+				if (error)
+					*error = faux_str_sprintf(
+						"VIEW \"%s\": Unknown TEMPLATE "
+						"\"%s\"", kview_name(view),
+						kview_template_ref(view));
+				return -1;
+			}
+			kview_set_template(view, ref);
+		}
+
+		// NAMESPACE references
+		iter = faux_list_head(kview_nspaces(view));
+		while ((nspace = (knspace_t *)faux_list_each(&iter))) {
+			kview_t *ref = kscheme_find_view(scheme,
+				knspace_view_ref(nspace));
+			if (!ref) {
+				if (error)
+					*error = faux_str_sprintf(
+						"VIEW \"%s\": Unknown NAMESPACE "
+						"reference \"%s\"",
+						kview_name(view),
+						knspace_view_ref(nspace));
+				return -1;
+			}
+			knspace_set_view(nspace, ref);
+		}
+
+		// Navigation targets
+		iter = faux_list_head(kview_commands(view));
+		while ((command = (kcommand_t *)faux_list_each(&iter))) {
+			const char *name = kcommand_nav_view_name(command);
+			kview_t *target = NULL;
+			if (!name)
+				continue;
+			target = kscheme_find_view(scheme, name);
+			// The TEMPLATE can't be entered
+			if (!target || kview_is_template(target)) {
+				if (error)
+					*error = faux_str_sprintf(
+						"VIEW \"%s\", COMMAND \"%s\": "
+						"Unknown navigation target "
+						"\"%s\"",
+						kview_name(view),
+						kcommand_name(command), name);
+				return -1;
+			}
+			kcommand_set_nav_view(command, target);
+		}
+
+		// PTYPE references
+		iter = faux_list_head(kview_commands(view));
+		while ((command = (kcommand_t *)faux_list_each(&iter))) {
+			if (kscheme_link_params(scheme, view, command,
+				kcommand_params(command), error) < 0)
+				return -1;
+		}
+	}
+
+	// ACTION's plugins
+	if (kscheme_link_actions(scheme, error) < 0)
+		return -1;
+
+	// STARTUP view
+	scheme->startup = NULL;
+	if (scheme->startup_ref) {
+		scheme->startup = kscheme_find_view(scheme, scheme->startup_ref);
+		if (!scheme->startup || kview_is_template(scheme->startup)) {
+			if (error)
+				*error = faux_str_sprintf(
+					"STARTUP: Unknown VIEW \"%s\"",
+					scheme->startup_ref);
+			return -1;
+		}
+	}
+
+	if (!kscheme_index_commands(scheme))
+		return -1;
+	kscheme_digest(scheme);
+
+	// Namespace loops. The namespace chain can't be longer than
+	// the number of views.
+	views_num = faux_list_len(scheme->views);
+	stack = faux_zmalloc(sizeof(*stack) * (views_num + 1));
+	assert(stack);
+	if (!stack)
+		return -1;
+	view_iter = faux_list_head(scheme->views);
+	while ((view = (kview_t *)faux_list_each(&view_iter))) {
+		if (kscheme_nspace_loop(view, stack, 0, views_num + 1)) {
+			if (error)
+				*error = faux_str_sprintf(
+					"VIEW \"%s\": NAMESPACE or TEMPLATE "
+					"loop detected",
+					kview_name(view));
+			goto err;
+		}
+	}
+
+	retval = 0;
+
+err:
+	faux_free(stack);
+
+	return retval;
+}
@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <faux/str.h>
+#include <faux/list.h>
+#include <klish/kvar.h>
+
+#include "private.h"
+
+
+kvar_t *kvar_new(const char *name)
+{
+	kvar_t *var = NULL;
+
+	if (!name)
+		return NULL;
+
+	var = faux_zmalloc(sizeof(*var));
+	assert(var);
+	if (!var)
+		return NULL;
+
+	// Initialize
+	var->name = faux_str_dup(name);
+	var->help = NULL;
+	var->value = NULL;
+	var->dynamic = BOOL_FALSE;
+	var->action = NULL;
+
+	return var;
+}
+
+
+void kvar_free(kvar_t *var)
+{
+	if (!var)
+		return;
+
+	faux_str_free(var->name);
+	faux_str_free(var->help);
+	faux_str_free(var->value);
+	kaction_free(var->action);
+	faux_free(var);
+}
+
+
+const char *kvar_name(const kvar_t *var)
+{
+	assert(var);
+	if (!var)
+		return NULL;
+
+	return var->name;
+}
+
+
+const char *kvar_help(const kvar_t *var)
+{
+	assert(var);
+	if (!var)
+		return NULL;
+
+	return var->help;
+}
+
+
+bool_t kvar_set_help(kvar_t *var, const char *help)
+{
+	assert(var);
+	if (!var)
+		return BOOL_FALSE;
+
+	faux_str_free(var->help);
+	var->help = faux_str_dup(help);
+
+	return BOOL_TRUE;
+}
+
+
+const char *kvar_value(const kvar_t *var)
+{
+	assert(var);
+	if (!var)
+		return NULL;
+
+	return var->value;
+}
+
+
+bool_t kvar_set_value(kvar_t *var, const char *value)
+{
+	assert(var);
+	if (!var)
+		return BOOL_FALSE;
+
+	faux_str_free(var->value);
+	var->value = faux_str_dup(value);
+
+	return BOOL_TRUE;
+}
+
+
+bool_t kvar_dynamic(const kvar_t *var)
+{
+	assert(var);
+	if (!var)
+		return BOOL_FALSE;
+
+	return var->dynamic;
+}
+
+
+void kvar_set_dynamic(kvar_t *var, bool_t dynamic)
+{
+	assert(var);
+	if (!var)
+		return;
+
+	var->dynamic = dynamic;
+}
+
+
+kaction_t *kvar_action(const kvar_t *var)
+{
+	assert(var);
+	if (!var)
+		return NULL;
+
+	return var->action;
+}
+
+
+void kvar_set_action(kvar_t *var, kaction_t *action)
+{
+	assert(var);
+	if (!var)
+		return;
+
+	kaction_free(var->action);
+	var->action = action;
+}
@@ -0,0 +1,489 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <faux/str.h>
+#include <faux/list.h>
+#include <klish/kview.h>
+
+#include "private.h"
+
+
+static int kview_command_compare(const void *first, const void *second)
+{
+	const kcommand_t *f = (const kcommand_t *)first;
+	const kcommand_t *s = (const kcommand_t *)second;
+
+	return strcmp(kcommand_name(f), kcommand_name(s));
+}
+
+
+static int kview_command_kcompare(const void *key, const void *list_item)
+{
+	const char *f = (const char *)key;
+	const kcommand_t *s = (const kcommand_t *)list_item;
+
+	return strcmp(f, kcommand_name(s));
+}
+
+
+static int kview_bind_compare(const void *first, const void *second)
+{
+	const kview_bind_t *f = (const kview_bind_t *)first;
+	const kview_bind_t *s = (const kview_bind_t *)second;
+
+	return strcmp(f->name, s->name);
+}
+
+
+static int kview_bind_kcompare(const void *key, const void *list_item)
+{
+	const char *f = (const char *)key;
+	const kview_bind_t *s = (const kview_bind_t *)list_item;
+
+	return strcmp(f, s->name);
+}
+
+
+static void kview_bind_free(void *data)
+{
+	kview_bind_t *bind = (kview_bind_t *)data;
+
+	if (!bind)
+		return;
+
+	faux_str_free(bind->name);
+	faux_str_free(bind->value);
+	faux_free(bind);
+}
+
+
+kview_t *kview_new(const char *name)
+{
+	kview_t *view = NULL;
+
+	if (!name)
+		return NULL;
+
+	view = faux_zmalloc(sizeof(*view));
+	assert(view);
+	if (!view)
+		return NULL;
+
+	// Initialize
+	view->name = faux_str_dup(name);
+	view->prompt = NULL;
+	view->inherit = BOOL_TRUE;
+	view->completion = BOOL_TRUE;
+	view->context_help = BOOL_TRUE;
+
+	view->commands = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		kview_command_compare, kview_command_kcompare,
+		(void (*)(void *))kcommand_free);
+	assert(view->commands);
+	view->nspaces = faux_list_new(FAUX_LIST_UNSORTED, FAUX_LIST_NONUNIQUE,
+		NULL, NULL, (void (*)(void *))knspace_free);
+	assert(view->nspaces);
+	view->is_template = BOOL_FALSE;
+	view->template_ref = NULL;
+	view->tmpl = NULL;
+	view->binds = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		kview_bind_compare, kview_bind_kcompare, kview_bind_free);
+	assert(view->binds);
+	memset(view->hotkeys, 0, sizeof(view->hotkeys));
+
+	return view;
+}
+
+
+void kview_free(kview_t *view)
+{
+	int i = 0;
+
+	if (!view)
+		return;
+
+	faux_str_free(view->name);
+	faux_str_free(view->prompt);
+	faux_list_free(view->commands);
+	faux_list_free(view->nspaces);
+	faux_str_free(view->template_ref);
+	faux_list_free(view->binds);
+	for (i = 0; i < KVIEW_HOTKEY_NUM; i++)
+		faux_str_free(view->hotkeys[i]);
+	faux_free(view);
+}
+
+
+const char *kview_name(const kview_t *view)
+{
+	assert(view);
+	if (!view)
+		return NULL;
+
+	return view->name;
+}
+
+
+const char *kview_prompt(const kview_t *view)
+{
+	assert(view);
+	if (!view)
+		return NULL;
+
+	return view->prompt;
+}
+
+
+bool_t kview_set_prompt(kview_t *view, const char *prompt)
+{
+	assert(view);
+	if (!view)
+		return BOOL_FALSE;
+
+	faux_str_free(view->prompt);
+	view->prompt = faux_str_dup(prompt);
+
+	return BOOL_TRUE;
+}
+
+
+bool_t kview_inherit(const kview_t *view)
+{
+	assert(view);
+	if (!view)
+		return BOOL_FALSE;
+
+	return view->inherit;
+}
+
+
+void kview_set_inherit(kview_t *view, bool_t inherit)
+{
+	assert(view);
+	if (!view)
+		return;
+
+	view->inherit = inherit;
+}
+
+
+bool_t kview_completion(const kview_t *view)
+{
+	assert(view);
+	if (!view)
+		return BOOL_FALSE;
+
+	return view->completion;
+}
+
+
+void kview_set_completion(kview_t *view, bool_t completion)
+{
+	assert(view);
+	if (!view)
+		return;
+
+	view->completion = completion;
+}
+
+
+bool_t kview_context_help(const kview_t *view)
+{
+	assert(view);
+	if (!view)
+		return BOOL_FALSE;
+
+	return view->context_help;
+}
+
+
+void kview_set_context_help(kview_t *view, bool_t context_help)
+{
+	assert(view);
+	if (!view)
+		return;
+
+	view->context_help = context_help;
+}
+
+
+bool_t kview_add_command(kview_t *view, kcommand_t *command)
+{
+	assert(view);
+	if (!view)
+		return BOOL_FALSE;
+	assert(command);
+	if (!command)
+		return BOOL_FALSE;
+
+	if (!faux_list_add(view->commands, command))
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+kcommand_t *kview_find_command(const kview_t *view, const char *name)
+{
+	assert(view);
+	if (!view)
+		return NULL;
+	assert(name);
+	if (!name)
+		return NULL;
+
+	return (kcommand_t *)faux_list_kfind(view->commands, name);
+}
+
+
+const faux_list_t *kview_commands(const kview_t *view)
+{
+	assert(view);
+	if (!view)
+		return NULL;
+
+	return view->commands;
+}
+
+
+bool_t kview_add_nspace(kview_t *view, knspace_t *nspace)
+{
+	assert(view);
+	if (!view)
+		return BOOL_FALSE;
+	assert(nspace);
+	if (!nspace)
+		return BOOL_FALSE;
+
+	if (!faux_list_add(view->nspaces, nspace))
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+const faux_list_t *kview_nspaces(const kview_t *view)
+{
+	assert(view);
+	if (!view)
+		return NULL;
+
+	return view->nspaces;
+}
+
+
+bool_t kview_is_template(const kview_t *view)
+{
+	assert(view);
+	if (!view)
+		return BOOL_FALSE;
+
+	return view->is_template;
+}
+
+
+void kview_set_is_template(kview_t *view, bool_t is_template)
+{
+	assert(view);
+	if (!view)
+		return;
+
+	view->is_template = is_template;
+}
+
+
+const char *kview_template_ref(const kview_t *view)
+{
+	assert(view);
+	if (!view)
+		return NULL;
+
+	return view->template_ref;
+}
+
+
+bool_t kview_set_template_ref(kview_t *view, const char *template_ref)
+{
+	assert(view);
+	if (!view)
+		return BOOL_FALSE;
+
+	faux_str_free(view->template_ref);
+	view->template_ref = faux_str_dup(template_ref);
+
+	return BOOL_TRUE;
+}
+
+
+kview_t *kview_template(const kview_t *view)
+{
+	assert(view);
+	if (!view)
+		return NULL;
+
+	return view->tmpl;
+}
+
+
+void kview_set_template(kview_t *view, kview_t *tmpl)
+{
+	assert(view);
+	if (!view)
+		return;
+
+	view->tmpl = tmpl;
+}
+
+
+bool_t kview_add_bind(kview_t *view, const char *name, const char *value)
+{
+	kview_bind_t *bind = NULL;
+
+	assert(view);
+	if (!view)
+		return BOOL_FALSE;
+	assert(name);
+	if (!name)
+		return BOOL_FALSE;
+
+	if (faux_list_kfind(view->binds, name))
+		return BOOL_FALSE;
+	bind = faux_zmalloc(sizeof(*bind));
+	assert(bind);
+	if (!bind)
+		return BOOL_FALSE;
+	bind->name = faux_str_dup(name);
+	bind->value = faux_str_dup(value ? value : "");
+	faux_list_add(view->binds, bind);
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Gets value of template's parameter
+ *
+ * The instance's own BINDs are searched first. Then the BINDs of
+ * template chain (default values).
+ *
+ * @return Value or NULL if parameter is not bound.
+ */
+const char *kview_bind(const kview_t *view, const char *name)
+{
+	assert(view);
+	if (!view)
+		return NULL;
+	assert(name);
+	if (!name)
+		return NULL;
+
+	// The template chain is checked for loops by kscheme_link()
+	while (view) {
+		kview_bind_t *bind = (kview_bind_t *)faux_list_kfind(
+			view->binds, name);
+		if (bind)
+			return bind->value;
+		view = view->tmpl;
+	}
+
+	return NULL;
+}
+
+
+size_t kview_binds_num(const kview_t *view)
+{
+	assert(view);
+	if (!view)
+		return 0;
+
+	return faux_list_len(view->binds);
+}
+
+
+const char *kview_bind_name(const kview_t *view, size_t index)
+{
+	faux_list_node_t *iter = NULL;
+	kview_bind_t *bind = NULL;
+
+	assert(view);
+	if (!view)
+		return NULL;
+
+	iter = faux_list_head(view->binds);
+	while ((bind = (kview_bind_t *)faux_list_each(&iter))) {
+		if (0 == index)
+			return bind->name;
+		index--;
+	}
+
+	return NULL;
+}
+
+
+/** @brief Gets code of hotkey by its name
+ *
+ * The key is a control key in caret notation like "^Z". The lower case
+ * letters are accepted too.
+ *
+ * @return Code or -1 on illegal key.
+ */
+int kview_hotkey_code(const char *key)
+{
+	char c = '\0';
+
+	if (!key || (key[0] != '^') || (key[1] == '\0') || (key[2] != '\0'))
+		return -1;
+	c = key[1];
+	if ((c >= 'a') && (c <= 'z'))
+		c = c - 'a' + 'A';
+	if ((c < '@') || (c > '_'))
+		return -1;
+
+	return c - '@';
+}
+
+
+bool_t kview_add_hotkey(kview_t *view, int code, const char *cmd)
+{
+	assert(view);
+	if (!view)
+		return BOOL_FALSE;
+	assert(cmd);
+	if (!cmd)
+		return BOOL_FALSE;
+	if ((code < 0) || (code >= KVIEW_HOTKEY_NUM))
+		return BOOL_FALSE;
+
+	if (view->hotkeys[code])
+		return BOOL_FALSE;
+	view->hotkeys[code] = faux_str_dup(cmd);
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Gets command bound to hotkey
+ *
+ * The view's own hotkeys are searched first. Then the hotkeys of template
+ * chain.
+ *
+ * @return Command line or NULL if key is not bound.
+ */
+const char *kview_hotkey(const kview_t *view, int code)
+{
+	assert(view);
+	if (!view)
+		return NULL;
+	if ((code < 0) || (code >= KVIEW_HOTKEY_NUM))
+		return NULL;
+
+	// The template chain is checked for loops by kscheme_link()
+	while (view) {
+		if (view->hotkeys[code])
+			return view->hotkeys[code];
+		view = view->tmpl;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,149 @@
+#ifndef _klish_kscheme_private_h
+#define _klish_kscheme_private_h
+
+#include <faux/list.h>
+#include <klish/kscheme.h>
+#include <klish/kview.h>
+#include <klish/kcommand.h>
+#include <klish/knspace.h>
+#include <klish/kaction.h>
+#include <klish/kptype.h>
+#include <klish/kparam.h>
+#include <klish/kvar.h>
+#include <klish/kplugin.h>
+
+
+struct kplugin_s {
+	char *name;
+	char *alias;
+	char *file;
+	bool_t rtld_global;
+	char *conf;
+};
+
+
+struct kaction_s {
+	char *sym;
+	kplugin_t *plugin; // Resolved by kscheme_link()
+	char *script;
+	char *shebang;
+	bool_t interactive;
+	bool_t lock;
+	bool_t interrupt;
+	bool_t records; // Writes structured records
+	bool_t batch; // Consecutive commands are executed by single call
+	unsigned int timeout; // Wall-clock limit
+	unsigned int cpu; // CPU time limit
+};
+
+
+struct kptype_s {
+	char *name;
+	char *help;
+	char *pattern;
+	kptype_method_e method;
+	kptype_preprocess_e preprocess;
+	kaction_t *action;
+};
+
+
+struct kparam_s {
+	char *name;
+	char *help;
+	char *ptype_ref;
+	kptype_t *ptype; // Resolved by kscheme_link()
+	kparam_mode_e mode;
+	bool_t optional;
+	char *defval;
+	char *prefix;
+	char *value;
+	faux_list_t *params; // Nested params
+};
+
+
+struct kvar_s {
+	char *name;
+	char *help;
+	char *value;
+	bool_t dynamic;
+	kaction_t *action;
+};
+
+
+struct kcommand_s {
+	char *name;
+	char *help;
+	knav_e nav;
+	char *nav_view_name;
+	kview_t *nav_view; // Resolved by kscheme_link()
+	ssize_t nav_num; // Number of levels for "up", level for "replace"
+	size_t id; // Dense index within scheme. Set by kscheme_link().
+	char *access;
+	char *cond;
+	kcond_e cond_class;
+	char **cond_vars; // Names of VARs the condition depends on
+	size_t cond_vars_num;
+	char *detail;
+	faux_list_t *params;
+	kaction_t *action;
+	bool_t bound; // Condition uses BIND of template's instance
+	unsigned int cache_ttl; // Seconds to keep output within cache
+	char **cache_vars; // Names of VARs the output depends on
+	size_t cache_vars_num;
+};
+
+
+struct knspace_s {
+	char *view_ref;
+	kview_t *view; // Resolved by kscheme_link()
+	char *prefix;
+	bool_t inherit;
+	bool_t completion;
+	bool_t context_help;
+};
+
+
+typedef struct {
+	char *name;
+	char *value;
+} kview_bind_t;
+
+
+struct kview_s {
+	char *name;
+	char *prompt;
+	bool_t inherit;
+	bool_t completion;
+	bool_t context_help;
+	faux_list_t *commands;
+	faux_list_t *nspaces;
+	bool_t is_template;
+	char *template_ref;
+	kview_t *tmpl; // Resolved by kscheme_link()
+	faux_list_t *binds; // Per-instance values of template's parameters
+	char *hotkeys[KVIEW_HOTKEY_NUM]; // Commands indexed by key code
+};
+
+
+// The list of commands which conditions depend on VAR
+typedef struct {
+	char *var;
+	size_t *ids;
+	size_t ids_num;
+} kscheme_dep_t;
+
+
+struct kscheme_s {
+	kview_t *global;
+	faux_list_t *views;
+	faux_list_t *ptypes;
+	faux_list_t *vars;
+	faux_list_t *plugins;
+	char *startup_ref;
+	kview_t *startup; // Resolved by kscheme_link()
+	size_t commands_num;
+	faux_list_t *deps; // VAR name -> commands
+	uint32_t version; // Digest of help data. Set by kscheme_link().
+};
+
+#endif // _klish_kscheme_private_h
@@ -0,0 +1,64 @@
+/** @file ksession.h
+ *
+ * @brief Klish session. The state of the single client: current path,
+ * user, VARs and visibility of commands.
+ */
+
+#ifndef _klish_ksession_h
+#define _klish_ksession_h
+
+#include <sys/types.h>
+
+#include <faux/faux.h>
+#include <klish/kscheme.h>
+#include <klish/kpath.h>
+#include <klish/ktoken.h>
+
+typedef struct ksession_s ksession_t;
+
+/** @brief Evaluates dynamic condition of command
+ *
+ * @return BOOL_TRUE if command is visible.
+ */
+typedef bool_t (*ksession_cond_fn)(ksession_t *session,
+	const kcommand_t *command, void *udata);
+
+
+C_DECL_BEGIN
+
+ksession_t *ksession_new(kscheme_t *scheme, kview_t *start);
+void ksession_free(ksession_t *session);
+
+kscheme_t *ksession_scheme(const ksession_t *session);
+kpath_t *ksession_path(const ksession_t *session);
+
+// User
+bool_t ksession_login(ksession_t *session, const char *user,
+	uid_t uid, gid_t gid);
+const char *ksession_user(const ksession_t *session);
+uid_t ksession_uid(const ksession_t *session);
+gid_t ksession_gid(const ksession_t *session);
+
+// VARs
+bool_t ksession_set_var(ksession_t *session, const char *name,
+	const char *value);
+const char *ksession_get_var(const ksession_t *session, const char *name);
+
+// Visibility of commands
+void ksession_set_cond_fn(ksession_t *session, ksession_cond_fn fn,
+	void *udata);
+bool_t ksession_command_visible(ksession_t *session,
+	const kcommand_t *command);
+const klevel_cmd_t *ksession_find_command(ksession_t *session,
+	const char *name);
+const klevel_cmd_t *ksession_parse_command(ksession_t *session,
+	const ktokens_t *tokens, size_t *words);
+char *ksession_cache_key(ksession_t *session, const klevel_cmd_t *cmd,
+	const ktokens_t *tokens);
+
+// Hotkeys of current level
+const char * const *ksession_hotkeys(ksession_t *session);
+
+C_DECL_END
+
+#endif // _klish_ksession_h
@@ -0,0 +1,277 @@
+/** @file kcond.c
+ *
+ * @brief Evaluation of command's visibility condition
+ *
+ * The condition is an expression similar to 'test' utility one:
+ *
+ * expr := and ["-o" expr]
+ * and := unary ["-a" and]
+ * unary := "!" unary | "-n" arg | "-z" arg | arg op arg | arg
+ * op := "=" | "!=" | "-eq" | "-ne" | "-lt" | "-le" | "-gt" | "-ge"
+ *
+ * The arguments can be quoted by '"' or '\''. The "${name}" references
+ * are replaced by the values of session VARs.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include <faux/str.h>
+#include <faux/conv.h>
+
+#include "private.h"
+
+#define KCOND_TOKENS_MAX 64
+
+typedef struct {
+	char *text; // Value after substitution
+	bool_t quoted; // Quoted token can't be an operator
+} kcond_token_t;
+
+typedef struct {
+	kcond_token_t tokens[KCOND_TOKENS_MAX];
+	size_t num;
+	size_t pos;
+	bool_t error;
+} kcond_parser_t;
+
+
+/** @brief Appends string with substituted VAR references
+ */
+static void kcond_expand(char **dst, const char *src, size_t len,
+	kcond_var_fn getter, void *udata)
+{
+	const char *end = src + len;
+	const char *pos = src;
+
+	while (pos < end) {
+		const char *ref = NULL;
+		const char *close = NULL;
+		char *name = NULL;
+		const char *value = NULL;
+
+		ref = strstr(pos, "${");
+		if (!ref || (ref >= end)) {
+			faux_str_catn(dst, pos, end - pos);
+			break;
+		}
+		faux_str_catn(dst, pos, ref - pos);
+		close = strchr(ref + 2, '}');
+		if (!close || (close >= end)) {
+			faux_str_catn(dst, ref, end - ref);
+			break;
+		}
+		name = faux_str_dupn(ref + 2, close - ref - 2);
+		if (getter)
+			value = getter(name, udata);
+		faux_str_free(name);
+		if (value)
+			faux_str_cat(dst, value);
+		pos = close + 1;
+	}
+}
+
+
+static bool_t kcond_tokenize(kcond_parser_t *parser, const char *expr,
+	kcond_var_fn getter, void *udata)
+{
+	const char *pos = expr;
+
+	while (*pos) {
+		const char *start = NULL;
+		kcond_token_t *token = NULL;
+
+		while (*pos && isspace((unsigned char)*pos))
+			pos++;
+		if ('\0' == *pos)
+			break;
+		if (parser->num >= KCOND_TOKENS_MAX)
+			return BOOL_FALSE;
+		token = &parser->tokens[parser->num];
+		token->text = faux_str_dup("");
+		token->quoted = BOOL_FALSE;
+
+		if (('"' == *pos) || ('\'' == *pos)) {
+			char quote = *pos;
+			pos++;
+			start = pos;
+			while (*pos && (*pos != quote))
+				pos++;
+			if ('\0' == *pos) { // Unclosed quote
+				faux_str_free(token->text);
+				return BOOL_FALSE;
+			}
+			kcond_expand(&token->text, start, pos - start,
+				getter, udata);
+			token->quoted = BOOL_TRUE;
+			pos++;
+		} else {
+			start = pos;
+			while (*pos && !isspace((unsigned char)*pos))
+				pos++;
+			kcond_expand(&token->text, start, pos - start,
+				getter, udata);
+			// Substituted value is never an operator
+			if (memchr(start, '$', pos - start))
+				token->quoted = BOOL_TRUE;
+		}
+		parser->num++;
+	}
+
+	return BOOL_TRUE;
+}
+
+
+static bool_t kcond_is_op(const kcond_parser_t *parser, size_t i,
+	const char *op)
+{
+	if (i >= parser->num)
+		return BOOL_FALSE;
+	if (parser->tokens[i].quoted)
+		return BOOL_FALSE;
+
+	return (strcmp(parser->tokens[i].text, op) == 0) ?
+		BOOL_TRUE : BOOL_FALSE;
+}
+
+
+static const char *kcond_arg(kcond_parser_t *parser)
+{
+	if (parser->pos >= parser->num) {
+		parser->error = BOOL_TRUE;
+		return "";
+	}
+
+	return parser->tokens[parser->pos++].text;
+}
+
+
+static bool_t kcond_compare_int(const char *a, const char *b, const char *op)
+{
+	long int x = 0;
+	long int y = 0;
+
+	if (!faux_conv_atol(a, &x, 10) || !faux_conv_atol(b, &y, 10))
+		return BOOL_FALSE;
+
+	if (strcmp(op, "-eq") == 0)
+		return (x == y) ? BOOL_TRUE : BOOL_FALSE;
+	if (strcmp(op, "-ne") == 0)
+		return (x != y) ? BOOL_TRUE : BOOL_FALSE;
+	if (strcmp(op, "-lt") == 0)
+		return (x < y) ? BOOL_TRUE : BOOL_FALSE;
+	if (strcmp(op, "-le") == 0)
+		return (x <= y) ? BOOL_TRUE : BOOL_FALSE;
+	if (strcmp(op, "-gt") == 0)
+		return (x > y) ? BOOL_TRUE : BOOL_FALSE;
+	if (strcmp(op, "-ge") == 0)
+		return (x >= y) ? BOOL_TRUE : BOOL_FALSE;
+
+	return BOOL_FALSE;
+}
+
+
+static bool_t kcond_unary(kcond_parser_t *parser)
+{
+	static const char *int_ops[] = {
+		"-eq", "-ne", "-lt", "-le", "-gt", "-ge", NULL };
+	const char *a = NULL;
+	const char *b = NULL;
+	size_t i = 0;
+
+	if (kcond_is_op(parser, parser->pos, "!")) {
+		parser->pos++;
+		return !kcond_unary(parser);
+	}
+	if (kcond_is_op(parser, parser->pos, "-n")) {
+		parser->pos++;
+		return ('\0' != *kcond_arg(parser)) ? BOOL_TRUE : BOOL_FALSE;
+	}
+	if (kcond_is_op(parser, parser->pos, "-z")) {
+		parser->pos++;
+		return ('\0' == *kcond_arg(parser)) ? BOOL_TRUE : BOOL_FALSE;
+	}
+
+	a = kcond_arg(parser);
+	if (kcond_is_op(parser, parser->pos, "=")) {
+		parser->pos++;
+		b = kcond_arg(parser);
+		return (strcmp(a, b) == 0) ? BOOL_TRUE : BOOL_FALSE;
+	}
+	if (kcond_is_op(parser, parser->pos, "!=")) {
+		parser->pos++;
+		b = kcond_arg(parser);
+		return (strcmp(a, b) != 0) ? BOOL_TRUE : BOOL_FALSE;
+	}
+	for (i = 0; int_ops[i]; i++) {
+		if (kcond_is_op(parser, parser->pos, int_ops[i])) {
+			parser->pos++;
+			b = kcond_arg(parser);
+			return kcond_compare_int(a, b, int_ops[i]);
+		}
+	}
+
+	return ('\0' != *a) ? BOOL_TRUE : BOOL_FALSE;
+}
+
+
+static bool_t kcond_and(kcond_parser_t *parser)
+{
+	bool_t res = kcond_unary(parser);
+
+	while (kcond_is_op(parser, parser->pos, "-a")) {
+		parser->pos++;
+		if (!kcond_unary(parser))
+			res = BOOL_FALSE;
+	}
+
+	return res;
+}
+
+
+static bool_t kcond_or(kcond_parser_t *parser)
+{
+	bool_t res = kcond_and(parser);
+
+	while (kcond_is_op(parser, parser->pos, "-o")) {
+		parser->pos++;
+		if (kcond_and(parser))
+			res = BOOL_TRUE;
+	}
+
+	return res;
+}
+
+
+/** @brief Evaluates condition expression
+ *
+ * @param [in] expr Expression.
+ * @param [in] getter Function to get VAR value by name.
+ * @param [in] udata User data for getter.
+ * @return BOOL_TRUE if condition is true. The malformed expression is false.
+ */
+bool_t kcond_eval(const char *expr, kcond_var_fn getter, void *udata)
+{
+	kcond_parser_t parser = {};
+	bool_t res = BOOL_FALSE;
+	size_t i = 0;
+
+	if (!expr)
+		return BOOL_TRUE;
+
+	if (kcond_tokenize(&parser, expr, getter, udata) &&
+		(parser.num > 0)) {
+		res = kcond_or(&parser);
+		// Garbage at the end
+		if (parser.error || (parser.pos != parser.num))
+			res = BOOL_FALSE;
+	}
+
+	for (i = 0; i < parser.num; i++)
+		faux_str_free(parser.tokens[i].text);
+
+	return res;
+}
@@ -0,0 +1,396 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <faux/str.h>
+#include <faux/list.h>
+#include <klish/kpath.h>
+
+#include "private.h"
+
+// Temporary entry for index building. The order is used to find out which
+// one of commands with the same name was added first.
+typedef struct {
+	klevel_cmd_t cmd;
+	size_t order;
+} klevel_build_t;
+
+typedef struct {
+	klevel_build_t *items;
+	size_t len;
+	size_t size;
+} klevel_builder_t;
+
+
+klevel_t *klevel_new(kview_t *view, klevel_t *parent)
+{
+	klevel_t *level = NULL;
+
+	assert(view);
+	if (!view)
+		return NULL;
+
+	level = faux_zmalloc(sizeof(*level));
+	assert(level);
+	if (!level)
+		return NULL;
+
+	// Initialize
+	level->view = view;
+	level->parent = parent;
+	level->depth = parent ? (parent->depth + 1) : 0;
+	level->indexed = BOOL_FALSE;
+	level->index = NULL;
+	level->index_len = 0;
+	level->names = NULL;
+	level->names_len = 0;
+	level->names_size = 0;
+	level->hotkeys_resolved = BOOL_FALSE;
+	memset(level->hotkeys, 0, sizeof(level->hotkeys));
+
+	return level;
+}
+
+
+void klevel_free(klevel_t *level)
+{
+	size_t i = 0;
+
+	if (!level)
+		return;
+
+	for (i = 0; i < level->names_len; i++)
+		faux_str_free(level->names[i]);
+	free(level->names);
+	free(level->index);
+	faux_free(level);
+}
+
+
+kview_t *klevel_view(const klevel_t *level)
+{
+	assert(level);
+	if (!level)
+		return NULL;
+
+	return level->view;
+}
+
+
+klevel_t *klevel_parent(const klevel_t *level)
+{
+	assert(level);
+	if (!level)
+		return NULL;
+
+	return level->parent;
+}
+
+
+size_t klevel_depth(const klevel_t *level)
+{
+	assert(level);
+	if (!level)
+		return 0;
+
+	return level->depth;
+}
+
+
+/** @brief Gets value of template's parameter bound by level's view
+ */
+const char *klevel_bind(const klevel_t *level, const char *name)
+{
+	assert(level);
+	if (!level)
+		return NULL;
+
+	return kview_bind(level->view, name);
+}
+
+
+/** @brief Gets map of hotkeys available on the level
+ *
+ * The map is indexed by key code. The hotkeys of level's view (and its
+ * template) mask the hotkeys of lower levels if view inherits them. The
+ * map is resolved once and is kept while level exists.
+ *
+ * @return Array of KVIEW_HOTKEY_NUM commands. NULL entry is unbound key.
+ */
+const char * const *klevel_hotkeys(klevel_t *level)
+{
+	const char * const *parent_hotkeys = NULL;
+	int i = 0;
+
+	assert(level);
+	if (!level)
+		return NULL;
+
+	if (level->hotkeys_resolved)
+		return level->hotkeys;
+
+	if (level->parent && kview_inherit(level->view))
+		parent_hotkeys = klevel_hotkeys(level->parent);
+	for (i = 0; i < KVIEW_HOTKEY_NUM; i++) {
+		level->hotkeys[i] = kview_hotkey(level->view, i);
+		if (!level->hotkeys[i] && parent_hotkeys)
+			level->hotkeys[i] = parent_hotkeys[i];
+	}
+	level->hotkeys_resolved = BOOL_TRUE;
+
+	return level->hotkeys;
+}
+
+
+static bool_t klevel_builder_add(klevel_builder_t *builder, const char *name,
+	kcommand_t *command, klevel_t *level, unsigned int flags)
+{
+	klevel_build_t *item = NULL;
+
+	if (builder->len == builder->size) {
+		size_t new_size = builder->size ? (builder->size * 2) : 16;
+		klevel_build_t *new_items = NULL;
+		new_items = realloc(builder->items,
+			new_size * sizeof(*new_items));
+		assert(new_items);
+		if (!new_items)
+			return BOOL_FALSE;
+		builder->items = new_items;
+		builder->size = new_size;
+	}
+	item = &builder->items[builder->len];
+	item->cmd.name = name;
+	item->cmd.command = command;
+	item->cmd.level = level;
+	item->cmd.flags = flags;
+	item->order = builder->len;
+	builder->len++;
+
+	return BOOL_TRUE;
+}
+
+
+static const char *klevel_add_name(klevel_t *level, char *name)
+{
+	if (level->names_len == level->names_size) {
+		size_t new_size = level->names_size ?
+			(level->names_size * 2) : 16;
+		char **new_names = NULL;
+
+		new_names = realloc(level->names,
+			new_size * sizeof(*new_names));
+		assert(new_names);
+		if (!new_names) {
+			faux_str_free(name);
+			return NULL;
+		}
+		level->names = new_names;
+		level->names_size = new_size;
+	}
+	level->names[level->names_len] = name;
+	level->names_len++;
+
+	return name;
+}
+
+
+/** @brief Collects commands of view and its namespaces
+ */
+static bool_t klevel_collect(klevel_t *level, klevel_builder_t *builder,
+	const kview_t *view, const char *prefix, unsigned int flags)
+{
+	faux_list_node_t *iter = NULL;
+	kcommand_t *command = NULL;
+	knspace_t *nspace = NULL;
+
+	iter = faux_list_head(kview_commands(view));
+	while ((command = (kcommand_t *)faux_list_each(&iter))) {
+		const char *name = kcommand_name(command);
+		if (prefix) {
+			name = klevel_add_name(level,
+				faux_str_sprintf("%s %s", prefix, name));
+			if (!name)
+				return BOOL_FALSE;
+		}
+		if (!klevel_builder_add(builder, name, command, level, flags))
+			return BOOL_FALSE;
+	}
+
+	iter = faux_list_head(kview_nspaces(view));
+	while ((nspace = (knspace_t *)faux_list_each(&iter))) {
+		const kview_t *nview = knspace_view(nspace);
+		const char *nprefix = knspace_prefix(nspace);
+		char *full_prefix = NULL;
+		unsigned int nflags = flags;
+		faux_list_node_t *niter = NULL;
+		bool_t res = BOOL_TRUE;
+
+		if (!nview) // Not linked
+			continue;
+		if (!knspace_completion(nspace))
+			nflags &= ~KLEVEL_CMD_COMPLETION;
+		if (!knspace_context_help(nspace))
+			nflags &= ~KLEVEL_CMD_CONTEXT_HELP;
+		if (prefix && nprefix)
+			full_prefix = faux_str_sprintf("%s %s", prefix, nprefix);
+		else if (prefix || nprefix)
+			full_prefix = faux_str_dup(prefix ? prefix : nprefix);
+
+		if (knspace_inherit(nspace)) {
+			res = klevel_collect(level, builder, nview,
+				full_prefix, nflags);
+		} else {
+			// Own commands of referenced view only
+			niter = faux_list_head(kview_commands(nview));
+			while ((command = (kcommand_t *)faux_list_each(&niter))) {
+				const char *name = kcommand_name(command);
+				if (full_prefix) {
+					name = klevel_add_name(level,
+						faux_str_sprintf("%s %s",
+						full_prefix, name));
+					if (!name) {
+						res = BOOL_FALSE;
+						break;
+					}
+				}
+				if (!klevel_builder_add(builder, name, command,
+					level, nflags)) {
+					res = BOOL_FALSE;
+					break;
+				}
+			}
+		}
+		faux_str_free(full_prefix);
+		if (!res)
+			return BOOL_FALSE;
+	}
+
+	// The template's commands are shared by all its instances. They are
+	// collected after the own ones so the instance can override them.
+	if (kview_template(view))
+		return klevel_collect(level, builder, kview_template(view),
+			prefix, flags);
+
+	return BOOL_TRUE;
+}
+
+
+static int klevel_build_compare(const void *first, const void *second)
+{
+	const klevel_build_t *f = (const klevel_build_t *)first;
+	const klevel_build_t *s = (const klevel_build_t *)second;
+	int res = 0;
+
+	res = strcmp(f->cmd.name, s->cmd.name);
+	if (res != 0)
+		return res;
+	if (f->order < s->order)
+		return -1;
+	if (f->order > s->order)
+		return 1;
+
+	return 0;
+}
+
+
+/** @brief Builds sorted index of all commands available on the level
+ *
+ * The index contains commands of level's view, commands of its namespaces
+ * and (if view inherits lower levels) the index of parent level. The
+ * higher level commands mask the lower level commands with the same name.
+ * So search for the command is a single binary search instead of the search
+ * within each level and each namespace.
+ */
+static bool_t klevel_build_index(klevel_t *level)
+{
+	klevel_builder_t builder = {};
+	const klevel_cmd_t *parent_index = NULL;
+	size_t parent_len = 0;
+	unsigned int parent_mask = ~0u;
+	size_t own_len = 0;
+	size_t i = 0;
+	size_t j = 0;
+	size_t k = 0;
+
+	if (!klevel_collect(level, &builder, level->view, NULL,
+		KLEVEL_CMD_COMPLETION | KLEVEL_CMD_CONTEXT_HELP)) {
+		free(builder.items);
+		return BOOL_FALSE;
+	}
+
+	// Sort own commands and remove duplicates. The first one wins.
+	if (builder.len > 1)
+		qsort(builder.items, builder.len, sizeof(*builder.items),
+			klevel_build_compare);
+	for (i = 0; i < builder.len; i++) {
+		if ((own_len > 0) && (strcmp(builder.items[own_len - 1].cmd.name,
+			builder.items[i].cmd.name) == 0))
+			continue;
+		builder.items[own_len] = builder.items[i];
+		own_len++;
+	}
+
+	// Lower levels
+	if (level->parent && kview_inherit(level->view)) {
+		parent_index = klevel_index(level->parent, &parent_len);
+		if (!kview_completion(level->view))
+			parent_mask &= ~KLEVEL_CMD_COMPLETION;
+		if (!kview_context_help(level->view))
+			parent_mask &= ~KLEVEL_CMD_CONTEXT_HELP;
+	}
+
+	level->index = malloc((own_len + parent_len + 1) *
+		sizeof(*level->index));
+	assert(level->index);
+	if (!level->index) {
+		free(builder.items);
+		return BOOL_FALSE;
+	}
+
+	// Merge two sorted arrays
+	i = 0;
+	j = 0;
+	k = 0;
+	while ((i < own_len) || (j < parent_len)) {
+		int res = 0;
+		if (i >= own_len)
+			res = 1;
+		else if (j >= parent_len)
+			res = -1;
+		else
+			res = strcmp(builder.items[i].cmd.name,
+				parent_index[j].name);
+		if (res <= 0) {
+			level->index[k++] = builder.items[i++].cmd;
+			if (0 == res) // Masked by higher level
+				j++;
+		} else {
+			level->index[k] = parent_index[j++];
+			level->index[k].flags &= parent_mask;
+			k++;
+		}
+	}
+	level->index_len = k;
+	free(builder.items);
+
+	return BOOL_TRUE;
+}
+
+
+const klevel_cmd_t *klevel_index(klevel_t *level, size_t *len)
+{
+	assert(level);
+	if (!level)
+		return NULL;
+
+	if (!level->indexed) {
+		if (!klevel_build_index(level))
+			return NULL;
+		level->indexed = BOOL_TRUE;
+	}
+	if (len)
+		*len = level->index_len;
+
+	return level->index;
+}
@@ -0,0 +1,347 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <faux/str.h>
+#include <klish/kpath.h>
+
+#include "private.h"
+
+
+/** @brief Creates path
+ *
+ * @param [in] global Global view. It's a level 0.
+ * @param [in] start Starting view. It's a level 1. Can be NULL.
+ * @return Path object or NULL on error.
+ */
+kpath_t *kpath_new(kview_t *global, kview_t *start)
+{
+	kpath_t *path = NULL;
+
+	assert(global);
+	if (!global)
+		return NULL;
+
+	path = faux_zmalloc(sizeof(*path));
+	assert(path);
+	if (!path)
+		return NULL;
+
+	// Initialize
+	path->current = klevel_new(global, NULL);
+	assert(path->current);
+	if (!path->current) {
+		faux_free(path);
+		return NULL;
+	}
+	if (start && !kpath_down(path, start)) {
+		kpath_free(path);
+		return NULL;
+	}
+
+	return path;
+}
+
+
+void kpath_free(kpath_t *path)
+{
+	klevel_t *level = NULL;
+
+	if (!path)
+		return;
+
+	level = path->current;
+	while (level) {
+		klevel_t *parent = klevel_parent(level);
+		klevel_free(level);
+		level = parent;
+	}
+	faux_free(path);
+}
+
+
+size_t kpath_depth(const kpath_t *path)
+{
+	assert(path);
+	if (!path)
+		return 0;
+
+	return klevel_depth(path->current);
+}
+
+
+klevel_t *kpath_current(const kpath_t *path)
+{
+	assert(path);
+	if (!path)
+		return NULL;
+
+	return path->current;
+}
+
+
+klevel_t *kpath_level(const kpath_t *path, size_t depth)
+{
+	klevel_t *level = NULL;
+
+	assert(path);
+	if (!path)
+		return NULL;
+
+	level = path->current;
+	while (level && (klevel_depth(level) > depth))
+		level = klevel_parent(level);
+
+	return level;
+}
+
+
+static void kpath_pop(kpath_t *path, size_t num)
+{
+	size_t i = 0;
+
+	for (i = 0; (i < num) && klevel_parent(path->current); i++) {
+		klevel_t *level = path->current;
+		path->current = klevel_parent(level);
+		klevel_free(level);
+	}
+}
+
+
+/** @brief Enters nested view
+ */
+bool_t kpath_down(kpath_t *path, kview_t *view)
+{
+	klevel_t *level = NULL;
+
+	assert(path);
+	if (!path)
+		return BOOL_FALSE;
+	assert(view);
+	if (!view)
+		return BOOL_FALSE;
+
+	level = klevel_new(view, path->current);
+	if (!level)
+		return BOOL_FALSE;
+	path->current = level;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Leaves nested views
+ *
+ * The level 1 can't be left. The caller must exit in this case.
+ *
+ * @param [in] path Path object.
+ * @param [in] num Number of levels to go up.
+ * @return BOOL_TRUE on success or BOOL_FALSE if it's an attempt to go
+ * above level 1.
+ */
+bool_t kpath_up(kpath_t *path, size_t num)
+{
+	assert(path);
+	if (!path)
+		return BOOL_FALSE;
+
+	if ((num + 1) > kpath_depth(path))
+		return BOOL_FALSE;
+	kpath_pop(path, num);
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Replaces view on specified level
+ *
+ * Replacing of current level's view is O(1). When the lower level is
+ * replaced then higher levels are rebuilt with the same views because
+ * their indexes depend on lower ones.
+ *
+ * @param [in] path Path object.
+ * @param [in] view New view.
+ * @param [in] depth Level to replace view on. The 0 means current level.
+ * @return BOOL_TRUE on success, BOOL_FALSE on illegal level.
+ */
+bool_t kpath_replace(kpath_t *path, kview_t *view, size_t depth)
+{
+	size_t cur_depth = 0;
+	size_t num = 0;
+	kview_t **upper = NULL;
+	size_t i = 0;
+	klevel_t *level = NULL;
+
+	assert(path);
+	if (!path)
+		return BOOL_FALSE;
+	assert(view);
+	if (!view)
+		return BOOL_FALSE;
+
+	cur_depth = kpath_depth(path);
+	if (0 == depth)
+		depth = cur_depth;
+	if ((depth < 1) || (depth > cur_depth))
+		return BOOL_FALSE;
+
+	// Save views of upper levels
+	num = cur_depth - depth;
+	if (num > 0) {
+		upper = faux_zmalloc(num * sizeof(*upper));
+		assert(upper);
+		if (!upper)
+			return BOOL_FALSE;
+		level = path->current;
+		for (i = num; i > 0; i--) {
+			upper[i - 1] = klevel_view(level);
+			level = klevel_parent(level);
+		}
+	}
+
+	// Replace
+	kpath_pop(path, num + 1);
+	kpath_down(path, view);
+	for (i = 0; i < num; i++)
+		kpath_down(path, upper[i]);
+	faux_free(upper);
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Executes command's navigation
+ *
+ * @param [in] path Path object.
+ * @param [in] command Command with navigation info.
+ * @return 0 - success, 1 - exit is requested, < 0 - navigation error.
+ */
+int kpath_nav(kpath_t *path, const kcommand_t *command)
+{
+	kview_t *view = NULL;
+	ssize_t num = 0;
+
+	assert(path);
+	if (!path)
+		return -1;
+	assert(command);
+	if (!command)
+		return -1;
+
+	view = kcommand_nav_view(command);
+	num = kcommand_nav_num(command);
+
+	switch (kcommand_nav(command)) {
+	case KNAV_NONE:
+		break;
+	case KNAV_DOWN:
+		if (!view || !kpath_down(path, view))
+			return -1;
+		break;
+	case KNAV_UP:
+		// Attempt to go above level 1 leads to exit
+		if (!kpath_up(path, (num > 0) ? num : 1))
+			return 1;
+		break;
+	case KNAV_REPLACE:
+		if (!view || !kpath_replace(path, view, (num > 0) ? num : 0))
+			return -1;
+		break;
+	case KNAV_EXIT:
+		return 1;
+	}
+
+	return 0;
+}
+
+
+static int kpath_cmd_kcompare(const void *key, const void *item)
+{
+	const char *f = (const char *)key;
+	const klevel_cmd_t *s = (const klevel_cmd_t *)item;
+
+	return strcmp(f, s->name);
+}
+
+
+/** @brief Finds command by its full name
+ *
+ * @param [in] path Path object.
+ * The returned entry is valid until the path is changed.
+ *
+ * @param [in] name Full command name.
+ * @return Found command or NULL.
+ */
+const klevel_cmd_t *kpath_find(kpath_t *path, const char *name)
+{
+	const klevel_cmd_t *index = NULL;
+	size_t len = 0;
+
+	assert(path);
+	if (!path)
+		return NULL;
+	assert(name);
+	if (!name)
+		return NULL;
+
+	index = klevel_index(path->current, &len);
+	if (!index || (0 == len))
+		return NULL;
+
+	return bsearch(name, index, len, sizeof(*index), kpath_cmd_kcompare);
+}
+
+
+/** @brief Finds all commands starting with prefix
+ *
+ * The found commands are consecutive entries of sorted index.
+ *
+ * @param [in] path Path object.
+ * @param [in] prefix Prefix of command name.
+ * @param [out] num Number of found commands.
+ * @return Pointer to the first found command or NULL.
+ */
+const klevel_cmd_t *kpath_find_prefix(kpath_t *path, const char *prefix,
+	size_t *num)
+{
+	const klevel_cmd_t *index = NULL;
+	size_t len = 0;
+	size_t prefix_len = 0;
+	size_t low = 0;
+	size_t high = 0;
+	size_t end = 0;
+
+	assert(path);
+	if (!path)
+		return NULL;
+	assert(prefix);
+	if (!prefix)
+		return NULL;
+	if (num)
+		*num = 0;
+
+	index = klevel_index(path->current, &len);
+	if (!index || (0 == len))
+		return NULL;
+
+	// Lower bound
+	high = len;
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if (strcmp(index[mid].name, prefix) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	prefix_len = strlen(prefix);
+	end = low;
+	while ((end < len) && (strncmp(index[end].name, prefix, prefix_len) == 0))
+		end++;
+	if (end == low)
+		return NULL;
+	if (num)
+		*num = end - low;
+
+	return &index[low];
+}
@@ -0,0 +1,670 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include <sys/types.h>
+#include <grp.h>
+
+#include <faux/str.h>
+#include <faux/list.h>
+#include <klish/ksession.h>
+
+#include "private.h"
+
+#define KSESSION_GROUPS_MAX 256
+
+
+static int ksession_var_compare(const void *first, const void *second)
+{
+	const ksession_var_t *f = (const ksession_var_t *)first;
+	const ksession_var_t *s = (const ksession_var_t *)second;
+
+	return strcmp(f->name, s->name);
+}
+
+
+static int ksession_var_kcompare(const void *key, const void *list_item)
+{
+	const char *f = (const char *)key;
+	const ksession_var_t *s = (const ksession_var_t *)list_item;
+
+	return strcmp(f, s->name);
+}
+
+
+static void ksession_var_free(void *data)
+{
+	ksession_var_t *var = (ksession_var_t *)data;
+
+	if (!var)
+		return;
+
+	faux_str_free(var->name);
+	faux_str_free(var->value);
+	faux_free(var);
+}
+
+
+static void ksession_free_groups(ksession_t *session)
+{
+	size_t i = 0;
+
+	for (i = 0; i < session->groups_num; i++)
+		faux_str_free(session->groups[i]);
+	faux_free(session->groups);
+	session->groups = NULL;
+	session->groups_num = 0;
+}
+
+
+static void ksession_free_bitmaps(ksession_t *session)
+{
+	faux_free(session->vis_static);
+	faux_free(session->vis_var);
+	faux_free(session->vis_dirty);
+	session->vis_static = NULL;
+	session->vis_var = NULL;
+	session->vis_dirty = NULL;
+}
+
+
+static bool_t ksession_update_visibility(ksession_t *session);
+
+
+ksession_t *ksession_new(kscheme_t *scheme, kview_t *start)
+{
+	ksession_t *session = NULL;
+
+	assert(scheme);
+	if (!scheme)
+		return NULL;
+
+	session = faux_zmalloc(sizeof(*session));
+	assert(session);
+	if (!session)
+		return NULL;
+
+	// Initialize
+	session->scheme = scheme;
+	session->path = kpath_new(kscheme_global(scheme), start);
+	assert(session->path);
+	session->user = NULL;
+	session->uid = (uid_t)-1;
+	session->gid = (gid_t)-1;
+	session->groups = NULL;
+	session->groups_num = 0;
+	session->vars = faux_list_new(FAUX_LIST_SORTED, FAUX_LIST_UNIQUE,
+		ksession_var_compare, ksession_var_kcompare,
+		ksession_var_free);
+	assert(session->vars);
+	session->cond_fn = NULL;
+	session->cond_udata = NULL;
+
+	// Anonymous user can see commands without access restrictions only
+	ksession_update_visibility(session);
+
+	return session;
+}
+
+
+void ksession_free(ksession_t *session)
+{
+	if (!session)
+		return;
+
+	kpath_free(session->path);
+	faux_str_free(session->user);
+	ksession_free_groups(session);
+	faux_list_free(session->vars);
+	ksession_free_bitmaps(session);
+	faux_free(session);
+}
+
+
+kscheme_t *ksession_scheme(const ksession_t *session)
+{
+	assert(session);
+	if (!session)
+		return NULL;
+
+	return session->scheme;
+}
+
+
+kpath_t *ksession_path(const ksession_t *session)
+{
+	assert(session);
+	if (!session)
+		return NULL;
+
+	return session->path;
+}
+
+
+const char *ksession_user(const ksession_t *session)
+{
+	assert(session);
+	if (!session)
+		return NULL;
+
+	return session->user;
+}
+
+
+uid_t ksession_uid(const ksession_t *session)
+{
+	assert(session);
+	if (!session)
+		return (uid_t)-1;
+
+	return session->uid;
+}
+
+
+gid_t ksession_gid(const ksession_t *session)
+{
+	assert(session);
+	if (!session)
+		return (gid_t)-1;
+
+	return session->gid;
+}
+
+
+static int ksession_str_compare(const void *first, const void *second)
+{
+	return strcmp(*(char * const *)first, *(char * const *)second);
+}
+
+
+/** @brief Sets session's user
+ *
+ * Gets names of user's groups and evaluates static visibility of all
+ * commands (access rights and conditions without VARs) once.
+ *
+ * @param [in] session Session object.
+ * @param [in] user User name.
+ * @param [in] uid User ID.
+ * @param [in] gid User's primary group ID.
+ * @return BOOL_TRUE on success, BOOL_FALSE on error.
+ */
+bool_t ksession_login(ksession_t *session, const char *user,
+	uid_t uid, gid_t gid)
+{
+	gid_t groups[KSESSION_GROUPS_MAX];
+	int groups_num = KSESSION_GROUPS_MAX;
+	int i = 0;
+
+	assert(session);
+	if (!session)
+		return BOOL_FALSE;
+	assert(user);
+	if (!user)
+		return BOOL_FALSE;
+
+	faux_str_free(session->user);
+	session->user = faux_str_dup(user);
+	session->uid = uid;
+	session->gid = gid;
+
+	// Resolve group names once. So access check is a string comparison.
+	ksession_free_groups(session);
+	if (getgrouplist(user, gid, groups, &groups_num) < 0) {
+		groups[0] = gid;
+		groups_num = 1;
+	}
+	session->groups = faux_zmalloc(groups_num * sizeof(*session->groups));
+	assert(session->groups);
+	if (!session->groups)
+		return BOOL_FALSE;
+	for (i = 0; i < groups_num; i++) {
+		struct group *gr = getgrgid(groups[i]);
+		if (!gr)
+			continue;
+		session->groups[session->groups_num] = faux_str_dup(gr->gr_name);
+		session->groups_num++;
+	}
+	qsort(session->groups, session->groups_num, sizeof(*session->groups),
+		ksession_str_compare);
+
+	return ksession_update_visibility(session);
+}
+
+
+bool_t ksession_set_var(ksession_t *session, const char *name,
+	const char *value)
+{
+	ksession_var_t *var = NULL;
+	const size_t *deps = NULL;
+	size_t deps_num = 0;
+	size_t i = 0;
+
+	assert(session);
+	if (!session)
+		return BOOL_FALSE;
+	assert(name);
+	if (!name)
+		return BOOL_FALSE;
+
+	var = (ksession_var_t *)faux_list_kfind(session->vars, name);
+	if (var) {
+		if (faux_str_cmp(var->value, value) == 0)
+			return BOOL_TRUE; // Nothing changed
+		faux_str_free(var->value);
+		var->value = faux_str_dup(value);
+	} else {
+		var = faux_zmalloc(sizeof(*var));
+		assert(var);
+		if (!var)
+			return BOOL_FALSE;
+		var->name = faux_str_dup(name);
+		var->value = faux_str_dup(value);
+		faux_list_add(session->vars, var);
+	}
+
+	// Conditions depending on this VAR must be re-evaluated
+	if (!session->vis_dirty)
+		return BOOL_TRUE;
+	deps = kscheme_cond_deps(session->scheme, name, &deps_num);
+	for (i = 0; i < deps_num; i++) {
+		if (deps[i] < session->commands_num)
+			KSESSION_BIT_SET(session->vis_dirty, deps[i]);
+	}
+
+	return BOOL_TRUE;
+}
+
+
+const char *ksession_get_var(const ksession_t *session, const char *name)
+{
+	ksession_var_t *var = NULL;
+
+	assert(session);
+	if (!session)
+		return NULL;
+	assert(name);
+	if (!name)
+		return NULL;
+
+	var = (ksession_var_t *)faux_list_kfind(session->vars, name);
+	if (!var)
+		return NULL;
+
+	return var->value;
+}
+
+
+static const char *ksession_cond_getter(const char *name, void *udata)
+{
+	return ksession_get_var((const ksession_t *)udata, name);
+}
+
+
+// The condition of template's command is evaluated within the level
+typedef struct {
+	const ksession_t *session;
+	const klevel_t *level;
+} ksession_bind_ctx_t;
+
+
+/** @brief Gets instance's BIND first then session's VAR
+ */
+static const char *ksession_bind_getter(const char *name, void *udata)
+{
+	ksession_bind_ctx_t *ctx = (ksession_bind_ctx_t *)udata;
+	const char *value = NULL;
+
+	if (ctx->level)
+		value = klevel_bind(ctx->level, name);
+	if (value)
+		return value;
+
+	return ksession_get_var(ctx->session, name);
+}
+
+
+/** @brief Checks access rights
+ *
+ * The access string is a list of group names separated by spaces or commas.
+ * The "*" means any user. The empty access string means no restrictions.
+ */
+static bool_t ksession_access(const ksession_t *session, const char *access)
+{
+	const char *pos = access;
+	bool_t restricted = BOOL_FALSE;
+
+	if (!access)
+		return BOOL_TRUE;
+
+	while (*pos) {
+		const char *start = NULL;
+		size_t len = 0;
+		size_t low = 0;
+		size_t high = session->groups_num;
+
+		while (*pos && (isspace((unsigned char)*pos) || (',' == *pos)))
+			pos++;
+		if ('\0' == *pos)
+			break;
+		start = pos;
+		while (*pos && !isspace((unsigned char)*pos) && (',' != *pos))
+			pos++;
+		len = pos - start;
+		restricted = BOOL_TRUE;
+
+		if ((1 == len) && ('*' == *start))
+			return BOOL_TRUE;
+		// Binary search within sorted names of groups
+		while (low < high) {
+			size_t mid = low + (high - low) / 2;
+			int res = strncmp(session->groups[mid], start, len);
+			if ((0 == res) && ('\0' != session->groups[mid][len]))
+				res = 1;
+			if (0 == res)
+				return BOOL_TRUE;
+			if (res < 0)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+	}
+
+	// Empty list is not a restriction
+	return restricted ? BOOL_FALSE : BOOL_TRUE;
+}
+
+
+/** @brief Evaluates static visibility of all commands
+ *
+ * Access rights and conditions without VARs can't be changed while session
+ * so they are evaluated once. The conditions with VARs are marked as dirty
+ * and will be evaluated on demand.
+ */
+static bool_t ksession_update_visibility(ksession_t *session)
+{
+	faux_list_node_t *view_iter = NULL;
+	kview_t *view = NULL;
+	size_t len = 0;
+
+	ksession_free_bitmaps(session);
+	session->commands_num = kscheme_commands_num(session->scheme);
+	len = KSESSION_BITMAP_LEN(session->commands_num);
+	if (0 == len)
+		return BOOL_TRUE;
+	session->vis_static = faux_zmalloc(len * sizeof(unsigned long));
+	session->vis_var = faux_zmalloc(len * sizeof(unsigned long));
+	session->vis_dirty = faux_zmalloc(len * sizeof(unsigned long));
+	assert(session->vis_static && session->vis_var && session->vis_dirty);
+	if (!session->vis_static || !session->vis_var || !session->vis_dirty) {
+		ksession_free_bitmaps(session);
+		return BOOL_FALSE;
+	}
+
+	view_iter = faux_list_head(kscheme_views(session->scheme));
+	while ((view = (kview_t *)faux_list_each(&view_iter))) {
+		faux_list_node_t *iter = NULL;
+		kcommand_t *command = NULL;
+
+		iter = faux_list_head(kview_commands(view));
+		while ((command = (kcommand_t *)faux_list_each(&iter))) {
+			size_t id = kcommand_id(command);
+			bool_t visible = BOOL_TRUE;
+
+			if (id >= session->commands_num)
+				continue;
+			visible = ksession_access(session,
+				kcommand_access(command));
+			if (visible &&
+				(kcommand_cond_class(command) == KCOND_STATIC))
+				visible = kcond_eval(kcommand_cond(command),
+					NULL, NULL);
+			if (visible)
+				KSESSION_BIT_SET(session->vis_static, id);
+			if (kcommand_cond_class(command) == KCOND_VAR)
+				KSESSION_BIT_SET(session->vis_dirty, id);
+		}
+	}
+
+	return BOOL_TRUE;
+}
+
+
+void ksession_set_cond_fn(ksession_t *session, ksession_cond_fn fn,
+	void *udata)
+{
+	assert(session);
+	if (!session)
+		return;
+
+	session->cond_fn = fn;
+	session->cond_udata = udata;
+}
+
+
+static bool_t ksession_visible(ksession_t *session, const kcommand_t *command,
+	const klevel_t *level)
+{
+	size_t id = 0;
+
+	id = kcommand_id(command);
+	if (id >= session->commands_num) // Scheme is not linked
+		return BOOL_FALSE;
+	if (!KSESSION_BIT_GET(session->vis_static, id))
+		return BOOL_FALSE;
+
+	switch (kcommand_cond_class(command)) {
+	case KCOND_VAR:
+		// The result depends on template's instance. Don't cache it.
+		if (kcommand_bound(command)) {
+			ksession_bind_ctx_t ctx = { session, level };
+			return kcond_eval(kcommand_cond(command),
+				ksession_bind_getter, &ctx);
+		}
+		if (KSESSION_BIT_GET(session->vis_dirty, id)) {
+			if (kcond_eval(kcommand_cond(command),
+				ksession_cond_getter, session))
+				KSESSION_BIT_SET(session->vis_var, id);
+			else
+				KSESSION_BIT_CLR(session->vis_var, id);
+			KSESSION_BIT_CLR(session->vis_dirty, id);
+		}
+		return KSESSION_BIT_GET(session->vis_var, id) ?
+			BOOL_TRUE : BOOL_FALSE;
+	case KCOND_DYNAMIC:
+		if (!session->cond_fn)
+			return BOOL_TRUE;
+		return session->cond_fn(session, command, session->cond_udata);
+	default:
+		break;
+	}
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Checks if command is visible for the session
+ *
+ * It's cheap for the most of commands: the static visibility is a bit
+ * within precomputed bitmap. The condition depending on VARs is evaluated
+ * only if one of these VARs was changed since the last evaluation. Only
+ * dynamic conditions and conditions using template's BINDs are evaluated
+ * each time. The BINDs are got from the current level of path.
+ *
+ * @param [in] session Session object.
+ * @param [in] command Command to check.
+ * @return BOOL_TRUE if command is visible.
+ */
+bool_t ksession_command_visible(ksession_t *session,
+	const kcommand_t *command)
+{
+	assert(session);
+	if (!session)
+		return BOOL_FALSE;
+	assert(command);
+	if (!command)
+		return BOOL_FALSE;
+
+	return ksession_visible(session, command,
+		kpath_current(session->path));
+}
+
+
+/** @brief Finds visible command within current path
+ */
+const klevel_cmd_t *ksession_find_command(ksession_t *session,
+	const char *name)
+{
+	const klevel_cmd_t *cmd = NULL;
+
+	assert(session);
+	if (!session)
+		return NULL;
+
+	cmd = kpath_find(session->path, name);
+	if (!cmd)
+		return NULL;
+	// The BINDs are got from the level the command was found on
+	if (!ksession_visible(session, cmd->command, cmd->level))
+		return NULL;
+
+	return cmd;
+}
+
+
+/** @brief Finds visible command by the leading words of parsed line
+ *
+ * The command name can contain several words. The longest name is used.
+ * The quoted word is an argument always so the search stops there.
+ *
+ * @param [in] session Session.
+ * @param [in] tokens Parsed line.
+ * @param [out] words Number of words used by command name.
+ * @return Found command or NULL.
+ */
+const klevel_cmd_t *ksession_parse_command(ksession_t *session,
+	const ktokens_t *tokens, size_t *words)
+{
+	const klevel_cmd_t *found = NULL;
+	char *name = NULL;
+	size_t num = 0;
+	size_t i = 0;
+
+	assert(session);
+	if (!session)
+		return NULL;
+	assert(tokens);
+	if (!tokens)
+		return NULL;
+	if (words)
+		*words = 0;
+
+	num = ktokens_len(tokens);
+	for (i = 0; i < num; i++) {
+		const ktoken_t *token = ktokens_at(tokens, i);
+		const klevel_cmd_t *cmd = NULL;
+		if (token->quote != KTOKEN_QUOTE_NONE)
+			break;
+		if (name)
+			faux_str_cat(&name, " ");
+		faux_str_catn(&name, ktoken_str(tokens, token), token->len);
+		cmd = ksession_find_command(session, name);
+		if (cmd) {
+			found = cmd;
+			if (words)
+				*words = i + 1;
+		}
+	}
+	faux_str_free(name);
+
+	return found;
+}
+
+
+/** @brief Builds cache key of command's output
+ *
+ * The key consists of session's user, command's identifier, normalized
+ * words of line, values of VARs the command's output depends on and BINDs
+ * of the level the command is found on. The output can depend on user's
+ * permissions so the users don't share it. The instances of template
+ * share the command but not its output. The words are length prefixed so
+ * the quoted word with spaces differs from several words.
+ *
+ * @param [in] session Session.
+ * @param [in] cmd Command found by ksession_parse_command().
+ * @param [in] tokens Parsed line.
+ * @return Allocated key or NULL if command is not cacheable.
+ */
+char *ksession_cache_key(ksession_t *session, const klevel_cmd_t *cmd,
+	const ktokens_t *tokens)
+{
+	char *key = NULL;
+	size_t num = 0;
+	size_t i = 0;
+	kview_t *view = NULL;
+	const kview_t *tmpl = NULL;
+
+	assert(session);
+	if (!session)
+		return NULL;
+	assert(cmd);
+	if (!cmd)
+		return NULL;
+	assert(tokens);
+	if (!tokens)
+		return NULL;
+	if (0 == kcommand_cache(cmd->command))
+		return NULL;
+
+	key = faux_str_sprintf("%s\n%zu\n",
+		session->user ? session->user : "", kcommand_id(cmd->command));
+	num = ktokens_len(tokens);
+	for (i = 0; i < num; i++) {
+		const ktoken_t *token = ktokens_at(tokens, i);
+		char *word = faux_str_sprintf("%zu:", token->len);
+		faux_str_cat(&key, word);
+		faux_str_free(word);
+		faux_str_catn(&key, ktoken_str(tokens, token), token->len);
+	}
+	num = kcommand_cache_vars_num(cmd->command);
+	for (i = 0; i < num; i++) {
+		const char *name = kcommand_cache_var(cmd->command, i);
+		const char *value = ksession_get_var(session, name);
+		faux_str_cat(&key, "\n");
+		faux_str_cat(&key, name);
+		if (value) {
+			faux_str_cat(&key, "=");
+			faux_str_cat(&key, value);
+		}
+	}
+	// The instance's BIND overrides the template's default one
+	view = klevel_view(cmd->level);
+	for (tmpl = view; tmpl; tmpl = kview_template(tmpl)) {
+		num = kview_binds_num(tmpl);
+		for (i = 0; i < num; i++) {
+			const char *name = kview_bind_name(tmpl, i);
+			faux_str_cat(&key, "\n@");
+			faux_str_cat(&key, name);
+			faux_str_cat(&key, "=");
+			faux_str_cat(&key, kview_bind(view, name));
+		}
+	}
+
+	return key;
+}
+
+
+/** @brief Gets map of hotkeys available within current path
+ *
+ * The map must be sent to the client after each change of current path.
+ * The pointer is valid until the current level is removed from path.
+ */
+const char * const *ksession_hotkeys(ksession_t *session)
+{
+	assert(session);
+	if (!session)
+		return NULL;
+
+	return klevel_hotkeys(kpath_current(session->path));
+}
@@ -0,0 +1,314 @@
+/** @file ktoken.c
+ *
+ * @brief Tokenizer of command line
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <ctype.h>
+
+#include <klish/ktoken.h>
+
+#include "private.h"
+
+#define KTOKENS_CHUNK 16
+
+
+ktokens_t *ktokens_new(void)
+{
+	ktokens_t *tokens = NULL;
+
+	tokens = faux_zmalloc(sizeof(*tokens));
+	assert(tokens);
+	if (!tokens)
+		return NULL;
+
+	// Initialize
+	tokens->line = NULL;
+	tokens->len = 0;
+	tokens->list = NULL;
+	tokens->num = 0;
+	tokens->size = 0;
+
+	return tokens;
+}
+
+
+void ktokens_free(ktokens_t *tokens)
+{
+	if (!tokens)
+		return;
+
+	faux_free(tokens->list);
+	faux_free(tokens);
+}
+
+
+static bool_t ktoken_is_space(char c)
+{
+	return isspace((unsigned char)c) ? BOOL_TRUE : BOOL_FALSE;
+}
+
+
+static bool_t ktoken_is_quote(char c)
+{
+	return ((KTOKEN_QUOTE_DOUBLE == c) || (KTOKEN_QUOTE_SINGLE == c) ||
+		(KTOKEN_QUOTE_BACKTICK == c)) ? BOOL_TRUE : BOOL_FALSE;
+}
+
+
+/** @brief Gets length of run of the same character
+ */
+static size_t ktoken_run(const char *line, size_t len, size_t pos)
+{
+	size_t end = pos;
+
+	while ((end < len) && (line[end] == line[pos]))
+		end++;
+
+	return end - pos;
+}
+
+
+/** @brief Scans single token starting at pos
+ *
+ * @return Position after token.
+ */
+static size_t ktoken_scan(const char *line, size_t len, size_t pos,
+	ktoken_t *token)
+{
+	char quote = line[pos];
+	size_t run = 0;
+	size_t i = 0;
+
+	memset(token, 0, sizeof(*token));
+	token->start = pos;
+	token->quote = KTOKEN_QUOTE_NONE;
+	token->closed = BOOL_TRUE;
+
+	// Plain word
+	if (!ktoken_is_quote(quote)) {
+		i = pos;
+		while ((i < len) && !ktoken_is_space(line[i]))
+			i++;
+		token->offset = pos;
+		token->len = i - pos;
+		token->end = i;
+		return i;
+	}
+
+	// The opening and closing sequences without content between them and
+	// followed by space is an empty string
+	run = ktoken_run(line, len, pos);
+	token->quote = (ktoken_quote_e)quote;
+	if ((0 == run % 2) && (run / 2 <= KTOKEN_QUOTE_MAX) &&
+		((pos + run == len) || ktoken_is_space(line[pos + run]))) {
+		token->quote_len = run / 2;
+		token->offset = pos + run / 2;
+		token->len = 0;
+		token->end = pos + run;
+		return token->end;
+	}
+	token->quote_len = (run > KTOKEN_QUOTE_MAX) ? KTOKEN_QUOTE_MAX : run;
+	token->offset = pos + token->quote_len;
+
+	// Closing sequence is a run not shorter than opening one and followed
+	// by space or end of line. The extra quotes are content.
+	i = token->offset;
+	while (i < len) {
+		size_t end = 0;
+		if (line[i] != quote) {
+			i++;
+			continue;
+		}
+		run = ktoken_run(line, len, i);
+		end = i + run;
+		if ((run >= token->quote_len) &&
+			((end == len) || ktoken_is_space(line[end]))) {
+			token->len = end - token->quote_len - token->offset;
+			token->end = end;
+			return end;
+		}
+		i = end;
+	}
+
+	// Unclosed quote takes the rest of line
+	token->closed = BOOL_FALSE;
+	token->len = len - token->offset;
+	token->end = len;
+
+	return len;
+}
+
+
+static bool_t ktokens_add(ktokens_t *tokens, const ktoken_t *token)
+{
+	if (tokens->num == tokens->size) {
+		size_t size = tokens->size + KTOKENS_CHUNK;
+		ktoken_t *list = realloc(tokens->list, size * sizeof(*list));
+		assert(list);
+		if (!list)
+			return BOOL_FALSE;
+		tokens->list = list;
+		tokens->size = size;
+	}
+	tokens->list[tokens->num++] = *token;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Parses the whole line
+ *
+ * The line is not copied. It must be valid while tokens are used.
+ *
+ * @return Number of tokens.
+ */
+size_t ktokens_parse(ktokens_t *tokens, const char *line, size_t len)
+{
+	return ktokens_update(tokens, line, len, 0);
+}
+
+
+/** @brief Parses the changed part of line
+ *
+ * The tokens that end before the changed position are kept. The rest of
+ * line is parsed again starting from the first affected token. So the
+ * typing at the end of line costs the last token only.
+ *
+ * @param [in] tokens Tokens of previous version of line.
+ * @param [in] line New version of line.
+ * @param [in] len Length of line.
+ * @param [in] changed Offset of the first changed byte.
+ * @return Number of tokens.
+ */
+size_t ktokens_update(ktokens_t *tokens, const char *line, size_t len,
+	size_t changed)
+{
+	size_t pos = 0;
+
+	assert(tokens);
+	if (!tokens)
+		return 0;
+
+	// The token that ends at changed position can be extended
+	while ((tokens->num > 0) &&
+		(tokens->list[tokens->num - 1].end >= changed))
+		tokens->num--;
+	if (tokens->num > 0)
+		pos = tokens->list[tokens->num - 1].end;
+	tokens->line = line;
+	tokens->len = line ? len : 0;
+
+	while (pos < tokens->len) {
+		ktoken_t token = {};
+		if (ktoken_is_space(line[pos])) {
+			pos++;
+			continue;
+		}
+		pos = ktoken_scan(line, tokens->len, pos, &token);
+		if (!ktokens_add(tokens, &token))
+			break;
+	}
+
+	return tokens->num;
+}
+
+
+size_t ktokens_len(const ktokens_t *tokens)
+{
+	assert(tokens);
+	if (!tokens)
+		return 0;
+
+	return tokens->num;
+}
+
+
+const ktoken_t *ktokens_at(const ktokens_t *tokens, size_t index)
+{
+	assert(tokens);
+	if (!tokens)
+		return NULL;
+	if (index >= tokens->num)
+		return NULL;
+
+	return &tokens->list[index];
+}
+
+
+/** @brief Finds token that contains position or ends at it
+ *
+ * It's a word under cursor for completion.
+ *
+ * @return Token or NULL if position is within spaces.
+ */
+const ktoken_t *ktokens_find(const ktokens_t *tokens, size_t pos)
+{
+	size_t low = 0;
+	size_t high = 0;
+
+	assert(tokens);
+	if (!tokens)
+		return NULL;
+
+	high = tokens->num;
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		const ktoken_t *token = &tokens->list[mid];
+		if (pos < token->start)
+			high = mid;
+		else if (pos > token->end)
+			low = mid + 1;
+		else
+			return token;
+	}
+
+	return NULL;
+}
+
+
+/** @brief Checks if the end of line is within unclosed quote
+ */
+bool_t ktokens_quoting(const ktokens_t *tokens)
+{
+	assert(tokens);
+	if (!tokens)
+		return BOOL_FALSE;
+	if (0 == tokens->num)
+		return BOOL_FALSE;
+
+	return tokens->list[tokens->num - 1].closed ? BOOL_FALSE : BOOL_TRUE;
+}
+
+
+/** @brief Checks if the last word is complete
+ *
+ * The word is complete if it's followed by space.
+ */
+bool_t ktokens_word_end(const ktokens_t *tokens)
+{
+	assert(tokens);
+	if (!tokens)
+		return BOOL_FALSE;
+	if (0 == tokens->num)
+		return BOOL_TRUE;
+
+	return (tokens->list[tokens->num - 1].end < tokens->len) ?
+		BOOL_TRUE : BOOL_FALSE;
+}
+
+
+/** @brief Gets pointer to token's content within line
+ *
+ * The content is not terminated. Its length is token->len.
+ */
+const char *ktoken_str(const ktokens_t *tokens, const ktoken_t *token)
+{
+	assert(tokens);
+	if (!tokens || !token)
+		return NULL;
+
+	return tokens->line + token->offset;
+}
@@ -0,0 +1,88 @@
+#ifndef _klish_ksession_private_h
+#define _klish_ksession_private_h
+
+#include <faux/list.h>
+#include <klish/kpath.h>
+#include <klish/ksession.h>
+#include <klish/ktoken.h>
+
+
+struct klevel_s {
+	kview_t *view;
+	klevel_t *parent;
+	size_t depth;
+	// Lazily built sorted index of available commands
+	bool_t indexed;
+	klevel_cmd_t *index;
+	size_t index_len;
+	char **names; // Names with namespace prefix. Owned by level.
+	size_t names_len;
+	size_t names_size;
+	// Lazily resolved hotkeys. Commands are owned by views.
+	bool_t hotkeys_resolved;
+	const char *hotkeys[KVIEW_HOTKEY_NUM];
+};
+
+
+struct ktokens_s {
+	const char *line; // Not owned
+	size_t len;
+	ktoken_t *list;
+	size_t num;
+	size_t size;
+};
+
+
+struct kpath_s {
+	klevel_t *current;
+};
+
+
+typedef struct {
+	char *name;
+	char *value;
+} ksession_var_t;
+
+
+// Bitmap over scheme's command identifiers
+#define KSESSION_BITS (sizeof(unsigned long) * 8)
+#define KSESSION_BITMAP_LEN(n) (((n) + KSESSION_BITS - 1) / KSESSION_BITS)
+#define KSESSION_BIT_SET(map, i) \
+	((map)[(i) / KSESSION_BITS] |= (1UL << ((i) % KSESSION_BITS)))
+#define KSESSION_BIT_CLR(map, i) \
+	((map)[(i) / KSESSION_BITS] &= ~(1UL << ((i) % KSESSION_BITS)))
+#define KSESSION_BIT_GET(map, i) \
+	(((map)[(i) / KSESSION_BITS] >> ((i) % KSESSION_BITS)) & 1UL)
+
+
+struct ksession_s {
+	kscheme_t *scheme;
+	kpath_t *path;
+	// User
+	char *user;
+	uid_t uid;
+	gid_t gid;
+	char **groups; // Sorted names of user's groups
+	size_t groups_num;
+	// VARs
+	faux_list_t *vars;
+	// Visibility
+	size_t commands_num;
+	unsigned long *vis_static; // Access rights and static conditions
+	unsigned long *vis_var; // Cached results of VAR conditions
+	unsigned long *vis_dirty; // VAR conditions to re-evaluate
+	ksession_cond_fn cond_fn;
+	void *cond_udata;
+};
+
+
+// Condition expression
+typedef const char *(*kcond_var_fn)(const char *name, void *udata);
+bool_t kcond_eval(const char *expr, kcond_var_fn getter, void *udata);
+
+// Level
+klevel_t *klevel_new(kview_t *view, klevel_t *parent);
+void klevel_free(klevel_t *level);
+const klevel_cmd_t *klevel_index(klevel_t *level, size_t *len);
+
+#endif // _klish_ksession_private_h
@@ -0,0 +1,70 @@
+/** @file ktoken.h
+ *
+ * @brief Tokenizer of command line
+ *
+ * The tokens are spans within the original line so nothing is copied. The
+ * token is quoted by one of three quote characters: double quote, single
+ * quote or backtick. The opening quote can be a sequence of up to
+ * KTOKEN_QUOTE_MAX equal characters. The token is closed by the same
+ * sequence followed by space or end of line. So the shorter sequences of
+ * the same quote character are the part of content:
+ *
+ * ""This is a "long" string""
+ *
+ * The tokenizer is incremental. On each keystroke only the tokens the
+ * change can affect are parsed again. The client uses it for help and
+ * completion and the daemon for command parsing.
+ */
+
+#ifndef _klish_ktoken_h
+#define _klish_ktoken_h
+
+#include <stddef.h>
+
+#include <faux/faux.h>
+
+// Maximum length of quote sequence
+#define KTOKEN_QUOTE_MAX 3
+
+/** @brief Quote of token
+ */
+typedef enum {
+	KTOKEN_QUOTE_NONE = '\0',
+	KTOKEN_QUOTE_DOUBLE = '"',
+	KTOKEN_QUOTE_SINGLE = '\'',
+	KTOKEN_QUOTE_BACKTICK = '`',
+} ktoken_quote_e;
+
+/** @brief Span of token within line
+ */
+typedef struct {
+	size_t start; // Start of token including opening quote
+	size_t end; // End of token including closing quote
+	size_t offset; // Start of content
+	size_t len; // Length of content
+	ktoken_quote_e quote;
+	unsigned char quote_len; // Length of quote sequence
+	bool_t closed; // The quoted token is closed
+} ktoken_t;
+
+typedef struct ktokens_s ktokens_t;
+
+
+C_DECL_BEGIN
+
+ktokens_t *ktokens_new(void);
+void ktokens_free(ktokens_t *tokens);
+
+size_t ktokens_parse(ktokens_t *tokens, const char *line, size_t len);
+size_t ktokens_update(ktokens_t *tokens, const char *line, size_t len,
+	size_t changed);
+size_t ktokens_len(const ktokens_t *tokens);
+const ktoken_t *ktokens_at(const ktokens_t *tokens, size_t index);
+const ktoken_t *ktokens_find(const ktokens_t *tokens, size_t pos);
+bool_t ktokens_quoting(const ktokens_t *tokens);
+bool_t ktokens_word_end(const ktokens_t *tokens);
+const char *ktoken_str(const ktokens_t *tokens, const ktoken_t *token);
+
+C_DECL_END
+
+#endif // _klish_ktoken_h
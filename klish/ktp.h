@@ -8,6 +8,13 @@
 
 #include <faux/msg.h>
 
+#define KTP_MAGIC 0x4b545020
+#define KTP_MAJOR 0x01
+#define KTP_MINOR 0x00
+
+// Length of session resumption token
+#define KTP_TOKEN_LEN 16
+
 typedef enum {
 	KTP_NULL = '\0',
 	KTP_STDIN = 'i',
@@ -24,14 +31,75 @@ typedef enum {
 	KTP_AUTH = 'a',
 	KTP_AUTH_ACK = 'A',
 	KTP_KEEPALIVE = 'k',
+	KTP_HOTKEYS = 'y',
+	KTP_HELP_INDEX = 'j',
+	KTP_JOBS = 'b', // List of user's background jobs
+	KTP_JOBS_ACK = 'B',
+	KTP_JOB_ATTACH = 't', // Get job's output and wait for its result
+	KTP_JOB_ATTACH_ACK = 'T', // Job is finished. The status is retcode.
+	KTP_RECORD = 'r', // Structured output of command. See krecord.h.
 } ktp_cmd_e;
 
 
+typedef enum {
+	KTP_PARAM_NULL = '\0',
+	// Raw data of KTP_STDIN, KTP_STDOUT, KTP_STDERR or KTP_RECORD stream
+	KTP_PARAM_DATA = 'd',
+	// Command line (not terminated) of KTP_CMD. The KTP_AUTH with command
+	// line is a one-shot request. The server executes command just after
+	// authentication, answers by KTP_CMD_ACK and closes connection.
+	KTP_PARAM_LINE = 'l',
+	// Key code (single byte) followed by command line (not terminated)
+	KTP_PARAM_HOTKEY = 'y',
+	// Scheme version. The uint32_t in network byte order.
+	KTP_PARAM_VERSION = 'r',
+	// Flags (single byte), name and help. Zero separated.
+	KTP_PARAM_HELP_CMD = 'c',
+	// Name, help and PTYPE help of previous command's PARAM.
+	KTP_PARAM_HELP_ARG = 'p',
+	// Entry of KTP_HELP_ACK: next word or PTYPE help and help string.
+	// Zero separated. The KTP_HELP has KTP_PARAM_LINE up to cursor.
+	KTP_PARAM_HELP = 'x',
+	// Time the command was waiting for start within the daemon's queue.
+	// Milliseconds. The uint32_t in network byte order.
+	KTP_PARAM_WAIT = 'w',
+	// CPU time of command's processes. Milliseconds. The uint32_t in
+	// network byte order.
+	KTP_PARAM_CPU = 'u',
+	// Peak memory usage of command's processes. KiB. The uint32_t in
+	// network byte order.
+	KTP_PARAM_MEMORY = 'm',
+	// Session resumption token (KTP_TOKEN_LEN bytes). Within KTP_AUTH
+	// it's followed by the number of received stdout bytes. The uint64_t
+	// in network byte order.
+	KTP_PARAM_RESUME = 't',
+	// Background job: identifier (uint32_t in network byte order), state
+	// (single byte), retcode (uint32_t in network byte order) and command
+	// line (not terminated). The KTP_JOB_ATTACH has identifier only.
+	KTP_PARAM_JOB = 'b',
+	// Flag of KTP_CMD to execute command in background. No data.
+	KTP_PARAM_BACKGROUND = 'g',
+	// Flag of KTP_CMD_ACK that the output is served from daemon's cache.
+	// The age of output. Milliseconds. The uint32_t in network byte order.
+	KTP_PARAM_CACHED = 'h',
+} ktp_param_e;
+
+
+// Flags of KTP_PARAM_HELP_CMD
+#define KTP_HELP_DYNAMIC 0x01 // Visibility depends on VARs or external code
+#define KTP_HELP_DYNAMIC_ARGS 0x02 // Args can't be parsed without server
+
+// States of KTP_PARAM_JOB
+#define KTP_JOB_RUNNING 'r'
+#define KTP_JOB_DONE 'd'
+
+
 C_DECL_BEGIN
 
 int ktp_connect_unix(const char *sun_path);
 void ktp_disconnect(int fd);
 int ktp_accept(int listen_sock);
+faux_msg_t *ktp_msg_preform(ktp_cmd_e cmd, uint32_t status);
 
 C_DECL_END
 
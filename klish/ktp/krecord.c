@@ -0,0 +1,426 @@
+/** @file krecord.c
+ *
+ * @brief Structured records of ACTION's output
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <arpa/inet.h>
+#include <endian.h>
+
+#include <faux/str.h>
+#include <klish/krecord.h>
+
+#include "private.h"
+
+
+krecord_t *krecord_new(void)
+{
+	krecord_t *record = NULL;
+
+	record = faux_zmalloc(sizeof(*record));
+	assert(record);
+	if (!record)
+		return NULL;
+
+	// Initialize
+	record->data = NULL;
+	record->size = 0;
+	krecord_reset(record);
+
+	return record;
+}
+
+
+void krecord_free(krecord_t *record)
+{
+	if (!record)
+		return;
+
+	faux_free(record->data);
+	faux_free(record);
+}
+
+
+/** @brief Removes all fields to reuse record
+ */
+void krecord_reset(krecord_t *record)
+{
+	assert(record);
+	if (!record)
+		return;
+
+	record->len = 0;
+}
+
+
+/** @brief Appends field's type and key and reserves space for value
+ *
+ * @return Pointer to value or NULL on error.
+ */
+static char *krecord_add(krecord_t *record, krecord_type_e type,
+	const char *key, size_t value_len)
+{
+	size_t key_len = 0;
+	size_t need = 0;
+	uint32_t header = 0;
+	char *p = NULL;
+
+	assert(record);
+	if (!record)
+		return NULL;
+	assert(key);
+	if (!key)
+		return NULL;
+	key_len = strlen(key);
+	if (key_len > UINT8_MAX)
+		return NULL;
+
+	if (0 == record->len)
+		record->len = KRECORD_HEADER_LEN;
+	need = record->len + 2 + key_len + value_len;
+	if (need - KRECORD_HEADER_LEN > KRECORD_MAX)
+		return NULL;
+	if (need > record->size) {
+		size_t size = record->size ? record->size : 256;
+		char *data = NULL;
+		while (size < need)
+			size *= 2;
+		data = realloc(record->data, size);
+		assert(data);
+		if (!data)
+			return NULL;
+		record->data = data;
+		record->size = size;
+	}
+
+	p = record->data + record->len;
+	*p++ = (char)type;
+	*p++ = (char)key_len;
+	memcpy(p, key, key_len);
+	p += key_len;
+	record->len = need;
+	header = htonl(record->len - KRECORD_HEADER_LEN);
+	memcpy(record->data, &header, sizeof(header));
+
+	return p;
+}
+
+
+bool_t krecord_add_str(krecord_t *record, const char *key, const char *str)
+{
+	size_t len = 0;
+	uint32_t n = 0;
+	char *p = NULL;
+
+	if (!str)
+		return krecord_add_null(record, key);
+	len = strlen(str);
+	p = krecord_add(record, KRECORD_STR, key, sizeof(n) + len);
+	if (!p)
+		return BOOL_FALSE;
+	n = htonl(len);
+	memcpy(p, &n, sizeof(n));
+	memcpy(p + sizeof(n), str, len);
+
+	return BOOL_TRUE;
+}
+
+
+bool_t krecord_add_int(krecord_t *record, const char *key, int64_t num)
+{
+	uint64_t n = htobe64((uint64_t)num);
+	char *p = NULL;
+
+	p = krecord_add(record, KRECORD_INT, key, sizeof(n));
+	if (!p)
+		return BOOL_FALSE;
+	memcpy(p, &n, sizeof(n));
+
+	return BOOL_TRUE;
+}
+
+
+bool_t krecord_add_bool(krecord_t *record, const char *key, bool_t flag)
+{
+	char *p = NULL;
+
+	p = krecord_add(record, KRECORD_BOOL, key, 1);
+	if (!p)
+		return BOOL_FALSE;
+	*p = flag ? 1 : 0;
+
+	return BOOL_TRUE;
+}
+
+
+bool_t krecord_add_null(krecord_t *record, const char *key)
+{
+	return krecord_add(record, KRECORD_NULL, key, 0) ?
+		BOOL_TRUE : BOOL_FALSE;
+}
+
+
+/** @brief Gets encoded record including header
+ *
+ * The data is ready to be written to KLISH_RECORD_FD.
+ */
+const char *krecord_data(const krecord_t *record, size_t *len)
+{
+	assert(record);
+	if (!record)
+		return NULL;
+	if (len)
+		*len = record->len;
+
+	return record->data;
+}
+
+
+/** @brief Gets size of the first record within stream
+ *
+ * The stream is not framed by transport so the receiver accumulates data
+ * until the record is complete.
+ *
+ * @param [in] data Stream data.
+ * @param [in] len Length of data.
+ * @return Size of record including header, 0 - record is incomplete, -1 -
+ * garbage.
+ */
+ssize_t krecord_size(const char *data, size_t len)
+{
+	uint32_t n = 0;
+
+	assert(data);
+	if (!data)
+		return -1;
+	if (len < KRECORD_HEADER_LEN)
+		return 0;
+
+	memcpy(&n, data, sizeof(n));
+	n = ntohl(n);
+	if (n > KRECORD_MAX)
+		return -1;
+	if (len < KRECORD_HEADER_LEN + n)
+		return 0;
+
+	return KRECORD_HEADER_LEN + n;
+}
+
+
+/** @brief Gets next field of record
+ *
+ * @param [in,out] pos Position within record's fields.
+ * @param [in] end End of record.
+ * @param [out] field Decoded field.
+ * @return BOOL_TRUE - field is decoded, BOOL_FALSE - end of record or
+ * malformed field. The pos is equal to end on the end of record.
+ */
+bool_t krecord_field_each(const char **pos, const char *end,
+	krecord_field_t *field)
+{
+	const char *p = NULL;
+	uint32_t n = 0;
+	uint64_t num = 0;
+
+	assert(pos);
+	assert(field);
+	if (!pos || !*pos || !field)
+		return BOOL_FALSE;
+	p = *pos;
+	if (end - p < 2)
+		return BOOL_FALSE;
+
+	memset(field, 0, sizeof(*field));
+	field->type = (krecord_type_e)*p++;
+	field->key_len = (unsigned char)*p++;
+	if ((size_t)(end - p) < field->key_len)
+		return BOOL_FALSE;
+	field->key = p;
+	p += field->key_len;
+
+	switch (field->type) {
+	case KRECORD_NULL:
+		break;
+	case KRECORD_STR:
+		if ((size_t)(end - p) < sizeof(n))
+			return BOOL_FALSE;
+		memcpy(&n, p, sizeof(n));
+		p += sizeof(n);
+		field->str_len = ntohl(n);
+		if ((size_t)(end - p) < field->str_len)
+			return BOOL_FALSE;
+		field->str = p;
+		p += field->str_len;
+		break;
+	case KRECORD_INT:
+		if ((size_t)(end - p) < sizeof(num))
+			return BOOL_FALSE;
+		memcpy(&num, p, sizeof(num));
+		p += sizeof(num);
+		field->num = (int64_t)be64toh(num);
+		break;
+	case KRECORD_BOOL:
+		if (end - p < 1)
+			return BOOL_FALSE;
+		field->num = *p++ ? 1 : 0;
+		break;
+	default:
+		return BOOL_FALSE;
+	}
+	*pos = p;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Checks that the record is complete and all the fields are valid
+ */
+bool_t krecord_valid(const char *data, size_t len)
+{
+	krecord_field_t field = {};
+	const char *pos = NULL;
+	const char *end = NULL;
+
+	if (krecord_size(data, len) != (ssize_t)len)
+		return BOOL_FALSE;
+
+	pos = data + KRECORD_HEADER_LEN;
+	end = data + len;
+	while (krecord_field_each(&pos, end, &field));
+
+	return (pos == end) ? BOOL_TRUE : BOOL_FALSE;
+}
+
+
+/** @brief Renders record as "key: value" lines
+ *
+ * @return Allocated string or NULL if record is malformed.
+ */
+char *krecord_text(const char *data, size_t len)
+{
+	krecord_field_t field = {};
+	const char *pos = NULL;
+	char *text = NULL;
+
+	if (!krecord_valid(data, len))
+		return NULL;
+
+	text = faux_str_dup("");
+	pos = data + KRECORD_HEADER_LEN;
+	while (krecord_field_each(&pos, data + len, &field)) {
+		char num[32];
+		faux_str_catn(&text, field.key, field.key_len);
+		faux_str_cat(&text, ": ");
+		switch (field.type) {
+		case KRECORD_STR:
+			faux_str_catn(&text, field.str, field.str_len);
+			break;
+		case KRECORD_INT:
+			snprintf(num, sizeof(num), "%" PRId64, field.num);
+			faux_str_cat(&text, num);
+			break;
+		case KRECORD_BOOL:
+			faux_str_cat(&text, field.num ? "true" : "false");
+			break;
+		default:
+			break;
+		}
+		faux_str_cat(&text, "\n");
+	}
+
+	return text;
+}
+
+
+/** @brief Appends JSON string literal
+ *
+ * The bytes above ASCII are copied as is. The ACTION is responsible for
+ * UTF-8.
+ */
+static void krecord_json_str(char **json, const char *str, size_t len)
+{
+	const char *chunk = str;
+	size_t i = 0;
+
+	faux_str_cat(json, "\"");
+	for (i = 0; i < len; i++) {
+		unsigned char c = (unsigned char)str[i];
+		char esc[8];
+		if ((c >= 0x20) && (c != '"') && (c != '\\'))
+			continue;
+		faux_str_catn(json, chunk, str + i - chunk);
+		chunk = str + i + 1;
+		switch (c) {
+		case '"':
+			faux_str_cat(json, "\\\"");
+			break;
+		case '\\':
+			faux_str_cat(json, "\\\\");
+			break;
+		case '\n':
+			faux_str_cat(json, "\\n");
+			break;
+		case '\r':
+			faux_str_cat(json, "\\r");
+			break;
+		case '\t':
+			faux_str_cat(json, "\\t");
+			break;
+		default:
+			snprintf(esc, sizeof(esc), "\\u%04x", c);
+			faux_str_cat(json, esc);
+			break;
+		}
+	}
+	faux_str_catn(json, chunk, str + len - chunk);
+	faux_str_cat(json, "\"");
+}
+
+
+/** @brief Renders record as single line JSON object
+ *
+ * @return Allocated string or NULL if record is malformed.
+ */
+char *krecord_json(const char *data, size_t len)
+{
+	krecord_field_t field = {};
+	const char *pos = NULL;
+	char *json = NULL;
+	bool_t first = BOOL_TRUE;
+
+	if (!krecord_valid(data, len))
+		return NULL;
+
+	json = faux_str_dup("{");
+	pos = data + KRECORD_HEADER_LEN;
+	while (krecord_field_each(&pos, data + len, &field)) {
+		char num[32];
+		if (!first)
+			faux_str_cat(&json, ",");
+		first = BOOL_FALSE;
+		krecord_json_str(&json, field.key, field.key_len);
+		faux_str_cat(&json, ":");
+		switch (field.type) {
+		case KRECORD_STR:
+			krecord_json_str(&json, field.str, field.str_len);
+			break;
+		case KRECORD_INT:
+			snprintf(num, sizeof(num), "%" PRId64, field.num);
+			faux_str_cat(&json, num);
+			break;
+		case KRECORD_BOOL:
+			faux_str_cat(&json, field.num ? "true" : "false");
+			break;
+		default:
+			faux_str_cat(&json, "null");
+			break;
+		}
+	}
+	faux_str_cat(&json, "}");
+
+	return json;
+}
@@ -63,3 +63,20 @@ int ktp_accept(int listen_sock)
 
 	return new_conn;
 }
+
+
+/** @brief Creates KTP message with filled header
+ */
+faux_msg_t *ktp_msg_preform(ktp_cmd_e cmd, uint32_t status)
+{
+	faux_msg_t *msg = NULL;
+
+	msg = faux_msg_new(KTP_MAGIC, KTP_MAJOR, KTP_MINOR);
+	assert(msg);
+	if (!msg)
+		return NULL;
+	faux_msg_set_cmd(msg, cmd);
+	faux_msg_set_status(msg, status);
+
+	return msg;
+}
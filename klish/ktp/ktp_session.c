@@ -9,9 +9,12 @@
 #include <fcntl.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <arpa/inet.h>
+#include <endian.h>
 
 #include <faux/str.h>
 #include <klish/ktp_session.h>
+#include <klish/ktoken.h>
 
 #include "private.h"
 
@@ -33,16 +36,58 @@ ktp_session_t *ktp_session_new(int sock)
 	session->net = faux_net_new();
 	assert(session->net);
 	faux_net_set_fd(session->net, sock);
+	session->help_valid = BOOL_FALSE;
+	session->help_version = 0;
+	session->help_cmds = NULL;
+	session->help_cmds_num = 0;
+	session->token_valid = BOOL_FALSE;
+	session->stdout_received = 0;
 
 	return session;
 }
 
 
+static void ktp_session_free_hotkeys(ktp_session_t *session)
+{
+	int i = 0;
+
+	for (i = 0; i < KVIEW_HOTKEY_NUM; i++) {
+		faux_str_free(session->hotkeys[i]);
+		session->hotkeys[i] = NULL;
+	}
+}
+
+
+static void ktp_session_free_help(ktp_session_t *session)
+{
+	size_t i = 0;
+
+	for (i = 0; i < session->help_cmds_num; i++) {
+		ktp_help_cmd_t *cmd = &session->help_cmds[i];
+		size_t j = 0;
+		for (j = 0; j < cmd->args_num; j++) {
+			faux_str_free(cmd->args[j].name);
+			faux_str_free(cmd->args[j].help);
+			faux_str_free(cmd->args[j].ptype_help);
+		}
+		faux_free(cmd->args);
+		faux_str_free(cmd->name);
+		faux_str_free(cmd->help);
+	}
+	faux_free(session->help_cmds);
+	session->help_cmds = NULL;
+	session->help_cmds_num = 0;
+	session->help_valid = BOOL_FALSE;
+}
+
+
 void ktp_session_free(ktp_session_t *session)
 {
 	if (!session)
 		return;
 
+	ktp_session_free_help(session);
+	ktp_session_free_hotkeys(session);
 	faux_net_free(session->net);
 	faux_free(session);
 }
@@ -70,6 +115,904 @@ int ktp_session_get_socket(ktp_session_t *session)
 }
 
 
+
+/** @brief Replaces map of hotkeys by the one received from server
+ *
+ * The KTP_HOTKEYS message contains the whole map of current view so the
+ * previous map is dropped.
+ */
+bool_t ktp_session_set_hotkeys(ktp_session_t *session, const faux_msg_t *msg)
+{
+	faux_list_node_t *iter = NULL;
+	uint16_t param_type = 0;
+	void *param_data = NULL;
+	uint32_t param_len = 0;
+
+	assert(session);
+	if (!session)
+		return BOOL_FALSE;
+	assert(msg);
+	if (!msg)
+		return BOOL_FALSE;
+	if (faux_msg_get_cmd(msg) != KTP_HOTKEYS)
+		return BOOL_FALSE;
+
+	ktp_session_free_hotkeys(session);
+	iter = faux_msg_init_param_iter(msg);
+	while (faux_msg_get_param_each(&iter, &param_type, &param_data,
+		&param_len)) {
+		const char *data = (const char *)param_data;
+		int code = 0;
+		if (param_type != KTP_PARAM_HOTKEY)
+			continue;
+		if (param_len < 2) // Key code and at least one char
+			continue;
+		code = (unsigned char)data[0];
+		if (code >= KVIEW_HOTKEY_NUM)
+			continue;
+		faux_str_free(session->hotkeys[code]);
+		session->hotkeys[code] = faux_str_dupn(data + 1, param_len - 1);
+	}
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Gets command bound to key
+ *
+ * Intended to be used by tinyrl's hotkey function so the hotkey is handled
+ * locally without request to server.
+ *
+ * @return Command line or NULL if key is not bound.
+ */
+const char *ktp_session_hotkey(const ktp_session_t *session, int key)
+{
+	assert(session);
+	if (!session)
+		return NULL;
+	if ((key < 0) || (key >= KVIEW_HOTKEY_NUM))
+		return NULL;
+
+	return session->hotkeys[key];
+}
+
+
+/** @brief Gets next zero terminated string of parameter
+ */
+static char *ktp_param_str(const char **data, const char *end)
+{
+	size_t len = 0;
+	char *str = NULL;
+
+	if (*data >= end)
+		return NULL;
+	len = strnlen(*data, end - *data);
+	str = faux_str_dupn(*data, len);
+	*data += len + 1;
+
+	return str;
+}
+
+
+static bool_t ktp_param_uint32(const void *data, uint32_t len,
+	uint32_t *val)
+{
+	uint32_t net_val = 0;
+
+	if (len != sizeof(net_val))
+		return BOOL_FALSE;
+	memcpy(&net_val, data, sizeof(net_val));
+	*val = ntohl(net_val);
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Replaces help index by the one received from server
+ *
+ * The KTP_HELP_INDEX message is received on each change of current view.
+ */
+bool_t ktp_session_set_help_index(ktp_session_t *session,
+	const faux_msg_t *msg)
+{
+	faux_list_node_t *iter = NULL;
+	uint16_t param_type = 0;
+	void *param_data = NULL;
+	uint32_t param_len = 0;
+	size_t size = 0;
+
+	assert(session);
+	if (!session)
+		return BOOL_FALSE;
+	assert(msg);
+	if (!msg)
+		return BOOL_FALSE;
+	if (faux_msg_get_cmd(msg) != KTP_HELP_INDEX)
+		return BOOL_FALSE;
+
+	ktp_session_free_help(session);
+	iter = faux_msg_init_param_iter(msg);
+	while (faux_msg_get_param_each(&iter, &param_type, &param_data,
+		&param_len)) {
+		const char *data = (const char *)param_data;
+		const char *end = data + param_len;
+
+		if (KTP_PARAM_VERSION == param_type) {
+			if (!ktp_param_uint32(param_data, param_len,
+				&session->help_version))
+				goto err;
+			session->help_valid = BOOL_TRUE;
+
+		} else if (KTP_PARAM_HELP_CMD == param_type) {
+			ktp_help_cmd_t *cmd = NULL;
+			if (param_len < 2)
+				goto err;
+			if (session->help_cmds_num == size) {
+				ktp_help_cmd_t *new_cmds = NULL;
+				size_t new_size = size ? (size * 2) : 32;
+				new_cmds = realloc(session->help_cmds,
+					new_size * sizeof(*new_cmds));
+				assert(new_cmds);
+				if (!new_cmds)
+					goto err;
+				session->help_cmds = new_cmds;
+				size = new_size;
+			}
+			cmd = &session->help_cmds[session->help_cmds_num++];
+			cmd->flags = (unsigned char)*data++;
+			cmd->name = ktp_param_str(&data, end);
+			cmd->help = ktp_param_str(&data, end);
+			cmd->args = NULL;
+			cmd->args_num = 0;
+			if (!cmd->name)
+				goto err;
+
+		} else if (KTP_PARAM_HELP_ARG == param_type) {
+			ktp_help_cmd_t *cmd = NULL;
+			ktp_help_arg_t *new_args = NULL;
+			ktp_help_arg_t *arg = NULL;
+			if (0 == session->help_cmds_num)
+				goto err;
+			cmd = &session->help_cmds[session->help_cmds_num - 1];
+			new_args = realloc(cmd->args,
+				(cmd->args_num + 1) * sizeof(*new_args));
+			assert(new_args);
+			if (!new_args)
+				goto err;
+			cmd->args = new_args;
+			arg = &cmd->args[cmd->args_num++];
+			arg->name = ktp_param_str(&data, end);
+			arg->help = ktp_param_str(&data, end);
+			arg->ptype_help = ktp_param_str(&data, end);
+		}
+	}
+	// The index without version can't be checked for validity
+	if (!session->help_valid)
+		goto err;
+
+	return BOOL_TRUE;
+
+err:
+	ktp_session_free_help(session);
+
+	return BOOL_FALSE;
+}
+
+
+/** @brief Checks scheme version from KTP_NOTIFICATION
+ *
+ * The help index is dropped if the scheme was changed. So the help is
+ * requested from server until the new index is received.
+ *
+ * @return BOOL_TRUE if help index is still valid.
+ */
+bool_t ktp_session_check_version(ktp_session_t *session,
+	const faux_msg_t *msg)
+{
+	void *param_data = NULL;
+	uint32_t param_len = 0;
+	uint32_t version = 0;
+
+	assert(session);
+	if (!session)
+		return BOOL_FALSE;
+	assert(msg);
+	if (!msg)
+		return BOOL_FALSE;
+
+	if (!session->help_valid)
+		return BOOL_FALSE;
+	if (!faux_msg_get_param_by_type(msg, KTP_PARAM_VERSION,
+		&param_data, &param_len))
+		return BOOL_TRUE; // Notification is not about scheme
+	if (ktp_param_uint32(param_data, param_len, &version) &&
+		(version == session->help_version))
+		return BOOL_TRUE;
+	ktp_session_free_help(session);
+
+	return BOOL_FALSE;
+}
+
+
+static int ktp_help_cmd_kcompare(const void *key, const void *item)
+{
+	const char *f = (const char *)key;
+	const ktp_help_cmd_t *s = (const ktp_help_cmd_t *)item;
+
+	return strcmp(f, s->name);
+}
+
+
+static bool_t ktp_help_add(ktp_help_t **help, size_t *num,
+	const char *prefix, size_t prefix_len, const char *line)
+{
+	ktp_help_t *new_help = NULL;
+
+	// Commands are sorted so the same words are neighbours
+	if ((*num > 0) && (strlen((*help)[*num - 1].prefix) == prefix_len) &&
+		(strncmp((*help)[*num - 1].prefix, prefix, prefix_len) == 0))
+		return BOOL_TRUE;
+
+	new_help = realloc(*help, (*num + 1) * sizeof(*new_help));
+	assert(new_help);
+	if (!new_help)
+		return BOOL_FALSE;
+	*help = new_help;
+	(*help)[*num].prefix = faux_str_dupn(prefix, prefix_len);
+	(*help)[*num].line = faux_str_dup(line ? line : "");
+	(*num)++;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Gets context help from cached help index
+ *
+ * The help for the next word of command name or for the next plain PARAM
+ * is found locally. If the answer depends on server's state (conditions
+ * with VARs, complex PARAMs, quoting) the function returns -1 and the help
+ * must be requested from server by ktp_session_req_help().
+ *
+ * @param [in] session KTP session.
+ * @param [in] line Text of the line up to cursor.
+ * @param [out] help Allocated array of entries. Free by ktp_help_free().
+ * @return Number of entries or -1 if server must be asked.
+ */
+ssize_t ktp_session_help(const ktp_session_t *session, const char *line,
+	ktp_help_t **help)
+{
+	char *text = NULL; // Normalized line: single spaces
+	ktokens_t *tokens = NULL;
+	size_t complete = 0; // Number of complete words
+	bool_t partial = BOOL_FALSE;
+	const ktp_help_cmd_t *found = NULL;
+	const ktp_help_cmd_t *cmd = NULL;
+	size_t found_words = 0;
+	size_t text_len = 0;
+	size_t tokens_num = 0;
+	size_t num = 0;
+	size_t i = 0;
+
+	assert(session);
+	if (!session)
+		return -1;
+	assert(line);
+	if (!line)
+		return -1;
+	assert(help);
+	if (!help)
+		return -1;
+	*help = NULL;
+
+	if (!session->help_valid)
+		return -1;
+	if (strchr(line, '\\'))
+		return -1;
+
+	// Normalize line. Remember the command with the longest name equal to
+	// the complete words. The quoted words are left to server.
+	tokens = ktokens_new();
+	tokens_num = ktokens_parse(tokens, line, strlen(line));
+	partial = !ktokens_word_end(tokens);
+	text = faux_str_dup("");
+	for (i = 0; i < tokens_num; i++) {
+		const ktoken_t *token = ktokens_at(tokens, i);
+		if (token->quote != KTOKEN_QUOTE_NONE) {
+			faux_str_free(text);
+			ktokens_free(tokens);
+			return -1;
+		}
+		if (i > 0)
+			faux_str_cat(&text, " ");
+		faux_str_catn(&text, ktoken_str(tokens, token), token->len);
+		if (partial && (i == tokens_num - 1))
+			break;
+		complete++;
+		cmd = bsearch(text, session->help_cmds, session->help_cmds_num,
+			sizeof(*session->help_cmds), ktp_help_cmd_kcompare);
+		if (cmd) {
+			found = cmd;
+			found_words = complete;
+		}
+	}
+	ktokens_free(tokens);
+	if ((complete > 0) && !partial)
+		faux_str_cat(&text, " ");
+	text_len = strlen(text);
+
+	// Next word of command names
+	for (i = 0; i < session->help_cmds_num; i++) {
+		const char *word = NULL;
+		size_t w = 0;
+		cmd = &session->help_cmds[i];
+		if (strncmp(cmd->name, text, text_len) != 0)
+			continue;
+		if (cmd->flags & KTP_HELP_DYNAMIC)
+			goto fallback;
+		// Skip complete words
+		word = cmd->name;
+		for (w = 0; w < complete; w++)
+			word = strchr(word, ' ') + 1;
+		if (!ktp_help_add(help, &num, word, strcspn(word, " "),
+			strchr(word, ' ') ? NULL : cmd->help))
+			goto fallback;
+	}
+
+	// PARAM of complete command
+	if (found) {
+		size_t pos = complete - found_words;
+		if (found->flags & (KTP_HELP_DYNAMIC | KTP_HELP_DYNAMIC_ARGS))
+			goto fallback;
+		if (pos < found->args_num) {
+			const ktp_help_arg_t *arg = &found->args[pos];
+			const char *prefix = NULL;
+			// Argument or longer command name. Let server decide.
+			if (num > 0)
+				goto fallback;
+			prefix = arg->ptype_help ? arg->ptype_help : arg->name;
+			if (!prefix || !*prefix)
+				prefix = arg->name;
+			if (!ktp_help_add(help, &num, prefix, strlen(prefix),
+				arg->help))
+				goto fallback;
+		} else if (!partial) {
+			if (!ktp_help_add(help, &num, "<cr>", 4, NULL))
+				goto fallback;
+		}
+	}
+	faux_str_free(text);
+
+	return num;
+
+fallback:
+	faux_str_free(text);
+	ktp_help_free(*help, num);
+	*help = NULL;
+
+	return -1;
+}
+
+
+void ktp_help_free(ktp_help_t *help, size_t num)
+{
+	size_t i = 0;
+
+	if (!help)
+		return;
+	for (i = 0; i < num; i++) {
+		faux_str_free(help[i].prefix);
+		faux_str_free(help[i].line);
+	}
+	faux_free(help);
+}
+
+
+/** @brief Requests context help from server
+ *
+ * It's used when ktp_session_help() can't answer locally. The server
+ * answers by KTP_HELP_ACK. See ktp_help_ack().
+ *
+ * @param [in] session KTP session.
+ * @param [in] line Text of the line up to cursor.
+ * @return 0 - success, -1 - error.
+ */
+int ktp_session_req_help(ktp_session_t *session, const char *line)
+{
+	faux_msg_t *msg = NULL;
+	int retval = -1;
+
+	assert(session);
+	if (!session)
+		return -1;
+	assert(line);
+	if (!line)
+		return -1;
+
+	msg = ktp_msg_preform(KTP_HELP, 0);
+	if (!msg)
+		return -1;
+	faux_msg_add_param(msg, KTP_PARAM_LINE, line, strlen(line));
+	if (faux_msg_send(msg, session->net) >= 0) {
+		session->state = KTP_SESSION_STATE_WAIT_FOR_HELP;
+		retval = 0;
+	}
+	faux_msg_free(msg);
+
+	return retval;
+}
+
+
+/** @brief Gets context help from KTP_HELP_ACK
+ *
+ * @param [in] msg KTP_HELP_ACK message.
+ * @param [out] help Allocated array of entries. Free by ktp_help_free().
+ * @return Number of entries or -1 on error.
+ */
+ssize_t ktp_help_ack(const faux_msg_t *msg, ktp_help_t **help)
+{
+	faux_list_node_t *iter = NULL;
+	uint16_t param_type = 0;
+	void *param_data = NULL;
+	uint32_t param_len = 0;
+	size_t num = 0;
+
+	assert(msg);
+	if (!msg)
+		return -1;
+	assert(help);
+	if (!help)
+		return -1;
+	*help = NULL;
+	if (faux_msg_get_cmd(msg) != KTP_HELP_ACK)
+		return -1;
+
+	iter = faux_msg_init_param_iter(msg);
+	while (faux_msg_get_param_each(&iter, &param_type, &param_data,
+		&param_len)) {
+		const char *data = (const char *)param_data;
+		const char *end = data + param_len;
+		char *prefix = NULL;
+		char *line = NULL;
+		bool_t added = BOOL_FALSE;
+		if (param_type != KTP_PARAM_HELP)
+			continue;
+		prefix = ktp_param_str(&data, end);
+		line = ktp_param_str(&data, end);
+		if (prefix)
+			added = ktp_help_add(help, &num, prefix,
+				strlen(prefix), line);
+		faux_str_free(prefix);
+		faux_str_free(line);
+		if (!added) {
+			ktp_help_free(*help, num);
+			*help = NULL;
+			return -1;
+		}
+	}
+
+	return num;
+}
+
+
+/** @brief Gets execution statistics from KTP_CMD_ACK
+ *
+ * The fields the server didn't send are zeroed.
+ */
+bool_t ktp_cmd_ack_stat(const faux_msg_t *msg, ktp_cmd_stat_t *stat)
+{
+	void *param_data = NULL;
+	uint32_t param_len = 0;
+
+	assert(msg);
+	if (!msg)
+		return BOOL_FALSE;
+	assert(stat);
+	if (!stat)
+		return BOOL_FALSE;
+	if ((faux_msg_get_cmd(msg) != KTP_CMD_ACK) &&
+		(faux_msg_get_cmd(msg) != KTP_JOB_ATTACH_ACK))
+		return BOOL_FALSE;
+
+	memset(stat, 0, sizeof(*stat));
+	if (faux_msg_get_param_by_type(msg, KTP_PARAM_WAIT,
+		&param_data, &param_len) &&
+		!ktp_param_uint32(param_data, param_len, &stat->wait))
+		return BOOL_FALSE;
+	if (faux_msg_get_param_by_type(msg, KTP_PARAM_CPU,
+		&param_data, &param_len) &&
+		!ktp_param_uint32(param_data, param_len, &stat->cpu))
+		return BOOL_FALSE;
+	if (faux_msg_get_param_by_type(msg, KTP_PARAM_MEMORY,
+		&param_data, &param_len) &&
+		!ktp_param_uint32(param_data, param_len, &stat->memory))
+		return BOOL_FALSE;
+	if (faux_msg_get_param_by_type(msg, KTP_PARAM_CACHED,
+		&param_data, &param_len)) {
+		if (!ktp_param_uint32(param_data, param_len, &stat->age))
+			return BOOL_FALSE;
+		stat->cached = BOOL_TRUE;
+	}
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Stores resumption token from KTP_AUTH_ACK
+ *
+ * @return BOOL_TRUE if server allows to resume session.
+ */
+bool_t ktp_session_set_resume(ktp_session_t *session, const faux_msg_t *msg)
+{
+	void *param_data = NULL;
+	uint32_t param_len = 0;
+
+	assert(session);
+	if (!session)
+		return BOOL_FALSE;
+	assert(msg);
+	if (!msg)
+		return BOOL_FALSE;
+	if (faux_msg_get_cmd(msg) != KTP_AUTH_ACK)
+		return BOOL_FALSE;
+
+	session->token_valid = BOOL_FALSE;
+	if (!faux_msg_get_param_by_type(msg, KTP_PARAM_RESUME,
+		&param_data, &param_len))
+		return BOOL_FALSE;
+	if (param_len != KTP_TOKEN_LEN)
+		return BOOL_FALSE;
+	memcpy(session->token, param_data, KTP_TOKEN_LEN);
+	session->token_valid = BOOL_TRUE;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Accounts stdout bytes received from server
+ *
+ * The server replays the output starting from this point on resume.
+ */
+void ktp_session_stdout_received(ktp_session_t *session, size_t len)
+{
+	assert(session);
+	if (!session)
+		return;
+
+	session->stdout_received += len;
+}
+
+
+/** @brief Resumes session over the new connection
+ *
+ * Sends KTP_AUTH with resumption token. The server answers by KTP_AUTH_ACK
+ * and then replays the missed output.
+ *
+ * @param [in] session Session with lost connection.
+ * @param [in] sock New connection.
+ * @return 0 - request is sent, -1 - error or session can't be resumed.
+ */
+int ktp_session_resume(ktp_session_t *session, int sock)
+{
+	faux_msg_t *msg = NULL;
+	uint8_t param[KTP_TOKEN_LEN + sizeof(uint64_t)];
+	uint64_t net_received = 0;
+	int fd = -1;
+	int retval = -1;
+
+	assert(session);
+	if (!session)
+		return -1;
+	if (!session->token_valid || (sock < 0))
+		return -1;
+
+	fd = faux_net_get_fd(session->net);
+	if ((fd >= 0) && (fd != sock))
+		close(fd);
+	faux_net_set_fd(session->net, sock);
+	session->state = KTP_SESSION_STATE_NOT_AUTHORIZED;
+
+	memcpy(param, session->token, KTP_TOKEN_LEN);
+	net_received = htobe64(session->stdout_received);
+	memcpy(param + KTP_TOKEN_LEN, &net_received, sizeof(net_received));
+	msg = ktp_msg_preform(KTP_AUTH, 0);
+	if (!msg)
+		return -1;
+	faux_msg_add_param(msg, KTP_PARAM_RESUME, param, sizeof(param));
+	if (faux_msg_send(msg, session->net) >= 0)
+		retval = 0;
+	faux_msg_free(msg);
+
+	return retval;
+}
+
+
+/** @brief Receives message from server
+ *
+ * @return Message or NULL if connection is broken.
+ */
+faux_msg_t *ktp_session_recv(ktp_session_t *session)
+{
+	faux_msg_t *msg = NULL;
+
+	assert(session);
+	if (!session)
+		return NULL;
+
+	msg = faux_msg_recv(session->net);
+	if (!msg)
+		session->state = KTP_SESSION_STATE_DISCONNECTED;
+
+	return msg;
+}
+
+
+/** @brief Sends one-shot request
+ *
+ * The authentication and command are sent by the single KTP_AUTH message
+ * so the whole request is a single write and a single round trip. The
+ * server answers by KTP_AUTH_ACK, then the command's output and finally
+ * KTP_CMD_ACK with command's retcode.
+ */
+int ktp_session_oneshot(ktp_session_t *session, const char *line)
+{
+	faux_msg_t *msg = NULL;
+	int retval = -1;
+
+	assert(session);
+	if (!session)
+		return -1;
+	assert(line);
+	if (!line)
+		return -1;
+
+	msg = ktp_msg_preform(KTP_AUTH, 0);
+	if (!msg)
+		return -1;
+	faux_msg_add_param(msg, KTP_PARAM_LINE, line, strlen(line));
+	if (faux_msg_send(msg, session->net) >= 0) {
+		session->state = KTP_SESSION_STATE_WAIT_FOR_CMD;
+		retval = 0;
+	}
+	faux_msg_free(msg);
+
+	return retval;
+}
+
+
+/** @brief Sends regular authentication request
+ */
+int ktp_session_auth(ktp_session_t *session)
+{
+	faux_msg_t *msg = NULL;
+	int retval = -1;
+
+	assert(session);
+	if (!session)
+		return -1;
+
+	msg = ktp_msg_preform(KTP_AUTH, 0);
+	if (!msg)
+		return -1;
+	if (faux_msg_send(msg, session->net) >= 0)
+		retval = 0;
+	faux_msg_free(msg);
+
+	return retval;
+}
+
+
+/** @brief Sends command line to execute within authorized session
+ */
+int ktp_session_cmd(ktp_session_t *session, const char *line)
+{
+	faux_msg_t *msg = NULL;
+	int retval = -1;
+
+	assert(session);
+	if (!session)
+		return -1;
+	assert(line);
+	if (!line)
+		return -1;
+
+	msg = ktp_msg_preform(KTP_CMD, 0);
+	if (!msg)
+		return -1;
+	faux_msg_add_param(msg, KTP_PARAM_LINE, line, strlen(line));
+	if (faux_msg_send(msg, session->net) >= 0) {
+		session->state = KTP_SESSION_STATE_WAIT_FOR_CMD;
+		retval = 0;
+	}
+	faux_msg_free(msg);
+
+	return retval;
+}
+
+
+/** @brief Sends command line to execute as background job
+ *
+ * The server answers by KTP_CMD_ACK with KTP_PARAM_JOB at once. The job's
+ * output and result are got by ktp_session_req_job_attach() later.
+ */
+int ktp_session_cmd_background(ktp_session_t *session, const char *line)
+{
+	faux_msg_t *msg = NULL;
+	int retval = -1;
+
+	assert(session);
+	if (!session)
+		return -1;
+	assert(line);
+	if (!line)
+		return -1;
+
+	msg = ktp_msg_preform(KTP_CMD, 0);
+	if (!msg)
+		return -1;
+	faux_msg_add_param(msg, KTP_PARAM_LINE, line, strlen(line));
+	faux_msg_add_param(msg, KTP_PARAM_BACKGROUND, NULL, 0);
+	if (faux_msg_send(msg, session->net) >= 0) {
+		session->state = KTP_SESSION_STATE_WAIT_FOR_CMD;
+		retval = 0;
+	}
+	faux_msg_free(msg);
+
+	return retval;
+}
+
+
+static int ktp_session_send_req(ktp_session_t *session, ktp_cmd_e cmd,
+	const void *data, size_t len)
+{
+	faux_msg_t *msg = NULL;
+	int retval = -1;
+
+	msg = ktp_msg_preform(cmd, 0);
+	if (!msg)
+		return -1;
+	if (data)
+		faux_msg_add_param(msg, KTP_PARAM_JOB, data, len);
+	if (faux_msg_send(msg, session->net) >= 0)
+		retval = 0;
+	faux_msg_free(msg);
+
+	return retval;
+}
+
+
+/** @brief Requests list of user's background jobs
+ */
+int ktp_session_req_jobs(ktp_session_t *session)
+{
+	assert(session);
+	if (!session)
+		return -1;
+
+	return ktp_session_send_req(session, KTP_JOBS, NULL, 0);
+}
+
+
+/** @brief Requests output and result of background job
+ *
+ * The server sends the spooled output by KTP_STDOUT messages then the
+ * live output and finally KTP_JOB_ATTACH_ACK with job's retcode.
+ */
+int ktp_session_req_job_attach(ktp_session_t *session, uint32_t id)
+{
+	uint32_t net_id = htonl(id);
+
+	assert(session);
+	if (!session)
+		return -1;
+
+	return ktp_session_send_req(session, KTP_JOB_ATTACH,
+		&net_id, sizeof(net_id));
+}
+
+
+static bool_t ktp_param_job(const void *data, uint32_t len, ktp_job_t *job)
+{
+	const char *p = (const char *)data;
+	uint32_t net_val = 0;
+	size_t hdr = sizeof(net_val) + 1 + sizeof(net_val);
+
+	if (len < hdr)
+		return BOOL_FALSE;
+	memcpy(&net_val, p, sizeof(net_val));
+	job->id = ntohl(net_val);
+	job->finished = (KTP_JOB_DONE == p[sizeof(net_val)]) ?
+		BOOL_TRUE : BOOL_FALSE;
+	memcpy(&net_val, p + sizeof(net_val) + 1, sizeof(net_val));
+	job->retcode = (int)ntohl(net_val);
+	job->line = faux_str_dupn(p + hdr, len - hdr);
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Gets job from KTP_CMD_ACK or KTP_JOB_ATTACH_ACK
+ *
+ * The job->line must be freed by faux_str_free().
+ *
+ * @return BOOL_FALSE if message has no job.
+ */
+bool_t ktp_msg_job(const faux_msg_t *msg, ktp_job_t *job)
+{
+	void *param_data = NULL;
+	uint32_t param_len = 0;
+
+	assert(msg);
+	if (!msg)
+		return BOOL_FALSE;
+	assert(job);
+	if (!job)
+		return BOOL_FALSE;
+
+	if (!faux_msg_get_param_by_type(msg, KTP_PARAM_JOB,
+		&param_data, &param_len))
+		return BOOL_FALSE;
+
+	return ktp_param_job(param_data, param_len, job);
+}
+
+
+/** @brief Gets list of jobs from KTP_JOBS_ACK
+ *
+ * @param [in] msg The KTP_JOBS_ACK message.
+ * @param [out] jobs Array of jobs. Must be freed by ktp_jobs_free().
+ * @return Number of jobs or -1 on error.
+ */
+ssize_t ktp_msg_jobs(const faux_msg_t *msg, ktp_job_t **jobs)
+{
+	faux_list_node_t *iter = NULL;
+	uint16_t param_type = 0;
+	void *param_data = NULL;
+	uint32_t param_len = 0;
+	ktp_job_t *arr = NULL;
+	size_t num = 0;
+
+	assert(msg);
+	if (!msg)
+		return -1;
+	assert(jobs);
+	if (!jobs)
+		return -1;
+	if (faux_msg_get_cmd(msg) != KTP_JOBS_ACK)
+		return -1;
+
+	iter = faux_msg_init_param_iter(msg);
+	while (faux_msg_get_param_each(&iter, &param_type, &param_data,
+		&param_len)) {
+		ktp_job_t *tmp = NULL;
+		if (param_type != KTP_PARAM_JOB)
+			continue;
+		tmp = realloc(arr, (num + 1) * sizeof(*arr));
+		assert(tmp);
+		if (!tmp)
+			break;
+		arr = tmp;
+		if (ktp_param_job(param_data, param_len, &arr[num]))
+			num++;
+	}
+	*jobs = arr;
+
+	return num;
+}
+
+
+void ktp_jobs_free(ktp_job_t *jobs, size_t num)
+{
+	size_t i = 0;
+
+	if (!jobs)
+		return;
+
+	for (i = 0; i < num; i++)
+		faux_str_free(jobs[i].line);
+	faux_free(jobs);
+}
+
+
 #if 0
 static void ktp_session_bad_socket(ktp_session_t *session)
 {
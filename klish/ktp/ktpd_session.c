@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
@@ -9,13 +10,23 @@
 #include <fcntl.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/random.h>
+#include <arpa/inet.h>
+#include <endian.h>
 
 #include <faux/str.h>
 #include <klish/ktp_session.h>
+#include <klish/ktoken.h>
 
 #include "private.h"
 
 
+static void ktpd_session_ack_free(void *data)
+{
+	faux_msg_free((faux_msg_t *)data);
+}
+
+
 ktpd_session_t *ktpd_session_new(int sock)
 {
 	ktpd_session_t *session = NULL;
@@ -33,6 +44,19 @@ ktpd_session_t *ktpd_session_new(int sock)
 	session->net = faux_net_new();
 	assert(session->net);
 	faux_net_set_fd(session->net, sock);
+	session->token_valid = (getrandom(session->token,
+		sizeof(session->token), 0) == sizeof(session->token)) ?
+		BOOL_TRUE : BOOL_FALSE;
+	session->replay = NULL;
+	session->replay_size = 0;
+	session->replay_len = 0;
+	session->replay_start = 0;
+	session->stdout_sent = 0;
+	// The batch answers several commands at once
+	session->acks = faux_list_new(FAUX_LIST_UNSORTED, FAUX_LIST_NONUNIQUE,
+		NULL, NULL, ktpd_session_ack_free);
+	assert(session->acks);
+	session->udata = NULL;
 
 	return session;
 }
@@ -40,9 +64,16 @@ ktpd_session_t *ktpd_session_new(int sock)
 
 void ktpd_session_free(ktpd_session_t *session)
 {
+	int i = 0;
+
 	if (!session)
 		return;
 
+	for (i = 0; i < KVIEW_HOTKEY_NUM; i++)
+		faux_str_free(session->hotkeys[i]);
+	faux_str_free(session->user);
+	faux_free(session->replay);
+	faux_list_free(session->acks);
 	faux_net_free(session->net);
 	faux_free(session);
 }
@@ -69,6 +100,1263 @@ int ktpd_session_get_socket(ktpd_session_t *session)
 	return faux_net_get_fd(session->net);
 }
 
+
+/** @brief Receives message from client
+ *
+ * @return Message or NULL if connection is broken.
+ */
+faux_msg_t *ktpd_session_recv(ktpd_session_t *session)
+{
+	faux_msg_t *msg = NULL;
+
+	assert(session);
+	if (!session)
+		return NULL;
+
+	msg = faux_msg_recv(session->net);
+
+	return msg;
+}
+
+
+/** @brief Authorizes session
+ *
+ * The user is identified by owner (by credentials of peer for UNIX socket).
+ */
+bool_t ktpd_session_login(ktpd_session_t *session, const char *user,
+	uid_t uid, gid_t gid)
+{
+	assert(session);
+	if (!session)
+		return BOOL_FALSE;
+	assert(user);
+	if (!user)
+		return BOOL_FALSE;
+
+	faux_str_free(session->user);
+	session->user = faux_str_dup(user);
+	session->uid = uid;
+	session->gid = gid;
+	session->state = KTPD_SESSION_STATE_IDLE;
+
+	return BOOL_TRUE;
+}
+
+
+bool_t ktpd_session_authorized(const ktpd_session_t *session)
+{
+	assert(session);
+	if (!session)
+		return BOOL_FALSE;
+	if ((KTPD_SESSION_STATE_NOT_AUTHORIZED == session->state) ||
+		(KTPD_SESSION_STATE_DISCONNECTED == session->state))
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+const char *ktpd_session_user(const ktpd_session_t *session)
+{
+	assert(session);
+	if (!session)
+		return NULL;
+
+	return session->user;
+}
+
+
+uid_t ktpd_session_uid(const ktpd_session_t *session)
+{
+	assert(session);
+	if (!session)
+		return (uid_t)-1;
+
+	return session->uid;
+}
+
+
+void *ktpd_session_udata(const ktpd_session_t *session)
+{
+	assert(session);
+	if (!session)
+		return NULL;
+
+	return session->udata;
+}
+
+
+void ktpd_session_set_udata(ktpd_session_t *session, void *udata)
+{
+	assert(session);
+	if (!session)
+		return;
+
+	session->udata = udata;
+}
+
+
+static bool_t ktpd_session_hotkeys_changed(const ktpd_session_t *session,
+	const char * const *hotkeys)
+{
+	int i = 0;
+
+	for (i = 0; i < KVIEW_HOTKEY_NUM; i++) {
+		const char *sent = session->hotkeys[i];
+		if (!sent && !hotkeys[i])
+			continue;
+		if (!sent || !hotkeys[i] || strcmp(sent, hotkeys[i]))
+			return BOOL_TRUE;
+	}
+
+	return BOOL_FALSE;
+}
+
+
+/** @brief Sends map of hotkeys to client
+ *
+ * The map is sent on change of current view. The client binds keys locally
+ * so the hotkey doesn't need a request to server. The map which is equal to
+ * the last sent one is not sent again (nested views inherit the same
+ * hotkeys usually).
+ *
+ * @param [in] session KTP session.
+ * @param [in] hotkeys Array of KVIEW_HOTKEY_NUM commands indexed by key code.
+ * @return 0 - success (or nothing to send), -1 - error.
+ */
+int ktpd_session_send_hotkeys(ktpd_session_t *session,
+	const char * const *hotkeys)
+{
+	faux_msg_t *msg = NULL;
+	int i = 0;
+	int retval = -1;
+
+	assert(session);
+	if (!session)
+		return -1;
+	assert(hotkeys);
+	if (!hotkeys)
+		return -1;
+
+	if (KTPD_SESSION_STATE_DETACHED == session->state)
+		return 0;
+	if (!ktpd_session_hotkeys_changed(session, hotkeys))
+		return 0;
+
+	msg = ktp_msg_preform(KTP_HOTKEYS, 0);
+	if (!msg)
+		return -1;
+	for (i = 0; i < KVIEW_HOTKEY_NUM; i++) {
+		char *param = NULL;
+		size_t len = 0;
+		if (!hotkeys[i])
+			continue;
+		len = strlen(hotkeys[i]);
+		param = faux_zmalloc(len + 1);
+		assert(param);
+		if (!param)
+			goto err;
+		param[0] = (char)i;
+		memcpy(param + 1, hotkeys[i], len);
+		faux_msg_add_param(msg, KTP_PARAM_HOTKEY, param, len + 1);
+		faux_free(param);
+	}
+	if (faux_msg_send(msg, session->net) < 0)
+		goto err;
+
+	// Remember map to don't send it twice
+	for (i = 0; i < KVIEW_HOTKEY_NUM; i++) {
+		faux_str_free(session->hotkeys[i]);
+		session->hotkeys[i] = faux_str_dup(hotkeys[i]);
+	}
+	retval = 0;
+
+err:
+	faux_msg_free(msg);
+
+	return retval;
+}
+
+
+/** @brief Adds parameter of zero separated strings
+ *
+ * @param [in] msg Message.
+ * @param [in] type Parameter type.
+ * @param [in] flags Leading flags byte or -1 if there is no one.
+ * @param [in] strs Strings. NULL is sent as empty string.
+ * @param [in] num Number of strings.
+ */
+static bool_t ktpd_msg_add_strs(faux_msg_t *msg, ktp_param_e type, int flags,
+	const char * const *strs, size_t num)
+{
+	char *param = NULL;
+	size_t len = 0;
+	size_t i = 0;
+	char *p = NULL;
+
+	if (flags >= 0)
+		len++;
+	for (i = 0; i < num; i++)
+		len += (strs[i] ? strlen(strs[i]) : 0) + 1;
+	param = faux_zmalloc(len);
+	assert(param);
+	if (!param)
+		return BOOL_FALSE;
+	p = param;
+	if (flags >= 0)
+		*p++ = (char)flags;
+	for (i = 0; i < num; i++) {
+		size_t slen = strs[i] ? strlen(strs[i]) : 0;
+		if (slen > 0)
+			memcpy(p, strs[i], slen);
+		p += slen + 1; // Zero is set by faux_zmalloc()
+	}
+	faux_msg_add_param(msg, type, param, len);
+	faux_free(param);
+
+	return BOOL_TRUE;
+}
+
+
+static void ktpd_msg_add_uint32(faux_msg_t *msg, ktp_param_e type,
+	uint32_t val)
+{
+	uint32_t net_val = htonl(val);
+
+	faux_msg_add_param(msg, type, &net_val, sizeof(net_val));
+}
+
+
+static uint32_t ktpd_uint32_sat(unsigned long long val)
+{
+	return (val > UINT32_MAX) ? UINT32_MAX : (uint32_t)val;
+}
+
+
+static void ktpd_msg_add_version(faux_msg_t *msg, uint32_t version)
+{
+	ktpd_msg_add_uint32(msg, KTP_PARAM_VERSION, version);
+}
+
+
+/** @brief Checks if client can find PARAM by position
+ *
+ * The plain sequence of mandatory common PARAMs with static PTYPEs only.
+ */
+static bool_t ktpd_session_static_args(const faux_list_t *params)
+{
+	faux_list_node_t *iter = NULL;
+	kparam_t *param = NULL;
+
+	iter = faux_list_head(params);
+	while ((param = (kparam_t *)faux_list_each(&iter))) {
+		if (kparam_mode(param) != KPARAM_MODE_COMMON)
+			return BOOL_FALSE;
+		if (kparam_optional(param))
+			return BOOL_FALSE;
+		if (faux_list_len(kparam_params(param)) > 0)
+			return BOOL_FALSE;
+		if (!kparam_ptype(param) || kptype_action(kparam_ptype(param)))
+			return BOOL_FALSE;
+	}
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Sends help index of current level to client
+ *
+ * The index contains the commands available for context help with their
+ * help strings and the help of their PARAMs and PTYPEs. It's sent on
+ * change of current view so the client answers static help itself. The
+ * commands with VAR or external conditions are marked as dynamic because
+ * their visibility can be changed within the view. The client asks server
+ * by KTP_HELP for them.
+ *
+ * @param [in] session KTP session.
+ * @param [in] ksession Klish session to get current path from.
+ * @return 0 - success, -1 - error.
+ */
+int ktpd_session_send_help_index(ktpd_session_t *session,
+	ksession_t *ksession)
+{
+	faux_msg_t *msg = NULL;
+	const klevel_cmd_t *cmds = NULL;
+	size_t num = 0;
+	size_t i = 0;
+	int retval = -1;
+
+	assert(session);
+	if (!session)
+		return -1;
+	assert(ksession);
+	if (!ksession)
+		return -1;
+	if (KTPD_SESSION_STATE_DETACHED == session->state)
+		return 0;
+
+	msg = ktp_msg_preform(KTP_HELP_INDEX, 0);
+	if (!msg)
+		return -1;
+	ktpd_msg_add_version(msg, kscheme_version(ksession_scheme(ksession)));
+
+	cmds = kpath_find_prefix(ksession_path(ksession), "", &num);
+	for (i = 0; i < num; i++) {
+		const klevel_cmd_t *cmd = &cmds[i];
+		kcommand_t *command = cmd->command;
+		kcond_e cond_class = kcommand_cond_class(command);
+		const char *strs[3] = {};
+		int flags = 0;
+		bool_t static_args = BOOL_FALSE;
+		faux_list_node_t *iter = NULL;
+		kparam_t *param = NULL;
+
+		if (!(cmd->flags & KLEVEL_CMD_CONTEXT_HELP))
+			continue;
+		if ((KCOND_VAR == cond_class) || (KCOND_DYNAMIC == cond_class))
+			flags |= KTP_HELP_DYNAMIC;
+		else if (!ksession_find_command(ksession, cmd->name))
+			continue; // Denied by access rights or static condition
+		static_args = ktpd_session_static_args(
+			kcommand_params(command));
+		if (!static_args)
+			flags |= KTP_HELP_DYNAMIC_ARGS;
+
+		strs[0] = cmd->name;
+		strs[1] = kcommand_help(command);
+		if (!ktpd_msg_add_strs(msg, KTP_PARAM_HELP_CMD, flags, strs, 2))
+			goto err;
+		if (!static_args)
+			continue;
+		iter = faux_list_head(kcommand_params(command));
+		while ((param = (kparam_t *)faux_list_each(&iter))) {
+			strs[0] = kparam_name(param);
+			strs[1] = kparam_help(param);
+			strs[2] = kptype_help(kparam_ptype(param));
+			if (!ktpd_msg_add_strs(msg, KTP_PARAM_HELP_ARG, -1,
+				strs, 3))
+				goto err;
+		}
+	}
+
+	if (faux_msg_send(msg, session->net) < 0)
+		goto err;
+	retval = 0;
+
+err:
+	faux_msg_free(msg);
+
+	return retval;
+}
+
+
+/** @brief Adds help entry unless it's equal to the previous one
+ *
+ * The commands are sorted so the same next words are neighbours.
+ */
+static bool_t ktpd_msg_add_help(faux_msg_t *msg, char **last,
+	const char *prefix, size_t prefix_len, const char *help)
+{
+	const char *strs[2] = {};
+	char *word = NULL;
+	bool_t retval = BOOL_FALSE;
+
+	if (*last && (strlen(*last) == prefix_len) &&
+		(strncmp(*last, prefix, prefix_len) == 0))
+		return BOOL_TRUE;
+	word = faux_str_dupn(prefix, prefix_len);
+	strs[0] = word;
+	strs[1] = help;
+	retval = ktpd_msg_add_strs(msg, KTP_PARAM_HELP, -1, strs, 2);
+	faux_str_free(*last);
+	*last = word;
+
+	return retval;
+}
+
+
+/** @brief Answers KTP_HELP by context help for the line
+ *
+ * The client asks server when its help index can't answer. So the help is
+ * found by current state of session: the conditions and access rights are
+ * checked and quoted words are parsed. The next words of visible command
+ * names are answered. The help of complete command is its PARAM found by
+ * position or "<cr>" if there is no more PARAMs.
+ *
+ * @param [in] session KTP session.
+ * @param [in] ksession Klish session to get current path from.
+ * @param [in] line Text of the line up to cursor.
+ * @return 0 - success, -1 - error.
+ */
+int ktpd_session_send_help(ktpd_session_t *session, ksession_t *ksession,
+	const char *line)
+{
+	faux_msg_t *msg = NULL;
+	ktokens_t *tokens = NULL;
+	char *text = NULL; // Normalized line: single spaces
+	char *last = NULL;
+	const klevel_cmd_t *cmds = NULL;
+	const klevel_cmd_t *found = NULL;
+	bool_t partial = BOOL_FALSE;
+	bool_t quoted = BOOL_FALSE;
+	size_t tokens_num = 0;
+	size_t complete = 0; // Number of complete words
+	size_t found_words = 0;
+	size_t num = 0;
+	size_t i = 0;
+	int retval = -1;
+
+	assert(session);
+	if (!session)
+		return -1;
+	assert(ksession);
+	if (!ksession)
+		return -1;
+	assert(line);
+	if (!line)
+		return -1;
+	if (KTPD_SESSION_STATE_DETACHED == session->state)
+		return 0;
+
+	msg = ktp_msg_preform(KTP_HELP_ACK, 0);
+	if (!msg)
+		return -1;
+
+	// The quoted word is an argument always
+	tokens = ktokens_new();
+	assert(tokens);
+	tokens_num = ktokens_parse(tokens, line, strlen(line));
+	partial = !ktokens_word_end(tokens);
+	text = faux_str_dup("");
+	for (i = 0; i < tokens_num; i++) {
+		const ktoken_t *token = ktokens_at(tokens, i);
+		const klevel_cmd_t *cmd = NULL;
+		if (partial && (i == tokens_num - 1))
+			break;
+		complete++;
+		if (quoted || (token->quote != KTOKEN_QUOTE_NONE)) {
+			quoted = BOOL_TRUE;
+			continue;
+		}
+		if (i > 0)
+			faux_str_cat(&text, " ");
+		faux_str_catn(&text, ktoken_str(tokens, token), token->len);
+		cmd = ksession_find_command(ksession, text);
+		if (cmd) {
+			found = cmd;
+			found_words = complete;
+		}
+	}
+
+	// Next word of visible command names
+	if (!quoted) {
+		if (complete > 0)
+			faux_str_cat(&text, " ");
+		if (partial) {
+			const ktoken_t *token = ktokens_at(tokens,
+				tokens_num - 1);
+			faux_str_catn(&text, ktoken_str(tokens, token),
+				token->len);
+		}
+		cmds = kpath_find_prefix(ksession_path(ksession), text, &num);
+	}
+	for (i = 0; i < num; i++) {
+		const klevel_cmd_t *cmd = &cmds[i];
+		const char *word = cmd->name;
+		size_t w = 0;
+		if (!(cmd->flags & KLEVEL_CMD_CONTEXT_HELP))
+			continue;
+		if (!ksession_find_command(ksession, cmd->name))
+			continue;
+		for (w = 0; w < complete; w++)
+			word = strchr(word, ' ') + 1;
+		if (!ktpd_msg_add_help(msg, &last, word, strcspn(word, " "),
+			strchr(word, ' ') ? NULL : kcommand_help(cmd->command)))
+			goto err;
+	}
+
+	// PARAM of complete command
+	if (found) {
+		size_t pos = complete - found_words;
+		faux_list_node_t *iter = faux_list_head(
+			kcommand_params(found->command));
+		kparam_t *param = NULL;
+		while ((param = (kparam_t *)faux_list_each(&iter)) && (pos > 0))
+			pos--;
+		if (param) {
+			const char *prefix = kptype_help(kparam_ptype(param));
+			if (!prefix || !*prefix)
+				prefix = kparam_name(param);
+			if (!ktpd_msg_add_help(msg, &last, prefix,
+				strlen(prefix), kparam_help(param)))
+				goto err;
+		} else if (!partial) {
+			if (!ktpd_msg_add_help(msg, &last, "<cr>", 4, NULL))
+				goto err;
+		}
+	}
+
+	if (faux_msg_send(msg, session->net) < 0)
+		goto err;
+	retval = 0;
+
+err:
+	faux_str_free(last);
+	faux_str_free(text);
+	ktokens_free(tokens);
+	faux_msg_free(msg);
+
+	return retval;
+}
+
+
+/** @brief Notifies client about scheme version
+ *
+ * The client drops cached help index if version differs.
+ */
+int ktpd_session_send_version(ktpd_session_t *session, uint32_t version)
+{
+	faux_msg_t *msg = NULL;
+	int retval = -1;
+
+	assert(session);
+	if (!session)
+		return -1;
+
+	msg = ktp_msg_preform(KTP_NOTIFICATION, 0);
+	if (!msg)
+		return -1;
+	ktpd_msg_add_version(msg, version);
+	if (faux_msg_send(msg, session->net) >= 0)
+		retval = 0;
+	faux_msg_free(msg);
+
+	return retval;
+}
+
+
+/** @brief Sends answer of command
+ *
+ * The answers of detached session are kept until session is resumed. So
+ * the client gets the results of commands that are finished while
+ * connection is lost. The message is freed anyway.
+ */
+static int ktpd_session_send_ack(ktpd_session_t *session, faux_msg_t *msg)
+{
+	int retval = -1;
+
+	if (KTPD_SESSION_STATE_DETACHED == session->state) {
+		if (!faux_list_add(session->acks, msg)) {
+			faux_msg_free(msg);
+			return -1;
+		}
+		return 0;
+	}
+	if (faux_msg_send(msg, session->net) >= 0)
+		retval = 0;
+	faux_msg_free(msg);
+
+	return retval;
+}
+
+
+/** @brief Adds execution statistics of finished process
+ */
+static void ktpd_msg_add_stat(faux_msg_t *msg, const kexec_t *exec)
+{
+	const kexec_usage_t *usage = NULL;
+
+	ktpd_msg_add_uint32(msg, KTP_PARAM_WAIT,
+		ktpd_uint32_sat(kexec_wait(exec)));
+	usage = kexec_usage(exec);
+	if (usage->cpu_usec > 0)
+		ktpd_msg_add_uint32(msg, KTP_PARAM_CPU,
+			ktpd_uint32_sat(usage->cpu_usec / 1000));
+	if (usage->memory_peak > 0)
+		ktpd_msg_add_uint32(msg, KTP_PARAM_MEMORY,
+			ktpd_uint32_sat(usage->memory_peak / 1024));
+}
+
+
+/** @brief Acknowledges finished command
+ *
+ * The status of message is the return code of ACTION's process. The
+ * statistics of execution are sent as parameters. The resource usage is
+ * known if process was running within its own cgroup.
+ */
+int ktpd_session_send_cmd_ack(ktpd_session_t *session, const kexec_t *exec)
+{
+	faux_msg_t *msg = NULL;
+
+	assert(session);
+	if (!session)
+		return -1;
+	assert(exec);
+	if (!exec)
+		return -1;
+
+	msg = ktp_msg_preform(KTP_CMD_ACK, (uint32_t)kexec_retcode(exec));
+	if (!msg)
+		return -1;
+	ktpd_msg_add_stat(msg, exec);
+
+	return ktpd_session_send_ack(session, msg);
+}
+
+
+/** @brief Answers KTP_CMD that has no process
+ *
+ * The command is a navigation only or it can't be executed. The error
+ * message is sent to stderr first.
+ *
+ * @param [in] session KTP session.
+ * @param [in] retcode Command's retcode.
+ * @param [in] error Error message or NULL.
+ * @return 0 - success, < 0 - error.
+ */
+int ktpd_session_send_cmd_result(ktpd_session_t *session, int retcode,
+	const char *error)
+{
+	faux_msg_t *msg = NULL;
+
+	assert(session);
+	if (!session)
+		return -1;
+
+	if (error)
+		ktpd_session_send_stderr(session, error, strlen(error));
+	msg = ktp_msg_preform(KTP_CMD_ACK, (uint32_t)retcode);
+	if (!msg)
+		return -1;
+
+	return ktpd_session_send_ack(session, msg);
+}
+
+
+/** @brief Sets size of replay ring of stdout
+ *
+ * The ring keeps recent output to send it to client that resumes session
+ * after reconnect. The 0 disables replay. The data within ring is lost.
+ */
+bool_t ktpd_session_set_replay_size(ktpd_session_t *session, size_t size)
+{
+	assert(session);
+	if (!session)
+		return BOOL_FALSE;
+
+	faux_free(session->replay);
+	session->replay = NULL;
+	session->replay_size = 0;
+	session->replay_len = 0;
+	session->replay_start = 0;
+	if (0 == size)
+		return BOOL_TRUE;
+	session->replay = faux_zmalloc(size);
+	assert(session->replay);
+	if (!session->replay)
+		return BOOL_FALSE;
+	session->replay_size = size;
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Gets session resumption token
+ *
+ * @return Token of KTP_TOKEN_LEN bytes or NULL if session can't be
+ * resumed.
+ */
+const uint8_t *ktpd_session_token(const ktpd_session_t *session)
+{
+	assert(session);
+	if (!session)
+		return NULL;
+	if (!session->token_valid)
+		return NULL;
+
+	return session->token;
+}
+
+
+/** @brief Checks token in constant time
+ */
+bool_t ktpd_session_token_match(const ktpd_session_t *session,
+	const uint8_t *token)
+{
+	uint8_t diff = 0;
+	size_t i = 0;
+
+	assert(session);
+	if (!session)
+		return BOOL_FALSE;
+	if (!token || !session->token_valid)
+		return BOOL_FALSE;
+
+	for (i = 0; i < KTP_TOKEN_LEN; i++)
+		diff |= session->token[i] ^ token[i];
+
+	return (0 == diff) ? BOOL_TRUE : BOOL_FALSE;
+}
+
+
+/** @brief Acknowledges authentication
+ *
+ * The resumption token is sent to client if session can be resumed.
+ */
+int ktpd_session_send_auth_ack(ktpd_session_t *session, uint32_t status)
+{
+	faux_msg_t *msg = NULL;
+	int retval = -1;
+
+	assert(session);
+	if (!session)
+		return -1;
+
+	msg = ktp_msg_preform(KTP_AUTH_ACK, status);
+	if (!msg)
+		return -1;
+	if ((0 == status) && session->token_valid && session->replay)
+		faux_msg_add_param(msg, KTP_PARAM_RESUME, session->token,
+			sizeof(session->token));
+	if (faux_msg_send(msg, session->net) >= 0)
+		retval = 0;
+	faux_msg_free(msg);
+
+	return retval;
+}
+
+
+/** @brief Gets resumption request from KTP_AUTH
+ *
+ * @param [in] msg The KTP_AUTH message.
+ * @param [out] token Buffer of KTP_TOKEN_LEN bytes for token.
+ * @param [out] received Number of stdout bytes client has received.
+ * @return BOOL_TRUE if message requests resumption.
+ */
+bool_t ktpd_auth_resume(const faux_msg_t *msg, uint8_t *token,
+	uint64_t *received)
+{
+	void *param_data = NULL;
+	uint32_t param_len = 0;
+	uint64_t net_received = 0;
+
+	assert(msg);
+	if (!msg)
+		return BOOL_FALSE;
+	if (faux_msg_get_cmd(msg) != KTP_AUTH)
+		return BOOL_FALSE;
+	if (!faux_msg_get_param_by_type(msg, KTP_PARAM_RESUME,
+		&param_data, &param_len))
+		return BOOL_FALSE;
+	if (param_len != KTP_TOKEN_LEN + sizeof(net_received))
+		return BOOL_FALSE;
+
+	memcpy(token, param_data, KTP_TOKEN_LEN);
+	memcpy(&net_received, (char *)param_data + KTP_TOKEN_LEN,
+		sizeof(net_received));
+	*received = be64toh(net_received);
+
+	return BOOL_TRUE;
+}
+
+
+/** @brief Gets command line of one-shot KTP_AUTH
+ *
+ * @return Allocated command line or NULL if it's a regular authentication.
+ * Must be freed by faux_str_free().
+ */
+char *ktpd_auth_line(const faux_msg_t *msg)
+{
+	void *param_data = NULL;
+	uint32_t param_len = 0;
+
+	assert(msg);
+	if (!msg)
+		return NULL;
+	if (faux_msg_get_cmd(msg) != KTP_AUTH)
+		return NULL;
+	if (!faux_msg_get_param_by_type(msg, KTP_PARAM_LINE,
+		&param_data, &param_len))
+		return NULL;
+
+	return faux_str_dupn((const char *)param_data, param_len);
+}
+
+
+/** @brief Gets command line of KTP_CMD or KTP_HELP
+ *
+ * @return Allocated command line or NULL on error. Must be freed by
+ * faux_str_free().
+ */
+char *ktpd_cmd_line(const faux_msg_t *msg)
+{
+	void *param_data = NULL;
+	uint32_t param_len = 0;
+
+	assert(msg);
+	if (!msg)
+		return NULL;
+	if ((faux_msg_get_cmd(msg) != KTP_CMD) &&
+		(faux_msg_get_cmd(msg) != KTP_HELP))
+		return NULL;
+	if (!faux_msg_get_param_by_type(msg, KTP_PARAM_LINE,
+		&param_data, &param_len))
+		return NULL;
+
+	return faux_str_dupn((const char *)param_data, param_len);
+}
+
+
+static void ktpd_session_replay_add(ktpd_session_t *session,
+	const char *data, size_t len)
+{
+	size_t end = 0;
+
+	// Only the tail fits the ring
+	if (len >= session->replay_size) {
+		memcpy(session->replay, data + len - session->replay_size,
+			session->replay_size);
+		session->replay_start = 0;
+		session->replay_len = session->replay_size;
+		return;
+	}
+
+	end = (session->replay_start + session->replay_len) %
+		session->replay_size;
+	while (len > 0) {
+		size_t chunk = session->replay_size - end;
+		if (chunk > len)
+			chunk = len;
+		memcpy(session->replay + end, data, chunk);
+		data += chunk;
+		len -= chunk;
+		end = (end + chunk) % session->replay_size;
+		session->replay_len += chunk;
+		if (session->replay_len > session->replay_size) {
+			session->replay_start = (session->replay_start +
+				session->replay_len - session->replay_size) %
+				session->replay_size;
+			session->replay_len = session->replay_size;
+		}
+	}
+}
+
+
+static int ktpd_session_send_data(ktpd_session_t *session, ktp_cmd_e cmd,
+	const char *data, size_t len)
+{
+	faux_msg_t *msg = NULL;
+	int retval = -1;
+
+	msg = ktp_msg_preform(cmd, 0);
+	if (!msg)
+		return -1;
+	faux_msg_add_param(msg, KTP_PARAM_DATA, data, len);
+	if (faux_msg_send(msg, session->net) >= 0)
+		retval = 0;
+	faux_msg_free(msg);
+
+	return retval;
+}
+
+
+/** @brief Sends command's stdout to client
+ *
+ * The data is kept within replay ring too. The data of detached session
+ * is kept only.
+ */
+int ktpd_session_send_stdout(ktpd_session_t *session, const char *data,
+	size_t len)
+{
+	assert(session);
+	if (!session)
+		return -1;
+	if (!data || (0 == len))
+		return 0;
+
+	if (session->replay)
+		ktpd_session_replay_add(session, data, len);
+	session->stdout_sent += len;
+	if (KTPD_SESSION_STATE_DETACHED == session->state)
+		return 0;
+
+	return ktpd_session_send_data(session, KTP_STDOUT, data, len);
+}
+
+
+/** @brief Sends command's stderr to client
+ *
+ * The stderr is not kept within replay ring so the detached session loses
+ * it.
+ */
+int ktpd_session_send_stderr(ktpd_session_t *session, const char *data,
+	size_t len)
+{
+	assert(session);
+	if (!session)
+		return -1;
+	if (!data || (0 == len))
+		return 0;
+	if (KTPD_SESSION_STATE_DETACHED == session->state)
+		return 0;
+
+	return ktpd_session_send_data(session, KTP_STDERR, data, len);
+}
+
+
+/** @brief Sends command's output and result from cache
+ *
+ * The whole stdout is sent first and then the whole stderr because the
+ * cache keeps them apart. So the order of interleaved output is not
+ * restored. The KTP_CMD_ACK has KTP_PARAM_CACHED with age of output.
+ */
+int ktpd_session_send_cached(ktpd_session_t *session,
+	const kcache_entry_t *entry)
+{
+	faux_msg_t *msg = NULL;
+	const char *data = NULL;
+	size_t len = 0;
+
+	assert(session);
+	if (!session)
+		return -1;
+	assert(entry);
+	if (!entry)
+		return -1;
+
+	data = kcache_entry_stdout(entry, &len);
+	if (ktpd_session_send_stdout(session, data, len) < 0)
+		return -1;
+	data = kcache_entry_stderr(entry, &len);
+	if (ktpd_session_send_stderr(session, data, len) < 0)
+		return -1;
+
+	msg = ktp_msg_preform(KTP_CMD_ACK,
+		(uint32_t)kcache_entry_retcode(entry));
+	if (!msg)
+		return -1;
+	ktpd_msg_add_uint32(msg, KTP_PARAM_CACHED, kcache_entry_age(entry));
+
+	return ktpd_session_send_ack(session, msg);
+}
+
+
+/** @brief Sends command's structured records to client
+ *
+ * The data is a part of records stream and it's not framed. The client
+ * assembles records itself. The records are not kept within replay ring so
+ * the detached session loses them.
+ */
+int ktpd_session_send_records(ktpd_session_t *session, const char *data,
+	size_t len)
+{
+	assert(session);
+	if (!session)
+		return -1;
+	if (!data || (0 == len))
+		return 0;
+	if (KTPD_SESSION_STATE_DETACHED == session->state)
+		return 0;
+
+	return ktpd_session_send_data(session, KTP_RECORD, data, len);
+}
+
+
+/** @brief Detaches session from lost connection
+ *
+ * The session keeps its state and the output of running commands is
+ * collected within replay ring until client resumes session.
+ *
+ * @return BOOL_TRUE - success, BOOL_FALSE - session can't be resumed.
+ */
+bool_t ktpd_session_detach(ktpd_session_t *session)
+{
+	int fd = -1;
+
+	assert(session);
+	if (!session)
+		return BOOL_FALSE;
+	if (!session->token_valid || !session->replay)
+		return BOOL_FALSE;
+	if ((KTPD_SESSION_STATE_IDLE != session->state) &&
+		(KTPD_SESSION_STATE_WAIT_FOR_PROCESS != session->state))
+		return BOOL_FALSE;
+
+	fd = faux_net_get_fd(session->net);
+	if (fd >= 0)
+		close(fd);
+	faux_net_set_fd(session->net, -1);
+	session->detached_state = session->state;
+	session->state = KTPD_SESSION_STATE_DETACHED;
+
+	return BOOL_TRUE;
+}
+
+
+bool_t ktpd_session_detached(const ktpd_session_t *session)
+{
+	assert(session);
+	if (!session)
+		return BOOL_FALSE;
+
+	return (KTPD_SESSION_STATE_DETACHED == session->state) ?
+		BOOL_TRUE : BOOL_FALSE;
+}
+
+
+/** @brief Attaches detached session to new connection
+ *
+ * Replays the output client has missed. The output that doesn't fit the
+ * ring is lost. The map of hotkeys sent before is forgotten because the new
+ * client process doesn't have it.
+ *
+ * @param [in] session Detached session.
+ * @param [in] sock New connection.
+ * @param [in] received Number of stdout bytes client has received.
+ * @param [out] lost Number of lost bytes. Can be NULL.
+ * @return 0 - success, -1 - error.
+ */
+int ktpd_session_resume(ktpd_session_t *session, int sock,
+	uint64_t received, uint64_t *lost)
+{
+	uint64_t oldest = 0;
+	size_t skip = 0;
+	size_t left = 0;
+	size_t pos = 0;
+	faux_list_node_t *node = NULL;
+	int i = 0;
+
+	assert(session);
+	if (!session)
+		return -1;
+	if (session->state != KTPD_SESSION_STATE_DETACHED)
+		return -1;
+	if (received > session->stdout_sent)
+		return -1;
+
+	for (i = 0; i < KVIEW_HOTKEY_NUM; i++) {
+		faux_str_free(session->hotkeys[i]);
+		session->hotkeys[i] = NULL;
+	}
+
+	faux_net_set_fd(session->net, sock);
+	session->state = session->detached_state;
+	if (ktpd_session_send_auth_ack(session, 0) < 0)
+		return -1;
+
+	oldest = session->stdout_sent - session->replay_len;
+	if (lost)
+		*lost = (received < oldest) ? (oldest - received) : 0;
+	if (received > oldest)
+		skip = (size_t)(received - oldest);
+	left = session->replay_len - skip;
+	pos = (session->replay_start + skip) % session->replay_size;
+	while (left > 0) {
+		size_t chunk = session->replay_size - pos;
+		if (chunk > left)
+			chunk = left;
+		if (ktpd_session_send_data(session, KTP_STDOUT,
+			session->replay + pos, chunk) < 0)
+			return -1;
+		left -= chunk;
+		pos = (pos + chunk) % session->replay_size;
+	}
+	// The commands were finished while session was detached
+	while ((node = faux_list_head(session->acks))) {
+		faux_msg_t *msg = (faux_msg_t *)faux_list_takeaway(
+			session->acks, node);
+		if (ktpd_session_send_ack(session, msg) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+
+/** @brief Checks if KTP_CMD requests background execution
+ */
+bool_t ktpd_cmd_background(const faux_msg_t *msg)
+{
+	void *param_data = NULL;
+	uint32_t param_len = 0;
+
+	assert(msg);
+	if (!msg)
+		return BOOL_FALSE;
+	if (faux_msg_get_cmd(msg) != KTP_CMD)
+		return BOOL_FALSE;
+	if (!faux_msg_get_param_by_type(msg, KTP_PARAM_BACKGROUND,
+		&param_data, &param_len))
+		return BOOL_FALSE;
+
+	return BOOL_TRUE;
+}
+
+
+static void ktpd_msg_add_job(faux_msg_t *msg, const kjob_t *job)
+{
+	const char *line = kjob_line(job) ? kjob_line(job) : "";
+	size_t line_len = strlen(line);
+	size_t len = sizeof(uint32_t) + 1 + sizeof(uint32_t) + line_len;
+	char *buf = NULL;
+	uint32_t net_val = 0;
+	bool_t finished = kjob_finished(job);
+
+	buf = faux_zmalloc(len);
+	assert(buf);
+	net_val = htonl(kjob_id(job));
+	memcpy(buf, &net_val, sizeof(net_val));
+	buf[sizeof(net_val)] = finished ? KTP_JOB_DONE : KTP_JOB_RUNNING;
+	net_val = htonl(finished ? (uint32_t)kexec_retcode(kjob_exec(job)) : 0);
+	memcpy(buf + sizeof(net_val) + 1, &net_val, sizeof(net_val));
+	memcpy(buf + sizeof(net_val) + 1 + sizeof(net_val), line, line_len);
+	faux_msg_add_param(msg, KTP_PARAM_JOB, buf, len);
+	faux_free(buf);
+}
+
+
+static bool_t ktpd_session_owns_job(const ktpd_session_t *session,
+	const kjob_t *job)
+{
+	if (!session->user || !kjob_user(job))
+		return BOOL_FALSE;
+
+	return (strcmp(session->user, kjob_user(job)) == 0) ?
+		BOOL_TRUE : BOOL_FALSE;
+}
+
+
+/** @brief Acknowledges command started in background
+ */
+int ktpd_session_send_job_started(ktpd_session_t *session,
+	const kjob_t *job)
+{
+	faux_msg_t *msg = NULL;
+
+	assert(session);
+	if (!session)
+		return -1;
+	assert(job);
+	if (!job)
+		return -1;
+
+	msg = ktp_msg_preform(KTP_CMD_ACK, 0);
+	if (!msg)
+		return -1;
+	ktpd_msg_add_job(msg, job);
+
+	return ktpd_session_send_ack(session, msg);
+}
+
+
+/** @brief Sends list of session user's jobs
+ */
+int ktpd_session_send_jobs(ktpd_session_t *session, const kjobs_t *jobs)
+{
+	faux_msg_t *msg = NULL;
+	faux_list_node_t *iter = NULL;
+	kjob_t *job = NULL;
+
+	assert(session);
+	if (!session)
+		return -1;
+	assert(jobs);
+	if (!jobs)
+		return -1;
+
+	msg = ktp_msg_preform(KTP_JOBS_ACK, 0);
+	if (!msg)
+		return -1;
+	iter = kjobs_iter(jobs);
+	while ((job = kjobs_each(&iter))) {
+		if (ktpd_session_owns_job(session, job))
+			ktpd_msg_add_job(msg, job);
+	}
+
+	return ktpd_session_send_ack(session, msg);
+}
+
+
+/** @brief Sends result of finished job to attached session
+ *
+ * The result is kept like command's answer if session is detached.
+ */
+int ktpd_session_send_job_done(ktpd_session_t *session, const kjob_t *job)
+{
+	faux_msg_t *msg = NULL;
+
+	assert(session);
+	if (!session)
+		return -1;
+	assert(job);
+	if (!job)
+		return -1;
+
+	msg = ktp_msg_preform(KTP_JOB_ATTACH_ACK,
+		(uint32_t)kexec_retcode(kjob_exec(job)));
+	if (!msg)
+		return -1;
+	ktpd_msg_add_job(msg, job);
+	ktpd_msg_add_stat(msg, kjob_exec(job));
+
+	return ktpd_session_send_ack(session, msg);
+}
+
+
+/** @brief Attaches session to job by KTP_JOB_ATTACH
+ *
+ * The spooled output is sent at once. The session gets the live output
+ * then if job is still running. The result is sent immediately if job is
+ * finished. The unknown job or job of another user is answered by
+ * KTP_JOB_ATTACH_ACK without KTP_PARAM_JOB.
+ *
+ * @return Job the session is attached to or the finished job which
+ * result is fetched. NULL - no such job.
+ */
+kjob_t *ktpd_session_job_attach(ktpd_session_t *session, kjobs_t *jobs,
+	const faux_msg_t *msg)
+{
+	void *param_data = NULL;
+	uint32_t param_len = 0;
+	uint32_t net_id = 0;
+	kjob_t *job = NULL;
+	uint64_t offset = 0;
+	char buf[4096];
+	ssize_t r = 0;
+
+	assert(session);
+	if (!session)
+		return NULL;
+	assert(jobs);
+	if (!jobs)
+		return NULL;
+	assert(msg);
+	if (!msg)
+		return NULL;
+
+	if (faux_msg_get_param_by_type(msg, KTP_PARAM_JOB,
+		&param_data, &param_len) && (param_len >= sizeof(net_id))) {
+		memcpy(&net_id, param_data, sizeof(net_id));
+		job = kjobs_find(jobs, ntohl(net_id));
+	}
+	if (!job || !ktpd_session_owns_job(session, job)) {
+		faux_msg_t *ack = ktp_msg_preform(KTP_JOB_ATTACH_ACK, 1);
+		if (ack)
+			ktpd_session_send_ack(session, ack);
+		return NULL;
+	}
+
+	while ((r = kjob_read(job, &offset, buf, sizeof(buf))) > 0)
+		ktpd_session_send_stdout(session, buf, r);
+	if (kjob_finished(job))
+		ktpd_session_send_job_done(session, job);
+	else
+		kjob_attach(job, session);
+
+	return job;
+}
+
+
 #if 0
 static void ktpd_session_bad_socket(ktpd_session_t *session)
 {
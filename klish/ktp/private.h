@@ -1,8 +1,12 @@
 #ifndef _klish_ktp_private_h
 #define _klish_ktp_private_h
 
+#include <stdint.h>
+
 #include <faux/net.h>
+#include <faux/list.h>
 #include <klish/ktp_session.h>
+#include <klish/krecord.h>
 
 
 typedef enum {
@@ -10,6 +14,7 @@ typedef enum {
 	KTPD_SESSION_STATE_NOT_AUTHORIZED = 'a',
 	KTPD_SESSION_STATE_IDLE = 'i',
 	KTPD_SESSION_STATE_WAIT_FOR_PROCESS = 'p',
+	KTPD_SESSION_STATE_DETACHED = 't', // Client is gone. Wait for resume.
 } ktpd_session_state_e;
 
 struct ktpd_session_s {
@@ -18,6 +23,18 @@ struct ktpd_session_s {
 	gid_t gid;
 	char *user;
 	faux_net_t *net;
+	void *udata; // Owner's data
+	char *hotkeys[KVIEW_HOTKEY_NUM]; // Last map sent to client
+	bool_t token_valid; // Resumption is possible
+	uint8_t token[KTP_TOKEN_LEN];
+	ktpd_session_state_e detached_state; // State before detach
+	// Replay ring of recent stdout
+	char *replay;
+	size_t replay_size;
+	size_t replay_len;
+	size_t replay_start; // Index of the oldest byte
+	uint64_t stdout_sent; // Total number of stdout bytes
+	faux_list_t *acks; // KTP_CMD_ACKs to send on resume
 };
 
 
@@ -30,9 +47,40 @@ typedef enum {
 	KTP_SESSION_STATE_WAIT_FOR_CMD = 'c',
 } ktp_session_state_e;
 
+// Help index entries received from server
+typedef struct {
+	char *name;
+	char *help;
+	char *ptype_help;
+} ktp_help_arg_t;
+
+typedef struct {
+	char *name;
+	char *help;
+	unsigned char flags;
+	ktp_help_arg_t *args;
+	size_t args_num;
+} ktp_help_cmd_t;
+
 struct ktp_session_s {
 	ktp_session_state_e state;
 	faux_net_t *net;
+	char *hotkeys[KVIEW_HOTKEY_NUM]; // Map received from server
+	// Help index of current view. Sorted by name.
+	bool_t help_valid;
+	uint32_t help_version;
+	ktp_help_cmd_t *help_cmds;
+	size_t help_cmds_num;
+	// Session resumption
+	bool_t token_valid;
+	uint8_t token[KTP_TOKEN_LEN];
+	uint64_t stdout_received;
+};
+
+struct krecord_s {
+	char *data; // Header and fields
+	size_t len;
+	size_t size;
 };
 
 #endif // _klish_ktp_private_h
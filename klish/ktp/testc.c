@@ -0,0 +1,266 @@
+/*
+ * testc.c
+ *
+ * Tests of ktp module. The server's session talks to client's one by
+ * socket pair.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+
+#include <faux/str.h>
+#include <faux/msg.h>
+
+#include "klish/ktp.h"
+#include "klish/ktp_session.h"
+#include "klish/krecord.h"
+
+/*-------------------------------------------------------- */
+/*
+ * Receive specified number of stdout bytes. The KTP_AUTH_ACK of resume
+ * comes first.
+ */
+static char *testc_ktp_recv_stdout(int sock, size_t expected)
+{
+	ktp_session_t *session = NULL;
+	struct timeval tv = {};
+	char *out = NULL;
+	faux_msg_t *msg = NULL;
+
+	// Don't hang if the data is lost
+	tv.tv_sec = 1;
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	session = ktp_session_new(sock);
+	out = faux_str_dup("");
+	while ((strlen(out) < expected) &&
+		(msg = ktp_session_recv(session))) {
+		void *data = NULL;
+		uint32_t len = 0;
+		if ((faux_msg_get_cmd(msg) == KTP_STDOUT) &&
+			faux_msg_get_param_by_type(msg, KTP_PARAM_DATA,
+			&data, &len))
+			faux_str_catn(&out, (const char *)data, len);
+		faux_msg_free(msg);
+	}
+	ktp_session_free(session);
+
+	return out;
+}
+
+/*-------------------------------------------------------- */
+/*
+ * Write stdout by chunks to session with ring of 8 bytes, detach it and
+ * resume with number of bytes client has received. Then compare replayed
+ * output and number of lost bytes.
+ */
+static int testc_ktpd_replay(const char **chunks, size_t detach_after,
+	uint64_t received, const char *expected, uint64_t expected_lost)
+{
+	ktpd_session_t *session = NULL;
+	int old_sock[2] = { -1, -1 };
+	int new_sock[2] = { -1, -1 };
+	uint64_t lost = 0;
+	char *out = NULL;
+	size_t i = 0;
+	int retval = -1;
+
+	if ((socketpair(AF_UNIX, SOCK_STREAM, 0, old_sock) < 0) ||
+		(socketpair(AF_UNIX, SOCK_STREAM, 0, new_sock) < 0)) {
+		printf("Can't create socket pair\n");
+		goto out;
+	}
+	session = ktpd_session_new(old_sock[0]);
+	ktpd_session_login(session, "user", getuid(), getgid());
+	if (!ktpd_session_set_replay_size(session, 8)) {
+		printf("Can't set replay size\n");
+		goto out;
+	}
+
+	for (i = 0; chunks[i]; i++) {
+		if ((i == detach_after) && !ktpd_session_detach(session)) {
+			printf("Can't detach session\n");
+			goto out;
+		}
+		ktpd_session_send_stdout(session, chunks[i],
+			strlen(chunks[i]));
+	}
+	// The session closes old socket on detach
+	old_sock[0] = -1;
+
+	if (ktpd_session_resume(session, new_sock[0], received, &lost) < 0) {
+		printf("Can't resume session\n");
+		goto out;
+	}
+	if (lost != expected_lost) {
+		printf("Lost %llu bytes instead of %llu\n",
+			(unsigned long long)lost,
+			(unsigned long long)expected_lost);
+		goto out;
+	}
+	out = testc_ktp_recv_stdout(new_sock[1], strlen(expected));
+	if (strcmp(out, expected)) {
+		printf("Replayed [%s] instead of [%s]\n", out, expected);
+		goto out;
+	}
+	retval = 0;
+
+out:
+	faux_str_free(out);
+	ktpd_session_free(session);
+	if (old_sock[0] >= 0)
+		close(old_sock[0]);
+	if (old_sock[1] >= 0)
+		close(old_sock[1]);
+	if (new_sock[0] >= 0)
+		close(new_sock[0]);
+	if (new_sock[1] >= 0)
+		close(new_sock[1]);
+
+	return retval;
+}
+
+/*-------------------------------------------------------- */
+/*
+ * The ring wraps around. The client gets the bytes it has missed only.
+ */
+int testc_ktpd_session_replay_wrap(void)
+{
+	const char *chunks[] = { "0123", "4567", "89", "abc", "def", NULL };
+
+	return testc_ktpd_replay(chunks, 3, 10, "abcdef", 0);
+}
+
+/*-------------------------------------------------------- */
+/*
+ * The client has missed more than ring keeps. The tail is replayed and
+ * the rest is reported as lost.
+ */
+int testc_ktpd_session_replay_lost(void)
+{
+	const char *chunks[] = { "0123", "456789abcdef", NULL };
+
+	return testc_ktpd_replay(chunks, 1, 4, "89abcdef", 4);
+}
+
+/*-------------------------------------------------------- */
+/*
+ * Encode record of all the field types and decode it back. The JSON
+ * rendering escapes the string.
+ */
+int testc_krecord_encode_decode(void)
+{
+	krecord_t *record = NULL;
+	const char *data = NULL;
+	size_t len = 0;
+	const char *pos = NULL;
+	krecord_field_t field = {};
+	char *json = NULL;
+	int retval = -1;
+
+	record = krecord_new();
+	krecord_add_str(record, "name", "eth\"0\"\n");
+	krecord_add_int(record, "mtu", -1500);
+	krecord_add_bool(record, "up", BOOL_TRUE);
+	krecord_add_null(record, "addr");
+	data = krecord_data(record, &len);
+	if (!data || (krecord_size(data, len) != (ssize_t)len) ||
+		!krecord_valid(data, len)) {
+		printf("Encoded record is invalid\n");
+		goto out;
+	}
+
+	pos = data + KRECORD_HEADER_LEN;
+	if (!krecord_field_each(&pos, data + len, &field) ||
+		(field.type != KRECORD_STR) ||
+		(field.key_len != 4) || strncmp(field.key, "name", 4) ||
+		(field.str_len != 7) || strncmp(field.str, "eth\"0\"\n", 7)) {
+		printf("Bad string field\n");
+		goto out;
+	}
+	if (!krecord_field_each(&pos, data + len, &field) ||
+		(field.type != KRECORD_INT) || (field.num != -1500)) {
+		printf("Bad integer field\n");
+		goto out;
+	}
+	if (!krecord_field_each(&pos, data + len, &field) ||
+		(field.type != KRECORD_BOOL) || (field.num != 1)) {
+		printf("Bad boolean field\n");
+		goto out;
+	}
+	if (!krecord_field_each(&pos, data + len, &field) ||
+		(field.type != KRECORD_NULL) ||
+		(field.key_len != 4) || strncmp(field.key, "addr", 4)) {
+		printf("Bad null field\n");
+		goto out;
+	}
+	if (krecord_field_each(&pos, data + len, &field) ||
+		(pos != data + len)) {
+		printf("Extra field\n");
+		goto out;
+	}
+
+	json = krecord_json(data, len);
+	if (!json || strcmp(json, "{\"name\":\"eth\\\"0\\\"\\n\","
+		"\"mtu\":-1500,\"up\":true,\"addr\":null}")) {
+		printf("Bad JSON [%s]\n", json ? json : "");
+		goto out;
+	}
+	retval = 0;
+
+out:
+	faux_str_free(json);
+	krecord_free(record);
+
+	return retval;
+}
+
+/*-------------------------------------------------------- */
+/*
+ * The stream can contain part of record. The record with broken field
+ * or too long one is a garbage.
+ */
+int testc_krecord_broken(void)
+{
+	krecord_t *record = NULL;
+	const char *data = NULL;
+	size_t len = 0;
+	char *buf = NULL;
+	uint32_t huge = htonl(KRECORD_MAX + 1);
+	int retval = -1;
+
+	record = krecord_new();
+	krecord_add_str(record, "name", "eth0");
+	krecord_add_int(record, "mtu", 1500);
+	data = krecord_data(record, &len);
+
+	if ((krecord_size(data, KRECORD_HEADER_LEN - 1) != 0) ||
+		(krecord_size(data, len - 1) != 0)) {
+		printf("Part of record is not recognized\n");
+		goto out;
+	}
+	if (krecord_size((const char *)&huge, sizeof(huge)) >= 0) {
+		printf("Too long record is accepted\n");
+		goto out;
+	}
+
+	// The string is longer than record
+	buf = faux_zmalloc(len);
+	memcpy(buf, data, len);
+	buf[KRECORD_HEADER_LEN + 2 + 4] = 0x7f;
+	if (krecord_valid(buf, len) || krecord_json(buf, len)) {
+		printf("Broken field is accepted\n");
+		goto out;
+	}
+	retval = 0;
+
+out:
+	faux_free(buf);
+	krecord_free(record);
+
+	return retval;
+}
@@ -1,6 +1,13 @@
 #ifndef _klish_ktp_session_h
 #define _klish_ktp_session_h
 
+#include <klish/ktp.h>
+#include <klish/kview.h>
+#include <klish/ksession.h>
+#include <klish/kexec.h>
+#include <klish/kjob.h>
+#include <klish/kcache.h>
+
 #define USOCK_PATH_MAX sizeof(((struct sockaddr_un *)0)->sun_path)
 
 #define KLISH_DEFAULT_UNIX_SOCKET_PATH "/tmp/klish-unix-socket"
@@ -8,6 +15,32 @@
 typedef struct ktpd_session_s ktpd_session_t;
 typedef struct ktp_session_s ktp_session_t;
 
+/** @brief Entry of context help answered by client locally
+ */
+typedef struct {
+	char *prefix; // Next word or PTYPE help
+	char *line; // Help string
+} ktp_help_t;
+
+/** @brief Execution statistics of command from KTP_CMD_ACK
+ */
+typedef struct {
+	uint32_t wait; // Time within the daemon's queue. Milliseconds.
+	uint32_t cpu; // CPU time. Milliseconds.
+	uint32_t memory; // Peak memory usage. KiB.
+	bool_t cached; // The output is served from daemon's cache
+	uint32_t age; // Age of cached output. Milliseconds.
+} ktp_cmd_stat_t;
+
+/** @brief Background job from KTP_PARAM_JOB
+ */
+typedef struct {
+	uint32_t id;
+	bool_t finished;
+	int retcode; // Valid if finished
+	char *line;
+} ktp_job_t;
+
 C_DECL_BEGIN
 
 // Client KTP session
@@ -15,12 +48,83 @@ ktp_session_t *ktp_session_new(int sock);
 void ktp_session_free(ktp_session_t *session);
 bool_t ktp_session_connected(ktp_session_t *session);
 int ktp_session_get_socket(ktp_session_t *session);
+bool_t ktp_session_set_hotkeys(ktp_session_t *session, const faux_msg_t *msg);
+const char *ktp_session_hotkey(const ktp_session_t *session, int key);
+bool_t ktp_session_set_help_index(ktp_session_t *session,
+	const faux_msg_t *msg);
+bool_t ktp_session_check_version(ktp_session_t *session,
+	const faux_msg_t *msg);
+ssize_t ktp_session_help(const ktp_session_t *session, const char *line,
+	ktp_help_t **help);
+int ktp_session_req_help(ktp_session_t *session, const char *line);
+ssize_t ktp_help_ack(const faux_msg_t *msg, ktp_help_t **help);
+void ktp_help_free(ktp_help_t *help, size_t num);
+bool_t ktp_cmd_ack_stat(const faux_msg_t *msg, ktp_cmd_stat_t *stat);
+bool_t ktp_session_set_resume(ktp_session_t *session, const faux_msg_t *msg);
+void ktp_session_stdout_received(ktp_session_t *session, size_t len);
+int ktp_session_resume(ktp_session_t *session, int sock);
+faux_msg_t *ktp_session_recv(ktp_session_t *session);
+int ktp_session_oneshot(ktp_session_t *session, const char *line);
+int ktp_session_auth(ktp_session_t *session);
+int ktp_session_cmd(ktp_session_t *session, const char *line);
+int ktp_session_cmd_background(ktp_session_t *session, const char *line);
+int ktp_session_req_jobs(ktp_session_t *session);
+int ktp_session_req_job_attach(ktp_session_t *session, uint32_t id);
+bool_t ktp_msg_job(const faux_msg_t *msg, ktp_job_t *job);
+ssize_t ktp_msg_jobs(const faux_msg_t *msg, ktp_job_t **jobs);
+void ktp_jobs_free(ktp_job_t *jobs, size_t num);
 
 // Server KTP session
 ktpd_session_t *ktpd_session_new(int sock);
 void ktpd_session_free(ktpd_session_t *session);
 bool_t ktpd_session_connected(ktpd_session_t *session);
 int ktpd_session_get_socket(ktpd_session_t *session);
+faux_msg_t *ktpd_session_recv(ktpd_session_t *session);
+bool_t ktpd_session_login(ktpd_session_t *session, const char *user,
+	uid_t uid, gid_t gid);
+bool_t ktpd_session_authorized(const ktpd_session_t *session);
+const char *ktpd_session_user(const ktpd_session_t *session);
+uid_t ktpd_session_uid(const ktpd_session_t *session);
+void *ktpd_session_udata(const ktpd_session_t *session);
+void ktpd_session_set_udata(ktpd_session_t *session, void *udata);
+int ktpd_session_send_cmd_result(ktpd_session_t *session, int retcode,
+	const char *error);
+int ktpd_session_send_auth_ack(ktpd_session_t *session, uint32_t status);
+char *ktpd_cmd_line(const faux_msg_t *msg);
+int ktpd_session_send_stdout(ktpd_session_t *session, const char *data,
+	size_t len);
+int ktpd_session_send_stderr(ktpd_session_t *session, const char *data,
+	size_t len);
+int ktpd_session_send_records(ktpd_session_t *session, const char *data,
+	size_t len);
+int ktpd_session_send_hotkeys(ktpd_session_t *session,
+	const char * const *hotkeys);
+int ktpd_session_send_help_index(ktpd_session_t *session,
+	ksession_t *ksession);
+int ktpd_session_send_help(ktpd_session_t *session, ksession_t *ksession,
+	const char *line);
+int ktpd_session_send_version(ktpd_session_t *session, uint32_t version);
+int ktpd_session_send_cmd_ack(ktpd_session_t *session, const kexec_t *exec);
+int ktpd_session_send_cached(ktpd_session_t *session,
+	const kcache_entry_t *entry);
+bool_t ktpd_session_set_replay_size(ktpd_session_t *session, size_t size);
+const uint8_t *ktpd_session_token(const ktpd_session_t *session);
+bool_t ktpd_session_token_match(const ktpd_session_t *session,
+	const uint8_t *token);
+bool_t ktpd_auth_resume(const faux_msg_t *msg, uint8_t *token,
+	uint64_t *received);
+char *ktpd_auth_line(const faux_msg_t *msg);
+bool_t ktpd_session_detach(ktpd_session_t *session);
+bool_t ktpd_session_detached(const ktpd_session_t *session);
+int ktpd_session_resume(ktpd_session_t *session, int sock,
+	uint64_t received, uint64_t *lost);
+bool_t ktpd_cmd_background(const faux_msg_t *msg);
+int ktpd_session_send_job_started(ktpd_session_t *session,
+	const kjob_t *job);
+int ktpd_session_send_jobs(ktpd_session_t *session, const kjobs_t *jobs);
+int ktpd_session_send_job_done(ktpd_session_t *session, const kjob_t *job);
+kjob_t *ktpd_session_job_attach(ktpd_session_t *session, kjobs_t *jobs,
+	const faux_msg_t *msg);
 
 C_DECL_END
 
@@ -0,0 +1,32 @@
+/** @file kvar.h
+ *
+ * @brief Klish scheme's "var" entry
+ */
+
+#ifndef _klish_kvar_h
+#define _klish_kvar_h
+
+#include <faux/faux.h>
+#include <klish/kaction.h>
+
+typedef struct kvar_s kvar_t;
+
+
+C_DECL_BEGIN
+
+kvar_t *kvar_new(const char *name);
+void kvar_free(kvar_t *var);
+
+const char *kvar_name(const kvar_t *var);
+const char *kvar_help(const kvar_t *var);
+bool_t kvar_set_help(kvar_t *var, const char *help);
+const char *kvar_value(const kvar_t *var);
+bool_t kvar_set_value(kvar_t *var, const char *value);
+bool_t kvar_dynamic(const kvar_t *var);
+void kvar_set_dynamic(kvar_t *var, bool_t dynamic);
+kaction_t *kvar_action(const kvar_t *var);
+void kvar_set_action(kvar_t *var, kaction_t *action);
+
+C_DECL_END
+
+#endif // _klish_kvar_h
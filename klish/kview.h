@@ -0,0 +1,74 @@
+/** @file kview.h
+ *
+ * @brief Klish scheme's "view" entry
+ *
+ * The TEMPLATE is a view which is never entered itself. The VIEW
+ * instantiates template by reference so the template's commands are
+ * shared by all instances and are not copied. The BINDs are instance's
+ * values of template's parameters. The template can define default
+ * values by its own BINDs. The ACTION gets BINDs of the level its command
+ * is found on as environment variables with KVIEW_BIND_ENV_PREFIX.
+ */
+
+#ifndef _klish_kview_h
+#define _klish_kview_h
+
+#include <faux/faux.h>
+#include <faux/list.h>
+#include <klish/kcommand.h>
+#include <klish/knspace.h>
+
+// Hotkeys are control keys "^@" - "^_" (codes 0 - 31)
+#define KVIEW_HOTKEY_NUM 32
+// Prefix of environment variables the BINDs are exported to ACTION by
+#define KVIEW_BIND_ENV_PREFIX "KLISH_BIND_"
+
+typedef struct kview_s kview_t;
+
+
+C_DECL_BEGIN
+
+kview_t *kview_new(const char *name);
+void kview_free(kview_t *view);
+
+const char *kview_name(const kview_t *view);
+const char *kview_prompt(const kview_t *view);
+bool_t kview_set_prompt(kview_t *view, const char *prompt);
+
+// Access to commands from the lower levels of current path
+bool_t kview_inherit(const kview_t *view);
+void kview_set_inherit(kview_t *view, bool_t inherit);
+bool_t kview_completion(const kview_t *view);
+void kview_set_completion(kview_t *view, bool_t completion);
+bool_t kview_context_help(const kview_t *view);
+void kview_set_context_help(kview_t *view, bool_t context_help);
+
+// Commands
+bool_t kview_add_command(kview_t *view, kcommand_t *command);
+kcommand_t *kview_find_command(const kview_t *view, const char *name);
+const faux_list_t *kview_commands(const kview_t *view);
+
+// Namespaces
+bool_t kview_add_nspace(kview_t *view, knspace_t *nspace);
+const faux_list_t *kview_nspaces(const kview_t *view);
+
+// Templates
+bool_t kview_is_template(const kview_t *view);
+void kview_set_is_template(kview_t *view, bool_t is_template);
+const char *kview_template_ref(const kview_t *view);
+bool_t kview_set_template_ref(kview_t *view, const char *template_ref);
+kview_t *kview_template(const kview_t *view);
+void kview_set_template(kview_t *view, kview_t *tmpl);
+bool_t kview_add_bind(kview_t *view, const char *name, const char *value);
+const char *kview_bind(const kview_t *view, const char *name);
+size_t kview_binds_num(const kview_t *view);
+const char *kview_bind_name(const kview_t *view, size_t index);
+
+// Hotkeys
+int kview_hotkey_code(const char *key);
+bool_t kview_add_hotkey(kview_t *view, int code, const char *cmd);
+const char *kview_hotkey(const kview_t *view, int code);
+
+C_DECL_END
+
+#endif // _klish_kview_h
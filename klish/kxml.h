@@ -0,0 +1,33 @@
+/** @file kxml.h
+ *
+ * @brief Loader of klish XML scheme files
+ *
+ * The files are validated against the klish.xsd semantics: allowed nested
+ * tags, known and required attributes, enumerations and booleans. The
+ * loaded scheme is not linked so the references between objects (possibly
+ * defined within another files) are not resolved. Use kscheme_merge() and
+ * kscheme_link() then. The kxml_load_files() and kxml_load() load files
+ * concurrently, merge and link the result. The "*.lua" files are Lua
+ * scripts defining the same elements by functions named after tags.
+ */
+
+#ifndef _klish_kxml_h
+#define _klish_kxml_h
+
+#include <faux/faux.h>
+#include <klish/kscheme.h>
+
+#define KXML_PATH_DELIM ";"
+#define KXML_EXT ".xml"
+#define KXML_LUA_EXT ".lua" // Lua scheme scripts if Lua support is enabled
+
+C_DECL_BEGIN
+
+kscheme_t *kxml_load_file(const char *filename, char **error);
+kscheme_t *kxml_load_files(const char * const *files, size_t files_num,
+	unsigned int jobs, char **error);
+kscheme_t *kxml_load(const char *path, unsigned int jobs, char **error);
+
+C_DECL_END
+
+#endif // _klish_kxml_h
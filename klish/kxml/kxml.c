@@ -0,0 +1,1128 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <assert.h>
+
+#include <faux/str.h>
+#include <faux/list.h>
+#include <faux/conv.h>
+#include <klish/kscheme.h>
+#include <klish/kxml.h>
+
+#include "private.h"
+
+#define KXML_STACK_STEP 16 // Step to increase stack of opened elements
+
+
+typedef int (*kxml_start_fn)(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs);
+typedef int (*kxml_end_fn)(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent);
+
+
+/** @brief Tag description. The semantics of klish.xsd.
+ */
+struct kxml_tag_s {
+	const char *name;
+	const char * const *attrs; // Allowed attributes
+	const char * const *required; // Required attributes
+	const char * const *children; // Allowed nested tags
+	bool_t text; // Tag has text content
+	kxml_start_fn start; // Element is opened
+	kxml_end_fn end; // Element is closed
+};
+
+
+static const char * const kxml_none[] = { NULL };
+
+static const char * const kxml_klish_attrs[] = {
+	"xmlns", "xmlns:xsi", "xsi:schemaLocation", NULL };
+static const char * const kxml_klish_children[] = {
+	"OVERVIEW", "STARTUP", "PTYPE", "COMMAND", "VIEW", "TEMPLATE",
+	"NAMESPACE", "VAR", "WATCHDOG", "HOTKEY", "PLUGIN", "HOOK", NULL };
+
+static const char * const kxml_ptype_attrs[] = {
+	"name", "help", "pattern", "method", "preprocess", NULL };
+static const char * const kxml_ptype_required[] = { "name", "help", NULL };
+static const char * const kxml_ptype_children[] = { "ACTION", NULL };
+
+static const char * const kxml_view_attrs[] = {
+	"name", "prompt", "depth", "restore", "access", "inherit",
+	"completion", "context_help", "template", NULL };
+static const char * const kxml_view_required[] = { "name", NULL };
+static const char * const kxml_view_children[] = {
+	"BIND", "NAMESPACE", "COMMAND", "HOTKEY", NULL };
+
+static const char * const kxml_bind_attrs[] = { "name", "value", NULL };
+
+static const char * const kxml_startup_attrs[] = {
+	"view", "viewid", "default_shebang", "timeout", "default_plugin",
+	NULL };
+static const char * const kxml_startup_required[] = { "view", NULL };
+static const char * const kxml_startup_children[] = {
+	"DETAIL", "ACTION", NULL };
+
+static const char * const kxml_command_attrs[] = {
+	"name", "help", "ref", "view", "viewid", "nav", "access", "args",
+	"args_help", "escape_chars", "cache", "cache_vars", NULL };
+static const char * const kxml_command_required[] = { "name", "help", NULL };
+static const char * const kxml_command_children[] = {
+	"DETAIL", "COND", "PARAM", "ACTION", NULL };
+
+static const char * const kxml_cond_children[] = { "ACTION", NULL };
+
+static const char * const kxml_param_attrs[] = {
+	"name", "help", "ptype", "default", "prefix", "mode", "optional",
+	"order", "value", "hidden", "test", "completion", "access", NULL };
+static const char * const kxml_param_required[] = {
+	"name", "help", "ptype", NULL };
+static const char * const kxml_param_children[] = { "PARAM", NULL };
+
+static const char * const kxml_action_attrs[] = {
+	"builtin", "shebang", "lock", "interrupt", "interactive", "timeout",
+	"cpu", "records", "batch", NULL };
+
+static const char * const kxml_nspace_attrs[] = {
+	"ref", "prefix", "prefix_help", "help", "completion", "context_help",
+	"inherit", "access", NULL };
+static const char * const kxml_nspace_required[] = { "ref", NULL };
+
+static const char * const kxml_var_attrs[] = {
+	"name", "help", "value", "dynamic", NULL };
+static const char * const kxml_var_required[] = { "name", NULL };
+static const char * const kxml_var_children[] = { "ACTION", NULL };
+
+static const char * const kxml_wdog_children[] = { "ACTION", NULL };
+
+static const char * const kxml_hotkey_attrs[] = { "key", "cmd", NULL };
+static const char * const kxml_hotkey_required[] = { "key", "cmd", NULL };
+
+static const char * const kxml_plugin_attrs[] = {
+	"name", "alias", "file", "rtld_global", NULL };
+static const char * const kxml_plugin_required[] = { "name", NULL };
+
+static const char * const kxml_hook_attrs[] = { "name", "builtin", NULL };
+
+
+static int kxml_start_ptype(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs);
+static int kxml_end_ptype(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent);
+static int kxml_start_view(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs);
+static int kxml_start_bind(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs);
+static int kxml_start_startup(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs);
+static int kxml_start_command(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs);
+static int kxml_start_cond(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs);
+static int kxml_end_cond(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent);
+static int kxml_start_param(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs);
+static int kxml_start_action(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs);
+static int kxml_end_action(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent);
+static int kxml_end_detail(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent);
+static int kxml_start_nspace(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs);
+static int kxml_start_var(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs);
+static int kxml_end_wdog(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent);
+static int kxml_start_plugin(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs);
+static int kxml_end_plugin(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent);
+static int kxml_start_hotkey(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs);
+static int kxml_start_hook(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs);
+
+static const kxml_tag_t kxml_tags[] = {
+	{"KLISH", kxml_klish_attrs, kxml_none, kxml_klish_children,
+		BOOL_FALSE, NULL, NULL},
+	{"PTYPE", kxml_ptype_attrs, kxml_ptype_required, kxml_ptype_children,
+		BOOL_FALSE, kxml_start_ptype, kxml_end_ptype},
+	{"VIEW", kxml_view_attrs, kxml_view_required, kxml_view_children,
+		BOOL_FALSE, kxml_start_view, NULL},
+	{"TEMPLATE", kxml_view_attrs, kxml_view_required, kxml_view_children,
+		BOOL_FALSE, kxml_start_view, NULL},
+	{"BIND", kxml_bind_attrs, kxml_bind_attrs, kxml_none,
+		BOOL_FALSE, kxml_start_bind, NULL},
+	{"STARTUP", kxml_startup_attrs, kxml_startup_required,
+		kxml_startup_children, BOOL_FALSE, kxml_start_startup, NULL},
+	{"COMMAND", kxml_command_attrs, kxml_command_required,
+		kxml_command_children, BOOL_FALSE, kxml_start_command, NULL},
+	{"COND", kxml_none, kxml_none, kxml_cond_children,
+		BOOL_TRUE, kxml_start_cond, kxml_end_cond},
+	{"PARAM", kxml_param_attrs, kxml_param_required, kxml_param_children,
+		BOOL_FALSE, kxml_start_param, NULL},
+	{"ACTION", kxml_action_attrs, kxml_none, kxml_none,
+		BOOL_TRUE, kxml_start_action, kxml_end_action},
+	{"OVERVIEW", kxml_none, kxml_none, kxml_none,
+		BOOL_FALSE, NULL, NULL},
+	{"DETAIL", kxml_none, kxml_none, kxml_none,
+		BOOL_TRUE, NULL, kxml_end_detail},
+	{"NAMESPACE", kxml_nspace_attrs, kxml_nspace_required, kxml_none,
+		BOOL_FALSE, kxml_start_nspace, NULL},
+	{"VAR", kxml_var_attrs, kxml_var_required, kxml_var_children,
+		BOOL_FALSE, kxml_start_var, NULL},
+	{"WATCHDOG", kxml_none, kxml_none, kxml_wdog_children,
+		BOOL_FALSE, NULL, kxml_end_wdog},
+	{"HOTKEY", kxml_hotkey_attrs, kxml_hotkey_required, kxml_none,
+		BOOL_FALSE, kxml_start_hotkey, NULL},
+	{"PLUGIN", kxml_plugin_attrs, kxml_plugin_required, kxml_none,
+		BOOL_TRUE, kxml_start_plugin, kxml_end_plugin},
+	{"HOOK", kxml_hook_attrs, kxml_none, kxml_none,
+		BOOL_FALSE, kxml_start_hook, NULL},
+	{NULL, NULL, NULL, NULL, BOOL_FALSE, NULL, NULL}
+};
+
+
+/** @brief Sets error message. The first error only is stored.
+ */
+int kxml_error(kxml_ctx_t *ctx, unsigned long line, const char *fmt, ...)
+{
+	va_list ap;
+	char *msg = NULL;
+
+	if (ctx->error)
+		return -1;
+
+	va_start(ap, fmt);
+	msg = faux_str_vsprintf(fmt, ap);
+	va_end(ap);
+	if (line > 0)
+		ctx->error = faux_str_sprintf("%s:%lu: %s", ctx->filename,
+			line, msg);
+	else
+		ctx->error = faux_str_sprintf("%s: %s", ctx->filename, msg);
+	faux_str_free(msg);
+
+	return -1;
+}
+
+
+/** @brief Gets name of known tag by index
+ *
+ * @return Tag name or NULL if index is out of range.
+ */
+const char *kxml_tag_name(size_t index)
+{
+	if (index >= (sizeof(kxml_tags) / sizeof(kxml_tags[0])))
+		return NULL;
+
+	return kxml_tags[index].name;
+}
+
+
+static bool_t kxml_in_list(const char * const *list, const char *str)
+{
+	size_t i = 0;
+
+	for (i = 0; list[i]; i++) {
+		if (!strcmp(list[i], str))
+			return BOOL_TRUE;
+	}
+
+	return BOOL_FALSE;
+}
+
+
+static bool_t kxml_is(const kxml_node_t *node, const char *name)
+{
+	if (!node)
+		return BOOL_FALSE;
+
+	return !strcmp(node->tag->name, name);
+}
+
+
+/** @brief Checks if element defines a view: VIEW or TEMPLATE
+ */
+static bool_t kxml_is_view(const kxml_node_t *node)
+{
+	return kxml_is(node, "VIEW") || kxml_is(node, "TEMPLATE");
+}
+
+
+/** @brief Gets attribute value
+ *
+ * @param [in] attrs Attributes. Array of name-value pairs ended by NULL.
+ * @return Value or NULL if attribute is not specified.
+ */
+static const char *kxml_attr(const char **attrs, const char *name)
+{
+	size_t i = 0;
+
+	if (!attrs)
+		return NULL;
+	for (i = 0; attrs[i]; i += 2) {
+		if (!strcmp(attrs[i], name))
+			return attrs[i + 1];
+	}
+
+	return NULL;
+}
+
+
+/** @brief Gets boolean attribute (xs:boolean)
+ *
+ * The value stays untouched if attribute is not specified.
+ */
+static int kxml_attr_bool(kxml_ctx_t *ctx, const kxml_node_t *node,
+	const char **attrs, const char *name, bool_t *value)
+{
+	const char *str = NULL;
+
+	str = kxml_attr(attrs, name);
+	if (!str)
+		return 0;
+	if (!strcmp(str, "true") || !strcmp(str, "1"))
+		*value = BOOL_TRUE;
+	else if (!strcmp(str, "false") || !strcmp(str, "0"))
+		*value = BOOL_FALSE;
+	else
+		return kxml_error(ctx, node->line, "%s: Illegal boolean value "
+			"\"%s\" of attribute \"%s\"", node->tag->name,
+			str, name);
+
+	return 0;
+}
+
+
+/** @brief Gets unsigned integer attribute
+ *
+ * The value is not changed if attribute is not specified.
+ */
+static int kxml_attr_uint(kxml_ctx_t *ctx, const kxml_node_t *node,
+	const char **attrs, const char *name, unsigned int *value)
+{
+	const char *str = NULL;
+
+	str = kxml_attr(attrs, name);
+	if (!str)
+		return 0;
+	if (!faux_conv_atoui(str, value, 10))
+		return kxml_error(ctx, node->line, "%s: Illegal unsigned "
+			"value \"%s\" of attribute \"%s\"", node->tag->name,
+			str, name);
+
+	return 0;
+}
+
+
+/** @brief Checks if string consists of spaces only
+ */
+static bool_t kxml_is_blank(const char *str)
+{
+	if (!str)
+		return BOOL_TRUE;
+	while (*str) {
+		if (!strchr(" \t\r\n", *str))
+			return BOOL_FALSE;
+		str++;
+	}
+
+	return BOOL_TRUE;
+}
+
+
+static int kxml_start_ptype(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs)
+{
+	kptype_t *ptype = NULL;
+	const char *name = kxml_attr(attrs, "name");
+	const char *str = NULL;
+
+	ptype = kptype_new(name, kxml_attr(attrs, "help"));
+	assert(ptype);
+	if (!kscheme_add_ptype(ctx->scheme, ptype)) {
+		kptype_free(ptype);
+		return kxml_error(ctx, node->line, "Duplicate PTYPE \"%s\"",
+			name);
+	}
+	node->obj = ptype;
+
+	kptype_set_pattern(ptype, kxml_attr(attrs, "pattern"));
+
+	if ((str = kxml_attr(attrs, "method"))) {
+		kptype_method_e method = KPTYPE_METHOD_REGEXP;
+		if (!kptype_method_resolve(str, &method))
+			return kxml_error(ctx, node->line, "PTYPE \"%s\": "
+				"Unknown method \"%s\"", name, str);
+		kptype_set_method(ptype, method);
+	}
+
+	if ((str = kxml_attr(attrs, "preprocess"))) {
+		kptype_preprocess_e preprocess = KPTYPE_PREPROCESS_NONE;
+		if (!kptype_preprocess_resolve(str, &preprocess))
+			return kxml_error(ctx, node->line, "PTYPE \"%s\": "
+				"Unknown preprocess \"%s\"", name, str);
+		kptype_set_preprocess(ptype, preprocess);
+	}
+
+	parent = parent; // Happy compiler
+
+	return 0;
+}
+
+
+static int kxml_end_ptype(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent)
+{
+	kptype_t *ptype = (kptype_t *)node->obj;
+
+	if ((kptype_method(ptype) != KPTYPE_METHOD_CODE) &&
+		!kptype_pattern(ptype))
+		return kxml_error(ctx, node->line, "PTYPE \"%s\": Missing "
+			"pattern", kptype_name(ptype));
+
+	parent = parent; // Happy compiler
+
+	return 0;
+}
+
+
+static int kxml_start_view(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs)
+{
+	static const char * const restore[] = { "none", "depth", "view", NULL };
+	kview_t *view = NULL;
+	const char *name = kxml_attr(attrs, "name");
+	const char *str = NULL;
+	bool_t flag = BOOL_FALSE;
+	bool_t is_template = kxml_is(node, "TEMPLATE");
+
+	// The VIEW can be defined several times. The commands are merged.
+	view = kscheme_find_view(ctx->scheme, name);
+	if (!view) {
+		view = kview_new(name);
+		assert(view);
+		kview_set_is_template(view, is_template);
+		kscheme_add_view(ctx->scheme, view);
+	} else if (kview_is_template(view) != is_template) {
+		return kxml_error(ctx, node->line, "%s \"%s\": Defined as both "
+			"VIEW and TEMPLATE", node->tag->name, name);
+	}
+	node->obj = view;
+
+	if ((str = kxml_attr(attrs, "template"))) {
+		if (kview_template_ref(view) &&
+			strcmp(kview_template_ref(view), str))
+			return kxml_error(ctx, node->line, "%s \"%s\": "
+				"Conflicting templates \"%s\" and \"%s\"",
+				node->tag->name, name,
+				kview_template_ref(view), str);
+		kview_set_template_ref(view, str);
+	}
+
+	if ((str = kxml_attr(attrs, "prompt")))
+		kview_set_prompt(view, str);
+
+	str = kxml_attr(attrs, "restore");
+	if (str && !kxml_in_list(restore, str))
+		return kxml_error(ctx, node->line, "VIEW \"%s\": Unknown "
+			"restore \"%s\"", name, str);
+
+	flag = kview_inherit(view);
+	if (kxml_attr_bool(ctx, node, attrs, "inherit", &flag) < 0)
+		return -1;
+	kview_set_inherit(view, flag);
+
+	flag = kview_completion(view);
+	if (kxml_attr_bool(ctx, node, attrs, "completion", &flag) < 0)
+		return -1;
+	kview_set_completion(view, flag);
+
+	flag = kview_context_help(view);
+	if (kxml_attr_bool(ctx, node, attrs, "context_help", &flag) < 0)
+		return -1;
+	kview_set_context_help(view, flag);
+
+	parent = parent; // Happy compiler
+
+	return 0;
+}
+
+
+static int kxml_start_bind(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs)
+{
+	kview_t *view = (kview_t *)parent->obj;
+	const char *name = kxml_attr(attrs, "name");
+
+	if (!kview_add_bind(view, name, kxml_attr(attrs, "value")))
+		return kxml_error(ctx, node->line, "%s \"%s\": Duplicate BIND "
+			"\"%s\"", parent->tag->name, kview_name(view), name);
+
+	return 0;
+}
+
+
+static int kxml_start_startup(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs)
+{
+	bool_t default_plugin = BOOL_TRUE;
+
+	if (kscheme_startup_ref(ctx->scheme))
+		return kxml_error(ctx, node->line, "Duplicate STARTUP");
+	if (kxml_attr_bool(ctx, node, attrs, "default_plugin",
+		&default_plugin) < 0)
+		return -1;
+	kscheme_set_startup_ref(ctx->scheme, kxml_attr(attrs, "view"));
+
+	parent = parent; // Happy compiler
+
+	return 0;
+}
+
+
+static int kxml_start_command(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs)
+{
+	kview_t *view = NULL;
+	kcommand_t *command = NULL;
+	const char *name = kxml_attr(attrs, "name");
+	const char *nav = NULL;
+	char *legacy = NULL;
+	unsigned int ttl = 0;
+	int retval = 0;
+
+	// The COMMAND outside the VIEW belongs to global view
+	if (kxml_is_view(parent))
+		view = (kview_t *)parent->obj;
+	else
+		view = kscheme_global(ctx->scheme);
+
+	command = kcommand_new(name, kxml_attr(attrs, "help"));
+	assert(command);
+	if (!kview_add_command(view, command)) {
+		kcommand_free(command);
+		return kxml_error(ctx, node->line, "VIEW \"%s\": Duplicate "
+			"COMMAND \"%s\"", kview_name(view), name);
+	}
+	node->obj = command;
+
+	// The legacy "view" attribute is a replacement of current level
+	nav = kxml_attr(attrs, "nav");
+	if (!nav && kxml_attr(attrs, "view")) {
+		legacy = faux_str_sprintf("replace:%s",
+			kxml_attr(attrs, "view"));
+		nav = legacy;
+	}
+	if (nav && !kcommand_set_nav(command, nav))
+		retval = kxml_error(ctx, node->line, "COMMAND \"%s\": Illegal "
+			"navigation \"%s\"", name, nav);
+	faux_str_free(legacy);
+	if (retval < 0)
+		return -1;
+
+	kcommand_set_access(command, kxml_attr(attrs, "access"));
+
+	if (kxml_attr_uint(ctx, node, attrs, "cache", &ttl) < 0)
+		return -1;
+	kcommand_set_cache(command, ttl);
+	kcommand_set_cache_vars(command, kxml_attr(attrs, "cache_vars"));
+
+	return 0;
+}
+
+
+static int kxml_start_cond(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs)
+{
+	kcommand_t *command = (kcommand_t *)parent->obj;
+
+	if (kcommand_cond(command))
+		return kxml_error(ctx, node->line, "Duplicate COND");
+	node->obj = command;
+
+	attrs = attrs; // Happy compiler
+
+	return 0;
+}
+
+
+static int kxml_end_cond(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent)
+{
+	kcommand_t *command = (kcommand_t *)node->obj;
+	const char *text = node->text;
+	// The ACTION makes the condition dynamic
+	bool_t dynamic = node->action ? BOOL_TRUE : BOOL_FALSE;
+
+	if (kxml_is_blank(text))
+		text = NULL;
+	if (!text && !dynamic)
+		return kxml_error(ctx, node->line, "COMMAND \"%s\": Empty COND",
+			kcommand_name(command));
+	if (!kcommand_set_cond(command, text ? text : "", dynamic))
+		return kxml_error(ctx, node->line, "COMMAND \"%s\": Illegal "
+			"COND \"%s\"", kcommand_name(command), text);
+
+	parent = parent; // Happy compiler
+
+	return 0;
+}
+
+
+static int kxml_start_param(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs)
+{
+	kparam_t *param = NULL;
+	const char *name = kxml_attr(attrs, "name");
+	const char *str = NULL;
+	bool_t flag = BOOL_FALSE;
+
+	param = kparam_new(name, kxml_attr(attrs, "help"));
+	assert(param);
+	if (kxml_is(parent, "PARAM"))
+		kparam_add_param((kparam_t *)parent->obj, param);
+	else
+		kcommand_add_param((kcommand_t *)parent->obj, param);
+	node->obj = param;
+
+	// Empty ptype means the flag parameter
+	str = kxml_attr(attrs, "ptype");
+	if (str && ('\0' != *str))
+		kparam_set_ptype_ref(param, str);
+
+	if ((str = kxml_attr(attrs, "mode"))) {
+		kparam_mode_e mode = KPARAM_MODE_COMMON;
+		if (!kparam_mode_resolve(str, &mode))
+			return kxml_error(ctx, node->line, "PARAM \"%s\": "
+				"Unknown mode \"%s\"", name, str);
+		kparam_set_mode(param, mode);
+	}
+
+	kparam_set_defval(param, kxml_attr(attrs, "default"));
+	kparam_set_prefix(param, kxml_attr(attrs, "prefix"));
+
+	// The "value" forces "subcommand" mode
+	if ((str = kxml_attr(attrs, "value"))) {
+		kparam_set_value(param, str);
+		kparam_set_mode(param, KPARAM_MODE_SUBCOMMAND);
+	}
+
+	flag = kparam_optional(param);
+	if (kxml_attr_bool(ctx, node, attrs, "optional", &flag) < 0)
+		return -1;
+	kparam_set_optional(param, flag);
+
+	flag = BOOL_FALSE;
+	if (kxml_attr_bool(ctx, node, attrs, "order", &flag) < 0)
+		return -1;
+	if (kxml_attr_bool(ctx, node, attrs, "hidden", &flag) < 0)
+		return -1;
+
+	return 0;
+}
+
+
+static int kxml_start_action(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs)
+{
+	kaction_t *action = NULL;
+	bool_t flag = BOOL_FALSE;
+	bool_t dup = BOOL_FALSE;
+	unsigned int num = 0;
+
+	action = kaction_new();
+	assert(action);
+
+	// The action is owned by parent's object right away
+	if (kxml_is(parent, "COMMAND")) {
+		if (kcommand_action((kcommand_t *)parent->obj))
+			dup = BOOL_TRUE;
+		else
+			kcommand_set_action((kcommand_t *)parent->obj, action);
+	} else if (kxml_is(parent, "PTYPE")) {
+		if (kptype_action((kptype_t *)parent->obj))
+			dup = BOOL_TRUE;
+		else
+			kptype_set_action((kptype_t *)parent->obj, action);
+	} else if (kxml_is(parent, "VAR")) {
+		if (kvar_action((kvar_t *)parent->obj))
+			dup = BOOL_TRUE;
+		else
+			kvar_set_action((kvar_t *)parent->obj, action);
+	} else {
+		// COND, STARTUP and WATCHDOG
+		if (parent->action)
+			dup = BOOL_TRUE;
+		else
+			parent->action = action;
+	}
+	if (dup) {
+		kaction_free(action);
+		return kxml_error(ctx, node->line, "Duplicate ACTION");
+	}
+	node->obj = action;
+
+	kaction_set_sym(action, kxml_attr(attrs, "builtin"));
+	kaction_set_shebang(action, kxml_attr(attrs, "shebang"));
+
+	flag = kaction_lock(action);
+	if (kxml_attr_bool(ctx, node, attrs, "lock", &flag) < 0)
+		return -1;
+	kaction_set_lock(action, flag);
+
+	flag = kaction_interrupt(action);
+	if (kxml_attr_bool(ctx, node, attrs, "interrupt", &flag) < 0)
+		return -1;
+	kaction_set_interrupt(action, flag);
+
+	flag = kaction_interactive(action);
+	if (kxml_attr_bool(ctx, node, attrs, "interactive", &flag) < 0)
+		return -1;
+	kaction_set_interactive(action, flag);
+
+	flag = kaction_records(action);
+	if (kxml_attr_bool(ctx, node, attrs, "records", &flag) < 0)
+		return -1;
+	kaction_set_records(action, flag);
+
+	flag = kaction_batch(action);
+	if (kxml_attr_bool(ctx, node, attrs, "batch", &flag) < 0)
+		return -1;
+	kaction_set_batch(action, flag);
+
+	num = kaction_timeout(action);
+	if (kxml_attr_uint(ctx, node, attrs, "timeout", &num) < 0)
+		return -1;
+	kaction_set_timeout(action, num);
+
+	num = kaction_cpu(action);
+	if (kxml_attr_uint(ctx, node, attrs, "cpu", &num) < 0)
+		return -1;
+	kaction_set_cpu(action, num);
+
+	return 0;
+}
+
+
+static int kxml_end_action(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent)
+{
+	if (!kxml_is_blank(node->text))
+		kaction_set_script((kaction_t *)node->obj, node->text);
+
+	ctx = ctx; // Happy compiler
+	parent = parent; // Happy compiler
+
+	return 0;
+}
+
+
+static int kxml_end_detail(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent)
+{
+	// The STARTUP's DETAIL is a banner. It's not stored.
+	if (kxml_is(parent, "COMMAND"))
+		kcommand_set_detail((kcommand_t *)parent->obj, node->text);
+
+	ctx = ctx; // Happy compiler
+
+	return 0;
+}
+
+
+static int kxml_start_nspace(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs)
+{
+	kview_t *view = NULL;
+	knspace_t *nspace = NULL;
+	bool_t flag = BOOL_FALSE;
+
+	if (kxml_is_view(parent))
+		view = (kview_t *)parent->obj;
+	else
+		view = kscheme_global(ctx->scheme);
+
+	nspace = knspace_new(kxml_attr(attrs, "ref"));
+	assert(nspace);
+	kview_add_nspace(view, nspace);
+	node->obj = nspace;
+
+	knspace_set_prefix(nspace, kxml_attr(attrs, "prefix"));
+
+	// The "help" is obsoleted by "context_help"
+	if (kxml_attr_bool(ctx, node, attrs, "help", &flag) < 0)
+		return -1;
+
+	flag = knspace_inherit(nspace);
+	if (kxml_attr_bool(ctx, node, attrs, "inherit", &flag) < 0)
+		return -1;
+	knspace_set_inherit(nspace, flag);
+
+	flag = knspace_completion(nspace);
+	if (kxml_attr_bool(ctx, node, attrs, "completion", &flag) < 0)
+		return -1;
+	knspace_set_completion(nspace, flag);
+
+	flag = knspace_context_help(nspace);
+	if (kxml_attr_bool(ctx, node, attrs, "context_help", &flag) < 0)
+		return -1;
+	knspace_set_context_help(nspace, flag);
+
+	return 0;
+}
+
+
+static int kxml_start_var(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs)
+{
+	kvar_t *var = NULL;
+	const char *name = kxml_attr(attrs, "name");
+	bool_t dynamic = BOOL_FALSE;
+
+	var = kvar_new(name);
+	assert(var);
+	if (!kscheme_add_var(ctx->scheme, var)) {
+		kvar_free(var);
+		return kxml_error(ctx, node->line, "Duplicate VAR \"%s\"",
+			name);
+	}
+	node->obj = var;
+
+	kvar_set_help(var, kxml_attr(attrs, "help"));
+	kvar_set_value(var, kxml_attr(attrs, "value"));
+	if (kxml_attr_bool(ctx, node, attrs, "dynamic", &dynamic) < 0)
+		return -1;
+	kvar_set_dynamic(var, dynamic);
+
+	parent = parent; // Happy compiler
+
+	return 0;
+}
+
+
+static int kxml_end_wdog(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent)
+{
+	if (!node->action)
+		return kxml_error(ctx, node->line, "WATCHDOG: ACTION is "
+			"required");
+
+	parent = parent; // Happy compiler
+
+	return 0;
+}
+
+
+static int kxml_start_plugin(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs)
+{
+	kplugin_t *plugin = NULL;
+	const char *name = kxml_attr(attrs, "name");
+	bool_t rtld_global = BOOL_FALSE;
+
+	plugin = kplugin_new(name);
+	assert(plugin);
+	if (!kscheme_add_plugin(ctx->scheme, plugin)) {
+		kplugin_free(plugin);
+		return kxml_error(ctx, node->line, "Duplicate PLUGIN \"%s\"",
+			name);
+	}
+	node->obj = plugin;
+
+	kplugin_set_alias(plugin, kxml_attr(attrs, "alias"));
+	kplugin_set_file(plugin, kxml_attr(attrs, "file"));
+	if (kxml_attr_bool(ctx, node, attrs, "rtld_global", &rtld_global) < 0)
+		return -1;
+	kplugin_set_rtld_global(plugin, rtld_global);
+
+	parent = parent; // Happy compiler
+
+	return 0;
+}
+
+
+static int kxml_end_plugin(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent)
+{
+	// The text content is a plugin's config
+	if (!kxml_is_blank(node->text))
+		kplugin_set_conf((kplugin_t *)node->obj, node->text);
+
+	ctx = ctx; // Happy compiler
+	parent = parent; // Happy compiler
+
+	return 0;
+}
+
+
+static int kxml_start_hotkey(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs)
+{
+	kview_t *view = NULL;
+	const char *key = kxml_attr(attrs, "key");
+	int code = -1;
+
+	// The HOTKEY outside the VIEW belongs to global view
+	if (kxml_is_view(parent))
+		view = (kview_t *)parent->obj;
+	else
+		view = kscheme_global(ctx->scheme);
+
+	code = kview_hotkey_code(key);
+	if (code < 0)
+		return kxml_error(ctx, node->line, "HOTKEY: Illegal key \"%s\"",
+			key);
+	if (!kview_add_hotkey(view, code, kxml_attr(attrs, "cmd")))
+		return kxml_error(ctx, node->line, "VIEW \"%s\": Duplicate "
+			"HOTKEY \"%s\"", kview_name(view), key);
+
+	return 0;
+}
+
+
+static int kxml_start_hook(kxml_ctx_t *ctx, kxml_node_t *node,
+	kxml_node_t *parent, const char **attrs)
+{
+	static const char * const hooks[] = {
+		"init", "fini", "access", "log", NULL };
+	const char *name = kxml_attr(attrs, "name");
+
+	if (name && !kxml_in_list(hooks, name))
+		return kxml_error(ctx, node->line, "HOOK: Unknown hook \"%s\"",
+			name);
+
+	parent = parent; // Happy compiler
+
+	return 0;
+}
+
+
+/** @brief Element is opened
+ *
+ * Validates element against its parent and creates the object. The object
+ * is attached to the parent's one immediately so nothing but the stack of
+ * opened elements is kept by loader.
+ */
+void kxml_start(kxml_ctx_t *ctx, const char *name, const char **attrs,
+	unsigned long line)
+{
+	const kxml_tag_t *tag = NULL;
+	kxml_node_t *node = NULL;
+	kxml_node_t *parent = NULL;
+	size_t i = 0;
+
+	if (ctx->error)
+		return;
+
+	for (tag = kxml_tags; tag->name; tag++) {
+		if (!strcmp(name, tag->name))
+			break;
+	}
+	if (!tag->name) {
+		kxml_error(ctx, line, "Unknown tag %s", name);
+		return;
+	}
+
+	if (ctx->depth > 0) {
+		parent = &ctx->stack[ctx->depth - 1];
+		if (!kxml_in_list(parent->tag->children, name)) {
+			kxml_error(ctx, line, "%s: Tag %s is not allowed here",
+				parent->tag->name, name);
+			return;
+		}
+	} else if (strcmp(name, "KLISH")) {
+		kxml_error(ctx, line, "The root tag must be KLISH");
+		return;
+	}
+
+	for (i = 0; attrs && attrs[i]; i += 2) {
+		if (!kxml_in_list(tag->attrs, attrs[i])) {
+			kxml_error(ctx, line, "%s: Unknown attribute \"%s\"",
+				name, attrs[i]);
+			return;
+		}
+	}
+	for (i = 0; tag->required[i]; i++) {
+		if (!kxml_attr(attrs, tag->required[i])) {
+			kxml_error(ctx, line, "%s: Missing required attribute "
+				"\"%s\"", name, tag->required[i]);
+			return;
+		}
+	}
+
+	// Push element. The stack can be reallocated so parent is got later.
+	if (ctx->depth >= ctx->stack_size) {
+		kxml_node_t *new_stack = NULL;
+		new_stack = realloc(ctx->stack, (ctx->stack_size +
+			KXML_STACK_STEP) * sizeof(*new_stack));
+		assert(new_stack);
+		if (!new_stack) {
+			kxml_error(ctx, line, "Not enough memory");
+			return;
+		}
+		ctx->stack = new_stack;
+		ctx->stack_size += KXML_STACK_STEP;
+	}
+	node = &ctx->stack[ctx->depth];
+	node->tag = tag;
+	node->line = line;
+	node->obj = NULL;
+	node->text = NULL;
+	node->action = NULL;
+	ctx->depth++;
+	parent = (ctx->depth > 1) ? &ctx->stack[ctx->depth - 2] : NULL;
+
+	if (tag->start)
+		tag->start(ctx, node, parent, attrs);
+}
+
+
+/** @brief Frees temporary data of opened element
+ */
+static void kxml_node_clean(kxml_node_t *node)
+{
+	faux_str_free(node->text);
+	node->text = NULL;
+	kaction_free(node->action);
+	node->action = NULL;
+}
+
+
+/** @brief Element is closed
+ */
+void kxml_end(kxml_ctx_t *ctx, const char *name, unsigned long line)
+{
+	kxml_node_t *node = NULL;
+	kxml_node_t *parent = NULL;
+
+	if (ctx->error)
+		return;
+	if (0 == ctx->depth)
+		return;
+
+	node = &ctx->stack[ctx->depth - 1];
+	parent = (ctx->depth > 1) ? &ctx->stack[ctx->depth - 2] : NULL;
+	if (node->tag->end)
+		node->tag->end(ctx, node, parent);
+	kxml_node_clean(node);
+	ctx->depth--;
+
+	name = name; // Happy compiler
+	line = line; // Happy compiler
+}
+
+
+/** @brief Text content of element. Can be called several times.
+ *
+ * Text of elements without text content is dropped so memory doesn't
+ * grow with formatting spaces.
+ */
+void kxml_text(kxml_ctx_t *ctx, const char *text, size_t len)
+{
+	kxml_node_t *node = NULL;
+
+	if (ctx->error)
+		return;
+	if (0 == ctx->depth)
+		return;
+
+	node = &ctx->stack[ctx->depth - 1];
+	if (!node->tag->text)
+		return;
+	faux_str_catn(&node->text, text, len);
+}
+
+
+#ifdef WITH_LUA
+/** @brief Checks if the file is a Lua scheme script
+ */
+static bool_t kxml_is_lua(const char *filename)
+{
+	const char *ext = strrchr(filename, '.');
+
+	if (!ext)
+		return BOOL_FALSE;
+
+	return !strcmp(ext, KXML_LUA_EXT);
+}
+#endif
+
+
+/** @brief Loads scheme from XML file
+ *
+ * The XML file is parsed by streaming parser chunk by chunk. Objects are
+ * created while elements are opened and no document tree is built. So
+ * the memory used by loader depends on nesting depth but not on file
+ * size. The "*.lua" file is a Lua script which defines the same elements
+ * (if Lua support is enabled). The function is thread safe so the files
+ * can be loaded concurrently.
+ *
+ * @param [in] filename File to load.
+ * @param [out] error Error message "<file>:<line>: <message>".
+ * Must be freed by faux_str_free().
+ * @return Allocated not linked scheme or NULL on error.
+ */
+kscheme_t *kxml_load_file(const char *filename, char **error)
+{
+	kxml_ctx_t ctx = {};
+	int retval = -1;
+
+	assert(filename);
+	if (!filename)
+		return NULL;
+
+	ctx.filename = filename;
+	ctx.scheme = kscheme_new();
+	assert(ctx.scheme);
+	ctx.error = NULL;
+	ctx.stack = NULL;
+	ctx.depth = 0;
+	ctx.stack_size = 0;
+	ctx.parser = NULL;
+
+#ifdef WITH_LUA
+	if (kxml_is_lua(filename))
+		retval = kxml_lua_parse_file(&ctx);
+	else
+#endif
+		retval = kxml_parse_file(&ctx);
+	if ((retval < 0) && !ctx.error)
+		kxml_error(&ctx, 0, "Can't parse XML file");
+	if (!ctx.error && (ctx.depth > 0))
+		kxml_error(&ctx, 0, "Unexpected end of file");
+
+	// Unwind the stack of opened elements on error
+	while (ctx.depth > 0)
+		kxml_node_clean(&ctx.stack[--ctx.depth]);
+	free(ctx.stack);
+
+	if (ctx.error) {
+		kscheme_free(ctx.scheme);
+		if (error)
+			*error = ctx.error;
+		else
+			faux_str_free(ctx.error);
+		return NULL;
+	}
+
+	return ctx.scheme;
+}
+
+
+#if !defined(HAVE_LIB_LIBXML2) && !defined(HAVE_LIB_EXPAT) && \
+	!defined(HAVE_LIB_BSDXML)
+
+int kxml_parse_file(kxml_ctx_t *ctx)
+{
+	return kxml_error(ctx, 0, "The XML backend is not supported");
+}
+
+#endif
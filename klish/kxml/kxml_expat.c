@@ -0,0 +1,126 @@
+/** @file kxml_expat.c
+ *
+ * @brief The expat (bsdxml) backend of streaming XML loader
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#if defined(HAVE_LIB_EXPAT) || defined(HAVE_LIB_BSDXML)
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#ifdef HAVE_LIB_BSDXML
+#include <bsdxml.h>
+#else
+#include <expat.h>
+#endif
+
+#include <faux/str.h>
+
+#include "private.h"
+
+
+static unsigned long kxml_expat_line(kxml_ctx_t *ctx)
+{
+	return (unsigned long)XML_GetCurrentLineNumber((XML_Parser)ctx->parser);
+}
+
+
+static void kxml_expat_stop(kxml_ctx_t *ctx)
+{
+	if (ctx->error)
+		XML_StopParser((XML_Parser)ctx->parser, XML_FALSE);
+}
+
+
+static void kxml_expat_start(void *user_data, const XML_Char *name,
+	const XML_Char **attrs)
+{
+	kxml_ctx_t *ctx = (kxml_ctx_t *)user_data;
+
+	kxml_start(ctx, name, attrs, kxml_expat_line(ctx));
+	kxml_expat_stop(ctx);
+}
+
+
+static void kxml_expat_end(void *user_data, const XML_Char *name)
+{
+	kxml_ctx_t *ctx = (kxml_ctx_t *)user_data;
+
+	kxml_end(ctx, name, kxml_expat_line(ctx));
+	kxml_expat_stop(ctx);
+}
+
+
+static void kxml_expat_text(void *user_data, const XML_Char *text, int len)
+{
+	kxml_ctx_t *ctx = (kxml_ctx_t *)user_data;
+
+	kxml_text(ctx, text, (size_t)len);
+}
+
+
+/** @brief Parses file by expat stream parser
+ */
+int kxml_parse_file(kxml_ctx_t *ctx)
+{
+	XML_Parser parser = NULL;
+	char buf[KXML_CHUNK_SIZE];
+	ssize_t r = 0;
+	int fd = -1;
+	int retval = -1;
+
+	fd = open(ctx->filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return kxml_error(ctx, 0, "Can't open file: %s",
+			strerror(errno));
+
+	parser = XML_ParserCreate(NULL);
+	assert(parser);
+	if (!parser) {
+		kxml_error(ctx, 0, "Can't create XML parser");
+		goto err;
+	}
+	XML_SetUserData(parser, ctx);
+	XML_SetElementHandler(parser, kxml_expat_start, kxml_expat_end);
+	XML_SetCharacterDataHandler(parser, kxml_expat_text);
+	ctx->parser = parser;
+
+	for (;;) {
+		r = read(fd, buf, sizeof(buf));
+		if (r < 0) {
+			if (EINTR == errno)
+				continue;
+			kxml_error(ctx, 0, "Can't read file: %s",
+				strerror(errno));
+			goto err;
+		}
+		// The zero-length chunk terminates parsing
+		if ((XML_Parse(parser, buf, (int)r, (0 == r)) ==
+			XML_STATUS_ERROR) && !ctx->error)
+			kxml_error(ctx, kxml_expat_line(ctx), "%s",
+				XML_ErrorString(XML_GetErrorCode(parser)));
+		if ((0 == r) || ctx->error)
+			break;
+	}
+
+	if (!ctx->error)
+		retval = 0;
+err:
+	ctx->parser = NULL;
+	if (parser)
+		XML_ParserFree(parser);
+	close(fd);
+
+	return retval;
+}
+
+#endif // HAVE_LIB_EXPAT || HAVE_LIB_BSDXML
@@ -0,0 +1,166 @@
+/** @file kxml_libxml2.c
+ *
+ * @brief The libxml2 backend of streaming XML loader
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#ifdef HAVE_LIB_LIBXML2
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <libxml/parser.h>
+#include <libxml/SAX2.h>
+
+#include <faux/str.h>
+
+#include "private.h"
+
+
+static unsigned long kxml_libxml2_line(kxml_ctx_t *ctx)
+{
+	xmlParserCtxtPtr parser = (xmlParserCtxtPtr)ctx->parser;
+
+	if (!parser)
+		return 0;
+
+	return (unsigned long)xmlSAX2GetLineNumber(parser);
+}
+
+
+static void kxml_libxml2_stop(kxml_ctx_t *ctx)
+{
+	if (ctx->error && ctx->parser)
+		xmlStopParser((xmlParserCtxtPtr)ctx->parser);
+}
+
+
+static void kxml_libxml2_start(void *user_data, const xmlChar *name,
+	const xmlChar **attrs)
+{
+	kxml_ctx_t *ctx = (kxml_ctx_t *)user_data;
+
+	kxml_start(ctx, (const char *)name, (const char **)attrs,
+		kxml_libxml2_line(ctx));
+	kxml_libxml2_stop(ctx);
+}
+
+
+static void kxml_libxml2_end(void *user_data, const xmlChar *name)
+{
+	kxml_ctx_t *ctx = (kxml_ctx_t *)user_data;
+
+	kxml_end(ctx, (const char *)name, kxml_libxml2_line(ctx));
+	kxml_libxml2_stop(ctx);
+}
+
+
+static void kxml_libxml2_text(void *user_data, const xmlChar *text, int len)
+{
+	kxml_ctx_t *ctx = (kxml_ctx_t *)user_data;
+
+	kxml_text(ctx, (const char *)text, (size_t)len);
+}
+
+
+// Errors are got by xmlCtxtGetLastError() so don't print them
+static void kxml_libxml2_silent(void *user_data, const char *msg, ...)
+{
+	user_data = user_data; // Happy compiler
+	msg = msg; // Happy compiler
+}
+
+
+/** @brief Stores parser's own error
+ */
+static void kxml_libxml2_error(kxml_ctx_t *ctx, xmlParserCtxtPtr parser)
+{
+	xmlErrorPtr xerr = xmlCtxtGetLastError(parser);
+	char *msg = NULL;
+	size_t len = 0;
+
+	if (!xerr || !xerr->message) {
+		kxml_error(ctx, 0, "Can't parse XML file");
+		return;
+	}
+
+	msg = faux_str_dup(xerr->message);
+	len = strlen(msg);
+	if ((len > 0) && ('\n' == msg[len - 1]))
+		msg[len - 1] = '\0';
+	kxml_error(ctx, (unsigned long)xerr->line, "%s", msg);
+	faux_str_free(msg);
+}
+
+
+/** @brief Parses file by libxml2 push parser (SAX)
+ */
+int kxml_parse_file(kxml_ctx_t *ctx)
+{
+	xmlSAXHandler sax = {};
+	xmlParserCtxtPtr parser = NULL;
+	char buf[KXML_CHUNK_SIZE];
+	ssize_t r = 0;
+	int fd = -1;
+	int retval = -1;
+
+	fd = open(ctx->filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return kxml_error(ctx, 0, "Can't open file: %s",
+			strerror(errno));
+
+	sax.startElement = kxml_libxml2_start;
+	sax.endElement = kxml_libxml2_end;
+	sax.characters = kxml_libxml2_text;
+	sax.cdataBlock = kxml_libxml2_text;
+	sax.warning = kxml_libxml2_silent;
+	sax.error = kxml_libxml2_silent;
+	sax.fatalError = kxml_libxml2_silent;
+
+	parser = xmlCreatePushParserCtxt(&sax, ctx, NULL, 0, ctx->filename);
+	assert(parser);
+	if (!parser) {
+		kxml_error(ctx, 0, "Can't create XML parser");
+		goto err;
+	}
+	xmlCtxtUseOptions(parser,
+		XML_PARSE_NONET | XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
+	ctx->parser = parser;
+
+	for (;;) {
+		r = read(fd, buf, sizeof(buf));
+		if (r < 0) {
+			if (EINTR == errno)
+				continue;
+			kxml_error(ctx, 0, "Can't read file: %s",
+				strerror(errno));
+			goto err;
+		}
+		// The zero-length chunk terminates parsing
+		if ((xmlParseChunk(parser, buf, r, (0 == r)) != 0) &&
+			!ctx->error)
+			kxml_libxml2_error(ctx, parser);
+		if ((0 == r) || ctx->error)
+			break;
+	}
+
+	if (!ctx->error)
+		retval = 0;
+err:
+	ctx->parser = NULL;
+	if (parser)
+		xmlFreeParserCtxt(parser);
+	close(fd);
+
+	return retval;
+}
+
+#endif // HAVE_LIB_LIBXML2
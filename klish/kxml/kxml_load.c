@@ -0,0 +1,286 @@
+#define _GNU_SOURCE
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#ifdef HAVE_LIB_LIBXML2
+#include <libxml/parser.h>
+#endif
+
+#include <faux/str.h>
+#include <faux/list.h>
+#include <klish/kscheme.h>
+#include <klish/kxml.h>
+
+
+/** @brief Result of single file loading
+ */
+typedef struct {
+	const char *filename;
+	kscheme_t *scheme;
+	char *error;
+} kxml_job_t;
+
+
+/** @brief Queue of files shared by workers
+ */
+typedef struct {
+	kxml_job_t *jobs;
+	size_t jobs_num;
+	size_t next; // The next file to load
+	pthread_mutex_t mutex;
+} kxml_queue_t;
+
+
+/** @brief Worker thread. Takes files from queue one by one.
+ */
+static void *kxml_worker(void *arg)
+{
+	kxml_queue_t *queue = (kxml_queue_t *)arg;
+
+	while (1) {
+		kxml_job_t *job = NULL;
+
+		pthread_mutex_lock(&queue->mutex);
+		if (queue->next < queue->jobs_num)
+			job = &queue->jobs[queue->next++];
+		pthread_mutex_unlock(&queue->mutex);
+		if (!job)
+			break;
+
+		job->scheme = kxml_load_file(job->filename, &job->error);
+	}
+
+	return NULL;
+}
+
+
+/** @brief Loads files concurrently and links the resulting scheme
+ *
+ * Each file is parsed by thread pool into its own scheme. Then the
+ * schemes are merged in the order of files and the references (NAMESPACE
+ * views, PTYPEs, ACTION's plugins etc.) are resolved by single thread.
+ *
+ * @param [in] files Array of file names.
+ * @param [in] files_num Number of files.
+ * @param [in] jobs Number of parallel workers. 0 - number of CPUs.
+ * @param [out] error Error messages. One line per error. Must be freed by
+ * faux_str_free().
+ * @return Linked scheme or NULL on error.
+ */
+kscheme_t *kxml_load_files(const char * const *files, size_t files_num,
+	unsigned int jobs, char **error)
+{
+	kxml_queue_t queue = {};
+	pthread_t *threads = NULL;
+	unsigned int started = 0;
+	kscheme_t *scheme = NULL;
+	char *errors = NULL;
+	char *msg = NULL;
+	size_t i = 0;
+
+	assert(files);
+	if (!files)
+		return NULL;
+
+	if (0 == jobs) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		jobs = (cpus > 0) ? (unsigned int)cpus : 1;
+	}
+	if (jobs > files_num)
+		jobs = files_num;
+
+#ifdef HAVE_LIB_LIBXML2
+	// Parser must be initialized before threads
+	xmlInitParser();
+#endif
+
+	queue.jobs = faux_zmalloc(sizeof(*queue.jobs) * (files_num + 1));
+	assert(queue.jobs);
+	queue.jobs_num = files_num;
+	queue.next = 0;
+	for (i = 0; i < files_num; i++)
+		queue.jobs[i].filename = files[i];
+	pthread_mutex_init(&queue.mutex, NULL);
+
+	// The current thread is a worker too. So files will be loaded even
+	// if threads can't be created.
+	if (jobs > 1) {
+		threads = faux_zmalloc(sizeof(*threads) * (jobs - 1));
+		assert(threads);
+		for (started = 0; started < jobs - 1; started++) {
+			if (pthread_create(&threads[started], NULL,
+				kxml_worker, &queue) != 0)
+				break;
+		}
+	}
+	kxml_worker(&queue);
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	faux_free(threads);
+	pthread_mutex_destroy(&queue.mutex);
+
+	// Merge per-file schemes in the order of files so the result
+	// doesn't depend on threads scheduling.
+	scheme = kscheme_new();
+	for (i = 0; i < files_num; i++) {
+		kxml_job_t *job = &queue.jobs[i];
+		if (!job->scheme) {
+			faux_str_cat(&errors, job->error);
+			faux_str_cat(&errors, "\n");
+			faux_str_free(job->error);
+			continue;
+		}
+		if (kscheme_merge(scheme, job->scheme, &msg) < 0) {
+			faux_str_cat(&errors, job->filename);
+			faux_str_cat(&errors, ": ");
+			faux_str_cat(&errors, msg);
+			faux_str_cat(&errors, "\n");
+			faux_str_free(msg);
+			msg = NULL;
+		}
+		kscheme_free(job->scheme);
+	}
+	faux_free(queue.jobs);
+
+	if (!errors && (kscheme_link(scheme, &msg) < 0)) {
+		faux_str_cat(&errors, msg);
+		faux_str_cat(&errors, "\n");
+		faux_str_free(msg);
+	}
+	if (errors) {
+		kscheme_free(scheme);
+		if (error)
+			*error = errors;
+		else
+			faux_str_free(errors);
+		return NULL;
+	}
+
+	return scheme;
+}
+
+
+static int kxml_filter(const struct dirent *entry)
+{
+	const char *ext = NULL;
+
+	if ('.' == entry->d_name[0])
+		return 0;
+	ext = strrchr(entry->d_name, '.');
+	if (!ext)
+		return 0;
+	if (!strcmp(ext, KXML_EXT))
+		return 1;
+#ifdef WITH_LUA
+	if (!strcmp(ext, KXML_LUA_EXT))
+		return 1;
+#endif
+
+	return 0;
+}
+
+
+/** @brief Adds file or all scheme files of directory to the list
+ */
+static int kxml_add_path(faux_list_t *files, const char *path, char **error)
+{
+	struct stat st = {};
+	struct dirent **entries = NULL;
+	int num = 0;
+	int i = 0;
+
+	if (stat(path, &st) < 0) {
+		if (error)
+			*error = faux_str_sprintf("%s: Can't access\n", path);
+		return -1;
+	}
+	if (!S_ISDIR(st.st_mode)) {
+		faux_list_add(files, faux_str_dup(path));
+		return 0;
+	}
+
+	// Sorted order makes results reproducible
+	num = scandir(path, &entries, kxml_filter, alphasort);
+	if (num < 0) {
+		if (error)
+			*error = faux_str_sprintf("%s: Can't read directory\n",
+				path);
+		return -1;
+	}
+	for (i = 0; i < num; i++) {
+		faux_list_add(files, faux_str_sprintf("%s/%s",
+			path, entries[i]->d_name));
+		free(entries[i]);
+	}
+	free(entries);
+
+	return 0;
+}
+
+
+/** @brief Loads scheme from the list of files and directories
+ *
+ * @param [in] path List of files and directories separated by
+ * KXML_PATH_DELIM. All "*.xml" (and "*.lua" if Lua support is enabled)
+ * files of directory are loaded.
+ * @param [in] jobs Number of parallel workers. 0 - number of CPUs.
+ * @param [out] error Error messages. Must be freed by faux_str_free().
+ * @return Linked scheme or NULL on error.
+ */
+kscheme_t *kxml_load(const char *path, unsigned int jobs, char **error)
+{
+	faux_list_t *files = NULL;
+	faux_list_node_t *iter = NULL;
+	const char **names = NULL;
+	const char *name = NULL;
+	kscheme_t *scheme = NULL;
+	char *paths = NULL;
+	char *saveptr = NULL;
+	char *token = NULL;
+	size_t i = 0;
+
+	assert(path);
+	if (!path)
+		return NULL;
+
+	files = faux_list_new(FAUX_LIST_UNSORTED, FAUX_LIST_NONUNIQUE,
+		NULL, NULL, (void (*)(void *))faux_str_free);
+	assert(files);
+	paths = faux_str_dup(path);
+	for (token = strtok_r(paths, KXML_PATH_DELIM, &saveptr); token;
+		token = strtok_r(NULL, KXML_PATH_DELIM, &saveptr)) {
+		if (kxml_add_path(files, token, error) < 0)
+			goto err;
+	}
+	if (0 == faux_list_len(files)) {
+		if (error)
+			*error = faux_str_sprintf("%s: No scheme files found\n",
+				path);
+		goto err;
+	}
+
+	names = faux_zmalloc(sizeof(*names) * faux_list_len(files));
+	assert(names);
+	iter = faux_list_head(files);
+	while ((name = (const char *)faux_list_each(&iter)))
+		names[i++] = name;
+	scheme = kxml_load_files(names, i, jobs, error);
+	faux_free(names);
+
+err:
+	faux_str_free(paths);
+	faux_list_free(files);
+
+	return scheme;
+}
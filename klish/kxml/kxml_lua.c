@@ -0,0 +1,301 @@
+/** @file kxml_lua.c
+ *
+ * @brief Lua frontend of scheme loader
+ *
+ * The Lua scheme file is a script executed once while loading. The global
+ * functions named after XML tags (KLISH, VIEW, COMMAND, PARAM, ACTION etc.)
+ * take a table. The string keys are attributes, the array part contains
+ * nested elements and strings of text content. The nested arrays without
+ * tag are flattened so the elements generated by loops can be inserted as
+ * a whole:
+ *
+ * local ports = {}
+ * for i = 1, 48 do
+ *     ports[#ports + 1] = COMMAND { name = "port" .. i, help = "Port " .. i,
+ *         ACTION { builtin = "port@klish", "select " .. i } }
+ * end
+ * KLISH { VIEW { name = "interface", ports } }
+ *
+ * The elements are fed to the same handlers as the XML elements so the
+ * validation, error messages and resulting scheme are the same.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#ifdef WITH_LUA
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+
+#include <faux/str.h>
+
+#include "private.h"
+
+// The address is a unique key of registry
+static const char kxml_lua_roots = 'r';
+
+static int kxml_lua_emit(lua_State *L, kxml_ctx_t *ctx, int idx);
+
+
+/** @brief Tag function. Marks table as element.
+ *
+ * The metatable of element contains the tag name and the line of script
+ * the element was defined at.
+ */
+static int kxml_lua_tag(lua_State *L)
+{
+	const char *tag = lua_tostring(L, lua_upvalueindex(1));
+	lua_Debug ar = {};
+	int line = 0;
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	lua_settop(L, 1);
+	if (lua_getmetatable(L, 1))
+		return luaL_error(L, "%s: The table is already an element",
+			tag);
+
+	if (lua_getstack(L, 1, &ar) && lua_getinfo(L, "l", &ar))
+		line = ar.currentline;
+
+	lua_newtable(L);
+	lua_pushstring(L, tag);
+	lua_setfield(L, -2, "tag");
+	lua_pushinteger(L, line);
+	lua_setfield(L, -2, "line");
+	lua_setmetatable(L, 1);
+
+	// The KLISH elements are roots to emit after script execution
+	if (!strcmp(tag, "KLISH")) {
+		lua_Integer n = 0;
+		lua_pushlightuserdata(L, (void *)&kxml_lua_roots);
+		lua_rawget(L, LUA_REGISTRYINDEX);
+		lua_getfield(L, -1, "n");
+		n = lua_tointeger(L, -1) + 1;
+		lua_pop(L, 1);
+		lua_pushinteger(L, n);
+		lua_setfield(L, -2, "n");
+		lua_pushvalue(L, 1);
+		lua_rawseti(L, -2, n);
+		lua_pop(L, 1);
+	}
+
+	return 1;
+}
+
+
+/** @brief Gets tag and line of element
+ *
+ * @return Tag name or NULL if the table is not an element.
+ */
+static const char *kxml_lua_element(lua_State *L, int idx,
+	unsigned long *line)
+{
+	const char *tag = NULL;
+
+	if (!lua_getmetatable(L, idx))
+		return NULL;
+	lua_getfield(L, -1, "tag");
+	tag = lua_tostring(L, -1); // Metatable holds reference
+	lua_getfield(L, -2, "line");
+	*line = (unsigned long)lua_tointeger(L, -1);
+	lua_pop(L, 3);
+
+	return tag;
+}
+
+
+/** @brief Gets attributes of element as name-value pairs ended by NULL
+ *
+ * @return Allocated array. Must be freed by kxml_lua_attrs_free().
+ */
+static char **kxml_lua_attrs(lua_State *L, kxml_ctx_t *ctx, int idx,
+	const char *tag, unsigned long line)
+{
+	char **attrs = NULL;
+	size_t num = 0;
+	size_t i = 0;
+
+	lua_pushnil(L);
+	while (lua_next(L, idx)) {
+		if (lua_type(L, -2) == LUA_TSTRING)
+			num++;
+		lua_pop(L, 1);
+	}
+	attrs = faux_zmalloc(sizeof(*attrs) * (num * 2 + 1));
+	assert(attrs);
+
+	lua_pushnil(L);
+	while (lua_next(L, idx)) {
+		const char *value = NULL;
+		// Number keys are the array part. The lua_next() can't
+		// continue with converted key so check the type only.
+		if (lua_type(L, -2) == LUA_TNUMBER) {
+			lua_pop(L, 1);
+			continue;
+		}
+		if (lua_type(L, -2) != LUA_TSTRING) {
+			kxml_error(ctx, line, "%s: Illegal attribute key", tag);
+			lua_pop(L, 2);
+			break;
+		}
+		if (lua_type(L, -1) == LUA_TBOOLEAN)
+			value = lua_toboolean(L, -1) ? "true" : "false";
+		else if ((lua_type(L, -1) == LUA_TSTRING) ||
+			(lua_type(L, -1) == LUA_TNUMBER))
+			value = lua_tostring(L, -1); // Converts copy only
+		if (!value) {
+			kxml_error(ctx, line, "%s: Illegal value of attribute "
+				"\"%s\"", tag, lua_tostring(L, -2));
+			lua_pop(L, 2);
+			break;
+		}
+		attrs[i++] = faux_str_dup(lua_tostring(L, -2));
+		attrs[i++] = faux_str_dup(value);
+		lua_pop(L, 1);
+	}
+
+	return attrs;
+}
+
+
+static void kxml_lua_attrs_free(char **attrs)
+{
+	size_t i = 0;
+
+	if (!attrs)
+		return;
+	for (i = 0; attrs[i]; i++)
+		faux_str_free(attrs[i]);
+	faux_free(attrs);
+}
+
+
+/** @brief Emits array part of table: nested elements and text
+ */
+static int kxml_lua_emit_list(lua_State *L, kxml_ctx_t *ctx, int idx,
+	unsigned long line)
+{
+	lua_Integer i = 0;
+
+	if (!lua_checkstack(L, 8))
+		return kxml_error(ctx, line, "Too deep nesting");
+	for (i = 1; !ctx->error; i++) {
+		int type = LUA_TNIL;
+
+		lua_rawgeti(L, idx, i);
+		type = lua_type(L, -1);
+		if (LUA_TNIL == type) {
+			lua_pop(L, 1);
+			break;
+		}
+		if ((LUA_TSTRING == type) || (LUA_TNUMBER == type)) {
+			size_t len = 0;
+			const char *text = lua_tolstring(L, -1, &len);
+			kxml_text(ctx, text, len);
+		} else if (LUA_TTABLE == type) {
+			unsigned long nested_line = 0;
+			if (kxml_lua_element(L, lua_gettop(L), &nested_line))
+				kxml_lua_emit(L, ctx, lua_gettop(L));
+			else // Not an element. Flatten the list.
+				kxml_lua_emit_list(L, ctx, lua_gettop(L),
+					line);
+		} else {
+			kxml_error(ctx, line, "Illegal nested value of type %s",
+				lua_typename(L, type));
+		}
+		lua_pop(L, 1);
+	}
+
+	return ctx->error ? -1 : 0;
+}
+
+
+/** @brief Emits element and its nested elements
+ */
+static int kxml_lua_emit(lua_State *L, kxml_ctx_t *ctx, int idx)
+{
+	const char *tag = NULL;
+	unsigned long line = 0;
+	char **attrs = NULL;
+
+	tag = kxml_lua_element(L, idx, &line);
+	if (!tag)
+		return kxml_error(ctx, 0, "Element without tag");
+
+	attrs = kxml_lua_attrs(L, ctx, idx, tag, line);
+	if (!ctx->error)
+		kxml_start(ctx, tag, (const char **)attrs, line);
+	kxml_lua_attrs_free(attrs);
+	if (ctx->error)
+		return -1;
+
+	if (kxml_lua_emit_list(L, ctx, idx, line) < 0)
+		return -1;
+
+	kxml_end(ctx, tag, line);
+
+	return ctx->error ? -1 : 0;
+}
+
+
+/** @brief Executes Lua scheme file and emits defined elements
+ */
+int kxml_lua_parse_file(kxml_ctx_t *ctx)
+{
+	lua_State *L = NULL;
+	const char *tag = NULL;
+	lua_Integer i = 0;
+	size_t t = 0;
+
+	L = luaL_newstate();
+	assert(L);
+	if (!L)
+		return kxml_error(ctx, 0, "Can't create Lua state");
+	luaL_openlibs(L);
+
+	lua_pushlightuserdata(L, (void *)&kxml_lua_roots);
+	lua_newtable(L);
+	lua_rawset(L, LUA_REGISTRYINDEX);
+
+	for (t = 0; (tag = kxml_tag_name(t)); t++) {
+		lua_pushstring(L, tag);
+		lua_pushcclosure(L, kxml_lua_tag, 1);
+		lua_setglobal(L, tag);
+	}
+
+	// The Lua message is "<file>:<line>: <message>" already
+	if (luaL_loadfile(L, ctx->filename) || lua_pcall(L, 0, 0, 0)) {
+		const char *msg = lua_tostring(L, -1);
+		if (!ctx->error)
+			ctx->error = faux_str_dup(msg ? msg : "Lua error");
+		lua_close(L);
+		return -1;
+	}
+
+	lua_pushlightuserdata(L, (void *)&kxml_lua_roots);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	for (i = 1; !ctx->error; i++) {
+		lua_rawgeti(L, -1, i);
+		if (lua_isnil(L, -1)) {
+			lua_pop(L, 1);
+			break;
+		}
+		kxml_lua_emit(L, ctx, lua_gettop(L));
+		lua_pop(L, 1);
+	}
+	if (!ctx->error && (1 == i))
+		kxml_error(ctx, 0, "KLISH element is not defined");
+	lua_close(L);
+
+	return ctx->error ? -1 : 0;
+}
+
+#endif // WITH_LUA
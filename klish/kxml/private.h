@@ -0,0 +1,54 @@
+#ifndef _klish_kxml_private_h
+#define _klish_kxml_private_h
+
+#include <faux/faux.h>
+#include <klish/kscheme.h>
+#include <klish/kxml.h>
+
+#define KXML_CHUNK_SIZE 16384 // Size of file chunk to feed parser with
+
+typedef struct kxml_tag_s kxml_tag_t;
+
+
+/** @brief Opened element. The stack of opened elements is the only
+ * loader's state so the memory doesn't depend on file size.
+ */
+typedef struct {
+	const kxml_tag_t *tag;
+	unsigned long line;
+	void *obj; // Object created for element
+	char *text; // Text content (for tags with text only)
+	kaction_t *action; // Nested ACTION which has no owner object
+} kxml_node_t;
+
+
+/** @brief Loader context
+ */
+typedef struct {
+	const char *filename;
+	kscheme_t *scheme;
+	char *error;
+	kxml_node_t *stack;
+	size_t depth;
+	size_t stack_size;
+	void *parser; // Parser specific data
+} kxml_ctx_t;
+
+
+// Parser independent handlers
+void kxml_start(kxml_ctx_t *ctx, const char *name, const char **attrs,
+	unsigned long line);
+void kxml_end(kxml_ctx_t *ctx, const char *name, unsigned long line);
+void kxml_text(kxml_ctx_t *ctx, const char *text, size_t len);
+int kxml_error(kxml_ctx_t *ctx, unsigned long line, const char *fmt, ...);
+const char *kxml_tag_name(size_t index);
+
+// Parser specific. Reads file chunk by chunk and calls handlers.
+int kxml_parse_file(kxml_ctx_t *ctx);
+
+#ifdef WITH_LUA
+// Executes Lua scheme script and calls handlers
+int kxml_lua_parse_file(kxml_ctx_t *ctx);
+#endif
+
+#endif // _klish_kxml_private_h
@@ -0,0 +1,26 @@
+#include <stdlib.h>
+
+int testc_version_major = 1;
+int testc_version_minor = 0;
+
+const char *testc_module[][2] = {
+
+	// kexecq
+	{"testc_kexecq_users", "Share slots between users, not sessions"},
+	{"testc_kexecq_weights", "Share user's slots by session weights"},
+	{"testc_kexecq_per_user", "Limit running processes per user"},
+
+	// kcache
+	{"testc_kcache_evict", "Evict least recently used entries"},
+	{"testc_kcache_ttl", "Remove expired entries on access"},
+
+	// ktpd_session
+	{"testc_ktpd_session_replay_wrap", "Replay missed output from wrapped ring"},
+	{"testc_ktpd_session_replay_lost", "Report output that doesn't fit ring"},
+
+	// krecord
+	{"testc_krecord_encode_decode", "Encode and decode fields of record"},
+	{"testc_krecord_broken", "Recognize part of record and garbage"},
+
+	{NULL, NULL}
+	};
@@ -44,4 +44,13 @@ struct _tinyrl {
 	unsigned int last_line_size; /* The length of last_buffer */
 	unsigned int last_width; /* Last terminal width. For resize */
 	bool_t utf8;		/* Is the encoding UTF-8 */
+	/* Non-interactive input */
+	char *in_buf;		/* Block of input or mmap()ed file */
+	size_t in_size;		/* Size of in_buf */
+	size_t in_len;		/* Length of valid data within in_buf */
+	size_t in_pos;		/* Start of the next line */
+	bool_t in_mmap;		/* The in_buf is mmap()ed regular file */
+	bool_t in_eof;
 };
+
+extern bool_t tinyrl_extend_line_buffer(tinyrl_t * instance, unsigned int len);
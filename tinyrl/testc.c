@@ -0,0 +1,201 @@
+/*
+ * testc.c
+ *
+ * Tests of non-interactive line reader. The test gets the lines by
+ * public tinyrl_readline() from regular file, pipe and stream that
+ * stdio has read partially.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "tinyrl/tinyrl.h"
+
+/* Longer than initial input block so the block must grow */
+#define TESTC_LONG_LINE (100 * 1024)
+
+/*-------------------------------------------------------- */
+/*
+ * Read all lines of stream and compare them to expected ones.
+ * The expected list is terminated by NULL.
+ */
+static int testc_tinyrl_expect(FILE * istream, const char **expected)
+{
+	tinyrl_t *rl = NULL;
+	FILE *ostream = NULL;
+	char *line = NULL;
+	int retval = -1;
+	unsigned int i = 0;
+
+	ostream = fopen("/dev/null", "w");
+	if (!ostream) {
+		printf("Can't open /dev/null\n");
+		return -1;
+	}
+	rl = tinyrl_new(istream, ostream, 0, NULL);
+	if (!rl) {
+		printf("Can't create tinyrl\n");
+		fclose(ostream);
+		return -1;
+	}
+
+	for (i = 0; expected[i]; i++) {
+		line = tinyrl_readline(rl, NULL);
+		if (!line) {
+			printf("Line %u: unexpected end of input\n", i);
+			goto out;
+		}
+		if (strcmp(line, expected[i])) {
+			printf("Line %u: got [%.40s] instead of [%.40s]\n",
+				i, line, expected[i]);
+			free(line);
+			goto out;
+		}
+		free(line);
+	}
+	line = tinyrl_readline(rl, NULL);
+	if (line) {
+		printf("Extra line [%.40s]\n", line);
+		free(line);
+		goto out;
+	}
+	retval = 0;
+
+out:
+	tinyrl_delete(rl);
+	fclose(ostream);
+
+	return retval;
+}
+
+/*-------------------------------------------------------- */
+/*
+ * The regular file is mmap()ed. The CR, leading whitespace and
+ * last line without newline are handled like before.
+ */
+int testc_tinyrl_readline_file(void)
+{
+	const char *input = "first\r\n  \tsecond\n\nlast";
+	const char *expected[] = { "first", "second", "", "last", NULL };
+	FILE *f = NULL;
+	int retval = -1;
+
+	f = tmpfile();
+	if (!f) {
+		printf("Can't create temporary file\n");
+		return -1;
+	}
+	fputs(input, f);
+	fflush(f);
+	rewind(f);
+	retval = testc_tinyrl_expect(f, expected);
+	fclose(f);
+
+	return retval;
+}
+
+/*-------------------------------------------------------- */
+/*
+ * The pipe is read by blocks. The line that is longer than block
+ * makes it grow.
+ */
+int testc_tinyrl_readline_pipe(void)
+{
+	const char *expected[] = { "one", NULL, "three", NULL };
+	char *long_line = NULL;
+	int fd[2] = { -1, -1 };
+	pid_t pid = -1;
+	FILE *f = NULL;
+	int retval = -1;
+	int status = 0;
+
+	long_line = malloc(TESTC_LONG_LINE + 1);
+	if (!long_line)
+		return -1;
+	memset(long_line, 'x', TESTC_LONG_LINE);
+	long_line[TESTC_LONG_LINE] = '\0';
+	expected[1] = long_line;
+
+	if (pipe(fd) < 0) {
+		printf("Can't create pipe\n");
+		free(long_line);
+		return -1;
+	}
+	pid = fork();
+	if (pid < 0) {
+		printf("Can't fork\n");
+		close(fd[0]);
+		close(fd[1]);
+		free(long_line);
+		return -1;
+	}
+	/* Writer. The pipe can't hold whole input. */
+	if (0 == pid) {
+		FILE *w = NULL;
+		close(fd[0]);
+		w = fdopen(fd[1], "w");
+		if (!w)
+			_exit(1);
+		fprintf(w, "one\n%s\nthree\n", long_line);
+		fclose(w);
+		_exit(0);
+	}
+	close(fd[1]);
+
+	f = fdopen(fd[0], "r");
+	if (f) {
+		retval = testc_tinyrl_expect(f, expected);
+		fclose(f);
+	} else {
+		close(fd[0]);
+	}
+	waitpid(pid, &status, 0);
+	free(long_line);
+
+	return retval;
+}
+
+/*-------------------------------------------------------- */
+/*
+ * The stdio reads ahead the whole pipe on the first fgets(). The
+ * reader takes these buffered data instead of losing them.
+ */
+int testc_tinyrl_readline_buffered(void)
+{
+	const char *input = "skip\ntwo\nthree\n";
+	const char *expected[] = { "two", "three", NULL };
+	char buf[16];
+	int fd[2] = { -1, -1 };
+	FILE *f = NULL;
+	int retval = -1;
+
+	if (pipe(fd) < 0) {
+		printf("Can't create pipe\n");
+		return -1;
+	}
+	if (write(fd[1], input, strlen(input)) != (ssize_t)strlen(input)) {
+		printf("Can't write to pipe\n");
+		close(fd[0]);
+		close(fd[1]);
+		return -1;
+	}
+	close(fd[1]);
+
+	f = fdopen(fd[0], "r");
+	if (!f) {
+		close(fd[0]);
+		return -1;
+	}
+	if (!fgets(buf, sizeof(buf), f) || strcmp(buf, "skip\n")) {
+		printf("Can't read the first line by stdio\n");
+		fclose(f);
+		return -1;
+	}
+	retval = testc_tinyrl_expect(f, expected);
+	fclose(f);
+
+	return retval;
+}
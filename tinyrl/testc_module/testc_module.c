@@ -0,0 +1,14 @@
+#include <stdlib.h>
+
+int testc_version_major = 1;
+int testc_version_minor = 0;
+
+const char *testc_module[][2] = {
+
+	// Non-interactive reader
+	{"testc_tinyrl_readline_file", "Read lines of regular file"},
+	{"testc_tinyrl_readline_pipe", "Read lines of pipe, grow input block"},
+	{"testc_tinyrl_readline_buffered", "Take input buffered by stdio"},
+
+	{NULL, NULL}
+	};
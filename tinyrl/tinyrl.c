@@ -15,11 +15,17 @@
 
 /* POSIX HEADERS */
 #include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 #include "lub/string.h"
 
 #include "private.h"
 
+/* Initial size of non-interactive input block */
+#define TINYRL_IN_BLOCK (64 * 1024)
+
 /*-------------------------------------------------------- */
 static int utf8_wchar(const char *sp, unsigned long *sym_out)
 {
@@ -589,6 +595,171 @@ static bool_t tinyrl_key_tab(tinyrl_t * this, int key)
 	return result;
 }
 
+/*-------------------------------------------------------- */
+/*
+ * Drop the non-interactive input state. The unread data of
+ * previous stream is lost.
+ */
+static void tinyrl_input_reset(tinyrl_t * this)
+{
+	if (this->in_mmap)
+		munmap(this->in_buf, this->in_size);
+	else
+		free(this->in_buf);
+	this->in_buf = NULL;
+	this->in_size = 0;
+	this->in_len = 0;
+	this->in_pos = 0;
+	this->in_mmap = BOOL_FALSE;
+	this->in_eof = BOOL_FALSE;
+}
+
+/*-------------------------------------------------------- */
+/*
+ * The regular file is mapped at once. The stream is positioned to
+ * the end of file then so stdio doesn't read it again.
+ */
+static bool_t tinyrl_input_mmap(tinyrl_t * this, FILE * istream)
+{
+	struct stat st;
+	off_t offset;
+	void *p;
+
+	if (fstat(fileno(istream), &st) < 0)
+		return BOOL_FALSE;
+	if (!S_ISREG(st.st_mode) || (st.st_size <= 0))
+		return BOOL_FALSE;
+	offset = ftello(istream);
+	if ((offset < 0) || (offset > st.st_size))
+		return BOOL_FALSE;
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+		fileno(istream), 0);
+	if (MAP_FAILED == p)
+		return BOOL_FALSE;
+	madvise(p, st.st_size, MADV_SEQUENTIAL);
+	fseeko(istream, 0, SEEK_END);
+
+	this->in_buf = p;
+	this->in_size = st.st_size;
+	this->in_len = st.st_size;
+	this->in_pos = offset;
+	this->in_mmap = BOOL_TRUE;
+	this->in_eof = BOOL_TRUE;
+
+	return BOOL_TRUE;
+}
+
+/*-------------------------------------------------------- */
+/*
+ * Get the number of bytes that stdio has read from descriptor
+ * but the application has not consumed yet. The way is the same
+ * as gnulib's freadahead(). Other libc gives 0 so the data that
+ * was buffered by stdio before tinyrl is not seen.
+ */
+static size_t tinyrl_input_buffered(FILE * istream)
+{
+#if defined(__GLIBC__)
+#ifndef _IO_IN_BACKUP
+#define _IO_IN_BACKUP 0x100
+#endif
+	if (istream->_IO_write_ptr > istream->_IO_write_base)
+		return 0;
+	return (istream->_IO_read_end - istream->_IO_read_ptr) +
+		((istream->_flags & _IO_IN_BACKUP) ?
+		(istream->_IO_save_end - istream->_IO_save_base) : 0);
+#else
+	istream = istream; /* Happy compiler */
+	return 0;
+#endif
+}
+
+/*-------------------------------------------------------- */
+/*
+ * Read the next block of input. The unprocessed tail is moved to
+ * the beginning of buffer and the buffer grows if the line doesn't
+ * fit it. The read() returns the data that is available already so
+ * the line is processed as soon as it arrives. The data that is
+ * buffered by stdio already is taken first else it's lost.
+ */
+static bool_t tinyrl_input_fill(tinyrl_t * this, FILE * istream)
+{
+	ssize_t n;
+	size_t buffered;
+
+	if (this->in_eof)
+		return BOOL_FALSE;
+
+	if (this->in_pos > 0) {
+		memmove(this->in_buf, this->in_buf + this->in_pos,
+			this->in_len - this->in_pos);
+		this->in_len -= this->in_pos;
+		this->in_pos = 0;
+	}
+	if (this->in_len == this->in_size) {
+		size_t size = this->in_size ? (this->in_size * 2) :
+			TINYRL_IN_BLOCK;
+		char *tmp = realloc(this->in_buf, size);
+		if (!tmp)
+			return BOOL_FALSE;
+		this->in_buf = tmp;
+		this->in_size = size;
+	}
+	buffered = tinyrl_input_buffered(istream);
+	if (buffered > 0) {
+		if (buffered > (this->in_size - this->in_len))
+			buffered = this->in_size - this->in_len;
+		n = fread(this->in_buf + this->in_len, 1, buffered, istream);
+	} else {
+		do {
+			n = read(fileno(istream), this->in_buf + this->in_len,
+				this->in_size - this->in_len);
+		} while ((n < 0) && (EINTR == errno));
+	}
+	if (n <= 0) {
+		this->in_eof = BOOL_TRUE;
+		return BOOL_FALSE;
+	}
+	this->in_len += n;
+
+	return BOOL_TRUE;
+}
+
+/*-------------------------------------------------------- */
+/*
+ * Get the next line of non-interactive input. The line is not
+ * terminated and it's valid until the next call. Returns NULL on
+ * end of input.
+ */
+static const char *tinyrl_input_line(tinyrl_t * this, FILE * istream,
+	size_t * len)
+{
+	const char *line;
+	char *nl = NULL;
+
+	if (!this->in_buf && !tinyrl_input_mmap(this, istream) &&
+		!tinyrl_input_fill(this, istream))
+		return NULL;
+
+	while (!(nl = memchr(this->in_buf + this->in_pos, '\n',
+		this->in_len - this->in_pos))) {
+		if (!tinyrl_input_fill(this, istream))
+			break;
+	}
+	line = this->in_buf + this->in_pos;
+	if (nl) {
+		*len = nl - line;
+		this->in_pos += *len + 1;
+	} else {
+		/* The last line without newline */
+		*len = this->in_len - this->in_pos;
+		this->in_pos = this->in_len;
+		if (0 == *len)
+			return NULL;
+	}
+
+	return line;
+}
+
 /*-------------------------------------------------------- */
 static void tinyrl_fini(tinyrl_t * this)
 {
@@ -603,6 +774,8 @@ static void tinyrl_fini(tinyrl_t * this)
 	lub_string_free(this->kill_string);
 	lub_string_free(this->last_buffer);
 	lub_string_free(this->prompt);
+
+	tinyrl_input_reset(this);
 }
 
 /*-------------------------------------------------------- */
@@ -652,6 +825,12 @@ static void tinyrl_init(tinyrl_t * this, FILE * istream, FILE * ostream,
 	this->last_point = 0;
 	this->last_line_size = 0;
 	this->utf8 = BOOL_FALSE;
+	this->in_buf = NULL;
+	this->in_size = 0;
+	this->in_len = 0;
+	this->in_pos = 0;
+	this->in_mmap = BOOL_FALSE;
+	this->in_eof = BOOL_FALSE;
 
 	/* create the vt100 terminal */
 	this->term = tinyrl_vt100_new(NULL, ostream);
@@ -957,8 +1136,6 @@ static char *internal_readline(tinyrl_t * this,
 
 	/* Non-interactive session */
 	} else {
-		char *s = NULL, buffer[80];
-		size_t len = sizeof(buffer);
 		char *tmp = NULL;
 
 		/* manually reset the line state without redisplaying */
@@ -968,25 +1145,47 @@ static char *internal_readline(tinyrl_t * this,
 		if (str) {
 			tmp = lub_string_dup(str);
 			internal_insertline(this, tmp);
-		} else {
-			while (istream && (sizeof(buffer) == len) &&
-				(s = fgets(buffer, sizeof(buffer), istream))) {
-				s = internal_insertline(this, buffer);
-				len = strlen(buffer) + 1; /* account for the '\0' */
-			}
-			if (!s || ((this->line[0] == '\0') && feof(istream))) {
+		} else if (istream) {
+			/*
+			 * The piped input doesn't need the renderer. The
+			 * line is copied from the input block to the edit
+			 * buffer at once so the custom handler sees the
+			 * usual state.
+			 */
+			size_t len = 0;
+			const char *s = tinyrl_input_line(this, istream, &len);
+			if (s) {
+				const char *p = memchr(s, '\r', len);
+				if (p)
+					len = p - s;
+				/* skip any whitespace at the beginning */
+				while (len && isspace((unsigned char)*s)) {
+					s++;
+					len--;
+				}
+				if (!tinyrl_extend_line_buffer(this, len))
+					len = this->buffer_size;
+				memcpy(this->buffer, s, len);
+				this->buffer[len] = '\0';
+				this->line = this->buffer;
+				this->point = this->end = len;
+			} else {
 				/* time to finish the session */
 				this->line = NULL;
 				lerrno = ENOENT;
 			}
+		} else {
+			this->line = NULL;
+			lerrno = ENOENT;
 		}
 
 		/*
-		 * check against fgets returning null as either error or end of file.
-		 * This is a measure to stop potential task spin on encountering an
-		 * error from fgets.
+		 * The default handler just echoes newline. The custom
+		 * one can reject the line.
 		 */
-		if (this->line && !this->handlers[KEY_LF](this, KEY_LF)) {
+		if (this->line && (str ||
+			(this->handlers[KEY_LF] != tinyrl_key_crlf)) &&
+			!this->handlers[KEY_LF](this, KEY_LF)) {
 			/* an issue has occured */
 			this->line = NULL;
 			lerrno = ENOEXEC;
@@ -1502,6 +1701,7 @@ void tinyrl_disable_echo(tinyrl_t * this, char echo_char)
 /*--------------------------------------------------------- */
 void tinyrl__set_istream(tinyrl_t * this, FILE * istream)
 {
+	tinyrl_input_reset(this);
 	tinyrl_vt100__set_istream(this->term, istream);
 	if (istream) {
 		int fd;